@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Times pxc on a generated module of about 50000 lines parsing it, the first time with --ast-cache,
+# which parses it and writes the cache, and again with the cache, which loads the parsed module
+# from file.px.pxast. The times are for getting the parsed module and for all of pxc.
+# Usage: run.sh [build directory] [function count] (defaults to ../../build, where build.sh puts
+# pxc, and 10000 functions of 5 lines)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+FUNCTIONS="${2:-10000}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+generate() {
+    echo "module big;"
+    echo "func f0(x: int64) : int64 { return x; }"
+    for ((i = 1; i < FUNCTIONS; i++)); do
+        echo "func f$i(x: int64) : int64 {"
+        echo "    total: int64 = f$((i - 1))(x) * 3 + $i;"
+        echo "    for i in 0..x { if (i % 2 == 0) { total += i; } else { total -= $i; } }"
+        echo "    return total;"
+        echo "}"
+    done
+    echo "func main() : int32 { printInt64(f$((FUNCTIONS - 1))(3)); return 0; }"
+}
+generate > "$OUT/big.px"
+echo "$(wc -l < "$OUT/big.px") lines, $FUNCTIONS functions"
+
+TIMEFORMAT="%R s wall, %U s user, %S s system"
+step() {
+    echo "$1:"
+    echo -n "  pxc: "
+    { time (cd "$OUT" && "$BUILD/pxc" $2 big.px 2> report.txt); } 2>&1
+    if [ -s "$OUT/report.txt" ]; then
+        echo "  ($(cut -d: -f2 < "$OUT/report.txt" | sed 's/^ //'))"
+    fi
+}
+
+step "no cache" ""
+step "cache miss" "--ast-cache-report"
+step "cache hit" "--ast-cache-report"
+echo "cache file: $(wc -c < "$OUT/big.px.pxast") bytes, source: $(wc -c < "$OUT/big.px") bytes"
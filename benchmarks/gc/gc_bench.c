@@ -0,0 +1,125 @@
+// Stresses the garbage collector and reports throughput, pause times and heap size for each workload.
+// Usage: gc_bench [minimum heap MB] [growth factor]
+
+#include <PxRuntime.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct Node
+{
+    struct Node *left;
+    struct Node *right;
+} Node;
+
+static const size_t NODE_POINTERS[] = { offsetof(Node, left), offsetof(Node, right) };
+static const PxGcType NODE_TYPE = { sizeof(Node), 2, NODE_POINTERS };
+
+static const size_t SLOT_POINTERS[] = { 0 };
+static const PxGcType SLOT_TYPE = { sizeof(void*), 1, SLOT_POINTERS };
+
+static const PxGcType BYTES_TYPE = { 1, 0, NULL };
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, PxGcStats before)
+{
+    double seconds = now() - start;
+    PxGcStats stats = pxGcStats();
+    uint64_t collections = stats.collections - before.collections;
+    printf("%-14s %7.3f s %8.1f MB allocated %5llu collections, mean pause %8.1f us, max %8.1f us, heap %6.1f MB\n",
+           name, seconds, (stats.bytesAllocated - before.bytesAllocated) / 1e6, (unsigned long long) collections,
+           collections == 0 ? 0.0 : (stats.totalPauseNanoseconds - before.totalPauseNanoseconds) / 1e3 / collections,
+           stats.maxPauseNanoseconds / 1e3, stats.heapBytes / 1e6);
+}
+
+static Node *makeTree(int depth)
+{
+    Node *node = pxGcAllocate(&NODE_TYPE);
+    if (depth == 0)
+        return node;
+    void **roots[] = { (void**) &node };
+    PxGcFrame frame = { NULL, 1, roots };
+    pxGcPushFrame(&frame);
+    node->left = makeTree(depth - 1);
+    node->right = makeTree(depth - 1);
+    pxGcPopFrame(&frame);
+    return node;
+}
+
+static int64_t countTree(const Node *node)
+{
+    return node == NULL ? 0 : 1 + countTree(node->left) + countTree(node->right);
+}
+
+int main(int argc, char **argv)
+{
+    PxGcConfig config = { 4 * 1024 * 1024, 2.0 };
+    if (argc > 1)
+        config.minimumHeapBytes = (size_t) (atof(argv[1]) * 1024 * 1024);
+    if (argc > 2)
+        config.growthFactor = atof(argv[2]);
+    pxGcConfigure(config);
+
+    volatile int64_t sink = 0;
+    Node *longLived = NULL;
+    void **slots = NULL;
+    void **roots[] = { (void**) &longLived, (void**) &slots };
+    PxGcFrame frame = { NULL, 2, roots };
+    pxGcPushFrame(&frame);
+
+    // Binary trees: a long lived tree while many short lived trees come and go
+    PxGcStats before = pxGcStats();
+    double start = now();
+    longLived = makeTree(18);
+    for (int depth = 4; depth <= 16; depth += 2)
+    {
+        for (int i = 0; i < (1 << (20 - depth)); ++i)
+            sink += countTree(makeTree(depth));
+    }
+    sink += countTree(longLived);
+    report("binary trees", start, before);
+
+    // Churn: a table of slots whose objects are replaced at random, so garbage is spread across blocks
+    before = pxGcStats();
+    start = now();
+    slots = pxGcAllocateArray(&SLOT_TYPE, 100000);
+    uint32_t random = 12345;
+    for (int i = 0; i < 20000000; ++i)
+    {
+        random = random * 1664525u + 1013904223u;
+        slots[(random >> 8) % 100000] = pxGcAllocate(&NODE_TYPE);
+    }
+    report("churn", start, before);
+
+    // Large arrays, allocated singly outside the size classes
+    before = pxGcStats();
+    start = now();
+    for (int i = 0; i < 20000; ++i)
+    {
+        char *bytes = pxGcAllocateArray(&BYTES_TYPE, 4096 + (i % 64) * 1024);
+        sink += bytes[0];
+    }
+    report("large arrays", start, before);
+
+    pxGcPopFrame(&frame);
+
+    PxGcStats stats = pxGcStats();
+    printf("\npause histogram over %llu collections\n", (unsigned long long) stats.collections);
+    for (int i = 0; i < PX_GC_PAUSE_BUCKETS; ++i)
+    {
+        if (stats.pauseHistogram[i] != 0)
+            printf("  %s%8llu us %8llu\n", i == PX_GC_PAUSE_BUCKETS - 1 ? ">=" : "< ",
+                   i == PX_GC_PAUSE_BUCKETS - 1 ? 1ull << (i - 1) : 1ull << i,
+                   (unsigned long long) stats.pauseHistogram[i]);
+    }
+    printf("%.1f MB allocated, %.1f MB freed\n", stats.bytesAllocated / 1e6, stats.bytesFreed / 1e6);
+    return sink == 0;
+}
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+# Runs the garbage collector stress workloads.
+# Usage: run.sh [build directory] [minimum heap MB] [growth factor]
+# (the build directory defaults to ../../build, where build.sh puts the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CC="${CC:-cc}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+$CC -O2 -I"$HERE/../../runtime/include" "$HERE/gc_bench.c" "$BUILD/libpxruntime.a" -pthread -o "$OUT/gc_bench"
+"$OUT/gc_bench" "${@:2}"
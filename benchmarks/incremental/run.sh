@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# Times pxc on a generated module of about 50000 lines after a one line edit, compiling all of it
+# again and with --incremental, which only parses and generates the functions the edit affected again.
+# Usage: run.sh [build directory] [function count] (defaults to ../../build, where build.sh puts
+# pxc, and 10000 functions of 5 lines)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+FUNCTIONS="${2:-10000}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+# Every function loops and calls the one before it, so a chain of callers depends on each
+generate() {
+    echo "module big;"
+    echo "func f0(x: int64) : int64 { return x; }"
+    for ((i = 1; i < FUNCTIONS; i++)); do
+        echo "func f$i(x: int64) : int64 {"
+        echo "    total: int64 = f$((i - 1))(x);"
+        echo "    for i in 0..x { total += $i; }"
+        echo "    return total;"
+        echo "}"
+    done
+    echo "func main() : int32 { printInt64(f$((FUNCTIONS - 1))(3)); return 0; }"
+}
+generate > "$OUT/full.px"
+cp "$OUT/full.px" "$OUT/incremental.px"
+echo "$(wc -l < "$OUT/full.px") lines, $FUNCTIONS functions"
+
+TIMEFORMAT="%R s wall, %U s user, %S s system"
+# The edits change a constant in the last function and in one in the middle, which leaves what
+# their callers may do as it was, and then make the middle one call printInt64, which does not
+edit() {
+    sed -i "$1" "$OUT/full.px" "$OUT/incremental.px"
+}
+step() {
+    echo "$1:"
+    echo -n "  full:        "
+    { time (cd "$OUT" && "$BUILD/pxc" full.px); } 2>&1
+    echo -n "  incremental: "
+    { time (cd "$OUT" && "$BUILD/pxc" --incremental-report incremental.px 2> report.txt); } 2>&1
+    echo "  ($(cut -d: -f2 < "$OUT/report.txt" | sed 's/^ //'))"
+}
+
+step "first compile"
+step "no edit"
+last=$((FUNCTIONS - 1))
+edit "s/total += $last;/total += $((last + 1));/"
+step "one line edit in f$last"
+middle=$((FUNCTIONS / 2))
+edit "s/total += $middle;/total += $((middle + 1));/"
+step "one line edit in f$middle"
+edit "s/total += $((middle + 1));/total += $((middle + 1)); printInt64(total);/"
+step "one line edit in f$middle that its callers depend on"
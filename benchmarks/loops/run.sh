@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Times each loop kernel written with a counted for loop against the same kernel written with while.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts pxc and the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CC="${CC:-cc}"
+CFLAGS="${CFLAGS:--O3 -march=native}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+for source in "$HERE"/*.px; do
+    name="$(basename "$source" .px)"
+    cp "$source" "$OUT"
+    (cd "$OUT" && "$BUILD/pxc" "$name.px")
+    $CC $CFLAGS -I"$HERE/../../runtime/include" "$OUT/$name.px.c" "$BUILD/libpxruntime.a" -o "$OUT/$name"
+done
+
+TIMEFORMAT="%R s"
+for kernel in sum saxpy; do
+    for loop in for while; do
+        echo -n "$kernel ($loop): "
+        { time "$OUT/${kernel}_$loop" > /dev/null; } 2>&1
+    done
+done
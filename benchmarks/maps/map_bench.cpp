@@ -0,0 +1,127 @@
+// Compares the px map with std::unordered_map: inserting random integer keys, finding keys that are
+// present and keys that are not, removing them, and counting string keys.
+// Usage: map_bench
+
+extern "C" {
+    #include <PxMap.h>
+}
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+PX_MAP_DEFINE(Int64, int64_t, int64_t, pxHashInteger, PX_MAP_EQUALS)
+PX_MAP_DEFINE(String, PxString, int64_t, pxStringHash, pxStringEquals)
+
+static const int64_t KEYS = 1000000;
+static const int64_t WORDS = 200000;
+static const int ROUNDS = 5;
+
+struct StringHash
+{
+    size_t operator()(const std::string &text) const
+    {
+        return std::hash<std::string>{}(text);
+    }
+};
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const char *table, const char *operation, double seconds, int64_t count)
+{
+    printf("%-20s %-14s %7.2f ns/op\n", table, operation, seconds / (double) (count * ROUNDS) * 1e9);
+}
+
+int main()
+{
+    std::vector<int64_t> keys(KEYS), missing(KEYS);
+    uint64_t seed = 42;
+    for (int64_t i = 0; i < KEYS; ++i)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        keys[i] = (int64_t) (seed >> 1);
+        missing[i] = -(int64_t) (seed >> 2) - 1;
+    }
+    std::vector<std::string> words;
+    for (int64_t i = 0; i < WORDS; ++i)
+        words.push_back("word" + std::to_string(i % (WORDS / 4) * 7919));
+    std::vector<PxString> pxWords;
+    for (auto &word : words)
+        pxWords.push_back(pxStringFromBytes((const int8_t*) word.data(), (intptr_t) word.size()));
+
+    volatile int64_t sink = 0;
+    double insert = 0, hit = 0, miss = 0, erase = 0, count = 0;
+    for (int r = 0; r < ROUNDS; ++r)
+    {
+        pxRegionEnter();
+        PxMap map = pxMapCreate();
+        double start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            *pxMapSlot_Int64(&map, keys[i]) = i;
+        insert += now() - start;
+        start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            sink += pxMapGet_Int64(&map, keys[i]);
+        hit += now() - start;
+        start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            sink += pxMapContains_Int64(&map, missing[i]);
+        miss += now() - start;
+        start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            sink += pxMapRemove_Int64(&map, keys[i]);
+        erase += now() - start;
+
+        PxMap counts = pxMapCreate();
+        start = now();
+        for (auto &word : pxWords)
+            *pxMapSlot_String(&counts, word) += 1;
+        count += now() - start;
+        pxRegionExit();
+    }
+    report("px map", "insert", insert, KEYS);
+    report("px map", "find hit", hit, KEYS);
+    report("px map", "find miss", miss, KEYS);
+    report("px map", "remove", erase, KEYS);
+    report("px map", "count strings", count, WORDS);
+
+    insert = hit = miss = erase = count = 0;
+    for (int r = 0; r < ROUNDS; ++r)
+    {
+        std::unordered_map<int64_t, int64_t> map;
+        double start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            map[keys[i]] = i;
+        insert += now() - start;
+        start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            sink += map.find(keys[i])->second;
+        hit += now() - start;
+        start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            sink += map.count(missing[i]);
+        miss += now() - start;
+        start = now();
+        for (int64_t i = 0; i < KEYS; ++i)
+            sink += map.erase(keys[i]);
+        erase += now() - start;
+
+        std::unordered_map<std::string, int64_t, StringHash> counts;
+        start = now();
+        for (auto &word : words)
+            counts[word] += 1;
+        count += now() - start;
+    }
+    report("std::unordered_map", "insert", insert, KEYS);
+    report("std::unordered_map", "find hit", hit, KEYS);
+    report("std::unordered_map", "find miss", miss, KEYS);
+    report("std::unordered_map", "remove", erase, KEYS);
+    report("std::unordered_map", "count strings", count, WORDS);
+
+    return sink == 0;
+}
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Times the px map against std::unordered_map, with the SSE2 group probe and with the portable one.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CXX="${CXX:-c++}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+$CXX -O2 -std=c++17 -I"$HERE/../../runtime/include" "$HERE/map_bench.cpp" "$BUILD/libpxruntime.a" -pthread -o "$OUT/map_bench"
+$CXX -O2 -std=c++17 -DPX_MAP_NO_SSE2 -I"$HERE/../../runtime/include" "$HERE/map_bench.cpp" "$BUILD/libpxruntime.a" -pthread -o "$OUT/map_bench_portable"
+echo "SSE2 probe:"
+"$OUT/map_bench"
+echo
+echo "Portable probe:"
+"$OUT/map_bench_portable" | grep "px map"
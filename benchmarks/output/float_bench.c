@@ -0,0 +1,89 @@
+// Compares the shortest float formatter with snprintf at the precision that always round trips.
+// Timings go to stderr.
+
+#include <PxRuntime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define COUNT 5000000
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void report(const char *name, double start, size_t bytes)
+{
+    double seconds = now() - start;
+    fprintf(stderr, "%-22s %7.1f ns/value  (%zu bytes)\n", name, seconds * 1e9 / COUNT, bytes);
+}
+
+int main(void)
+{
+    float *floats = malloc(COUNT * sizeof(float));
+    double *doubles = malloc(COUNT * sizeof(double));
+    uint64_t state = 88172645463325252ull;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        // Finite values spread over all exponents
+        uint64_t bits = nextRandom(&state);
+        uint32_t floatBits = (uint32_t) bits & 0xBFFFFFFFu;
+        uint64_t doubleBits = bits & 0xBFFFFFFFFFFFFFFFull;
+        memcpy(&floats[i], &floatBits, sizeof(float));
+        memcpy(&doubles[i], &doubleBits, sizeof(double));
+    }
+
+    char text[64];
+    size_t bytes = 0;
+    double start = now();
+    for (int i = 0; i < COUNT; ++i)
+        bytes += snprintf(text, sizeof(text), "%.9g", floats[i]);
+    report("snprintf %.9g", start, bytes);
+
+    bytes = 0;
+    start = now();
+    for (int i = 0; i < COUNT; ++i)
+        bytes += pxFormatFloat32(floats[i], text);
+    report("pxFormatFloat32", start, bytes);
+
+    bytes = 0;
+    start = now();
+    for (int i = 0; i < COUNT; ++i)
+        bytes += snprintf(text, sizeof(text), "%.17g", doubles[i]);
+    report("snprintf %.17g", start, bytes);
+
+    bytes = 0;
+    start = now();
+    for (int i = 0; i < COUNT; ++i)
+        bytes += pxFormatFloat64(doubles[i], text);
+    report("pxFormatFloat64", start, bytes);
+
+    start = now();
+    for (int i = 0; i < COUNT; ++i)
+        printf("%f", floats[i]);
+    fflush(stdout);
+    report("printf %f", start, 0);
+
+    start = now();
+    for (int i = 0; i < COUNT; ++i)
+        printFloat(floats[i]);
+    pxFlush();
+    report("printFloat", start, 0);
+
+    free(floats);
+    free(doubles);
+    return 0;
+}
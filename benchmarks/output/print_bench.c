@@ -0,0 +1,79 @@
+// Compares the buffered runtime output functions with the printf calls they replaced.
+// Timings go to stderr, so redirect stdout: print_bench > /dev/null
+
+#include <PxRuntime.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#define COUNT 10000000
+
+static void printfInt(int32_t i)
+{
+    printf("%d", i);
+}
+
+static void printfString(PxString str)
+{
+    printf("%.*s", (int) str.byteLength, (const char*) pxStringBytes(&str));
+}
+
+// Spreads the values over the whole int32 range, negatives included
+static int32_t value(int32_t i)
+{
+    return (int32_t) ((uint32_t) i * 2654435761u);
+}
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, double bytes)
+{
+    double seconds = now() - start;
+    fprintf(stderr, "%-22s %7.3f s %8.1f MB/s\n", name, seconds, bytes / seconds / 1e6);
+}
+
+int main(void)
+{
+    static const int8_t text[] = "report line ";
+    PxString line = pxStringFromBytes(text, sizeof(text) - 1);
+    PxString space = pxStringFromBytes((const int8_t*) " ", 1);
+    double intBytes = 0;
+    for (int32_t i = 0; i < COUNT; ++i)
+        intBytes += snprintf(NULL, 0, "%d ", value(i));
+
+    double start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+    {
+        printfInt(value(i));
+        putchar(' ');
+    }
+    fflush(stdout);
+    report("printf int", start, intBytes);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+    {
+        printInt(value(i));
+        printString(space);
+    }
+    pxFlush();
+    report("printInt", start, intBytes);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        printfString(line);
+    fflush(stdout);
+    report("printf string", start, (double) COUNT * line.byteLength);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        printString(line);
+    pxFlush();
+    report("printString", start, (double) COUNT * line.byteLength);
+    return 0;
+}
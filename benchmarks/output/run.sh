@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Times the buffered runtime output and the float formatter against printf.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CC="${CC:-cc}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+for bench in print_bench float_bench; do
+    $CC -O2 -I"$HERE/../../runtime/include" "$HERE/$bench.c" "$BUILD/libpxruntime.a" -pthread -o "$OUT/$bench"
+    "$OUT/$bench" > /dev/null
+done
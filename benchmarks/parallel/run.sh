@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Times a kernel with irregular iterations (Collatz sequence lengths) as a sequential for loop and as a
+# parallel for on pools of 1, 2, 4, ... workers up to one per processor.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts pxc and the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CC="${CC:-cc}"
+CFLAGS="${CFLAGS:--O3 -march=native}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+for source in "$HERE"/*.px; do
+    name="$(basename "$source" .px)"
+    cp "$source" "$OUT"
+    (cd "$OUT" && "$BUILD/pxc" "$name.px")
+    $CC $CFLAGS -I"$HERE/../../runtime/include" "$OUT/$name.px.c" "$BUILD/libpxruntime.a" -pthread -o "$OUT/$name"
+done
+
+PROCESSORS="$(getconf _NPROCESSORS_ONLN)"
+TIMEFORMAT="%R s"
+echo -n "collatz (sequential): "
+{ time "$OUT/collatz_sequential" > /dev/null; } 2>&1
+workers=1
+while true; do
+    echo -n "collatz (parallel, $workers workers): "
+    { time PX_WORKERS=$workers "$OUT/collatz_parallel" > /dev/null; } 2>&1
+    [ "$workers" -ge "$PROCESSORS" ] && break
+    workers=$((workers * 2))
+    [ "$workers" -gt "$PROCESSORS" ] && workers=$PROCESSORS
+done
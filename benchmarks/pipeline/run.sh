@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Times parsing generated modules of growing size serially and with the scanner on a thread of its
+# own (--pipeline-threshold=0), as --parse-report gives it, and the generated C is compared. The
+# scanner only runs alongside the parser with a second processor free.
+# Usage: run.sh [build directory] [largest function count] (defaults to ../../build, where build.sh
+# puts pxc, and 40000 functions of 5 lines)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+LARGEST="${2:-40000}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+generate() {
+    echo "module big;"
+    echo "func f0(x: int64) : int64 { return x; }"
+    for ((i = 1; i < $1; i++)); do
+        echo "func f$i(x: int64) : int64 {"
+        echo "    total: int64 = f$((i - 1))(x) * 3 + $i;"
+        echo "    for i in 0..x { if (i % 2 == 0) { total += i; } else { total -= $i; } }"
+        echo "    return total;"
+        echo "}"
+    done
+    echo "func main() : int32 { printInt64(f$(($1 - 1))(3)); return 0; }"
+}
+
+echo "$(nproc) processors"
+for ((functions = 1250; functions <= LARGEST; functions *= 2)); do
+    generate "$functions" > "$OUT/big.px"
+    echo "$(wc -c < "$OUT/big.px") bytes, $functions functions:"
+    for mode in serial pipelined; do
+        threshold=$([ "$mode" = pipelined ] && echo 0 || echo 18446744073709551615)
+        best=""
+        for run in 1 2 3; do
+            (cd "$OUT" && "$BUILD/pxc" --parse-report --pipeline-threshold="$threshold" big.px 2> report.txt)
+            time=$(sed 's/.* in \([0-9.]*\) ms/\1/' < "$OUT/report.txt")
+            if [ -z "$best" ] || awk "BEGIN { exit !($time < $best) }"; then
+                best="$time"
+            fi
+        done
+        cp "$OUT/big.px.c" "$OUT/$mode.c"
+        echo "  $mode: $best ms"
+    done
+    cmp -s "$OUT/serial.c" "$OUT/pipelined.c" || echo "  the generated C differs"
+done
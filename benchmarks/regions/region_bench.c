@@ -0,0 +1,90 @@
+// Compares region allocation with malloc and free, as a request handler would use them: many small
+// objects are allocated, touched, and all freed when the request ends.
+// Usage: region_bench
+
+#include <PxRuntime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define REQUESTS 2000
+#define OBJECTS_PER_REQUEST 10000
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start)
+{
+    double seconds = now() - start;
+    double count = (double) REQUESTS * OBJECTS_PER_REQUEST;
+    printf("%-22s %7.2f ns/object %8.1f M objects/s\n", name, seconds / count * 1e9, count / seconds / 1e6);
+}
+
+// Object sizes from 16 to 256 bytes, varying within a request
+static size_t objectSize(int32_t i)
+{
+    return 16 + (((uint32_t) i * 2654435761u) >> 24);
+}
+
+int main(void)
+{
+    static void *objects[OBJECTS_PER_REQUEST];
+    volatile uint64_t sink = 0;
+
+    double start = now();
+    for (int32_t r = 0; r < REQUESTS; ++r)
+    {
+        for (int32_t i = 0; i < OBJECTS_PER_REQUEST; ++i)
+        {
+            objects[i] = malloc(objectSize(i));
+            *(int32_t*) objects[i] = i;
+        }
+        for (int32_t i = 0; i < OBJECTS_PER_REQUEST; ++i)
+        {
+            sink += *(int32_t*) objects[i];
+            free(objects[i]);
+        }
+    }
+    report("malloc/free", start);
+
+    for (int hugePages = 0; hugePages < 2; ++hugePages)
+    {
+        pxRegionUseHugePages(hugePages);
+        start = now();
+        for (int32_t r = 0; r < REQUESTS; ++r)
+        {
+            pxRegionEnter();
+            for (int32_t i = 0; i < OBJECTS_PER_REQUEST; ++i)
+            {
+                objects[i] = pxRegionAllocate(pxCurrentRegion(), objectSize(i), 8);
+                *(int32_t*) objects[i] = i;
+            }
+            for (int32_t i = 0; i < OBJECTS_PER_REQUEST; ++i)
+                sink += *(int32_t*) objects[i];
+            pxRegionExit();
+        }
+        report(hugePages ? "region, huge pages" : "region", start);
+    }
+
+    start = now();
+    for (int32_t r = 0; r < REQUESTS; ++r)
+    {
+        pxRegionEnter();
+        for (int32_t i = 0; i < OBJECTS_PER_REQUEST; ++i)
+        {
+            objects[i] = pxNew(objectSize(i));
+            *(int32_t*) objects[i] = i;
+        }
+        for (int32_t i = 0; i < OBJECTS_PER_REQUEST; ++i)
+            sink += *(int32_t*) objects[i];
+        pxRegionExit();
+    }
+    report("pxNew (zeroed)", start);
+
+    return sink == 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Feeds pxc repl more and more definitions, each calling the one before it, followed by a call to
+# the last, and reports the time per input, which should stay flat however many came before.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts pxc and the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+for count in 1000 2000 4000 8000; do
+    {
+        echo "func f0(x: int64) : int64 { return x + 1; }"
+        for ((i = 1; i < count; i++)); do
+            echo "func f$i(x: int64) : int64 { return f$((i - 1))(x) % 1000 + 1; }"
+        done
+        echo "f$((count - 1))(0)"
+    } > "$OUT/inputs.px"
+    start=$(date +%s%N)
+    "$BUILD/pxc" repl < "$OUT/inputs.px" > /dev/null
+    end=$(date +%s%N)
+    echo "$count inputs: $(( (end - start) / count / 1000 )) us per input"
+done
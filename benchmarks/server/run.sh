@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# Times many small compiles, as an editor or build loop makes them, run by pxc itself and sent to
+# pxc --server through pxc-client: first of a module that does not change, then of one that is
+# edited before each compile.
+# Usage: run.sh [build directory] [compile count] (defaults to ../../build, where build.sh puts
+# pxc and pxc-client, and 200 compiles)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+COUNT="${2:-200}"
+OUT="$(mktemp -d)"
+export PXC_SOCKET="$OUT/pxc.sock"
+trap '"$BUILD/pxc-client" --stop > /dev/null 2>&1 || true; rm -rf "$OUT"' EXIT
+
+cat > "$OUT/lib.px" <<PX
+module lib;
+func square(x: int64) : int64 { return x * x; }
+PX
+generate() {
+    echo "module app;"
+    echo "import lib;"
+    for ((i = 0; i < 50; i++)); do
+        echo "func f$i(x: int64) : int64 { total: int64 = 0; for i in 0..x { total += square(i) + $1; } return total; }"
+    done
+    echo "func main() : int32 { printInt64(f49(3)); return 0; }"
+}
+generate 0 > "$OUT/app.px"
+cd "$OUT"
+"$BUILD/pxc" lib.px
+
+"$BUILD/pxc" --server &
+for ((i = 0; i < 100; i++)); do
+    [ -S "$PXC_SOCKET" ] && break
+    sleep 0.05
+done
+
+time_ms() {
+    local start end
+    start=$(date +%s%N)
+    "$@"
+    end=$(date +%s%N)
+    echo "$(( (end - start) / 1000000 )) ms"
+}
+same() {
+    for ((i = 0; i < COUNT; i++)); do
+        "$@" app.px
+    done
+}
+edited() {
+    for ((i = 0; i < COUNT; i++)); do
+        generate "$i" > app.px
+        "$@" app.px
+    done
+}
+
+echo "$COUNT compiles of an unchanged module:"
+echo "  pxc:        $(time_ms same "$BUILD/pxc")"
+echo "  pxc-client: $(time_ms same "$BUILD/pxc-client")"
+echo "$COUNT compiles of a module edited before each:"
+echo "  pxc:        $(time_ms edited "$BUILD/pxc")"
+echo "  pxc-client: $(time_ms edited "$BUILD/pxc-client")"
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Times the PxString and PxStringBuilder runtime functions.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CC="${CC:-cc}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+$CC -O2 -I"$HERE/../../runtime/include" "$HERE/string_bench.c" "$BUILD/libpxruntime.a" -pthread -o "$OUT/string_bench"
+"$OUT/string_bench"
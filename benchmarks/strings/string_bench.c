@@ -0,0 +1,113 @@
+// Times each PxString and PxStringBuilder operation over short (inline) and long (arena) strings.
+// Usage: string_bench
+
+#include <PxRuntime.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define COUNT 10000000
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start)
+{
+    double seconds = now() - start;
+    printf("%-22s %7.2f ns/op\n", name, seconds / COUNT * 1e9);
+}
+
+static PxString make(const char *text)
+{
+    return pxStringFromBytes((const int8_t*) text, (intptr_t) strlen(text));
+}
+
+int main(void)
+{
+    PxString shortA = make("short key 1");
+    PxString shortB = make("short key 2");
+    PxString longA = make("a longer string that lives in the arena, 1");
+    PxString longB = make("a longer string that lives in the arena, 2");
+    PxString utf8 = make(u8"こんにちは世界, a mixed string of code points");
+    volatile uint64_t sink = 0;
+
+    double start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringEquals(shortA, (i & 1) ? shortA : shortB);
+    report("equals short", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringEquals(longA, (i & 1) ? longA : longB);
+    report("equals long", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringCompare(longA, (i & 1) ? longA : longB);
+    report("compare long", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringHash((i & 1) ? shortA : shortB);
+    report("hash short", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringHash((i & 1) ? longA : longB);
+    report("hash long", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringConcat(make("ab"), make("cd")).byteLength;
+    report("concat short", start);
+
+    start = now();
+    PxString built = make("");
+    for (int32_t i = 0; i < COUNT; ++i)
+        built = pxStringConcat(built, shortA);
+    sink += built.byteLength;
+    report("append in loop", start);
+    pxStringArenaReset();
+
+    start = now();
+    PxStringBuilder *builder = newStringBuilder();
+    for (int32_t i = 0; i < COUNT; ++i)
+        appendString(builder, shortA);
+    sink += finishStringBuilder(builder).byteLength;
+    report("builder appendString", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        appendInt(builder, i);
+    sink += finishStringBuilder(builder).byteLength;
+    report("builder appendInt", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        appendFloat64(builder, i * 0.37);
+    sink += finishStringBuilder(builder).byteLength;
+    report("builder appendFloat64", start);
+    pxStringArenaReset();
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringSlice(longA, i & 7, 30).byteLength;
+    report("slice ascii", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringSlice(utf8, i & 7, 20).byteLength;
+    report("slice utf8", start);
+
+    start = now();
+    for (int32_t i = 0; i < COUNT; ++i)
+        sink += pxStringCharAt(utf8, i & 15);
+    report("charAt utf8", start);
+
+    return sink == 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Times a short and a long running program interpreted, interpreted with hot functions compiled in
+# the background (pxc run --tiered), and compiled to C ahead of time, counting the C compiler.
+# Usage: run.sh [build directory] (defaults to ../../build, where build.sh puts pxc and the runtime)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+BUILD="$(cd "${1:-$HERE/../../build}" && pwd)"
+CC="${CC:-cc}"
+CFLAGS="${CFLAGS:--O2}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+TIMEFORMAT="%R s"
+for program in short long; do
+    cp "$HERE/$program.px" "$OUT"
+    echo -n "$program (interpreted): "
+    { time "$BUILD/pxc" run "$OUT/$program.px" > /dev/null; } 2>&1
+    echo -n "$program (tiered): "
+    { time "$BUILD/pxc" run --tiered "$OUT/$program.px" > /dev/null; } 2>&1
+    echo -n "$program (compiled to C, with the C compiler): "
+    { time (cd "$OUT" && "$BUILD/pxc" "$program.px" && \
+        $CC $CFLAGS -I"$HERE/../../runtime/include" "$program.px.c" "$BUILD/libpxruntime.a" -pthread -o "$program" && \
+        "./$program" > /dev/null); } 2>&1
+done
@@ -0,0 +1,99 @@
+// Compares filling a px dynamic array with push against a preallocated C array and a realloc'd
+// buffer, and shows how the growth factor trades pushes per second against unused capacity.
+// Usage: vector_bench
+
+#include <PxRuntime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUNDS 200
+#define ELEMENTS 1000000
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, double unused)
+{
+    double seconds = now() - start;
+    double count = (double) ROUNDS * ELEMENTS;
+    printf("%-24s %6.2f ns/push %8.1f M pushes/s %6.1f%% unused\n", name, seconds / count * 1e9, count / seconds / 1e6, unused * 100);
+}
+
+int main(void)
+{
+    volatile int64_t sink = 0;
+
+    int64_t *fixed = malloc(sizeof(int64_t) * ELEMENTS);
+    double start = now();
+    for (int32_t r = 0; r < ROUNDS; ++r)
+    {
+        for (int64_t i = 0; i < ELEMENTS; ++i)
+            fixed[i] = i;
+        sink += fixed[ELEMENTS - 1];
+    }
+    report("fixed array", start, 0);
+    free(fixed);
+
+    double unused = 0;
+    start = now();
+    for (int32_t r = 0; r < ROUNDS; ++r)
+    {
+        int64_t *data = NULL;
+        intptr_t length = 0, capacity = 0;
+        for (int64_t i = 0; i < ELEMENTS; ++i)
+        {
+            if (length == capacity)
+            {
+                capacity = capacity == 0 ? 4 : capacity * 2;
+                data = realloc(data, sizeof(int64_t) * capacity);
+            }
+            data[length++] = i;
+        }
+        sink += data[ELEMENTS - 1];
+        unused = 1 - (double) length / capacity;
+        free(data);
+    }
+    report("realloc, factor 2", start, unused);
+
+    const double factors[] = { 1.5, 2.0, 4.0 };
+    for (int f = 0; f < 3; ++f)
+    {
+        pxVectorSetGrowthFactor(factors[f]);
+        start = now();
+        for (int32_t r = 0; r < ROUNDS; ++r)
+        {
+            pxRegionEnter();
+            PxVector vector = pxVectorCreate();
+            for (int64_t i = 0; i < ELEMENTS; ++i)
+                *(int64_t*) pxVectorPush(&vector, sizeof(int64_t)) = i;
+            sink += ((int64_t*) vector.data)[ELEMENTS - 1];
+            unused = 1 - (double) vector.length / vector.capacity;
+            pxRegionExit();
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "push, factor %.1f", factors[f]);
+        report(name, start, unused);
+    }
+
+    pxVectorSetGrowthFactor(2.0);
+    start = now();
+    for (int32_t r = 0; r < ROUNDS; ++r)
+    {
+        pxRegionEnter();
+        PxVector vector = pxVectorCreate();
+        pxVectorReserve(&vector, ELEMENTS, sizeof(int64_t));
+        for (int64_t i = 0; i < ELEMENTS; ++i)
+            *(int64_t*) pxVectorPush(&vector, sizeof(int64_t)) = i;
+        sink += ((int64_t*) vector.data)[ELEMENTS - 1];
+        pxRegionExit();
+    }
+    report("push after reserve", start, 0);
+
+    return sink == 0;
+}
@@ -0,0 +1,45 @@
+
+#ifndef _PX_ASTCACHE_H_
+#define _PX_ASTCACHE_H_
+
+#include "Utf8String.h"
+#include "ast/AST.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace px {
+
+    // The parsed tree of a module, cached in a binary file (.pxast) next to it so pxc --ast-cache
+    // can skip parsing a module whose source did not change. The file holds a hash of the source it
+    // was parsed from, and is only used for the same source. It is mapped into memory and the
+    // nodes are built straight from it, in one pass.
+    //
+    // The layout, in 32 bit words of the writer's byte order:
+    //   header   magic, version, source hash (low and high word), string count, node word count
+    //   nodes    the module's name, position and imports, then its statements, each node in
+    //            preorder as its NodeType, position (offset, line, column), fields and children.
+    //            A missing child is NodeType::UNKNOWN; a list starts with its length.
+    //   strings  a byte length followed by the UTF-8 bytes, padded to a word
+    // Names and literals are indices of strings, so the file holds no pointers or offsets that
+    // depend on where it is loaded.
+    class AstCache
+    {
+    public:
+        static const uint32_t MAGIC = 0x43415850; // "PXAC"
+        static const uint32_t VERSION = 1;
+
+        // FNV-1a over the source's bytes
+        static uint64_t hash(const Utf8String &source);
+        // Writes module, parsed from source with sourceHash, to path, giving whether it could be
+        // written
+        static bool write(const std::string &path, uint64_t sourceHash, ast::Module &module);
+        // Gives the module cached at path when it was parsed from source with sourceHash, or
+        // nullptr when it is missing, stale or not a cache. fileName must outlive the module.
+        static std::unique_ptr<ast::Module> read(const std::string &path, uint64_t sourceHash, const Utf8String &fileName);
+    };
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+
+#ifndef _PX_COMPILESERVER_H_
+#define _PX_COMPILESERVER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace px {
+
+    // The files a compile read and the ones it wrote, which tell the server when what it gave is
+    // out of date
+    struct CompileRecord
+    {
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+    };
+
+    // What a compile printed and the exit code pxc would have given
+    struct CompileReply
+    {
+        int32_t exitCode;
+        std::string out;
+        std::string err;
+    };
+
+    // pxc --server: compiles for clients that connect to a Unix domain socket, so a compile does not
+    // pay for starting pxc, and the interfaces of imported modules stay in memory between compiles.
+    // A request is the client's working directory and pxc's arguments; the reply is what the compile
+    // printed and its exit code. Requests are served one at a time, in the client's directory.
+    //
+    // A compile that succeeded is remembered with the size, modification time and hash of each file
+    // it read and wrote. The same request is answered from it, without compiling, while those files
+    // are the same: a file whose size or time changed is hashed, and only a changed hash compiles again.
+    //
+    // The protocol, in the byte order of the machine both ends run on:
+    //   request  magic, kind (COMPILE or STOP), string count, then the directory and the arguments
+    //   reply    exit code, standard output, standard error
+    // where a string is a 32 bit byte length followed by its bytes.
+    class CompileServer
+    {
+    public:
+        static const uint32_t MAGIC = 0x56535850; // "PXSV"
+        enum Kind : uint32_t
+        {
+            COMPILE = 1,
+            STOP = 2
+        };
+        // Compiles as pxc would with arguments, filling in record, and gives the exit code
+        typedef std::function<int32_t(const std::vector<std::string> &arguments, CompileRecord &record)> CompileFunction;
+
+        CompileServer(const std::string &socketPath, const CompileFunction &compile);
+        ~CompileServer();
+
+        // Starts listening, giving false with the reason on standard error when it can not
+        bool listen();
+        // Serves requests until a client asks the server to stop
+        void run();
+
+        // How many requests were compiled and how many were answered from an earlier compile
+        size_t compileCount() const
+        {
+            return compiles;
+        }
+        size_t reuseCount() const
+        {
+            return reuses;
+        }
+
+        // $PXC_SOCKET, or /tmp/pxc-<user id>.sock
+        static std::string defaultSocketPath();
+        // Has the server at socketPath compile arguments in directory, giving false when it can
+        // not be reached
+        static bool request(const std::string &socketPath, const std::string &directory, const std::vector<std::string> &arguments,
+                            CompileReply &reply);
+        static bool stop(const std::string &socketPath);
+
+    private:
+        struct Stamp
+        {
+            std::string path;
+            bool exists;
+            int64_t modified;
+            int64_t size;
+            uint64_t hash;
+        };
+        struct Result
+        {
+            CompileReply reply;
+            std::vector<Stamp> stamps;
+        };
+
+        bool serve(int connection);
+        CompileReply compile(const std::vector<std::string> &arguments, CompileRecord &record);
+        static Stamp stamp(const std::string &path);
+        static bool unchanged(Stamp &recorded);
+
+        const std::string socketPath;
+        const CompileFunction compileFunction;
+        int listener;
+        std::string directory;
+        std::unordered_map<std::string, Result> results;
+        size_t compiles;
+        size_t reuses;
+    };
+
+}
+
+#endif
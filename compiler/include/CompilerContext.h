@@ -0,0 +1,61 @@
+
+#ifndef _PX_COMPILERCONTEXT_H_
+#define _PX_COMPILERCONTEXT_H_
+
+#include "Error.h"
+#include "Scope.h"
+#include "Utf8String.h"
+#include "ast/AST.h"
+#include "ast/Declaration.h"
+#include "ast/Statement.h"
+#include "vm/Bytecode.h"
+
+#include <memory>
+#include <vector>
+
+namespace px {
+
+    class InterfaceCache;
+
+    struct CompileOptions
+    {
+        bool inlining;
+        size_t inlineThreshold;
+    };
+
+    // Compiles modules held in memory, for programs that embed the compiler through libpx: the source
+    // is a buffer, and the C, the bytecode and the errors come back in memory instead of in files
+    // and on standard output. A context compiles one module at a time, as many as it is given; each
+    // compile's tree and scopes are freed before the next one starts. The compiler keeps nothing
+    // outside of its context, so contexts on different threads share nothing but constant tables.
+    class CompilerContext
+    {
+    public:
+        explicit CompilerContext(const CompileOptions &options);
+
+        // Compiles source to C into output, giving false when it has errors. fileName names the
+        // module in errors, and imports are looked for next to it.
+        bool compileToC(const Utf8String &fileName, const Utf8String &source, Utf8String &output);
+        // Compiles source to bytecode the Interpreter runs, giving nullptr when it has errors
+        std::unique_ptr<Program> compileToBytecode(const Utf8String &fileName, const Utf8String &source);
+
+        // The errors of the last compile
+        const std::vector<Error> &diagnostics() const
+        {
+            return errors.all();
+        }
+
+        // Where imported interfaces are kept between compiles, if anywhere
+        void useInterfaces(InterfaceCache *cache);
+
+    private:
+        std::unique_ptr<ast::Module> analyze(const Utf8String &fileName, const Utf8String &source, ScopeTree &scopeTree);
+
+        const CompileOptions options;
+        ErrorLog errors;
+        InterfaceCache *interfaces;
+    };
+
+}
+
+#endif
@@ -4,20 +4,63 @@
 
 #include "ast/Visitor.h"
 #include "Error.h"
+#include "ModuleInterface.h"
 #include "Scope.h"
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 namespace px {
 
+    // What the analysis of a function definition found that the functions calling it depend on,
+    // which the IncrementalCompiler keeps so the definition need not be analyzed again
+    struct FunctionFacts
+    {
+        uint32_t attributes = 0;
+        bool writesMemory = false;
+        bool writesGlobals = false;
+        bool readsGlobals = false;
+        bool resizesParameters = false;
+        // Whether some call passes the function arrays that may alias
+        bool aliasedArrayArguments = false;
+        // The functions it calls, and the ones it passes arrays that may alias
+        std::vector<Utf8String> callees;
+        std::vector<Utf8String> aliasedCallees;
+    };
+
     class ContextAnalyzer : public ast::Visitor
     {
     public:
         ContextAnalyzer(Scope *rootScope, ErrorLog *errors);
 
         void analyze(ast::AST & ast);
+        // Analyzes the statements of one input to the REPL in the module scope the inputs before it
+        // were analyzed in. Only the functions it defines have their attributes inferred, so an
+        // input takes as long however many came before it. An input with errors leaves the module
+        // scope as it found it.
+        void analyzeInput(ast::Module &input);
+        Scope *moduleScope() const
+        {
+            return _moduleScope;
+        }
+        // The function definitions named in reused are not analyzed again: each one is declared
+        // and given the facts found for it before, and its body is left alone
+        void reuseFunctions(const std::unordered_map<Utf8String, FunctionFacts> *reused);
+        // Imported interfaces are taken from cache instead of being mapped for this analysis alone
+        void useInterfaces(InterfaceCache *cache);
+        // The reused definitions that call a function that is no longer there. They are declared
+        // but not analyzed, so the caller has to analyze their bodies again.
+        const std::vector<Utf8String> &rejectedFunctions() const
+        {
+            return rejected;
+        }
+        FunctionFacts facts(Function *function);
         void *visit(ast::ArrayIndexReference &a) override;
         void *visit(ast::ArrayLiteral &a) override;
         void *visit(ast::ArrayIndexAssignmentStatement &a) override;
         void *visit(ast::AssignmentStatement &a) override;
+        void *visit(ast::AwaitExpression &a) override;
         void *visit(ast::BinaryOpExpression &e) override;
         void *visit(ast::BoolLiteral &b) override;
         void *visit(ast::BlockStatement &s) override;
@@ -28,14 +71,18 @@ namespace px {
         void *visit(ast::DoWhileStatement &w) override;
         void *visit(ast::ExpressionStatement &s) override;
         void *visit(ast::FloatLiteral &f) override;
+        void *visit(ast::ForStatement &f) override;
         void *visit(ast::FunctionCallExpression &f) override;
         void *visit(ast::FunctionDeclaration &f) override;
         void *visit(ast::FunctionDefinition &f) override;
         void *visit(ast::IfStatement &i) override;
         void *visit(ast::IntegerLiteral &i) override;
         void *visit(ast::Module &m) override;
+        void *visit(ast::RegionStatement &r) override;
         void *visit(ast::ReturnStatement &s) override;
+        void *visit(ast::SpawnExpression &s) override;
         void *visit(ast::StringLiteral &s) override;
+        void *visit(ast::SwitchStatement &s) override;
         void *visit(ast::TernaryOpExpression &t) override;
         void *visit(ast::UnaryOpExpression &e) override;
         void *visit(ast::VariableDeclaration &d) override;
@@ -43,11 +90,173 @@ namespace px {
         void *visit(ast::WhileStatement &w) override;
 
     private:
+        // Facts gathered while a function body is analyzed, from which its Function::Attributes are inferred
+        struct FunctionSummary
+        {
+            std::vector<Function*> callees;
+            std::vector<Function*> divergingCallees;
+            std::vector<Function*> aliasedCallees;
+            size_t size = 0;
+            bool readsGlobals = false;
+            bool writesGlobals = false;
+            bool readsArrays = false;
+            bool writesArrays = false;
+            bool callsExternal = false;
+            bool passesArraysToExternal = false;
+            bool hasInfiniteLoop = false;
+            bool diverges = false;
+            bool aliasedArrayArguments = false;
+            bool resizesParameters = false;
+        };
+
+        // The parallel for whose body is being analyzed: its iterations share every variable declared
+        // outside scope, and a break leaves it when the loop and switch depths are still the ones
+        // its body started with
+        struct ParallelLoop
+        {
+            Scope *scope;
+            Variable *variable;
+            size_t loopDepth;
+            size_t switchDepth;
+            // The shared arrays the iterations write, and where they use one other than at the loop
+            // index, which is only allowed for arrays no iteration writes
+            std::vector<Variable*> writtenArrays;
+            std::vector<std::pair<Variable*, SourcePosition>> sharedReads;
+        };
+
+        // A call from a parallel for, which may only be checked once the callee's summary is complete
+        struct ParallelCall
+        {
+            Function *function;
+            SourcePosition position;
+            bool passesSharedArrays;
+        };
+
+        // An array a parallel for reads away from the loop index while it writes another array,
+        // which may be the same one when either is a parameter. They are only known to be distinct
+        // once every call of the function is known to pass distinct arrays.
+        struct ParallelAlias
+        {
+            Function *function;
+            SourcePosition position;
+            Variable *read;
+            Variable *written;
+            Utf8String loopVariable;
+        };
+
+        // A call from inside a region block that passes a value allocated there along with container,
+        // which outlives the block, or to a function that may store it in a global when container is
+        // nullptr; checked like a ParallelCall once every summary is complete
+        struct RegionCall
+        {
+            Function *function;
+            SourcePosition position;
+            Variable *container;
+        };
+
+        // A spawned call, checked like a ParallelCall once every summary is complete
+        struct SpawnCall
+        {
+            Function *function;
+            SourcePosition position;
+            bool passesContainers;
+        };
+
+        // A future declared in scope whose task may still be running, since it has not been awaited
+        // there yet, and the arrays and maps that were passed to the task
+        struct PendingTask
+        {
+            Variable *future;
+            Scope *scope;
+            Function *function;
+            std::vector<Variable*> containers;
+        };
+
+        // Something done while a task may still be running that is only an error if callee, or the
+        // task's function, turns out to write or read what the other one uses. A GLOBAL use changes
+        // the global variable, or calls callee, which may write one the task reads. The other uses
+        // involve the container variable that was also passed to the task: PASSED gives it to callee,
+        // READ reads it, and SPAWNED passes it to callee as a second task.
+        struct TaskConflict
+        {
+            enum Use { GLOBAL, PASSED, READ, SPAWNED };
+
+            SourcePosition position;
+            Variable *future;
+            Function *task;
+            Function *callee;
+            Variable *variable;
+            Use use;
+        };
+
+        void analyzeContainerOperation(ast::FunctionCallExpression &f);
+        void analyzeStatements(std::vector<std::unique_ptr<ast::Statement>> &statements);
         void checkAssignmentTypes(Variable * variable, std::unique_ptr<ast::Expression>& expression, const SourcePosition & start);
+        bool escapesRegion(ast::Expression &expression, size_t targetDepth);
+        Type *getArrayType(Type *elementType, size_t count);
+        Type *getFutureType(const Utf8String &name);
+        Type *getMapType(const Utf8String &name);
+        Type *getParameterType(const ast::Parameter &param, const SourcePosition &position);
+        Type *getType(const Utf8String &name);
+        bool isGlobal(Variable *variable) const;
+        bool isParameter(Variable *variable) const;
+        bool isSharedByParallelLoop(Variable *variable) const;
+        bool mayAlias(Variable *array, Variable *other) const;
+        void recordTaskConflicts(const SourcePosition &position, Variable *variable, Function *callee);
+        void recordTaskUse(const SourcePosition &position, Variable *variable, Function *spawned);
+        void endPendingTasks(Scope *scope);
+        FunctionSummary *currentSummary();
+        void inferAttributes();
+        void openImports(ast::Module &module);
+        Function *importFunction(const Utf8String &name, const SourcePosition &position);
+        bool reuseFunction(Function *function, const FunctionFacts &facts, const SourcePosition &position);
 
         Scope *_currentScope;
+        Scope *_moduleScope;
         px::Function *currentFunction;
         size_t loopDepth;
+        size_t switchDepth;
+        size_t regionDepth;
+        std::vector<bool> loopBreaks;
+        bool diverges;
+        std::vector<Function*> divergingCalls;
+        size_t returnCount;
+        std::unordered_map<Function*, FunctionSummary> summaries;
+        // The functions defined since attributes were last inferred
+        std::vector<Function*> definedFunctions;
+        // The properties inferAttributes spreads from callees to callers, kept for the functions of
+        // earlier inputs
+        struct SpreadProperties
+        {
+            std::unordered_map<Function*, bool> writesMemory;
+            std::unordered_map<Function*, bool> writesGlobals;
+            std::unordered_map<Function*, bool> readsGlobals;
+            std::unordered_map<Function*, bool> resizesParameters;
+        };
+        SpreadProperties spreadProperties;
+        const std::unordered_map<Utf8String, FunctionFacts> *reusedFunctions;
+        std::vector<Utf8String> rejected;
+        // The interfaces of the imported modules, and the module importing them
+        std::vector<std::shared_ptr<ModuleInterface>> imports;
+        InterfaceCache *interfaceCache;
+        ast::Module *importingModule;
+        // The symbols of inputs that had errors, which were taken out of the module scope
+        std::vector<std::unique_ptr<Symbol>> discardedSymbols;
+        std::vector<ParallelLoop> parallelLoops;
+        std::vector<ParallelCall> parallelCalls;
+        std::vector<ParallelAlias> parallelAliases;
+        std::vector<RegionCall> regionCalls;
+        std::vector<SpawnCall> spawnCalls;
+        std::vector<PendingTask> pendingTasks;
+        std::vector<TaskConflict> taskConflicts;
+        // The spawn that may appear as the initial value of the future being declared, and the
+        // future variable being awaited, which are the only places these are allowed
+        ast::Expression *spawnInitializer;
+        ast::Expression *awaitedFuture;
+        // The shared array being indexed by the loop variable of a parallel for, or having one of
+        // its elements written, whose use is checked there rather than as a read of the whole array
+        // or, for an element written, as a read of a container passed to a task
+        ast::Expression *parallelElement;
         ErrorLog * const errors;
     };
 
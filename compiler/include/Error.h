@@ -35,6 +35,16 @@ namespace px {
             return errors.size();
         }
 
+        void clear()
+        {
+            errors.clear();
+        }
+
+        const std::vector<Error> &all() const
+        {
+            return errors;
+        }
+
         void output() const
         {
             UFILE *out = u_get_stdout();
@@ -0,0 +1,111 @@
+
+#ifndef _PX_INCREMENTALCOMPILER_H_
+#define _PX_INCREMENTALCOMPILER_H_
+
+#include "ContextAnalyzer.h"
+#include "Error.h"
+#include "Scope.h"
+#include "ast/AST.h"
+#include "cg/CCompiler.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace px {
+
+    struct IncrementalOptions
+    {
+        // The Inliner settings the module is compiled with; changing them compiles it all again
+        bool inlining;
+        size_t inlineThreshold;
+        // Where imported interfaces are kept between compiles, if anywhere
+        InterfaceCache *interfaces = nullptr;
+    };
+
+    // What the cache keeps for a function definition: a hash of its source text, what its callers
+    // depend on, the callees the Inliner put in it, whether it may be inlined and the C generated for it
+    struct CachedFunction
+    {
+        uint64_t fingerprint;
+        Utf8String signature;
+        FunctionFacts facts;
+        std::vector<Utf8String> inlined;
+        bool inlinable;
+        FunctionFragment fragment;
+    };
+
+    // Compiles a module to C again after an edit, analyzing and generating only the function
+    // definitions the edit can have changed. What each definition compiled to is kept in a cache
+    // next to the module (file.px.pxinc) and reused as long as
+    //  - the text of the definition is the same,
+    //  - no function it calls changed its signature, attributes or the effects its callers check,
+    //  - no callee the Inliner put into it changed, and
+    //  - whether its callers pass it aliasing arrays did not change.
+    // A definition that changed in one of these ways makes the ones depending on it compile again,
+    // one round at a time, until a round changes nothing the others depend on. The bodies of the
+    // definitions that are reused are not parsed, only scanned for their end, unless they may be
+    // inlined. Any edit outside function definitions, to the imported interfaces or to the options
+    // compiles everything again.
+    class IncrementalCompiler
+    {
+    public:
+        static const uint32_t CACHE_MAGIC = 0x43495850; // "PXIC"
+        static const uint32_t CACHE_VERSION = 1;
+
+        IncrementalCompiler(const Utf8String &fileName, const IncrementalOptions &options);
+
+        // Writes file.px.c and the cache, giving whether the module compiled. Its errors are in errors.
+        bool compile(ErrorLog &errors);
+
+        ast::Module &module() const
+        {
+            return *_module;
+        }
+        Scope *moduleScope() const
+        {
+            return analyzer->moduleScope();
+        }
+        size_t functionCount() const
+        {
+            return functions;
+        }
+        // How many function definitions were generated again by the last compile, and how many
+        // rounds of analysis it took
+        size_t compiledCount() const
+        {
+            return compiled;
+        }
+        size_t roundCount() const
+        {
+            return rounds;
+        }
+        // Prints how much of the module was compiled again to stderr
+        void outputReport() const;
+
+    private:
+        void loadCache(const std::string &path);
+        void writeCache(const std::string &path) const;
+        uint64_t shapeHash(const Utf8String &source) const;
+        static Utf8String signature(Function *function);
+
+        const Utf8String fileName;
+        const IncrementalOptions options;
+        uint64_t cachedShape;
+        std::unordered_map<Utf8String, CachedFunction> cache;
+        std::unordered_map<Utf8String, CachedFunction> nextCache;
+        uint64_t nextShape;
+        std::unique_ptr<ast::Module> _module;
+        std::unique_ptr<ScopeTree> scopeTree;
+        std::unique_ptr<ContextAnalyzer> analyzer;
+        size_t functions;
+        size_t compiled;
+        size_t rounds;
+    };
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+
+#ifndef _PX_MODULEINTERFACE_H_
+#define _PX_MODULEINTERFACE_H_
+
+#include "Symbol.h"
+#include "Utf8String.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace px {
+
+    // A parameter as a module interface records it: fixed size arrays are stored as their element
+    // type and length, and every other type by its name
+    struct InterfaceParameter
+    {
+        Utf8String name;
+        Utf8String typeName;
+        // The length of a fixed size array, or 0
+        uint32_t arraySize;
+    };
+
+    struct InterfaceFunction
+    {
+        Utf8String name;
+        Utf8String returnTypeName;
+        std::vector<InterfaceParameter> parameters;
+        // The Function::Attributes callers may rely on: PURE, CONST and NO_RETURN
+        uint32_t attributes;
+    };
+
+    // The binary interface (.pxi) of a module, which pxc writes next to the C it generates so
+    // other modules can import it without analyzing its source. The file is mapped into memory
+    // and nothing is read up front: a name is looked up in a hash table at the front of the file,
+    // and only the function found is decoded.
+    //
+    // The layout, in 32 bit words of the writer's byte order:
+    //   header     magic, version, module name, slot count, function count
+    //   slots      slot count pairs of name hash and function offset, 0 for an empty slot
+    //   functions  name, return type, attributes, parameter count, then a name, type and array
+    //              size per parameter
+    //   strings    a byte length followed by the UTF-8 bytes, padded to a word
+    // Names and types are byte offsets of strings, and functions are byte offsets from the start.
+    class ModuleInterface
+    {
+    public:
+        static const uint32_t MAGIC = 0x49585850; // "PXXI"
+        static const uint32_t VERSION = 1;
+
+        ~ModuleInterface();
+
+        // The functions a module's interface holds: the ones it defines that other modules can call,
+        // in order of name
+        static std::vector<Function*> exports(const SymbolTable &moduleSymbols);
+        // Writes the interface of the given functions of moduleName to path, giving whether it
+        // could be written
+        static bool write(const std::string &path, const Utf8String &moduleName, const std::vector<Function*> &functions);
+        // Maps the interface at path, or gives nullptr when the file is missing or is not one
+        static std::unique_ptr<ModuleInterface> open(const std::string &path);
+        // Reads the interface at path into memory, where rewriting the file does not change it
+        static std::unique_ptr<ModuleInterface> read(const std::string &path);
+
+        const Utf8String &moduleName() const
+        {
+            return name;
+        }
+        uint32_t functionCount() const;
+        // Looks up the function called functionName, filling in function when the module has it
+        bool findFunction(const Utf8String &functionName, InterfaceFunction &function) const;
+
+    private:
+        ModuleInterface(const uint8_t *data, size_t size, bool mapped);
+        bool valid();
+        uint32_t word(uint32_t offset) const;
+        bool readString(uint32_t offset, Utf8String &text) const;
+        bool stringEquals(uint32_t offset, const Utf8String &text) const;
+
+        const uint8_t *data;
+        const size_t size;
+        // Whether data was mapped, or read into memory where there is no mmap
+        const bool mapped;
+        Utf8String name;
+        uint32_t slotCount;
+    };
+
+    // Keeps the interfaces imported by one compile for the next, as pxc --server does. They are
+    // read into memory rather than mapped, since the files may be written again meanwhile, and an
+    // interface is read again once its file's size, modification time or inode changes. A file
+    // changed in the last couple of seconds is always read again, as a rewrite within the same
+    // clock tick would leave its modification time as it was.
+    class InterfaceCache
+    {
+    public:
+        // The interface at path, or nullptr as for ModuleInterface::open
+        std::shared_ptr<ModuleInterface> open(const std::string &path);
+
+    private:
+        struct Entry
+        {
+            int64_t modified;
+            int64_t size;
+            uint64_t inode;
+            std::shared_ptr<ModuleInterface> interface;
+        };
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #ifndef _PX_PARSER_H_
 #define _PX_PARSER_H_
 
+#include <functional>
 #include <iostream>
 #include <ast/AST.h>
 #include <ast/Expression.h>
@@ -18,11 +19,31 @@ namespace px {
         Parser(ErrorLog *errors);
 
         std::unique_ptr<ast::Module> parse(const Utf8String &fileName, std::istream &in);
+        std::unique_ptr<ast::Module> parse(const Utf8String &fileName, const Utf8String &source);
+        // Parses only the module line and the imports, leaving the module without statements
+        std::unique_ptr<ast::Module> parseHeader(const Utf8String &fileName, std::istream &in);
+        std::unique_ptr<ast::Module> parseHeader(const Utf8String &fileName, const Utf8String &source);
+        // Parses statements with no module declaration in front, such as an input to the REPL
+        std::unique_ptr<ast::Module> parseStatements(const Utf8String &fileName, const Utf8String &source);
+        // Steps over the body of each function definition for which skip gives true, leaving the
+        // definition an empty block. skip is given the definition's prototype and where its text
+        // starts and ends, and the body is only scanned to find its end.
+        typedef std::function<bool(const ast::FunctionPrototype &prototype, size_t start, size_t end)> BodyFilter;
+        void skipBodies(const BodyFilter &skip);
+        // A module of at least this many bytes is scanned on a thread of its own while it is parsed.
+        // By default that is PIPELINE_THRESHOLD when there is more than one processor, and never
+        // when there is one.
+        static const size_t PIPELINE_THRESHOLD = 262144;
+        static size_t defaultPipelineThreshold();
+        void pipelineFrom(size_t bytes);
+        bool pipelines(const Utf8String &source) const;
 
     private:
         std::unique_ptr<Scanner> scanner;
         std::unique_ptr<Token> currentToken;
         ErrorLog * const errors;
+        BodyFilter skipBody;
+        size_t pipelineThreshold;
 
         void accept();
         bool accept(TokenType type);
@@ -33,18 +54,26 @@ namespace px {
         int getPrecedence(TokenType type);
         ast::BinaryOperator getBinaryOp(TokenType type);
 
+        std::unique_ptr<ast::Module> parseModuleHeader(const Utf8String &fileName);
+        void parseModuleStatements(ast::Module &module);
         std::unique_ptr<ast::Statement> parseStatement();
         std::unique_ptr<ast::Statement> parseArrayIndexAssignment();
         std::unique_ptr<ast::Statement> parseAssignment();
         std::unique_ptr<ast::BlockStatement> parseBlockStatement();
+        bool skipBlockStatement(const ast::FunctionPrototype &prototype, const SourcePosition &start);
         std::unique_ptr<ast::BreakStatement> parseBreakStatement();
         std::unique_ptr<ast::ContinueStatement> parseContinueStatement();
         std::unique_ptr<ast::DoWhileStatement> parseDoWhileStatement();
+        std::unique_ptr<ast::ForStatement> parseForStatement();
         std::unique_ptr<ast::ExpressionStatement> parseExpressionStatement();
         std::unique_ptr<ast::Statement> parseFunctionDeclaration();
         std::unique_ptr<ast::FunctionPrototype> parseFunctionPrototype();
         std::unique_ptr<ast::IfStatement> parseIfStatement();
+        std::unique_ptr<ast::RegionStatement> parseRegionStatement();
         std::unique_ptr<ast::ReturnStatement> parseReturnStatement();
+        std::unique_ptr<ast::SwitchStatement> parseSwitchStatement();
+        Utf8String parseTypeName();
+        std::unique_ptr<ast::BlockStatement> parseCaseBody();
         std::unique_ptr<ast::VariableDeclaration> parseVariableDeclaration();
         std::unique_ptr<ast::Expression> parseExpression();
         std::unique_ptr<ast::Expression> parseBinary(int precedence = 1);
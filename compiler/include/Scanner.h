@@ -2,8 +2,12 @@
 #ifndef _PX_SCANNER_H_
 #define _PX_SCANNER_H_
 
+#include <deque>
+#include <exception>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "SourcePosition.h"
 #include "Token.h"
@@ -11,16 +15,35 @@
 
 namespace px {
 
+    // A pipelined scanner scans on a thread of its own, a producer that runs ahead of the parser and
+    // hands it the tokens through a ring of compact tokens, so scanning and parsing overlap. The
+    // parser takes them through the same calls either way, and gets the same tokens at the same
+    // positions; the tokens taken but not accepted are kept to go back to.
     class Scanner
     {
     public:
-        Scanner(const Utf8String & fileName, const Utf8String & source);
-        ~Scanner() = default;
+        Scanner(const Utf8String & fileName, const Utf8String & source, bool pipelined = false);
+        ~Scanner();
         bool accept();
         bool accept(TokenType type);
         bool accept(const Utf8String &token);
         void rewind();
         Token &nextToken();
+        // Where the scanner is and the token it scanned last, so it can go back there to scan again
+        // what was stepped over
+        struct State
+        {
+            SourcePosition current;
+            SourcePosition peek;
+            Token token;
+            // The tokens of a pipelined scanner that were accepted and taken
+            size_t currentIndex;
+            size_t peekIndex;
+        };
+        // A pipelined scanner keeps the tokens from the last state saved until it is restored, so
+        // only that one can be restored
+        State save();
+        void restore(const State &state);
 
         const SourcePosition &position();
 
@@ -31,13 +54,41 @@ namespace px {
         void scanCharEscape(Utf8String & token);
         void scanCharCodePoint(Utf8String & token, unsigned int length);
 
-        static std::unordered_map<Utf8String, TokenType> keywords;
+        // A token as the pipeline passes it: where it starts, where the scanner is after it and
+        // the exception scanning it threw, if any, to throw again where the parser takes it
+        struct ScannedToken
+        {
+            TokenType type;
+            int integerBase;
+            Type *suffixType;
+            uint32_t offset, line, column;
+            uint32_t endOffset, endLine, endColumn;
+            Utf8String str;
+            std::exception_ptr failure;
+            // Whether scanning on gives this token again
+            bool last;
+        };
+        struct Pipeline;
+        const ScannedToken &scanned(size_t index);
+        void dropAccepted();
+
+        static const std::unordered_map<Utf8String, TokenType> keywords;
         Utf8String source;
         const size_t length;
         SourcePosition currentPos;
         SourcePosition peekPos;
         Token peekToken;
 
+        std::unique_ptr<Pipeline> pipeline;
+        // The tokens taken from the pipeline that may still be needed, the first one's index, and
+        // the indices of the tokens at currentPos and peekPos and of the last state saved. The
+        // tokens no longer needed are kept spare to take the next ones.
+        std::deque<ScannedToken> window;
+        std::vector<ScannedToken> spare;
+        size_t windowStart;
+        size_t currentIndex;
+        size_t peekIndex;
+        size_t savedIndex;
     };
 
 }
@@ -55,6 +55,12 @@ namespace px {
             ++childIndex_;
         }
 
+        // Steps past the child scopes not entered yet
+        void skipScopes()
+        {
+            childIndex_ = children_.size();
+        }
+
     private:
         std::unique_ptr<SymbolTable> symbols_;
         Scope * const parent_;
@@ -70,6 +76,13 @@ namespace px {
         {
             root_ = current_ = new Scope();
         }
+        ScopeTree(const ScopeTree &) = delete;
+        ScopeTree &operator=(const ScopeTree &) = delete;
+
+        ~ScopeTree()
+        {
+            delete root_;
+        }
 
         Scope *root() const
         {
@@ -23,6 +23,13 @@ namespace px
         virtual ~OtherSymbolData() = default;
     };
 
+    enum class Visibility
+    {
+        PUBLIC,
+        PROTECTED,
+        PRIVATE
+    };
+
     enum class SymbolType
     {
         UNKNOWN = 0,
@@ -69,6 +76,7 @@ namespace px
         static Type * const FLOAT64;
         static Type * const CHAR;
         static Type * const STRING;
+        static Type * const STRING_BUILDER;
 
         enum TypeFlags : uint32_t
         {
@@ -82,6 +90,10 @@ namespace px
             BUILTIN_STRING = 0x40 | BUILTIN,
             BUILTIN_VOID = 0x80 | BUILTIN,
             BUILTIN_ARRAY = 0x100 | BUILTIN,
+            BUILTIN_STRING_BUILDER = 0x400 | BUILTIN,
+            BUILTIN_DYNAMIC_ARRAY = 0x800 | BUILTIN,
+            BUILTIN_MAP = 0x1000 | BUILTIN,
+            BUILTIN_FUTURE = 0x2000 | BUILTIN,
             ABSTRACT = 0x100,
             SEALED = 0x200,
         };
@@ -187,6 +199,38 @@ namespace px
             return isBuiltin(BUILTIN_ARRAY);
         }
 
+        bool isStringBuilder() const
+        {
+            return isBuiltin(BUILTIN_STRING_BUILDER);
+        }
+
+        bool isDynamicArray() const
+        {
+            return isBuiltin(BUILTIN_DYNAMIC_ARRAY);
+        }
+
+        bool isMap() const
+        {
+            return isBuiltin(BUILTIN_MAP);
+        }
+
+        bool isFuture() const
+        {
+            return isBuiltin(BUILTIN_FUTURE);
+        }
+
+        // Dynamic arrays and maps, which are passed to functions by pointer so they can be changed in place
+        bool isContainer() const
+        {
+            return isDynamicArray() || isMap();
+        }
+
+        // Values of the type may point into the region they were created in
+        bool holdsRegionMemory() const;
+
+        // One of the types above, which every symbol table shares and none deletes
+        bool isPredefined() const;
+
         Type * const parent;
         const size_t size;
         const unsigned int flags;
@@ -211,33 +255,101 @@ namespace px
         const size_t count;
     };
 
+    // A growable array, T[], stored as a PxVector whose buffer lives in a region
+    class DynamicArrayType : public Type
+    {
+    public:
+        explicit DynamicArrayType(Type *element)
+                : Type{ element->name + "[]", nullptr, sizeof(void*) * 4, BUILTIN_DYNAMIC_ARRAY}, elementType{ element }
+        {
+        }
+
+        Type * const elementType;
+    };
+
+    // A hash map, map[K, V], stored as a PxMap whose table lives in a region
+    class MapType : public Type
+    {
+    public:
+        MapType(Type *key, Type *value)
+                : Type{ Utf8String{"map["} + key->name + ", " + value->name + "]", nullptr, sizeof(void*) * 6, BUILTIN_MAP}, keyType{ key }, valueType{ value }
+        {
+        }
+
+        Type * const keyType;
+        Type * const valueType;
+    };
+
+    // The result of a spawned call, future[T], stored as the task the call runs in
+    class FutureType : public Type
+    {
+    public:
+        explicit FutureType(Type *value)
+                : Type{ Utf8String{"future["} + value->name + "]", nullptr, sizeof(void*) * 4 + value->size, BUILTIN_FUTURE}, valueType{ value }
+        {
+        }
+
+        Type * const valueType;
+    };
+
     class Function : public Symbol
     {
     public:
+        // Properties proven by the ContextAnalyzer that the code generator passes on to the C compiler
+        enum Attributes : uint32_t
+        {
+            NO_ATTRIBUTES = 0,
+            PURE = 0x01,
+            CONST = 0x02,
+            NO_INLINE = 0x04,
+            ALWAYS_INLINE = 0x08,
+            NO_RETURN = 0x10,
+            RESTRICT_ARRAYS = 0x20,
+        };
+
         Type * returnType;
         std::vector<Variable*> parameters;
         bool declared;
         bool isExtern;
+        Visibility visibility;
+        uint32_t attributes;
+        // The module a function was imported from, or empty for the module's own functions
+        Utf8String module;
 
-        Function(const Utf8String &func, const std::vector<Variable*> &params, Type *retType, bool ext, bool declare = false)
-            : Symbol{ func, SymbolType::FUNCTION }, returnType {retType}, parameters{ params }, declared(declare), isExtern{ext}
+        Function(const Utf8String &func, const std::vector<Variable*> &params, Type *retType, bool ext, bool declare = false, Visibility v = Visibility::PUBLIC)
+            : Symbol{ func, SymbolType::FUNCTION }, returnType {retType}, parameters{ params }, declared(declare), isExtern{ext}, visibility{ v }, attributes{ NO_ATTRIBUTES }
         {
         }
+
+        // The function owns its parameters, which the scope of its body only borrows
+        ~Function() override;
+
+        bool hasAttribute(Attributes attribute) const
+        {
+            return (attributes & attribute) == attribute;
+        }
     };
 
     class Variable : public Symbol
     {
     public:
         Type * type;
+        // Set when the variable is assigned after its declaration, or when an array is passed by pointer
+        bool mutated;
+        // Set for the induction variable of a for loop
+        bool readOnly;
+        // The number of region blocks around the declaration
+        size_t regionDepth;
+
         Variable(const Utf8String &var, Type *t)
-            : Symbol{ var, SymbolType::VARIABLE }, type{ t }
+            : Symbol{ var, SymbolType::VARIABLE }, type{ t }, mutated{ false }, readOnly{ false }, regionDepth{ 0 }
         {
         }
     };
     class SymbolTable
     {
     public:
-        SymbolTable(SymbolTable *parent = nullptr) : _parent{ parent }
+        SymbolTable(SymbolTable *parent = nullptr) : _parent{ parent }, _journaling{ false }
         {
         }
 
@@ -245,9 +357,14 @@ namespace px
         {
             for (auto entry : _symbols)
             {
+                // Borrowed symbols may already be gone
+                if (std::find(_borrowed.begin(), _borrowed.end(), entry.second) != _borrowed.end())
+                {
+                    continue;
+                }
                 if(entry.second->symbolType == SymbolType::TYPE){
                     Type *type = (Type*) entry.second;
-                    if(type->isBuiltin())  {
+                    if(type->isPredefined())  {
                         continue;
                     }
                 }
@@ -262,9 +379,47 @@ namespace px
 
         void addSymbol(Symbol *symbol)
         {
+            if (_journaling)
+            {
+                auto existing = _symbols.find(symbol->name);
+                _journal.emplace_back(symbol, existing != _symbols.end() ? existing->second : nullptr);
+            }
             _symbols[symbol->name] = symbol;
         }
 
+        // Adds a symbol that something else owns, such as the parameter of a function, which the
+        // table will not delete
+        void addBorrowedSymbol(Symbol *symbol)
+        {
+            addSymbol(symbol);
+            _borrowed.push_back(symbol);
+        }
+
+        // Remembers the symbols added from now on, so they can be taken back out
+        void startJournal()
+        {
+            _journal.clear();
+            _journaling = true;
+        }
+
+        // Takes out the symbols added since startJournal, putting back the ones they hid, and gives
+        // them to the caller, as the nodes analyzed with them may still point at them
+        std::vector<Symbol*> rollBack()
+        {
+            std::vector<Symbol*> added;
+            for (auto entry = _journal.rbegin(); entry != _journal.rend(); ++entry)
+            {
+                if (entry->second != nullptr)
+                    _symbols[entry->first->name] = entry->second;
+                else
+                    _symbols.erase(entry->first->name);
+                added.push_back(entry->first);
+            }
+            _journal.clear();
+            _journaling = false;
+            return added;
+        }
+
         Symbol* getSymbol(const Utf8String &name, bool localsOnly = false) const
         {
             auto symbol = _symbols.find(name);
@@ -303,6 +458,17 @@ namespace px
             return getSymbol<Function>(name, SymbolType::FUNCTION, localsOnly);
         }
 
+        std::vector<Function*> getLocalFunctions() const
+        {
+            std::vector<Function*> functions;
+            for (auto &local : _symbols)
+            {
+                if (local.second->symbolType == SymbolType::FUNCTION)
+                    functions.push_back((Function*)local.second);
+            }
+            return functions;
+        }
+
         std::vector<Variable*> getLocalVariables() const
         {
             std::vector<Variable*> variables;
@@ -331,14 +497,32 @@ namespace px
             addSymbol(Type::FLOAT64);
             addSymbol(Type::CHAR);
             addSymbol(Type::STRING);
+            addSymbol(Type::STRING_BUILDER);
             addSymbol(new Function{"printInt", {new Variable{"i", Type::INT32}}, Type::VOID, true });
+            addSymbol(new Function{"printInt64", {new Variable{"i", Type::INT64}}, Type::VOID, true });
+            addSymbol(new Function{"printUInt64", {new Variable{"i", Type::UINT64}}, Type::VOID, true });
             addSymbol(new Function{"printFloat", {new Variable{"f", Type::FLOAT32}}, Type::VOID, true });
+            addSymbol(new Function{"printFloat64", {new Variable{"d", Type::FLOAT64}}, Type::VOID, true });
             addSymbol(new Function{"printString", {new Variable{"str", Type::STRING}}, Type::VOID, true });
+            addSymbol(new Function{"newStringBuilder", {}, Type::STRING_BUILDER, true });
+            addSymbol(new Function{"reserveStringBuilder", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"bytes", Type::INT64}}, Type::VOID, true });
+            addSymbol(new Function{"appendInt", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"i", Type::INT32}}, Type::VOID, true });
+            addSymbol(new Function{"appendInt64", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"i", Type::INT64}}, Type::VOID, true });
+            addSymbol(new Function{"appendUInt64", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"i", Type::UINT64}}, Type::VOID, true });
+            addSymbol(new Function{"appendFloat", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"f", Type::FLOAT32}}, Type::VOID, true });
+            addSymbol(new Function{"appendFloat64", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"d", Type::FLOAT64}}, Type::VOID, true });
+            addSymbol(new Function{"appendBool", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"b", Type::BOOL}}, Type::VOID, true });
+            addSymbol(new Function{"appendChar", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"c", Type::CHAR}}, Type::VOID, true });
+            addSymbol(new Function{"appendString", {new Variable{"builder", Type::STRING_BUILDER}, new Variable{"str", Type::STRING}}, Type::VOID, true });
+            addSymbol(new Function{"finishStringBuilder", {new Variable{"builder", Type::STRING_BUILDER}}, Type::STRING, true });
         }
 
     private:
         std::unordered_map<Utf8String, Symbol*> _symbols;
+        std::vector<Symbol*> _borrowed;
         SymbolTable * const _parent;
+        std::vector<std::pair<Symbol*, Symbol*>> _journal;
+        bool _journaling;
     };
 }
 
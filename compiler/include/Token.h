@@ -13,6 +13,7 @@ namespace px {
         BAD, END_FILE, IDENTIFIER, INTEGER, FLOAT, CHAR, STRING,
         KW_ABSTRACT,
         KW_AS,
+        KW_AWAIT,
         KW_BREAK,
         KW_CASE,
         KW_CONCEPT,
@@ -26,14 +27,19 @@ namespace px {
         KW_FUNC,
         KW_IF,
         KW_IMPLEMENTATION,
+        KW_IMPORT,
+        KW_IN,
         KW_INTERFACE,
         KW_MODULE,
         KW_NEW,
+        KW_PARALLEL,
         KW_PRIVATE,
         KW_PROTECTED,
         KW_PUBLIC,
         KW_REF,
+        KW_REGION,
         KW_RETURN,
+        KW_SPAWN,
         KW_STATE,
         KW_SWITCH,
         KW_TRUE,
@@ -80,6 +86,7 @@ namespace px {
         OP_NOT_EQUAL,
         OP_OR,
         OP_QUESTION,
+        OP_RANGE,
         OP_RIGHT_SHIFT,
         OP_STAR,
         OP_SUB
@@ -93,7 +100,7 @@ namespace px {
         int integerBase;
         SourcePosition position;
 
-        static std::unordered_map<TokenType, const Utf8String> tokenNames;
+        static const std::unordered_map<TokenType, const Utf8String> tokenNames;
         Token(const SourcePosition &pos) : position{ pos } { clear(); }
         Token(const SourcePosition &pos, TokenType t, const Utf8String &s) : type { t }, str{ s }, suffixType{ nullptr }, integerBase{10}, position{ pos }
         {
@@ -101,16 +101,16 @@ namespace px {
 
         bool startsWith(const Utf8String &other) const
         {
-            if( count >= other.count) {
-                return std::equal(bytes.begin(), bytes.end(), bytes.begin());
+            if( bytes.size() >= other.bytes.size()) {
+                return std::equal(other.bytes.begin(), other.bytes.end(), bytes.begin());
             }
             return false;
         }
 
         bool endsWith(const Utf8String &other) const
         {
-            if( count >= other.count) {
-                return std::equal(bytes.rbegin(), bytes.rend(), bytes.rbegin());
+            if( bytes.size() >= other.bytes.size()) {
+                return std::equal(other.bytes.rbegin(), other.bytes.rend(), bytes.rbegin());
             }
             return false;
         }
@@ -123,6 +123,15 @@ namespace px {
             return *this;
         }
 
+        Utf8String &operator=(Utf8String &&other)
+        {
+            count = other.count;
+            bytes = std::move(other.bytes);
+            pointsStart = std::move(other.pointsStart);
+            other.count = 0;
+            return *this;
+        }
+
         Utf8String operator+(const Utf8String &other) const
         {
             Utf8String copy{ *this };
@@ -148,7 +157,7 @@ namespace px {
             return *this;
         }
 
-        Utf8String operator+=(const Utf8String &other)
+        Utf8String& operator+=(const Utf8String &other)
         {
             size_t length = bytes.size();
             count += other.count;
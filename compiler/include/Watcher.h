@@ -0,0 +1,73 @@
+
+#ifndef _PX_WATCHER_H_
+#define _PX_WATCHER_H_
+
+#include "Utf8String.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace px {
+
+    // pxc --watch dir: compiles the modules in a directory, then compiles them again as they change.
+    // Changes are taken from inotify, and a burst of them, as an editor saving several files makes,
+    // is taken as one once the directory has been quiet for the debounce time.
+    //
+    // Only the modules affected by a change are compiled: the files whose text changed, then the
+    // modules importing one whose interface (.pxi) came out different, and so on. The module line
+    // and imports of each file are kept from the last time it changed, so ordering the modules by
+    // their imports only parses the headers of the changed files. Each rebuild prints the modules
+    // it compiled and the ones that failed to, how long compiling them took and how long it was
+    // since the first change.
+    class Watcher
+    {
+    public:
+        static const unsigned DEFAULT_DEBOUNCE = 50;
+        // Compiles the module at path as pxc would, giving whether it compiled
+        typedef std::function<bool(const std::string &path)> CompileFunction;
+
+        Watcher(const std::string &directory, unsigned debounceMilliseconds, const CompileFunction &compile, std::ostream &log);
+        ~Watcher();
+
+        // Starts watching and compiles every module, giving false with the reason in the log when
+        // the directory can not be watched
+        bool start();
+        // Waits up to timeout milliseconds, or for ever when it is negative, for a change, then for
+        // the burst it starts to end, and compiles what it affected. Gives the files compiled.
+        std::vector<std::string> waitAndRebuild(int timeout);
+        // Rebuilds for ever
+        void run();
+
+    private:
+        struct WatchedFile
+        {
+            uint64_t hash;
+            // Empty when the header did not parse
+            Utf8String moduleName;
+            std::vector<Utf8String> imports;
+            std::string interface;
+        };
+
+        std::vector<std::string> rebuild(const std::set<std::string> &changed, std::chrono::steady_clock::time_point firstChange, bool initial);
+        std::vector<std::string> buildOrder() const;
+        bool readEvents(std::set<std::string> &changed);
+        std::string path(const std::string &name) const;
+        std::string readInterface(const Utf8String &moduleName) const;
+
+        const std::string directory;
+        const unsigned debounce;
+        const CompileFunction compile;
+        std::ostream &log;
+        int notify;
+        std::map<std::string, WatchedFile> files;
+    };
+
+}
+
+#endif
@@ -5,9 +5,12 @@
 #include "SourcePosition.h"
 
 #include <memory>
+#include <vector>
 
 namespace px
 {
+    class Function;
+
     namespace ast
     {
         class Visitor;
@@ -26,6 +29,8 @@ namespace px
             EXP_TERNARY_OP,
             EXP_UNARY_OP,
             EXP_VAR_LOAD,
+            EXP_AWAIT,
+            EXP_SPAWN,
             LITERAL_ARRAY,
             LITERAL_BOOL,
             LITERAL_CHAR,
@@ -40,8 +45,11 @@ namespace px
             STMT_CONTINUE,
             STMT_DO_WHILE,
             STMT_EXP,
+            STMT_FOR,
             STMT_IF,
+            STMT_REGION,
             STMT_RETURN,
+            STMT_SWITCH,
             STMT_WHILE
         };
         class AST
@@ -57,12 +65,28 @@ namespace px
             virtual void *accept(Visitor &visitor) = 0;
         };
 
+        // A module named by an import statement
+        class Import
+        {
+        public:
+            const SourcePosition position;
+            const Utf8String moduleName;
+
+            Import(const SourcePosition &pos, const Utf8String &name) : position{ pos }, moduleName{ name }
+            {
+            }
+        };
+
         class Module : public AST
         {
         public:
-            const Utf8String &moduleName;
+            const Utf8String moduleName;
             const Utf8String &fileName;
+            std::vector<Import> imports;
             std::vector<std::unique_ptr<Statement>> statements;
+            // The functions of the imported modules that the statements call, which the
+            // ContextAnalyzer fills in
+            std::vector<Function*> importedFunctions;
 
             Module(const SourcePosition &pos, const Utf8String &module, const Utf8String &file)
                 : AST{ NodeType::MODULE, pos }, moduleName{ module }, fileName{ file }
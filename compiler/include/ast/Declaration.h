@@ -14,9 +14,11 @@ namespace px
         public:
             const Utf8String name;
             const Utf8String typeName;
+            // Shared by the copies of the parameter the prototype is copied with
+            std::shared_ptr<int64_t> arraySize;
 
-            Parameter(const Utf8String &func, const Utf8String &ty)
-                : name{ func }, typeName{ ty }
+            Parameter(const Utf8String &func, const Utf8String &ty, int64_t *array = nullptr)
+                : name{ func }, typeName{ ty }, arraySize{ array }
             {
             }
         };
@@ -28,9 +30,10 @@ namespace px
             const Utf8String returnTypeName;
             std::vector<Parameter> parameters;
             bool isExtern;
+            Visibility visibility;
 
-            FunctionPrototype(const Utf8String &fname, const Utf8String &retTypeName, const std::vector<Parameter> &params, bool ext)
-                : name{ fname }, returnTypeName{ retTypeName }, parameters{ params }, isExtern{ ext }
+            FunctionPrototype(const Utf8String &fname, const Utf8String &retTypeName, const std::vector<Parameter> &params, bool ext, Visibility v = Visibility::PUBLIC)
+                : name{ fname }, returnTypeName{ retTypeName }, parameters{ params }, isExtern{ ext }, visibility{ v }
             {
             }
         };
@@ -70,7 +73,7 @@ namespace px
             const Utf8String typeName;
             const Utf8String name;
             std::unique_ptr<Expression> initialValue;
-            int64_t *arraySize;
+            std::unique_ptr<int64_t> arraySize;
 
             VariableDeclaration(const SourcePosition &pos, const Utf8String &t, const Utf8String &n, std::unique_ptr<Expression> value,  int64_t *array)
                 : Statement{ NodeType::DECLARE_VAR, pos }, typeName{ t }, name{ n }, initialValue{ std::move(value) }, arraySize{ array }
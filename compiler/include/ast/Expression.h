@@ -41,6 +41,20 @@ namespace px
             void *accept(Visitor &visitor) override;
         };
 
+        // await f: waits for the task started for the future f and gives its result
+        class AwaitExpression : public Expression
+        {
+        public:
+            std::unique_ptr<Expression> future;
+
+            AwaitExpression(const SourcePosition &pos, std::unique_ptr<Expression> f)
+                : Expression{ NodeType::EXP_AWAIT, pos }, future{ std::move(f) }
+            {
+            }
+
+            void *accept(Visitor &visitor) override;
+        };
+
         enum class BinaryOperator
         {
             BAD,
@@ -86,15 +100,30 @@ namespace px
             void *accept(Visitor &visitor) override;
         };
 
+        // Operations on dynamic arrays and maps that are written as calls, such as push(values, 1)
+        enum class ContainerOperation
+        {
+            NONE,
+            PUSH,
+            POP,
+            RESERVE,
+            APPEND,
+            LENGTH,
+            CONTAINS,
+            REMOVE,
+            KEYS,
+        };
+
         class FunctionCallExpression : public Expression
         {
         public:
             const Utf8String functionName;
             std::vector<std::unique_ptr<Expression>> arguments;
             Function *function;
+            ContainerOperation containerOperation;
 
             FunctionCallExpression(const SourcePosition &pos, const Utf8String &name, std::vector<std::unique_ptr<Expression>> args)
-                : Expression{ NodeType::EXP_FUNC_CALL, pos }, functionName{ name }, arguments{ std::move(args) }, function{}
+                : Expression{ NodeType::EXP_FUNC_CALL, pos }, functionName{ name }, arguments{ std::move(args) }, function{}, containerOperation{ ContainerOperation::NONE }
             {
             }
 
@@ -123,6 +152,20 @@ namespace px
             void *accept(Visitor &visitor) override;
         };
 
+        // spawn f(args): starts a call as a task on the worker pool, giving a future for its result
+        class SpawnExpression : public Expression
+        {
+        public:
+            std::unique_ptr<FunctionCallExpression> call;
+
+            SpawnExpression(const SourcePosition &pos, std::unique_ptr<FunctionCallExpression> c)
+                : Expression{ NodeType::EXP_SPAWN, pos }, call{ std::move(c) }
+            {
+            }
+
+            void *accept(Visitor &visitor) override;
+        };
+
         class TernaryOpExpression : public Expression
         {
         public:
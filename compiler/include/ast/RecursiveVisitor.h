@@ -0,0 +1,56 @@
+
+#ifndef _PX_AST_RECURSIVEVISITOR_H_
+#define _PX_AST_RECURSIVEVISITOR_H_
+
+#include <ast/Visitor.h>
+
+namespace px
+{
+    namespace ast
+    {
+        // Walks every child of every node. Children are reached through traverse() so that
+        // subclasses can inspect or replace a child in place.
+        class RecursiveVisitor : public Visitor
+        {
+        public:
+            void *visit(ArrayIndexReference &a) override;
+            void *visit(ArrayLiteral &a) override;
+            void *visit(ArrayIndexAssignmentStatement &a) override;
+            void *visit(AssignmentStatement &a) override;
+            void *visit(AwaitExpression &a) override;
+            void *visit(BinaryOpExpression &b) override;
+            void *visit(BlockStatement &s) override;
+            void *visit(BoolLiteral &b) override;
+            void *visit(BreakStatement &b) override;
+            void *visit(CastExpression &c) override;
+            void *visit(CharLiteral &c) override;
+            void *visit(ContinueStatement &c) override;
+            void *visit(DoWhileStatement &d) override;
+            void *visit(ExpressionStatement &s) override;
+            void *visit(FloatLiteral &f) override;
+            void *visit(ForStatement &f) override;
+            void *visit(FunctionCallExpression &f) override;
+            void *visit(FunctionDeclaration &f) override;
+            void *visit(FunctionDefinition &f) override;
+            void *visit(IfStatement &i) override;
+            void *visit(IntegerLiteral &i) override;
+            void *visit(Module &m) override;
+            void *visit(RegionStatement &r) override;
+            void *visit(ReturnStatement &s) override;
+            void *visit(SpawnExpression &s) override;
+            void *visit(StringLiteral &s) override;
+            void *visit(SwitchStatement &s) override;
+            void *visit(TernaryOpExpression &t) override;
+            void *visit(UnaryOpExpression &u) override;
+            void *visit(VariableDeclaration &v) override;
+            void *visit(VariableExpression &v) override;
+            void *visit(WhileStatement &w) override;
+
+        protected:
+            virtual void traverse(std::unique_ptr<Expression> &expression);
+            virtual void traverse(std::unique_ptr<Statement> &statement);
+        };
+    }
+}
+
+#endif
@@ -102,7 +102,7 @@ namespace px
             std::unique_ptr<Statement> body;
 
             DoWhileStatement(const SourcePosition &pos, std::unique_ptr<Expression> cond, std::unique_ptr<Statement> statement)
-                : Statement{ NodeType::STMT_WHILE, pos }, condition{ std::move(cond) }, body{ std::move(statement) }
+                : Statement{ NodeType::STMT_DO_WHILE, pos }, condition{ std::move(cond) }, body{ std::move(statement) }
             {
             }
 
@@ -124,6 +124,33 @@ namespace px
 
         };
 
+        // for i in start..end: the induction variable counts up from start to end - 1 and is read-only in the body.
+        // The ContextAnalyzer sets independentIterations when no iteration reads or writes memory another one
+        // writes, and needsRestrict when that also relies on the array parameters of the function not aliasing.
+        class ForStatement : public Statement
+        {
+        public:
+            const Utf8String variableName;
+            const Utf8String typeName;
+            std::unique_ptr<Expression> start;
+            std::unique_ptr<Expression> end;
+            std::unique_ptr<Statement> body;
+            Type *variableType;
+            bool independentIterations;
+            bool needsRestrict;
+            // A parallel for hands its iterations to the runtime's worker pool
+            const bool parallel;
+
+            ForStatement(const SourcePosition &pos, const Utf8String &name, const Utf8String &type, std::unique_ptr<Expression> from,
+                         std::unique_ptr<Expression> to, std::unique_ptr<Statement> statement, bool isParallel = false)
+                : Statement{ NodeType::STMT_FOR, pos }, variableName{ name }, typeName{ type }, start{ std::move(from) }, end{ std::move(to) },
+                  body{ std::move(statement) }, variableType{}, independentIterations{ false }, needsRestrict{ false }, parallel{ isParallel }
+            {
+            }
+
+            void *accept(Visitor &visitor) override;
+        };
+
         class IfStatement : public Statement
         {
         public:
@@ -140,6 +167,21 @@ namespace px
 
         };
 
+        // region { ... }: everything allocated while the block runs, strings included, is freed when it
+        // is left. The ContextAnalyzer rejects storing such values where they outlive the block.
+        class RegionStatement : public Statement
+        {
+        public:
+            std::unique_ptr<BlockStatement> body;
+
+            RegionStatement(const SourcePosition &pos, std::unique_ptr<BlockStatement> block)
+                : Statement{ NodeType::STMT_REGION, pos }, body{ std::move(block) }
+            {
+            }
+
+            void *accept(Visitor &visitor) override;
+        };
+
         class ReturnStatement : public Statement
         {
         public:
@@ -156,6 +198,36 @@ namespace px
 
         };
 
+        class SwitchCase
+        {
+        public:
+            const SourcePosition position;
+            std::vector<std::unique_ptr<Expression>> values;
+            std::unique_ptr<BlockStatement> body;
+            std::vector<int64_t> constants;
+
+            SwitchCase(const SourcePosition &pos, std::vector<std::unique_ptr<Expression>> vals, std::unique_ptr<BlockStatement> statements)
+                : position{ pos }, values{ std::move(vals) }, body{ std::move(statements) }
+            {
+            }
+        };
+
+        // Cases do not fall through. The constants of each case are filled in by the ContextAnalyzer.
+        class SwitchStatement : public Statement
+        {
+        public:
+            std::unique_ptr<Expression> scrutinee;
+            std::vector<SwitchCase> cases;
+            std::unique_ptr<BlockStatement> defaultBody;
+
+            SwitchStatement(const SourcePosition &pos, std::unique_ptr<Expression> value, std::vector<SwitchCase> switchCases, std::unique_ptr<BlockStatement> defaultStatements)
+                : Statement{ NodeType::STMT_SWITCH, pos }, scrutinee{ std::move(value) }, cases{ std::move(switchCases) }, defaultBody{ std::move(defaultStatements) }
+            {
+            }
+
+            void *accept(Visitor &visitor) override;
+        };
+
         class WhileStatement : public Statement
         {
         public:
@@ -20,6 +20,7 @@ namespace px
             virtual void *visit(ArrayLiteral &a) = 0;
             virtual void *visit(ArrayIndexAssignmentStatement &a) = 0;
             virtual void *visit(AssignmentStatement &a) = 0;
+            virtual void *visit(AwaitExpression &a) = 0;
             virtual void *visit(BinaryOpExpression &f) = 0;
             virtual void *visit(BlockStatement &s) = 0;
             virtual void *visit(BoolLiteral &b) = 0;
@@ -30,14 +31,18 @@ namespace px
             virtual void *visit(DoWhileStatement &w) = 0;
             virtual void *visit(ExpressionStatement &s) = 0;
             virtual void *visit(FloatLiteral &i) = 0;
+            virtual void *visit(ForStatement &f) = 0;
             virtual void *visit(FunctionCallExpression &f) = 0;
             virtual void *visit(FunctionDeclaration &f) = 0;
             virtual void *visit(FunctionDefinition &f) = 0;
             virtual void *visit(IfStatement &i) = 0;
             virtual void *visit(IntegerLiteral &i) = 0;
             virtual void *visit(Module &m) = 0;
+            virtual void *visit(RegionStatement &r) = 0;
             virtual void *visit(ReturnStatement &s) = 0;
+            virtual void *visit(SpawnExpression &s) = 0;
             virtual void *visit(StringLiteral &s) = 0;
+            virtual void *visit(SwitchStatement &s) = 0;
             virtual void *visit(TernaryOpExpression &t) = 0;
             virtual void *visit(UnaryOpExpression &u) = 0;
             virtual void *visit(VariableDeclaration &s) = 0;
@@ -7,18 +7,52 @@
 #include "Utf8String.h"
 
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace px {
 
+    // A map type a FunctionFragment uses: its name, the PX_MAP_DEFINE suffix and the definition
+    struct FragmentMap
+    {
+        Utf8String typeName;
+        Utf8String name;
+        Utf8String definition;
+    };
+
+    // The C of one function definition, with the strings, constant arrays and outlined functions it
+    // uses, which the IncrementalCompiler keeps from one compile to the next
+    struct FunctionFragment
+    {
+        Utf8String code;
+        std::vector<FragmentMap> maps;
+    };
+
     class CCompiler : public ast::Visitor
     {
     public:
+        // A switch is lowered to a binary search when it has at least SPARSE_SWITCH_MIN_CASES values
+        // spread over more than SPARSE_SWITCH_SPREAD times as many integers
+        static const size_t SPARSE_SWITCH_MIN_CASES = 4;
+        static const size_t SPARSE_SWITCH_SPREAD = 3;
+        static const size_t SPARSE_SWITCH_LINEAR_CASES = 3;
+
         CCompiler(ScopeTree * scopeTree);
         void compile(ast::AST &ast);
+        // Generates the module's C and returns it instead of writing the module's file
+        Utf8String compileToString(ast::Module &module);
+        // Generates the C for the named functions alone and returns it instead of writing the
+        // module's file. The TieredCompiler compiles hot functions this way.
+        Utf8String compileFunctions(ast::Module &module, const std::unordered_set<Utf8String> &functions);
+        // Generates each function definition as a fragment of its own into fragments, except for the
+        // reused ones, whose fragments are already there and are put in as they are
+        void compileFragments(std::unordered_map<Utf8String, FunctionFragment> *fragments, const std::unordered_set<Utf8String> *reused);
+        static Utf8String pxTypeToCType(Type *type);
         void *visit(ast::ArrayIndexReference &a) override;
         void *visit(ast::ArrayIndexAssignmentStatement &a) override;
         void *visit(ast::ArrayLiteral &a) override;
         void *visit(ast::AssignmentStatement &a) override;
+        void *visit(ast::AwaitExpression &a) override;
         void *visit(ast::BinaryOpExpression &e) override;
         void *visit(ast::BoolLiteral &b) override;
         void *visit(ast::BlockStatement &s) override;
@@ -29,14 +63,18 @@ namespace px {
         void *visit(ast::DoWhileStatement &d) override;
         void *visit(ast::ExpressionStatement &s) override;
         void *visit(ast::FloatLiteral &f) override;
+        void *visit(ast::ForStatement &f) override;
         void *visit(ast::FunctionCallExpression &f) override;
         void *visit(ast::FunctionDeclaration &f) override;
         void *visit(ast::FunctionDefinition &f) override;
         void *visit(ast::IfStatement &i) override;
         void *visit(ast::IntegerLiteral &i) override;
         void *visit(ast::Module &m) override;
+        void *visit(ast::RegionStatement &r) override;
         void *visit(ast::ReturnStatement &s) override;
+        void *visit(ast::SpawnExpression &s) override;
         void *visit(ast::StringLiteral &s) override;
+        void *visit(ast::SwitchStatement &s) override;
         void *visit(ast::TernaryOpExpression &t) override;
         void *visit(ast::UnaryOpExpression &e) override;
         void *visit(ast::VariableDeclaration &d) override;
@@ -44,19 +82,81 @@ namespace px {
         void *visit(ast::WhileStatement &w) override;
 
     private:
-        static Utf8String pxTypeToCType(Type *type);
+        static Utf8String elementSize(Type *elementType);
         void indent();
         void indent(ast::AST *node);
         void unindent();
         void unindent(ast::AST *node);
         void newLine();
         void add(const Utf8String &text);
+        Utf8String buildFunctionSignature(Function *function);
         Utf8String buildFunctionProto(Function *function);
+        Utf8String render(ast::AST &node);
+        Utf8String poolString(const Utf8String &literal);
+        Utf8String stringTableDefinition() const;
+        void compileFragment(ast::FunctionDefinition &f);
+        // How many blocks with futures and how many region blocks were open where a break target or
+        // an enclosing loop begins
+        struct ExitDepths
+        {
+            size_t tasks;
+            size_t regions;
+        };
+        ExitDepths exitDepths() const;
+        bool leavesScopes(const ExitDepths &depths) const;
+        void exitScopes(const ExitDepths &depths);
+        void awaitTasks(size_t depth);
+        void exitRegions(size_t depth);
+        Utf8String poolArray(const Utf8String &elementType, size_t count, const Utf8String &initializer);
+        bool isContainerParameter(const Utf8String &name);
+        bool returnsOwnContainer(ast::Expression &expression);
+        Utf8String containerAddress(ast::Expression &expression);
+        void assignVector(const Utf8String &name, Type *elementType, ast::Expression &expression);
+        void assignContainer(const Utf8String &name, Type *type, ast::Expression &expression);
+        Utf8String mapName(Type *type);
+        void defineMap(const Utf8String &typeName, const Utf8String &name, const Utf8String &definition);
+        void compileContainerOperation(ast::FunctionCallExpression &f, bool statement);
+        void compileParallelFor(ast::ForStatement &f);
+        void compileReturn(ast::ReturnStatement &s);
+        void compileSpawn(ast::VariableDeclaration &v);
+        Utf8String spawnTaskType(Function *function);
 
         Utf8String code;
         unsigned int indentLevel;
         Utf8String toPreDeclare;
+        std::unordered_map<Utf8String, size_t> stringPool;
+        Utf8String stringTable;
+        std::unordered_map<Utf8String, Utf8String> arrayPool;
+        Utf8String constantArrays;
+        // The PX_MAP_DEFINE suffix of each map type used, and the definitions themselves
+        std::unordered_map<Utf8String, Utf8String> mapNames;
+        std::unordered_map<Utf8String, Utf8String> mapLines;
+        Utf8String mapDefinitions;
+        // The structs and prototypes of the functions that parallel for bodies and spawned calls are
+        // outlined into, and the functions themselves, which follow the rest of the module
+        Utf8String outlinedDeclarations;
+        Utf8String outlinedFunctions;
+        size_t parallelCount;
+        // The functions that have a task struct for spawning them
+        std::unordered_set<Utf8String> spawnedFunctions;
+        // The futures declared in each open block, whose tasks are awaited when control leaves it
+        std::vector<std::vector<Utf8String>> pendingTasks;
+        std::vector<Utf8String> breakLabels;
+        std::vector<ExitDepths> breakDepths;
+        std::vector<ExitDepths> continueDepths;
+        size_t regionDepth;
+        size_t switchCount;
+        size_t forCount;
         px::Function *currentFunction;
+        // The only functions whose definitions are generated, or nullptr for all of them
+        const std::unordered_set<Utf8String> *onlyFunctions;
+        bool writeFile;
+        // Where function definitions are generated as fragments, and the ones to reuse, when
+        // compiling incrementally; the pooled names of the fragment being generated get its prefix
+        std::unordered_map<Utf8String, FunctionFragment> *fragments;
+        const std::unordered_set<Utf8String> *reusedFragments;
+        Utf8String fragmentPrefix;
+        std::unordered_set<Utf8String> *fragmentMaps;
         px::Scope *currentScope;
         px::ScopeTree * const scopeTree;
     };
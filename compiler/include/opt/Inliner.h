@@ -0,0 +1,107 @@
+
+#ifndef _PX_OPT_INLINER_H_
+#define _PX_OPT_INLINER_H_
+
+#include "ast/RecursiveVisitor.h"
+#include "SourcePosition.h"
+#include "Utf8String.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace px {
+
+    struct InlineDecision
+    {
+        SourcePosition position;
+        Utf8String caller;
+        Utf8String callee;
+        bool inlined;
+        size_t cost;
+        Utf8String reason;
+    };
+
+    // Substitutes the bodies of small, non-recursive functions at their call sites.
+    // Runs on the parsed module before context analysis so that the scopes built by the
+    // ContextAnalyzer already see the inlined code.
+    //
+    // Two shapes of callee are handled:
+    //  - functions whose body is a single 'return <expr>;' are inlined inside expressions,
+    //    with the arguments substituted for the parameters
+    //  - void functions without early returns are inlined at statement level as a block
+    //    that binds each argument to a renamed copy of its parameter
+    // Names are not resolved yet, so a callee is not inlined into a function that declares a variable
+    // named like one of the globals the callee uses.
+    class Inliner : public ast::RecursiveVisitor
+    {
+    public:
+        static const size_t DEFAULT_THRESHOLD = 20;
+
+        explicit Inliner(size_t threshold = DEFAULT_THRESHOLD);
+
+        void run(ast::Module &module);
+        // The definition of function was not parsed, so it is neither inlined nor inlined into, and
+        // its calls are taken to be callees when looking for recursion
+        void assumeCalls(const Utf8String &function, const std::vector<Utf8String> &callees);
+        // Whether calls to function may be inlined as far as its own body goes, whether or not it is recursive
+        bool inlinable(const Utf8String &function) const;
+
+        const std::vector<InlineDecision> &decisions() const
+        {
+            return decisionLog;
+        }
+
+        void outputReport() const;
+
+        // Cost model: the number of AST nodes under node.
+        static size_t cost(ast::AST &node);
+
+        void *visit(ast::FunctionDefinition &f) override;
+
+    protected:
+        void traverse(std::unique_ptr<ast::Expression> &expression) override;
+        void traverse(std::unique_ptr<ast::Statement> &statement) override;
+
+    private:
+        enum class Shape
+        {
+            NONE,
+            EXPRESSION,
+            BLOCK
+        };
+
+        struct Candidate
+        {
+            ast::FunctionDefinition *definition;
+            Shape shape;
+            size_t cost;
+            bool recursive;
+            // The variables the body uses that it does not declare
+            std::unordered_set<Utf8String> globals;
+        };
+
+        void analyzeCandidate(Candidate &candidate);
+        void findGlobals(Candidate &candidate);
+        void findRecursion();
+        Candidate *lookupCandidate(ast::FunctionCallExpression &call);
+        bool rejectArguments(Candidate &candidate, ast::FunctionCallExpression &call, Utf8String &reason);
+        void record(ast::FunctionCallExpression &call, const Candidate &candidate, bool inlined, const Utf8String &reason);
+
+        std::unique_ptr<ast::Expression> inlineExpression(Candidate &candidate, ast::FunctionCallExpression &call);
+        std::unique_ptr<ast::Statement> inlineBlock(Candidate &candidate, ast::FunctionCallExpression &call);
+
+        const size_t threshold;
+        size_t inlineCount;
+        Utf8String currentFunction;
+        // The parameters and locals of the function being inlined into
+        std::unordered_set<Utf8String> callerNames;
+        std::unordered_map<Utf8String, Candidate> candidates;
+        std::unordered_map<Utf8String, std::vector<Utf8String>> callGraph;
+        std::unordered_map<Utf8String, std::vector<Utf8String>> assumedCalls;
+        std::vector<InlineDecision> decisionLog;
+    };
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+
+#ifndef _PX_VM_BYTECODE_H_
+#define _PX_VM_BYTECODE_H_
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+#include "Utf8String.h"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace px {
+
+    // A register holds any px value. Integers are kept in 64 bits, extended from their own width
+    // (signed types with their sign, unsigned ones with zeros), float32 as a double rounded to float
+    // precision, bools and chars as integers, and strings and dynamic arrays inline. Fixed and
+    // dynamic arrays are otherwise handled through a pointer to their storage, which is made of
+    // values too, so an element of any type takes one Value.
+    union Value
+    {
+        int64_t i;
+        uint64_t u;
+        double f;
+        void *p;
+        PxString s;
+        PxVector v;
+    };
+
+    // Every instruction is an opcode and three 16 bit operands, usually registers of the current
+    // frame: a is the destination and b and c the sources. Jumps and other instructions with a wide
+    // operand join b and c into one 32 bit value.
+    #define PX_OPCODES(X) \
+        X(MOVE)            /* a = b */ \
+        X(LOAD_INT)        /* a = wide, sign extended */ \
+        X(LOAD_CONST)      /* a = constants[wide] */ \
+        X(LOAD_GLOBAL)     /* a = globals[wide] */ \
+        X(STORE_GLOBAL)    /* globals[wide] = a */ \
+        X(GLOBAL_ADDRESS)  /* a = &globals[wide] */ \
+        X(ADDRESS)         /* a = &frame[wide] */ \
+        X(LOAD_INDIRECT)   /* a = *b */ \
+        X(STORE_INDIRECT)  /* *a = b */ \
+        X(ADD_I) X(SUB_I) X(MUL_I) X(DIV_I) X(MOD_I) X(DIV_U) X(MOD_U) \
+        X(AND) X(OR) X(XOR) X(SHL) X(SHR_I) X(SHR_U) \
+        X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F) \
+        X(NEG_I) X(CMPL) X(NEG_F) X(NOT) \
+        X(EQ_I) X(NE_I) X(LT_I) X(LE_I) X(LT_U) X(LE_U) \
+        X(EQ_F) X(NE_F) X(LT_F) X(LE_F) \
+        X(NARROW_I8) X(NARROW_I16) X(NARROW_I32) /* a = a cut to the width, in place */ \
+        X(NARROW_U8) X(NARROW_U16) X(NARROW_U32) X(ROUND_F32) \
+        X(I_TO_F) X(U_TO_F) X(F_TO_I) X(F_TO_U) \
+        X(CONCAT) X(STR_EQ) X(STR_NE) X(STR_LT) X(STR_LE) \
+        X(JUMP)            /* goto wide */ \
+        X(JUMP_IF)         /* if (a) goto wide */ \
+        X(JUMP_UNLESS)     /* if (!a) goto wide */ \
+        X(FOR_NEXT)        /* ++a, then if (a < the register after a) goto wide */ \
+        X(FOR_NEXT_U)      /* the same with an unsigned comparison */ \
+        X(JUMP_TABLE)      /* goto switchTables[wide] at a - low, or its default */ \
+        X(LOOKUP_SWITCH)   /* goto switchTables[wide] at the key equal to a, or its default */ \
+        X(CALL)            /* a = functions[b](c...) */ \
+        X(CALL_NATIVE)     /* a = natives[b](c...) */ \
+        X(RETURN)          /* returns a */ \
+        X(RETURN_VOID) \
+        X(UNDEFINED)       /* the function was declared but has no body yet */ \
+        X(ARRAY_LOAD)      /* a = b[c] */ \
+        X(ARRAY_STORE)     /* a[b] = c */ \
+        X(VECTOR_LOAD)     /* a = b->data[c] */ \
+        X(VECTOR_STORE)    /* a->data[b] = c */ \
+        X(VECTOR_NEW)      /* *a = an empty vector in the current region */ \
+        X(VECTOR_LENGTH)   /* a = b->length */ \
+        X(VECTOR_PUSH)     /* push c onto a */ \
+        X(VECTOR_POP)      /* a = the last element of b, removed */ \
+        X(VECTOR_RESERVE)  /* room for b more elements in a */ \
+        X(VECTOR_APPEND)   /* the elements of b added to a */ \
+        X(VECTOR_ASSIGN)   /* the elements of a replaced by those of b */ \
+        X(VECTOR_ASSIGN_ARRAY) /* the elements of a replaced by the first c elements of the array b */ \
+        X(VECTOR_COPY)     /* a = a copy of b in the current region */ \
+        X(REGION_ENTER) \
+        X(REGION_EXIT)
+
+    enum class Opcode : uint16_t
+    {
+    #define PX_OPCODE_ENUM(name) name,
+        PX_OPCODES(PX_OPCODE_ENUM)
+    #undef PX_OPCODE_ENUM
+    };
+
+    struct Instruction
+    {
+        Opcode op;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+
+        int32_t wide() const
+        {
+            return (int32_t) ((uint32_t) b | ((uint32_t) c << 16));
+        }
+
+        void setWide(int32_t value)
+        {
+            b = (uint16_t) ((uint32_t) value & 0xFFFF);
+            c = (uint16_t) ((uint32_t) value >> 16);
+        }
+    };
+
+    // A runtime function px code can call, which reads its arguments from consecutive registers
+    typedef void (*NativeFunction)(Value *result, const Value *arguments);
+
+    // A frame holds the registers of a call followed by the storage of its fixed arrays and dynamic
+    // arrays. The parameters are its first registers.
+    struct BytecodeFunction
+    {
+        Utf8String name;
+        std::vector<Instruction> code;
+        uint32_t parameterCount;
+        uint32_t frameSize;
+        bool defined;
+        // Why the function can not be compiled to C by the TieredCompiler, or empty when it can. The
+        // functions it calls are not taken into account.
+        Utf8String uncompilable;
+    };
+
+    // The targets of a switch: a dense one is indexed by the value less low, a sparse one searches
+    // its sorted keys
+    struct SwitchTable
+    {
+        int64_t low;
+        std::vector<int64_t> keys;
+        std::vector<int32_t> targets;
+        int32_t defaultTarget;
+    };
+
+    struct Program
+    {
+        std::vector<BytecodeFunction> functions;
+        std::vector<NativeFunction> natives;
+        std::vector<Value> constants;
+        std::vector<SwitchTable> switchTables;
+        // The bytes of the string constants too long to be stored inline
+        std::deque<std::string> strings;
+        uint32_t globalCount;
+        // Runs the initializers of the module's variables
+        uint32_t initializer;
+        // The index of main, or -1 when the module has none
+        int32_t main;
+    };
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+
+#ifndef _PX_VM_BYTECODECOMPILER_H_
+#define _PX_VM_BYTECODECOMPILER_H_
+
+#include "ast/Visitor.h"
+#include "Error.h"
+#include "Scope.h"
+#include "vm/Bytecode.h"
+
+#include <unordered_map>
+
+namespace px {
+
+    // Compiles an analyzed module to bytecode for the Interpreter. It walks the scope tree the
+    // ContextAnalyzer built, the way the CCompiler does, so the two can not both compile one tree.
+    // Constructs the interpreter does not run, such as maps, are reported to the error log.
+    class BytecodeCompiler : public ast::Visitor
+    {
+    public:
+        BytecodeCompiler(ScopeTree *scopeTree, ErrorLog *errors);
+        std::unique_ptr<Program> compile(ast::Module &module);
+        // Compiles one input to the REPL into the program of the inputs before it, giving the function
+        // to call to run it. The function returns the input's value when it ends with an expression.
+        uint32_t compileInput(ast::Module &input);
+        // Steps over an input that was not compiled because it had errors
+        void skipInput();
+        // Whether an input ending with an expression of type gives its value
+        static bool isDisplayable(const Type *type);
+        const Program &inputProgram() const
+        {
+            return *program;
+        }
+        void *visit(ast::ArrayIndexReference &a) override;
+        void *visit(ast::ArrayIndexAssignmentStatement &a) override;
+        void *visit(ast::ArrayLiteral &a) override;
+        void *visit(ast::AssignmentStatement &a) override;
+        void *visit(ast::AwaitExpression &a) override;
+        void *visit(ast::BinaryOpExpression &b) override;
+        void *visit(ast::BoolLiteral &b) override;
+        void *visit(ast::BlockStatement &s) override;
+        void *visit(ast::BreakStatement &b) override;
+        void *visit(ast::CastExpression &c) override;
+        void *visit(ast::CharLiteral &c) override;
+        void *visit(ast::ContinueStatement &c) override;
+        void *visit(ast::DoWhileStatement &d) override;
+        void *visit(ast::ExpressionStatement &s) override;
+        void *visit(ast::FloatLiteral &f) override;
+        void *visit(ast::ForStatement &f) override;
+        void *visit(ast::FunctionCallExpression &f) override;
+        void *visit(ast::FunctionDeclaration &f) override;
+        void *visit(ast::FunctionDefinition &f) override;
+        void *visit(ast::IfStatement &i) override;
+        void *visit(ast::IntegerLiteral &i) override;
+        void *visit(ast::Module &m) override;
+        void *visit(ast::RegionStatement &r) override;
+        void *visit(ast::ReturnStatement &s) override;
+        void *visit(ast::SpawnExpression &s) override;
+        void *visit(ast::StringLiteral &s) override;
+        void *visit(ast::SwitchStatement &s) override;
+        void *visit(ast::TernaryOpExpression &t) override;
+        void *visit(ast::UnaryOpExpression &u) override;
+        void *visit(ast::VariableDeclaration &v) override;
+        void *visit(ast::VariableExpression &v) override;
+        void *visit(ast::WhileStatement &w) override;
+
+    private:
+        // Where break and continue jump to, patched once the statement ends
+        struct JumpTarget
+        {
+            bool loop;
+            size_t regionDepth;
+            std::vector<size_t> breaks;
+            std::vector<size_t> continues;
+        };
+
+        // The state of the function being compiled; module level code goes in the initializer
+        struct FunctionState
+        {
+            uint32_t index;
+            Function *function;
+            std::unordered_map<Variable*, uint16_t> locals;
+            uint32_t nextRegister;
+            // The registers below are taken by the variables in scope, the ones above by temporaries
+            uint32_t localsTop;
+            uint32_t registerCount;
+            uint32_t storageSize;
+            // The ADDRESS instructions whose offsets count from the end of the registers
+            std::vector<size_t> storageAddresses;
+            std::vector<JumpTarget> targets;
+            size_t regionDepth;
+        };
+
+        void startProgram(const char *initializerName);
+        size_t emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+        size_t emitWide(Opcode op, uint32_t a, int32_t wide);
+        size_t here() const;
+        void patch(size_t jump, size_t target);
+        uint16_t allocate(uint32_t count = 1);
+        uint32_t allocateStorage(uint32_t count);
+        void addressStorage(uint16_t target, uint32_t offset);
+        uint32_t constant(const Value &value);
+        uint32_t stringConstant(const Utf8String &text);
+        uint32_t functionIndex(Function *function, const SourcePosition &position);
+        int32_t nativeIndex(Function *function);
+        void uncompilable(const char *reason);
+        void error(const SourcePosition &position, const Utf8String &message);
+
+        Variable *lookup(const Utf8String &name);
+        bool isParameter(Variable *variable) const;
+        void compileInto(ast::Expression &expression, uint16_t target);
+        uint16_t operand(ast::Expression &expression);
+        uint16_t containerPointer(ast::Expression &expression);
+        void compileArithmetic(ast::BinaryOperator op, Type *type, uint16_t target, uint16_t left, uint16_t right);
+        void narrow(Type *type, uint16_t target);
+        void loadInteger(int64_t value, uint16_t target);
+        void compileCall(ast::FunctionCallExpression &call, uint16_t target);
+        void storeArrayLiteral(ast::ArrayLiteral &literal, uint16_t array);
+        void compileContainerOperation(ast::FunctionCallExpression &call, uint16_t target);
+        void assignVector(uint16_t vector, ast::Expression &expression);
+        JumpTarget compileBody(ast::Statement &body, bool loop);
+        void exitRegions(size_t depth);
+        void beginFunction(uint32_t index, Function *function);
+        void endFunction(const SourcePosition &position);
+
+        ScopeTree *scopeTree;
+        Scope *currentScope;
+        Scope *moduleScope;
+        ErrorLog *errors;
+        std::unique_ptr<Program> program;
+        FunctionState *state;
+        FunctionState initializer;
+        std::unordered_map<Function*, uint32_t> functionIndexes;
+        // Where each function was first used, for the error when one is never defined
+        std::vector<std::pair<Function*, SourcePosition>> firstUses;
+        std::unordered_map<Function*, int32_t> nativeIndexes;
+        std::unordered_map<Variable*, uint32_t> globals;
+        std::unordered_map<Utf8String, uint32_t> stringConstants;
+        // The register the expression being visited leaves its value in
+        uint16_t target;
+    };
+
+}
+
+#endif
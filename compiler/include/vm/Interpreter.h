@@ -0,0 +1,90 @@
+
+#ifndef _PX_VM_INTERPRETER_H_
+#define _PX_VM_INTERPRETER_H_
+
+#include "vm/Bytecode.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace px {
+
+    class TieredCompiler;
+
+    // Thrown when a program runs out of room for its call frames
+    class StackOverflow : public std::runtime_error
+    {
+    public:
+        explicit StackOverflow(const Utf8String &function)
+            : std::runtime_error{ (Utf8String{ "Stack overflow calling " } + function).toString() }
+        {
+        }
+    };
+
+    // Thrown when a program calls a function that was declared but never defined, which only a
+    // program the REPL is still adding to can do
+    class UndefinedFunction : public std::runtime_error
+    {
+    public:
+        explicit UndefinedFunction(const Utf8String &function)
+            : std::runtime_error{ (Utf8String{ "Function " } + function + Utf8String{ " is not defined yet" }).toString() }
+        {
+        }
+    };
+
+    // Runs a compiled Program. Every call's frame is carved out of one stack of values right above
+    // its caller's, so a call only copies its arguments, and the addresses of the arrays stored in a
+    // frame stay valid while it runs.
+    class Interpreter
+    {
+    public:
+        static const size_t STACK_VALUES = 1 << 20;
+
+        explicit Interpreter(const Program &program);
+        // Runs the initializers of the module's variables and then main, giving what main returns, or
+        // 0 when it returns nothing or the module has no main
+        int32_t run();
+        // Runs one function of a program that may have gained functions and variables since the
+        // interpreter was made, giving what it returns. The module's variables keep their values
+        // from one call to the next.
+        Value call(uint32_t function);
+
+        // Hands each function to compiler once its calls and loop iterations add up to threshold.
+        // When timed, the time spent in compiled code is measured.
+        void setTiering(TieredCompiler *compiler, uint32_t threshold, bool timed);
+        // Has the calls to function run code from now on. Any thread may install code while the
+        // interpreter runs.
+        void install(uint32_t function, NativeFunction code);
+        // The time run took in total and in compiled code
+        uint64_t runNanoseconds() const
+        {
+            return totalTime;
+        }
+        uint64_t compiledNanoseconds() const
+        {
+            return compiledTime;
+        }
+
+    private:
+        Value execute(uint32_t function);
+        void hot(uint32_t function);
+
+        const Program &program;
+        std::unique_ptr<Value[]> stack;
+        std::vector<Value> globals;
+        // How many times each function was called or went around a loop
+        std::vector<uint32_t> counters;
+        std::unique_ptr<std::atomic<NativeFunction>[]> compiled;
+        size_t compiledCapacity;
+        TieredCompiler *tiers;
+        uint32_t threshold;
+        bool timed;
+        uint64_t totalTime;
+        uint64_t compiledTime;
+    };
+
+}
+
+#endif
@@ -0,0 +1,15 @@
+
+#ifndef _PX_VM_NATIVES_H_
+#define _PX_VM_NATIVES_H_
+
+#include "vm/Bytecode.h"
+
+namespace px {
+
+    // The runtime function an extern function binds to when its program is interpreted, or nullptr
+    // when the registration table has none of that name
+    NativeFunction findNative(const Utf8String &name);
+
+}
+
+#endif
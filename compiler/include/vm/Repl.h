@@ -0,0 +1,62 @@
+
+#ifndef _PX_VM_REPL_H_
+#define _PX_VM_REPL_H_
+
+#include "ContextAnalyzer.h"
+#include "Error.h"
+#include "Parser.h"
+#include "Scope.h"
+#include "vm/BytecodeCompiler.h"
+#include "vm/Interpreter.h"
+
+#include <istream>
+#include <memory>
+
+namespace px {
+
+    // What evaluating one input gave
+    struct ReplResult
+    {
+        bool ok;
+        // The type of the value the input ended with, or nullptr when it gave none
+        Type *type;
+        Value value;
+    };
+
+    // Reads px statements one input at a time and runs each as soon as it is read. The inputs are
+    // statements of one module that grows with each of them: every input is analyzed and compiled
+    // in the module scope the ones before it left, so only its own statements are looked at, and
+    // the interpreter keeps the module's variables from one input to the next.
+    class Repl
+    {
+    public:
+        Repl();
+
+        // Parses, analyzes, compiles and runs input. When it has errors, they are in errors() and
+        // the input leaves nothing behind.
+        ReplResult evaluate(const Utf8String &input);
+        const ErrorLog &errors() const
+        {
+            return errorLog;
+        }
+
+        // Evaluates the inputs read from input until it ends or a line is :quit, printing the value
+        // of each input that ends with an expression. An input goes on over as many lines as it
+        // takes for its braces to close, and a statement that ends a line needs no semicolon.
+        void run(std::istream &input, bool prompt);
+
+        // Prints value the way a px program would print a value of type
+        static void display(const Type *type, const Value &value);
+
+    private:
+        ScopeTree scopeTree;
+        ErrorLog errorLog;
+        ContextAnalyzer analyzer;
+        BytecodeCompiler compiler;
+        std::unique_ptr<Interpreter> interpreter;
+        size_t inputCount;
+    };
+
+}
+
+#endif
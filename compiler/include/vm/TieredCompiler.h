@@ -0,0 +1,110 @@
+
+#ifndef _PX_VM_TIEREDCOMPILER_H_
+#define _PX_VM_TIEREDCOMPILER_H_
+
+#include "vm/Bytecode.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace px {
+
+    class Interpreter;
+
+    struct TieringOptions
+    {
+        // How many calls and loop iterations make a function hot
+        uint32_t threshold;
+        // The Inliner settings the module was compiled with, which it is compiled again with
+        bool inlining;
+        size_t inlineThreshold;
+        // Whether the time spent in compiled code is measured for the report
+        bool timed;
+    };
+
+    // A function that became hot, and whether it was compiled
+    struct TierEvent
+    {
+        Utf8String function;
+        // When the function became hot, from the start of the run
+        uint64_t hotNanoseconds;
+        uint64_t compileNanoseconds;
+        bool compiled;
+        // Why the function was not compiled
+        Utf8String reason;
+    };
+
+    // Compiles the functions an Interpreter finds hot to machine code on a background thread. The
+    // CCompiler generates a function together with the functions it calls, the system C compiler
+    // builds them into a shared library and the library is loaded with dlopen, after which the
+    // interpreter calls the compiled function in its place. The module is parsed and analyzed again
+    // for each one, as the CCompiler needs a scope tree of its own.
+    //
+    // Only functions whose arguments and result are scalars or strings and which do not use the
+    // module's variables, spawn tasks or run parallel loops can be compiled, and only if the
+    // functions they call can be too.
+    class TieredCompiler
+    {
+    public:
+        static const uint32_t DEFAULT_THRESHOLD = 10000;
+
+        TieredCompiler(const Program &program, Interpreter &interpreter, const Utf8String &fileName,
+                       const std::string &source, const TieringOptions &options);
+        ~TieredCompiler();
+
+        // Queues function to be compiled. The interpreter calls this when the function gets hot.
+        void request(uint32_t function);
+        // Waits for every queued function to be compiled or given up on
+        void finish();
+        // Gives up on the queued functions and waits for the one being compiled
+        void stop();
+
+        // Why function can not be compiled, or empty when it can
+        const Utf8String &uncompilable(uint32_t function) const
+        {
+            return reasons[function];
+        }
+        std::vector<TierEvent> events() const;
+        // Prints each tier-up and the time spent in each tier to stderr
+        void outputReport() const;
+
+    private:
+        void work();
+        void compile(uint32_t function, TierEvent &event);
+        int runCompiler(const std::vector<std::string> &arguments, const std::string &output);
+        bool stopped() const;
+        uint64_t elapsed() const;
+
+        const Program &program;
+        Interpreter &interpreter;
+        const Utf8String fileName;
+        const std::string source;
+        const TieringOptions options;
+        const std::chrono::steady_clock::time_point start;
+        std::vector<Utf8String> reasons;
+        std::vector<std::vector<uint32_t>> callees;
+        std::vector<bool> requested;
+
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<uint32_t> queue;
+        std::vector<TierEvent> log;
+        bool busy;
+        bool stopping;
+        // The C compiler's process while one runs, or 0
+        int compilerProcess;
+        std::thread worker;
+        // The directory the C files and libraries are built in, and the libraries loaded
+        std::string directory;
+        std::vector<void*> libraries;
+        uint64_t compileTime;
+    };
+
+}
+
+#endif
@@ -0,0 +1,825 @@
+#include "AstCache.h"
+
+#include "ast/Declaration.h"
+#include "ast/Expression.h"
+#include "ast/Literal.h"
+#include "ast/Statement.h"
+#include "ast/Visitor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace px {
+
+    static const uint32_t HEADER_WORDS = 6;
+
+    // The types the scanner gives literals, which are stored by their index here
+    static const std::vector<Type*> &literalTypes()
+    {
+        static const std::vector<Type*> types{ Type::INT8, Type::INT16, Type::INT32, Type::INT64, Type::UINT8, Type::UINT16,
+                                               Type::UINT32, Type::UINT64, Type::FLOAT32, Type::FLOAT64 };
+        return types;
+    }
+
+    uint64_t AstCache::hash(const Utf8String &source)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        const uint8_t *bytes = source.data();
+        for (size_t i = 0; i < source.byteLength(); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    namespace
+    {
+
+        class AstWriter : public ast::Visitor
+        {
+        public:
+            std::vector<uint32_t> words;
+            std::vector<std::string> strings;
+
+            void module(ast::Module &m)
+            {
+                string(m.moduleName);
+                position(m.position);
+                words.push_back((uint32_t) m.imports.size());
+                for (auto &import : m.imports)
+                {
+                    position(import.position);
+                    string(import.moduleName);
+                }
+                list(m.statements);
+            }
+
+            void *visit(ast::ArrayIndexReference &a) override
+            {
+                start(a);
+                node(a.array.get());
+                node(a.index.get());
+                return nullptr;
+            }
+
+            void *visit(ast::ArrayLiteral &a) override
+            {
+                start(a);
+                list(a.values);
+                return nullptr;
+            }
+
+            void *visit(ast::ArrayIndexAssignmentStatement &a) override
+            {
+                start(a);
+                words.push_back((uint32_t) a.opType);
+                node(a.reference.get());
+                node(a.expression.get());
+                return nullptr;
+            }
+
+            void *visit(ast::AssignmentStatement &a) override
+            {
+                start(a);
+                string(a.variableName);
+                words.push_back((uint32_t) a.opType);
+                node(a.expression.get());
+                return nullptr;
+            }
+
+            void *visit(ast::AwaitExpression &a) override
+            {
+                start(a);
+                node(a.future.get());
+                return nullptr;
+            }
+
+            void *visit(ast::BinaryOpExpression &b) override
+            {
+                start(b);
+                words.push_back((uint32_t) b.op);
+                words.push_back((uint32_t) b.token);
+                node(b.left.get());
+                node(b.right.get());
+                return nullptr;
+            }
+
+            void *visit(ast::BlockStatement &s) override
+            {
+                start(s);
+                list(s.statements);
+                return nullptr;
+            }
+
+            void *visit(ast::BoolLiteral &b) override
+            {
+                start(b);
+                string(b.literal);
+                return nullptr;
+            }
+
+            void *visit(ast::BreakStatement &b) override
+            {
+                start(b);
+                return nullptr;
+            }
+
+            void *visit(ast::CastExpression &c) override
+            {
+                start(c);
+                string(c.newTypeName);
+                node(c.expression.get());
+                return nullptr;
+            }
+
+            void *visit(ast::CharLiteral &c) override
+            {
+                start(c);
+                string(c.literal);
+                return nullptr;
+            }
+
+            void *visit(ast::ContinueStatement &c) override
+            {
+                start(c);
+                return nullptr;
+            }
+
+            void *visit(ast::DoWhileStatement &d) override
+            {
+                start(d);
+                node(d.condition.get());
+                node(d.body.get());
+                return nullptr;
+            }
+
+            void *visit(ast::ExpressionStatement &s) override
+            {
+                start(s);
+                node(s.expression.get());
+                return nullptr;
+            }
+
+            void *visit(ast::FloatLiteral &f) override
+            {
+                start(f);
+                typeIndex(f.type);
+                string(f.literal);
+                return nullptr;
+            }
+
+            void *visit(ast::ForStatement &f) override
+            {
+                start(f);
+                string(f.variableName);
+                string(f.typeName);
+                words.push_back(f.parallel ? 1 : 0);
+                node(f.start.get());
+                node(f.end.get());
+                node(f.body.get());
+                return nullptr;
+            }
+
+            void *visit(ast::FunctionCallExpression &f) override
+            {
+                start(f);
+                string(f.functionName);
+                list(f.arguments);
+                return nullptr;
+            }
+
+            void *visit(ast::FunctionDeclaration &f) override
+            {
+                start(f);
+                prototype(*f.prototype);
+                return nullptr;
+            }
+
+            void *visit(ast::FunctionDefinition &f) override
+            {
+                start(f);
+                prototype(*f.prototype);
+                node(f.block.get());
+                return nullptr;
+            }
+
+            void *visit(ast::IfStatement &i) override
+            {
+                start(i);
+                node(i.condition.get());
+                node(i.trueStatement.get());
+                node(i.elseStatement.get());
+                return nullptr;
+            }
+
+            void *visit(ast::IntegerLiteral &i) override
+            {
+                start(i);
+                typeIndex(i.type);
+                string(i.literal);
+                int64(i.value);
+                return nullptr;
+            }
+
+            void *visit(ast::Module &m) override
+            {
+                return nullptr;
+            }
+
+            void *visit(ast::RegionStatement &r) override
+            {
+                start(r);
+                node(r.body.get());
+                return nullptr;
+            }
+
+            void *visit(ast::ReturnStatement &s) override
+            {
+                start(s);
+                node(s.returnValue.get());
+                return nullptr;
+            }
+
+            void *visit(ast::SpawnExpression &s) override
+            {
+                start(s);
+                node(s.call.get());
+                return nullptr;
+            }
+
+            void *visit(ast::StringLiteral &s) override
+            {
+                start(s);
+                string(s.literal);
+                return nullptr;
+            }
+
+            void *visit(ast::SwitchStatement &s) override
+            {
+                start(s);
+                node(s.scrutinee.get());
+                words.push_back((uint32_t) s.cases.size());
+                for (auto &switchCase : s.cases)
+                {
+                    position(switchCase.position);
+                    list(switchCase.values);
+                    node(switchCase.body.get());
+                }
+                node(s.defaultBody.get());
+                return nullptr;
+            }
+
+            void *visit(ast::TernaryOpExpression &t) override
+            {
+                start(t);
+                node(t.condition.get());
+                node(t.trueExpr.get());
+                node(t.falseExpr.get());
+                return nullptr;
+            }
+
+            void *visit(ast::UnaryOpExpression &u) override
+            {
+                start(u);
+                words.push_back((uint32_t) u.op);
+                words.push_back((uint32_t) u.token);
+                node(u.expression.get());
+                return nullptr;
+            }
+
+            void *visit(ast::VariableDeclaration &d) override
+            {
+                start(d);
+                string(d.typeName);
+                string(d.name);
+                arraySize(d.arraySize.get());
+                node(d.initialValue.get());
+                return nullptr;
+            }
+
+            void *visit(ast::VariableExpression &v) override
+            {
+                start(v);
+                string(v.variable);
+                return nullptr;
+            }
+
+            void *visit(ast::WhileStatement &w) override
+            {
+                start(w);
+                node(w.condition.get());
+                node(w.body.get());
+                return nullptr;
+            }
+
+        private:
+            std::unordered_map<std::string, uint32_t> stringIndices;
+
+            void position(const SourcePosition &position)
+            {
+                words.push_back((uint32_t) position.fileOffset);
+                words.push_back((uint32_t) position.line);
+                words.push_back((uint32_t) position.lineColumn);
+            }
+
+            void start(ast::AST &node)
+            {
+                words.push_back((uint32_t) node.nodeType);
+                position(node.position);
+            }
+
+            void node(ast::AST *node)
+            {
+                if (node == nullptr)
+                    words.push_back((uint32_t) ast::NodeType::UNKNOWN);
+                else
+                    node->accept(*this);
+            }
+
+            template<typename T>
+            void list(const std::vector<std::unique_ptr<T>> &nodes)
+            {
+                words.push_back((uint32_t) nodes.size());
+                for (auto &node : nodes)
+                    node->accept(*this);
+            }
+
+            void string(const Utf8String &text)
+            {
+                std::string bytes = text.toString();
+                auto entry = stringIndices.find(bytes);
+                if (entry == stringIndices.end())
+                {
+                    entry = stringIndices.emplace(bytes, (uint32_t) strings.size()).first;
+                    strings.push_back(bytes);
+                }
+                words.push_back(entry->second);
+            }
+
+            void int64(int64_t value)
+            {
+                words.push_back((uint32_t) (uint64_t) value);
+                words.push_back((uint32_t) ((uint64_t) value >> 32));
+            }
+
+            void arraySize(const int64_t *size)
+            {
+                words.push_back(size != nullptr ? 1 : 0);
+                int64(size != nullptr ? *size : 0);
+            }
+
+            void typeIndex(Type *type)
+            {
+                auto &types = literalTypes();
+                words.push_back((uint32_t) (std::find(types.begin(), types.end(), type) - types.begin()));
+            }
+
+            void prototype(ast::FunctionPrototype &prototype)
+            {
+                string(prototype.name);
+                string(prototype.returnTypeName);
+                words.push_back(prototype.isExtern ? 1 : 0);
+                words.push_back((uint32_t) prototype.visibility);
+                words.push_back((uint32_t) prototype.parameters.size());
+                for (auto &parameter : prototype.parameters)
+                {
+                    string(parameter.name);
+                    string(parameter.typeName);
+                    arraySize(parameter.arraySize.get());
+                }
+            }
+        };
+
+        // Builds the nodes back from the words. A file that ends early or names a string or node
+        // it does not have is given up on, by throwing.
+        class AstReader
+        {
+        public:
+            AstReader(const uint32_t *nodeWords, size_t count, std::vector<Utf8String> &strings, const Utf8String &fileName)
+                : words{ nodeWords }, wordCount{ count }, next{ 0 }, strings{ strings }, fileName{ fileName }
+            {
+            }
+
+            std::unique_ptr<ast::Module> module()
+            {
+                Utf8String moduleName = string();
+                SourcePosition start = position();
+                auto module = std::make_unique<ast::Module>(start, moduleName, fileName);
+                uint32_t importCount = word();
+                for (uint32_t i = 0; i < importCount; ++i)
+                {
+                    SourcePosition importPosition = position();
+                    module->imports.emplace_back(importPosition, string());
+                }
+                uint32_t statementCount = word();
+                for (uint32_t i = 0; i < statementCount; ++i)
+                    module->addStatement(required(statement()));
+                if (next != wordCount)
+                    fail();
+                return module;
+            }
+
+        private:
+            const uint32_t *words;
+            const size_t wordCount;
+            size_t next;
+            std::vector<Utf8String> &strings;
+            const Utf8String &fileName;
+
+            [[noreturn]] static void fail()
+            {
+                throw std::runtime_error{ "The AST cache is damaged" };
+            }
+
+            uint32_t word()
+            {
+                if (next >= wordCount)
+                    fail();
+                return words[next++];
+            }
+
+            // Reads a value of an enum whose last value is last, so that a damaged file can not make
+            // one outside of it
+            template<typename T>
+            T enumeration(T last)
+            {
+                uint32_t value = word();
+                if (value > (uint32_t) last)
+                    fail();
+                return (T) value;
+            }
+
+            const Utf8String &string()
+            {
+                uint32_t index = word();
+                if (index >= strings.size())
+                    fail();
+                return strings[index];
+            }
+
+            int64_t int64()
+            {
+                uint64_t low = word();
+                uint64_t high = word();
+                return (int64_t) (low | high << 32);
+            }
+
+            std::unique_ptr<int64_t> arraySize()
+            {
+                bool present = word() != 0;
+                int64_t size = int64();
+                return present ? std::make_unique<int64_t>(size) : nullptr;
+            }
+
+            Type *literalType()
+            {
+                uint32_t index = word();
+                auto &types = literalTypes();
+                if (index >= types.size())
+                    fail();
+                return types[index];
+            }
+
+            SourcePosition position()
+            {
+                SourcePosition position{ fileName };
+                position.fileOffset = word();
+                position.line = word();
+                position.lineColumn = word();
+                return position;
+            }
+
+            template<typename T>
+            static std::unique_ptr<T> required(std::unique_ptr<T> node)
+            {
+                if (node == nullptr)
+                    fail();
+                return node;
+            }
+
+            static bool isExpression(ast::NodeType type)
+            {
+                return (type >= ast::NodeType::EXP_ARRAY_ACCESS && type <= ast::NodeType::LITERAL_STRING);
+            }
+
+            std::unique_ptr<ast::Expression> expression()
+            {
+                std::unique_ptr<ast::AST> node = this->node();
+                if (node != nullptr && !isExpression(node->nodeType))
+                    fail();
+                return std::unique_ptr<ast::Expression>{ (ast::Expression*) node.release() };
+            }
+
+            std::unique_ptr<ast::Statement> statement()
+            {
+                std::unique_ptr<ast::AST> node = this->node();
+                if (node != nullptr && (isExpression(node->nodeType) || node->nodeType == ast::NodeType::MODULE))
+                    fail();
+                return std::unique_ptr<ast::Statement>{ (ast::Statement*) node.release() };
+            }
+
+            std::unique_ptr<ast::BlockStatement> block()
+            {
+                std::unique_ptr<ast::AST> node = this->node();
+                if (node != nullptr && node->nodeType != ast::NodeType::STMT_BLOCK)
+                    fail();
+                return std::unique_ptr<ast::BlockStatement>{ (ast::BlockStatement*) node.release() };
+            }
+
+            std::vector<std::unique_ptr<ast::Expression>> expressions()
+            {
+                std::vector<std::unique_ptr<ast::Expression>> values;
+                uint32_t count = word();
+                for (uint32_t i = 0; i < count; ++i)
+                    values.push_back(required(expression()));
+                return values;
+            }
+
+            std::unique_ptr<ast::FunctionPrototype> prototype()
+            {
+                Utf8String name = string();
+                Utf8String returnTypeName = string();
+                bool isExtern = word() != 0;
+                auto visibility = enumeration(Visibility::PRIVATE);
+                std::vector<ast::Parameter> parameters;
+                uint32_t count = word();
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    Utf8String parameterName = string();
+                    Utf8String typeName = string();
+                    parameters.emplace_back(parameterName, typeName, arraySize().release());
+                }
+                return std::make_unique<ast::FunctionPrototype>(name, returnTypeName, parameters, isExtern, visibility);
+            }
+
+            std::unique_ptr<ast::AST> node()
+            {
+                auto type = (ast::NodeType) word();
+                if (type == ast::NodeType::UNKNOWN)
+                    return nullptr;
+                SourcePosition start = position();
+                switch (type)
+                {
+                    case ast::NodeType::DECLARE_VAR:
+                    {
+                        Utf8String typeName = string();
+                        Utf8String name = string();
+                        auto size = arraySize();
+                        auto value = expression();
+                        return std::make_unique<ast::VariableDeclaration>(start, typeName, name, std::move(value), size.release());
+                    }
+                    case ast::NodeType::DECLARE_FUNC:
+                        return std::make_unique<ast::FunctionDeclaration>(start, prototype());
+                    case ast::NodeType::DECLARE_FUNC_BODY:
+                    {
+                        auto functionPrototype = prototype();
+                        return std::make_unique<ast::FunctionDefinition>(start, std::move(functionPrototype), required(block()));
+                    }
+                    case ast::NodeType::EXP_ARRAY_ACCESS:
+                    {
+                        auto array = required(expression());
+                        return std::make_unique<ast::ArrayIndexReference>(start, std::move(array), required(expression()));
+                    }
+                    case ast::NodeType::EXP_CAST:
+                    {
+                        Utf8String typeName = string();
+                        return std::make_unique<ast::CastExpression>(start, typeName, required(expression()));
+                    }
+                    case ast::NodeType::EXP_FUNC_CALL:
+                    {
+                        Utf8String name = string();
+                        return std::make_unique<ast::FunctionCallExpression>(start, name, expressions());
+                    }
+                    case ast::NodeType::EXP_BINARY_OP:
+                    {
+                        auto op = enumeration(ast::BinaryOperator::EXP);
+                        auto token = enumeration(TokenType::OP_SUB);
+                        auto left = required(expression());
+                        return std::make_unique<ast::BinaryOpExpression>(start, op, token, std::move(left), required(expression()));
+                    }
+                    case ast::NodeType::EXP_TERNARY_OP:
+                    {
+                        auto condition = required(expression());
+                        auto trueExpression = required(expression());
+                        return std::make_unique<ast::TernaryOpExpression>(start, std::move(condition), std::move(trueExpression), required(expression()));
+                    }
+                    case ast::NodeType::EXP_UNARY_OP:
+                    {
+                        auto op = enumeration(ast::UnaryOperator::NOT);
+                        auto token = enumeration(TokenType::OP_SUB);
+                        return std::make_unique<ast::UnaryOpExpression>(start, op, token, required(expression()));
+                    }
+                    case ast::NodeType::EXP_VAR_LOAD:
+                        return std::make_unique<ast::VariableExpression>(start, string());
+                    case ast::NodeType::EXP_AWAIT:
+                        return std::make_unique<ast::AwaitExpression>(start, required(expression()));
+                    case ast::NodeType::EXP_SPAWN:
+                    {
+                        auto call = required(expression());
+                        if (call->nodeType != ast::NodeType::EXP_FUNC_CALL)
+                            fail();
+                        return std::make_unique<ast::SpawnExpression>(start, std::unique_ptr<ast::FunctionCallExpression>{ (ast::FunctionCallExpression*) call.release() });
+                    }
+                    case ast::NodeType::LITERAL_ARRAY:
+                    {
+                        auto array = std::make_unique<ast::ArrayLiteral>(start);
+                        array->values = expressions();
+                        return array;
+                    }
+                    case ast::NodeType::LITERAL_BOOL:
+                        return std::make_unique<ast::BoolLiteral>(start, string());
+                    case ast::NodeType::LITERAL_CHAR:
+                        return std::make_unique<ast::CharLiteral>(start, string());
+                    case ast::NodeType::LITERAL_FLOAT:
+                    {
+                        Type *type = literalType();
+                        return std::make_unique<ast::FloatLiteral>(start, type, string());
+                    }
+                    case ast::NodeType::LITERAL_INT:
+                    {
+                        Type *type = literalType();
+                        Utf8String literal = string();
+                        return std::make_unique<ast::IntegerLiteral>(start, type, literal, int64());
+                    }
+                    case ast::NodeType::LITERAL_STRING:
+                        return std::make_unique<ast::StringLiteral>(start, string());
+                    case ast::NodeType::STMT_ARRAY_INDEX_ASSIGN:
+                    {
+                        auto op = enumeration(TokenType::OP_SUB);
+                        auto reference = required(expression());
+                        return std::make_unique<ast::ArrayIndexAssignmentStatement>(start, std::move(reference), op, required(expression()));
+                    }
+                    case ast::NodeType::STMT_ASSIGN:
+                    {
+                        Utf8String name = string();
+                        auto op = enumeration(TokenType::OP_SUB);
+                        return std::make_unique<ast::AssignmentStatement>(start, name, op, required(expression()));
+                    }
+                    case ast::NodeType::STMT_BLOCK:
+                    {
+                        auto block = std::make_unique<ast::BlockStatement>(start);
+                        uint32_t count = word();
+                        for (uint32_t i = 0; i < count; ++i)
+                            block->addStatement(required(statement()));
+                        return block;
+                    }
+                    case ast::NodeType::STMT_BREAK:
+                        return std::make_unique<ast::BreakStatement>(start);
+                    case ast::NodeType::STMT_CONTINUE:
+                        return std::make_unique<ast::ContinueStatement>(start);
+                    case ast::NodeType::STMT_DO_WHILE:
+                    {
+                        auto condition = required(expression());
+                        return std::make_unique<ast::DoWhileStatement>(start, std::move(condition), required(statement()));
+                    }
+                    case ast::NodeType::STMT_EXP:
+                        return std::make_unique<ast::ExpressionStatement>(start, required(expression()));
+                    case ast::NodeType::STMT_FOR:
+                    {
+                        Utf8String name = string();
+                        Utf8String typeName = string();
+                        bool parallel = word() != 0;
+                        auto from = required(expression());
+                        auto to = required(expression());
+                        return std::make_unique<ast::ForStatement>(start, name, typeName, std::move(from), std::move(to), required(statement()), parallel);
+                    }
+                    case ast::NodeType::STMT_IF:
+                    {
+                        auto condition = required(expression());
+                        auto trueStatement = required(statement());
+                        return std::make_unique<ast::IfStatement>(start, std::move(condition), std::move(trueStatement), statement());
+                    }
+                    case ast::NodeType::STMT_REGION:
+                        return std::make_unique<ast::RegionStatement>(start, required(block()));
+                    case ast::NodeType::STMT_RETURN:
+                        return std::make_unique<ast::ReturnStatement>(start, expression());
+                    case ast::NodeType::STMT_SWITCH:
+                    {
+                        auto scrutinee = required(expression());
+                        std::vector<ast::SwitchCase> cases;
+                        uint32_t count = word();
+                        for (uint32_t i = 0; i < count; ++i)
+                        {
+                            SourcePosition casePosition = position();
+                            auto values = expressions();
+                            cases.emplace_back(casePosition, std::move(values), required(block()));
+                        }
+                        return std::make_unique<ast::SwitchStatement>(start, std::move(scrutinee), std::move(cases), block());
+                    }
+                    case ast::NodeType::STMT_WHILE:
+                    {
+                        auto condition = required(expression());
+                        return std::make_unique<ast::WhileStatement>(start, std::move(condition), required(statement()));
+                    }
+                    default:
+                        fail();
+                }
+            }
+        };
+
+    }
+
+    bool AstCache::write(const std::string &path, uint64_t sourceHash, ast::Module &module)
+    {
+        AstWriter writer;
+        writer.module(module);
+
+        std::string strings;
+        for (auto &bytes : writer.strings)
+        {
+            uint32_t length = (uint32_t) bytes.size();
+            strings.append((const char*) &length, sizeof(length));
+            strings += bytes;
+            strings.resize((strings.size() + 3) & ~(size_t) 3, '\0');
+        }
+        uint32_t header[HEADER_WORDS] = { MAGIC, VERSION, (uint32_t) sourceHash, (uint32_t) (sourceHash >> 32),
+                                          (uint32_t) writer.strings.size(), (uint32_t) writer.words.size() };
+
+        std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+        out.write((const char*) header, sizeof(header));
+        out.write((const char*) writer.words.data(), (std::streamsize) (writer.words.size() * sizeof(uint32_t)));
+        out.write(strings.data(), (std::streamsize) strings.size());
+        return out.good();
+    }
+
+    // Decodes the cache in data, giving nullptr when it is stale or damaged
+    static std::unique_ptr<ast::Module> decode(const uint8_t *data, size_t size, uint64_t sourceHash, const Utf8String &fileName)
+    {
+        const uint32_t *words = (const uint32_t*) data;
+        size_t wordCount = size / sizeof(uint32_t);
+        if (wordCount < HEADER_WORDS || words[0] != AstCache::MAGIC || words[1] != AstCache::VERSION
+            || words[2] != (uint32_t) sourceHash || words[3] != (uint32_t) (sourceHash >> 32) || words[5] > wordCount - HEADER_WORDS)
+            return nullptr;
+
+        // Each string takes a length word at least, which bounds how many the rest of the file holds
+        size_t offset = (HEADER_WORDS + words[5]) * sizeof(uint32_t);
+        if (words[4] > (size - offset) / sizeof(uint32_t))
+            return nullptr;
+
+        try {
+            std::vector<Utf8String> strings;
+            strings.reserve(words[4]);
+            for (uint32_t i = 0; i < words[4]; ++i)
+            {
+                uint32_t length;
+                if (offset + sizeof(length) > size)
+                    return nullptr;
+                std::memcpy(&length, data + offset, sizeof(length));
+                offset += sizeof(length);
+                if (length > size - offset)
+                    return nullptr;
+                strings.emplace_back(std::string{ (const char*) data + offset, length });
+                offset += (length + 3) & ~(size_t) 3;
+            }
+
+            AstReader reader{ words + HEADER_WORDS, words[5], strings, fileName };
+            return reader.module();
+        }
+        catch (const std::exception &) {
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<ast::Module> AstCache::read(const std::string &path, uint64_t sourceHash, const Utf8String &fileName)
+    {
+    #if !defined(_WIN32)
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return nullptr;
+        struct stat status;
+        void *data = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0)
+            data = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (data == MAP_FAILED)
+            return nullptr;
+        auto module = decode((const uint8_t*) data, (size_t) status.st_size, sourceHash, fileName);
+        munmap(data, (size_t) status.st_size);
+        return module;
+    #else
+        std::ifstream in{ path, std::ios::binary };
+        if (!in.good())
+            return nullptr;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string contents = buffer.str();
+        // Copied to memory aligned for the words
+        std::vector<uint32_t> words((contents.size() + 3) / 4);
+        std::memcpy(words.data(), contents.data(), contents.size());
+        return decode((const uint8_t*) words.data(), contents.size(), sourceHash, fileName);
+    #endif
+    }
+
+}
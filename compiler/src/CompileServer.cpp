@@ -0,0 +1,423 @@
+#include "CompileServer.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace px {
+
+    // A file changed this recently may change again within the same tick of its clock, so its time
+    // is not trusted
+    static const int64_t RACY_NANOSECONDS = 2000000000;
+
+    // FNV-1a over a file's bytes
+    static uint64_t hashFile(const std::string &path)
+    {
+        std::ifstream in{ path, std::ios::binary };
+        uint64_t hash = 14695981039346656037ull;
+        char buffer[65536];
+        while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+        {
+            for (std::streamsize i = 0; i < in.gcount(); ++i)
+            {
+                hash ^= (uint8_t) buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    CompileServer::CompileServer(const std::string &path, const CompileFunction &compile)
+        : socketPath{ path }, compileFunction{ compile }, listener{ -1 }, compiles{ 0 }, reuses{ 0 }
+    {
+    }
+
+#if !defined(_WIN32)
+
+    static bool writeAll(int fd, const void *data, size_t length)
+    {
+        const char *bytes = (const char*) data;
+        while (length > 0)
+        {
+            ssize_t written = ::write(fd, bytes, length);
+            if (written <= 0)
+                return false;
+            bytes += written;
+            length -= (size_t) written;
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, void *data, size_t length)
+    {
+        char *bytes = (char*) data;
+        while (length > 0)
+        {
+            ssize_t count = ::read(fd, bytes, length);
+            if (count <= 0)
+                return false;
+            bytes += count;
+            length -= (size_t) count;
+        }
+        return true;
+    }
+
+    template<typename T>
+    static bool writeValue(int fd, T value)
+    {
+        return writeAll(fd, &value, sizeof(value));
+    }
+
+    static bool writeString(int fd, const std::string &text)
+    {
+        return writeValue(fd, (uint32_t) text.size()) && writeAll(fd, text.data(), text.size());
+    }
+
+    static bool readString(int fd, std::string &text)
+    {
+        uint32_t length;
+        if (!readAll(fd, &length, sizeof(length)))
+            return false;
+        text.resize(length);
+        return readAll(fd, &text[0], length);
+    }
+
+    static bool socketAddress(const std::string &path, sockaddr_un &address)
+    {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    static int connectTo(const std::string &path)
+    {
+        sockaddr_un address;
+        if (!socketAddress(path, address))
+            return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, (sockaddr*) &address, sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static std::string readBack(FILE *file)
+    {
+        std::string contents;
+        std::rewind(file);
+        char buffer[65536];
+        size_t count;
+        while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+            contents.append(buffer, count);
+        return contents;
+    }
+
+    CompileServer::~CompileServer()
+    {
+        if (listener >= 0)
+        {
+            close(listener);
+            unlink(socketPath.c_str());
+        }
+    }
+
+    bool CompileServer::listen()
+    {
+        sockaddr_un address;
+        if (!socketAddress(socketPath, address))
+        {
+            std::cerr << "The socket path " << socketPath << " is too long" << std::endl;
+            return false;
+        }
+        // A socket no server answers on is left over from one that did not stop
+        int running = connectTo(socketPath);
+        if (running >= 0)
+        {
+            close(running);
+            std::cerr << "A server is already listening on " << socketPath << std::endl;
+            return false;
+        }
+        unlink(socketPath.c_str());
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, (sockaddr*) &address, sizeof(address)) != 0 || ::listen(listener, 16) != 0)
+        {
+            std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+            if (listener >= 0)
+                close(listener);
+            listener = -1;
+            return false;
+        }
+        char *current = getcwd(nullptr, 0);
+        directory = current != nullptr ? current : ".";
+        std::free(current);
+        // A client that goes away before its reply is written must not stop the server
+        std::signal(SIGPIPE, SIG_IGN);
+        return true;
+    }
+
+    void CompileServer::run()
+    {
+        while (listener >= 0)
+        {
+            int connection = accept(listener, nullptr, nullptr);
+            if (connection < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            bool serving = serve(connection);
+            close(connection);
+            if (!serving)
+                break;
+        }
+        // Clients that come later are turned away rather than left waiting
+        if (listener >= 0)
+        {
+            close(listener);
+            unlink(socketPath.c_str());
+            listener = -1;
+        }
+    }
+
+    // Gives false once the request was to stop
+    bool CompileServer::serve(int connection)
+    {
+        uint32_t header[3];
+        if (!readAll(connection, header, sizeof(header)) || header[0] != MAGIC)
+            return true;
+        if (header[1] == STOP)
+        {
+            writeValue(connection, (int32_t) 0);
+            writeString(connection, std::string{});
+            writeString(connection, std::string{});
+            return false;
+        }
+        std::vector<std::string> strings(header[2]);
+        for (auto &text : strings)
+        {
+            if (!readString(connection, text))
+                return true;
+        }
+        if (header[1] != COMPILE || strings.empty())
+            return true;
+
+        std::string key;
+        for (auto &text : strings)
+            key += text + '\0';
+        CompileReply reply;
+        auto result = results.find(key);
+        bool upToDate = result != results.end();
+        for (size_t i = 0; upToDate && i < result->second.stamps.size(); ++i)
+            upToDate = unchanged(result->second.stamps[i]);
+        if (upToDate)
+        {
+            ++reuses;
+            reply = result->second.reply;
+        }
+        else if (chdir(strings[0].c_str()) != 0)
+        {
+            reply = CompileReply{ -1, std::string{}, "Could not change to directory " + strings[0] + "\n" };
+        }
+        else
+        {
+            ++compiles;
+            CompileRecord record;
+            std::vector<std::string> arguments{ strings.begin() + 1, strings.end() };
+            reply = compile(arguments, record);
+            // Only a compile that worked is kept, since a failed one may not have got to reading
+            // all the files it would have
+            if (reply.exitCode == 0)
+            {
+                Result &kept = results[key];
+                kept.reply = reply;
+                kept.stamps.clear();
+                // The files are looked at again from the server's own directory
+                for (auto *paths : { &record.inputs, &record.outputs })
+                {
+                    for (auto &path : *paths)
+                        kept.stamps.push_back(stamp(path[0] == '/' ? path : strings[0] + "/" + path));
+                }
+            }
+            else
+                results.erase(key);
+            if (chdir(directory.c_str()) != 0)
+                std::cerr << "Could not change back to directory " << directory << std::endl;
+        }
+        writeValue(connection, reply.exitCode);
+        writeString(connection, reply.out);
+        writeString(connection, reply.err);
+        return true;
+    }
+
+    // The compile writes to the server's standard output and error, which go to files meanwhile
+    CompileReply CompileServer::compile(const std::vector<std::string> &arguments, CompileRecord &record)
+    {
+        CompileReply reply;
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+        FILE *out = std::tmpfile();
+        FILE *err = std::tmpfile();
+        if (out == nullptr || err == nullptr)
+        {
+            if (out != nullptr)
+                std::fclose(out);
+            if (err != nullptr)
+                std::fclose(err);
+            return CompileReply{ -1, std::string{}, "Could not make files for the compile's output\n" };
+        }
+        int savedOut = dup(STDOUT_FILENO);
+        int savedErr = dup(STDERR_FILENO);
+        dup2(fileno(out), STDOUT_FILENO);
+        dup2(fileno(err), STDERR_FILENO);
+        try {
+            reply.exitCode = compileFunction(arguments, record);
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            reply.exitCode = -1;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+        dup2(savedOut, STDOUT_FILENO);
+        dup2(savedErr, STDERR_FILENO);
+        close(savedOut);
+        close(savedErr);
+        reply.out = readBack(out);
+        reply.err = readBack(err);
+        std::fclose(out);
+        std::fclose(err);
+        return reply;
+    }
+
+    CompileServer::Stamp CompileServer::stamp(const std::string &path)
+    {
+        Stamp found{ path, false, 0, 0, 0 };
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+            return found;
+        found.exists = true;
+        found.modified = (int64_t) status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+        found.size = (int64_t) status.st_size;
+        found.hash = hashFile(path);
+        return found;
+    }
+
+    bool CompileServer::unchanged(Stamp &recorded)
+    {
+        Stamp current{ recorded.path, false, 0, 0, 0 };
+        struct stat status;
+        if (stat(recorded.path.c_str(), &status) == 0)
+        {
+            current.exists = true;
+            current.modified = (int64_t) status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+            current.size = (int64_t) status.st_size;
+        }
+        if (current.exists != recorded.exists)
+            return false;
+        if (!current.exists)
+            return true;
+        if (current.size != recorded.size)
+            return false;
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        if (current.modified == recorded.modified && now - current.modified > RACY_NANOSECONDS)
+            return true;
+        if (hashFile(recorded.path) != recorded.hash)
+            return false;
+        recorded.modified = current.modified;
+        return true;
+    }
+
+    std::string CompileServer::defaultSocketPath()
+    {
+        const char *path = std::getenv("PXC_SOCKET");
+        if (path != nullptr && *path != '\0')
+            return path;
+        return "/tmp/pxc-" + std::to_string(getuid()) + ".sock";
+    }
+
+    static bool sendRequest(const std::string &socketPath, uint32_t kind, const std::vector<std::string> &strings, CompileReply &reply)
+    {
+        int fd = connectTo(socketPath);
+        if (fd < 0)
+            return false;
+        bool sent = writeValue(fd, CompileServer::MAGIC) && writeValue(fd, kind) && writeValue(fd, (uint32_t) strings.size());
+        for (size_t i = 0; sent && i < strings.size(); ++i)
+            sent = writeString(fd, strings[i]);
+        bool answered = sent && readAll(fd, &reply.exitCode, sizeof(reply.exitCode)) && readString(fd, reply.out) && readString(fd, reply.err);
+        close(fd);
+        return answered;
+    }
+
+    bool CompileServer::request(const std::string &socketPath, const std::string &directory, const std::vector<std::string> &arguments,
+                                CompileReply &reply)
+    {
+        std::vector<std::string> strings{ directory };
+        strings.insert(strings.end(), arguments.begin(), arguments.end());
+        return sendRequest(socketPath, COMPILE, strings, reply);
+    }
+
+    bool CompileServer::stop(const std::string &socketPath)
+    {
+        CompileReply reply;
+        return sendRequest(socketPath, STOP, std::vector<std::string>{}, reply);
+    }
+
+#else
+
+    CompileServer::~CompileServer()
+    {
+    }
+
+    bool CompileServer::listen()
+    {
+        std::cerr << "pxc --server needs Unix domain sockets" << std::endl;
+        return false;
+    }
+
+    void CompileServer::run()
+    {
+    }
+
+    std::string CompileServer::defaultSocketPath()
+    {
+        return std::string{};
+    }
+
+    bool CompileServer::request(const std::string &socketPath, const std::string &directory, const std::vector<std::string> &arguments,
+                                CompileReply &reply)
+    {
+        return false;
+    }
+
+    bool CompileServer::stop(const std::string &socketPath)
+    {
+        return false;
+    }
+
+#endif
+
+}
@@ -0,0 +1,70 @@
+#include "CompilerContext.h"
+
+#include "ContextAnalyzer.h"
+#include "Parser.h"
+#include "cg/CCompiler.h"
+#include "opt/Inliner.h"
+#include "vm/BytecodeCompiler.h"
+
+namespace px {
+
+    CompilerContext::CompilerContext(const CompileOptions &compileOptions) : options{ compileOptions }, interfaces{ nullptr }
+    {
+    }
+
+    void CompilerContext::useInterfaces(InterfaceCache *cache)
+    {
+        interfaces = cache;
+    }
+
+    // Gives nullptr when the module has errors
+    std::unique_ptr<ast::Module> CompilerContext::analyze(const Utf8String &fileName, const Utf8String &source, ScopeTree &scopeTree)
+    {
+        errors.clear();
+        Parser parser{ &errors };
+        std::unique_ptr<ast::Module> module;
+        try {
+            module = parser.parse(fileName, source);
+        }
+        catch (const Error &) {
+            return nullptr;
+        }
+
+        if (options.inlining)
+        {
+            Inliner inliner{ options.inlineThreshold };
+            inliner.run(*module);
+        }
+        ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+        analyzer.useInterfaces(interfaces);
+        analyzer.analyze(*module);
+        if (errors.count() > 0)
+            return nullptr;
+        return module;
+    }
+
+    bool CompilerContext::compileToC(const Utf8String &fileName, const Utf8String &source, Utf8String &output)
+    {
+        ScopeTree scopeTree;
+        std::unique_ptr<ast::Module> module = analyze(fileName, source, scopeTree);
+        if (module == nullptr)
+            return false;
+        CCompiler compiler{ &scopeTree };
+        output = compiler.compileToString(*module);
+        return true;
+    }
+
+    std::unique_ptr<Program> CompilerContext::compileToBytecode(const Utf8String &fileName, const Utf8String &source)
+    {
+        ScopeTree scopeTree;
+        std::unique_ptr<ast::Module> module = analyze(fileName, source, scopeTree);
+        if (module == nullptr)
+            return nullptr;
+        BytecodeCompiler compiler{ &scopeTree, &errors };
+        std::unique_ptr<Program> program = compiler.compile(*module);
+        if (errors.count() > 0)
+            return nullptr;
+        return program;
+    }
+
+}
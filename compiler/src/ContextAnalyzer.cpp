@@ -1,14 +1,146 @@
 
 #include "ContextAnalyzer.h"
 #include "Token.h"
+#include "ast/RecursiveVisitor.h"
+#include "opt/Inliner.h"
 
 #include <iostream>
 #include <functional>
+#include <unordered_set>
 
 namespace px
 {
+    // The element type of a fixed or dynamic array type, the value type of a map, or nullptr for any other type
+    static Type *getElementType(Type *type)
+    {
+        if (type->isArray())
+            return ((ArrayType*) type)->elementType;
+        if (type->isDynamicArray())
+            return ((DynamicArrayType*) type)->elementType;
+        if (type->isMap())
+            return ((MapType*) type)->valueType;
+        return nullptr;
+    }
+
+    static ast::ContainerOperation getContainerOperation(const Utf8String &name)
+    {
+        if (name == "push")
+            return ast::ContainerOperation::PUSH;
+        if (name == "pop")
+            return ast::ContainerOperation::POP;
+        if (name == "reserve")
+            return ast::ContainerOperation::RESERVE;
+        if (name == "append")
+            return ast::ContainerOperation::APPEND;
+        if (name == "length")
+            return ast::ContainerOperation::LENGTH;
+        if (name == "contains")
+            return ast::ContainerOperation::CONTAINS;
+        if (name == "remove")
+            return ast::ContainerOperation::REMOVE;
+        if (name == "keys")
+            return ast::ContainerOperation::KEYS;
+        return ast::ContainerOperation::NONE;
+    }
+
+    static bool isInfiniteLoop(ast::Expression &condition, bool hasBreak)
+    {
+        return !hasBreak && condition.nodeType == ast::NodeType::LITERAL_BOOL && ((ast::BoolLiteral&) condition).value;
+    }
+
+    // Checks whether the iterations of a for loop can run in any order: the body makes no calls, never leaves
+    // the loop early and only touches the arrays it writes at the element named by the induction variable
+    class LoopDependenceChecker : public ast::RecursiveVisitor
+    {
+    public:
+        bool dependent = false;
+        std::vector<Utf8String> writtenArrays;
+        std::vector<std::pair<Utf8String, bool>> accesses;
+
+        explicit LoopDependenceChecker(const Utf8String &variable) : induction{ variable }
+        {
+        }
+
+        bool independent() const
+        {
+            if (dependent)
+                return false;
+            for (auto &access : accesses)
+            {
+                bool written = std::find(writtenArrays.begin(), writtenArrays.end(), access.first) != writtenArrays.end();
+                if (written && !access.second)
+                    return false;
+            }
+            return true;
+        }
+
+        void *visit(ast::ArrayIndexAssignmentStatement &a) override
+        {
+            auto reference = (ast::ArrayIndexReference*) a.reference.get();
+            if (reference->array->nodeType == ast::NodeType::EXP_VAR_LOAD)
+                writtenArrays.push_back(((ast::VariableExpression*) reference->array.get())->variable);
+            else
+                dependent = true;
+            return RecursiveVisitor::visit(a);
+        }
+
+        void *visit(ast::ArrayIndexReference &a) override
+        {
+            if (a.array->nodeType == ast::NodeType::EXP_VAR_LOAD)
+            {
+                bool byInduction = a.index->nodeType == ast::NodeType::EXP_VAR_LOAD && ((ast::VariableExpression*) a.index.get())->variable == induction;
+                accesses.emplace_back(((ast::VariableExpression*) a.array.get())->variable, byInduction);
+            }
+            else
+            {
+                dependent = true;
+            }
+            return RecursiveVisitor::visit(a);
+        }
+
+        void *visit(ast::BreakStatement &b) override
+        {
+            dependent = true;
+            return nullptr;
+        }
+
+        void *visit(ast::ForStatement &f) override
+        {
+            dependent = dependent || f.variableName == induction;
+            return RecursiveVisitor::visit(f);
+        }
+
+        void *visit(ast::RegionStatement &r) override
+        {
+            dependent = true;
+            return nullptr;
+        }
+
+        void *visit(ast::FunctionCallExpression &f) override
+        {
+            dependent = true;
+            return nullptr;
+        }
+
+        void *visit(ast::ReturnStatement &s) override
+        {
+            dependent = true;
+            return nullptr;
+        }
+
+        void *visit(ast::VariableDeclaration &d) override
+        {
+            dependent = dependent || d.name == induction;
+            return RecursiveVisitor::visit(d);
+        }
+
+    private:
+        const Utf8String induction;
+    };
+
     ContextAnalyzer::ContextAnalyzer(Scope *rootScope, ErrorLog *log)
-        : _currentScope{rootScope}, currentFunction{}, errors{log}, loopDepth{}
+        : _currentScope{rootScope}, _moduleScope{}, currentFunction{}, loopDepth{}, switchDepth{}, regionDepth{}, diverges{}, returnCount{},
+          reusedFunctions{}, interfaceCache{}, importingModule{}, spawnInitializer{}, awaitedFuture{}, parallelElement{}, errors{log}
     {
 
     }
@@ -18,11 +150,48 @@ namespace px
         ast.accept(*this);
     }
 
+    void ContextAnalyzer::analyzeInput(ast::Module &input)
+    {
+        auto current = _currentScope;
+        if (_moduleScope == nullptr)
+            _moduleScope = new Scope(current);
+        _currentScope = _moduleScope;
+        size_t errorCount = errors->count();
+        _moduleScope->symbols()->startJournal();
+        for (auto &statement : input.statements)
+        {
+            statement->accept(*this);
+        }
+        inferAttributes();
+        _currentScope = current;
+        if (errors->count() > errorCount)
+        {
+            for (Symbol *symbol : _moduleScope->symbols()->rollBack())
+                discardedSymbols.emplace_back(symbol);
+        }
+    }
+
     void ContextAnalyzer::checkAssignmentTypes(Variable *variable, std::unique_ptr<ast::Expression> &expression, const SourcePosition &start) {
         Type *varType = variable->type;
         Type *exprType = expression->type;
         if (varType == exprType)
             return;
+        // A dynamic array can be filled from a fixed array of the same elements
+        if (varType->isDynamicArray() && exprType->isArray() && getElementType(varType) == getElementType(exprType))
+            return;
+        if (varType->isDynamicArray() && expression->nodeType == ast::NodeType::LITERAL_ARRAY)
+        {
+            // Each value of a literal is converted to the element type on its own
+            Type *elementType = getElementType(varType);
+            auto &values = ((ast::ArrayLiteral&) *expression).values;
+            for (auto &value : values)
+            {
+                if (!value->type->isImpiciltyCastableTo(elementType))
+                    errors->addError(Error{start, Utf8String{"Can not implicitly convert from '"} + value->type->name + "' to '" + elementType->name + "'"});
+            }
+            expression->type = getArrayType(elementType, values.size());
+            return;
+        }
 
         if (exprType->isVoid())
         {
@@ -60,11 +229,656 @@ namespace px
         }
     }
 
+    // Looks a type up by name, making the dynamic array type for a name such as int64[] on first use
+    Type *ContextAnalyzer::getType(const Utf8String &name)
+    {
+        Type *type = _currentScope->symbols()->getType(name);
+        if (type != nullptr)
+            return type;
+        if (name.startsWith("map["))
+            return getMapType(name);
+        if (name.startsWith("future["))
+            return getFutureType(name);
+        if (!name.endsWith("[]"))
+            return nullptr;
+        std::string elementName = name.toString();
+        elementName.resize(elementName.size() - 2);
+        Type *elementType = _currentScope->symbols()->getType(elementName);
+        if (elementType == nullptr || elementType->isVoid() || elementType->isArray() || elementType->isContainer() || elementType->isFuture())
+            return nullptr;
+        type = new DynamicArrayType(elementType);
+        _currentScope->root()->symbols()->addSymbol(type);
+        return type;
+    }
+
+    // Makes the map type named map[K, V] on first use. Keys are integers, chars, bools or strings;
+    // values can be anything but void, arrays and other containers.
+    Type *ContextAnalyzer::getMapType(const Utf8String &name)
+    {
+        std::string text = name.toString();
+        size_t comma = text.find(", ");
+        if (text.compare(0, 4, "map[") != 0 || comma == std::string::npos || text.back() != ']')
+            return nullptr;
+        Type *keyType = _currentScope->symbols()->getType(text.substr(4, comma - 4));
+        Type *valueType = _currentScope->symbols()->getType(text.substr(comma + 2, text.size() - comma - 3));
+        if (keyType == nullptr || valueType == nullptr)
+            return nullptr;
+        if (!keyType->isInt() && !keyType->isUInt() && !keyType->isChar() && !keyType->isBool() && !keyType->isString())
+            return nullptr;
+        if (valueType->isVoid() || valueType->isArray() || valueType->isContainer() || valueType->isFuture())
+            return nullptr;
+        Type *type = new MapType(keyType, valueType);
+        _currentScope->root()->symbols()->addSymbol(type);
+        return type;
+    }
+
+    // Makes the type named future[T] on first use. A task's result is handed from one thread to
+    // another, so T can not be an array, a container or a StringBuilder, which belong to one thread.
+    Type *ContextAnalyzer::getFutureType(const Utf8String &name)
+    {
+        std::string text = name.toString();
+        if (text.back() != ']')
+            return nullptr;
+        Type *valueType = getType(text.substr(7, text.size() - 8));
+        if (valueType == nullptr || valueType->isArray() || valueType->isContainer() || valueType->isStringBuilder() || valueType->isFuture())
+            return nullptr;
+        Type *type = new FutureType(valueType);
+        _currentScope->root()->symbols()->addSymbol(type);
+        return type;
+    }
+
+    Type *ContextAnalyzer::getArrayType(Type *elementType, size_t count)
+    {
+        Utf8String typeName = elementType->name + "[" + std::to_string(count) + "]";
+        Type *type = _currentScope->symbols()->getType(typeName);
+        if (type == nullptr) {
+            auto rootSymbols = _currentScope->root()->symbols();
+            type = new ArrayType(elementType, count);
+            rootSymbols->addSymbol(type);
+        }
+        return type;
+    }
+
+    Type *ContextAnalyzer::getParameterType(const ast::Parameter &param, const SourcePosition &position)
+    {
+        Type *paramType = getType(param.typeName);
+        if (paramType == nullptr)
+        {
+            errors->addError(Error{ position, Utf8String{ "Function parameter type " } + param.typeName + " was not found" });
+        }
+        else if (paramType->isFuture())
+        {
+            errors->addError(Error{ position, Utf8String{ "Function parameter " } + param.name + " can not be a future" });
+        }
+        else if (param.arraySize != nullptr)
+        {
+            paramType = getArrayType(paramType, *param.arraySize);
+        }
+        return paramType;
+    }
+
+    void ContextAnalyzer::analyzeContainerOperation(ast::FunctionCallExpression &f)
+    {
+        for (auto &arg : f.arguments)
+            arg->accept(*this);
+
+        ast::ContainerOperation operation = f.containerOperation;
+        bool unary = operation == ast::ContainerOperation::POP || operation == ast::ContainerOperation::LENGTH
+            || operation == ast::ContainerOperation::KEYS;
+        if (f.arguments.size() != (unary ? 1 : 2))
+        {
+            errors->addError(Error{ f.position, Utf8String{ "Invalid number of arguments given to function " } + f.functionName });
+            return;
+        }
+        Type *containerType = f.arguments[0]->type;
+        bool mapOnly = operation == ast::ContainerOperation::CONTAINS || operation == ast::ContainerOperation::REMOVE
+            || operation == ast::ContainerOperation::KEYS;
+        bool arrayOnly = operation == ast::ContainerOperation::PUSH || operation == ast::ContainerOperation::POP
+            || operation == ast::ContainerOperation::APPEND;
+        if ((!containerType->isDynamicArray() || mapOnly) && (!containerType->isMap() || arrayOnly))
+        {
+            const char *expected = mapOnly ? "a map" : arrayOnly ? "a dynamic array" : "a dynamic array or a map";
+            errors->addError(Error{ f.position, Utf8String{ "The first argument of " } + f.functionName + " must be " + expected + ", not '" + containerType->name + "'" });
+            return;
+        }
+        Type *elementType = getElementType(containerType);
+        switch (operation)
+        {
+            case ast::ContainerOperation::LENGTH:
+                f.type = Type::INT64;
+                return;
+            case ast::ContainerOperation::CONTAINS:
+            {
+                Variable key{ "", ((MapType*) containerType)->keyType };
+                checkAssignmentTypes(&key, f.arguments[1], f.position);
+                f.type = Type::BOOL;
+                return;
+            }
+            case ast::ContainerOperation::KEYS:
+                f.type = getType(((MapType*) containerType)->keyType->name + "[]");
+                return;
+            default:
+                break;
+        }
+
+        // Every other operation changes the container, which must be named
+        if (f.arguments[0]->nodeType != ast::NodeType::EXP_VAR_LOAD)
+        {
+            errors->addError(Error{ f.position, Utf8String{ "The first argument of " } + f.functionName + " must be a variable" });
+            return;
+        }
+        Variable *array = _currentScope->symbols()->getVariable(((ast::VariableExpression*) f.arguments[0].get())->variable);
+        if (isSharedByParallelLoop(array))
+        {
+            errors->addError(Error{ f.position, Utf8String{ "Can not change " } + array->name + " inside a parallel for, since its iterations share it" });
+        }
+        array->mutated = true;
+        recordTaskConflicts(f.position, array, nullptr);
+        if (operation == ast::ContainerOperation::APPEND && f.arguments[1]->nodeType == ast::NodeType::EXP_VAR_LOAD)
+        {
+            Variable *source = _currentScope->symbols()->getVariable(((ast::VariableExpression*) f.arguments[1].get())->variable);
+            if (source != nullptr)
+                recordTaskUse(f.position, source, nullptr);
+        }
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr)
+        {
+            if (isGlobal(array))
+            {
+                summary->writesGlobals = true;
+            }
+            else if (isParameter(array))
+            {
+                summary->writesArrays = true;
+                summary->resizesParameters = true;
+            }
+        }
+
+        switch (operation)
+        {
+            case ast::ContainerOperation::PUSH:
+            case ast::ContainerOperation::APPEND:
+            {
+                // Appending copies the elements into the array's own region, so only elements that point into a region can escape
+                bool copied = operation == ast::ContainerOperation::APPEND && !elementType->holdsRegionMemory();
+                if (!copied && escapesRegion(*f.arguments[1], array->regionDepth))
+                {
+                    errors->addError(Error{ f.position, Utf8String{ "Can not store a value allocated in a region block in " } + array->name + ", which outlives it" });
+                }
+                if (operation == ast::ContainerOperation::APPEND)
+                {
+                    if (f.arguments[1]->type != containerType)
+                        errors->addError(Error{ f.position, Utf8String{ "Can not append a value of type '" } + f.arguments[1]->type->name + "' to an array of type '" + containerType->name + "'" });
+                }
+                else
+                {
+                    Variable element{ array->name, elementType };
+                    checkAssignmentTypes(&element, f.arguments[1], f.position);
+                }
+                f.type = Type::VOID;
+                break;
+            }
+            case ast::ContainerOperation::POP:
+                f.type = elementType;
+                break;
+            case ast::ContainerOperation::REMOVE:
+            {
+                Variable key{ "", ((MapType*) containerType)->keyType };
+                checkAssignmentTypes(&key, f.arguments[1], f.position);
+                f.type = Type::BOOL;
+                break;
+            }
+            case ast::ContainerOperation::RESERVE:
+                if (!f.arguments[1]->type->isInt() && !f.arguments[1]->type->isUInt())
+                    errors->addError(Error{ f.position, Utf8String{ "The number of elements to reserve must be an integer" } });
+                f.type = Type::VOID;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void ContextAnalyzer::analyzeStatements(std::vector<std::unique_ptr<ast::Statement>> &statements)
+    {
+        // A sequence never completes when one of its statements that runs unconditionally, before
+        // any return, is an infinite loop, a block that never completes or a call to a function
+        // that never returns. The calls are only resolved once every function has been analyzed.
+        bool sequenceDiverges = false;
+        std::vector<Function*> calls;
+        size_t returns = returnCount;
+        for (auto &statement : statements)
+        {
+            diverges = false;
+            divergingCalls.clear();
+            statement->accept(*this);
+            if (sequenceDiverges || returnCount != returns)
+                continue;
+
+            switch (statement->nodeType)
+            {
+                case ast::NodeType::STMT_BLOCK:
+                case ast::NodeType::STMT_DO_WHILE:
+                case ast::NodeType::STMT_WHILE:
+                    sequenceDiverges = diverges;
+                    calls.insert(calls.end(), divergingCalls.begin(), divergingCalls.end());
+                    break;
+                case ast::NodeType::STMT_EXP:
+                {
+                    auto expression = ((ast::ExpressionStatement*) statement.get())->expression.get();
+                    if (expression->nodeType == ast::NodeType::EXP_FUNC_CALL && ((ast::FunctionCallExpression*) expression)->function != nullptr)
+                        calls.push_back(((ast::FunctionCallExpression*) expression)->function);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        diverges = sequenceDiverges;
+        divergingCalls = calls;
+    }
+
+    // Whether storing the value of expression somewhere declared at targetDepth region blocks deep could
+    // leave it pointing into a region that has been freed. Literals are static and variables from around
+    // the target were not made by the inner regions.
+    bool ContextAnalyzer::escapesRegion(ast::Expression &expression, size_t targetDepth)
+    {
+        if (regionDepth <= targetDepth || expression.type == nullptr || !expression.type->holdsRegionMemory())
+            return false;
+        if (expression.nodeType == ast::NodeType::LITERAL_STRING)
+            return false;
+        if (expression.nodeType == ast::NodeType::EXP_VAR_LOAD)
+        {
+            Variable *variable = _currentScope->symbols()->getVariable(((ast::VariableExpression&) expression).variable);
+            return variable == nullptr || variable->regionDepth > targetDepth;
+        }
+        return true;
+    }
+
+    bool ContextAnalyzer::isGlobal(Variable *variable) const
+    {
+        return _moduleScope != nullptr && _moduleScope->symbols()->getVariable(variable->name, true) == variable;
+    }
+
+    bool ContextAnalyzer::isParameter(Variable *variable) const
+    {
+        if (currentFunction == nullptr)
+            return false;
+        auto &parameters = currentFunction->parameters;
+        return std::find(parameters.begin(), parameters.end(), variable) != parameters.end();
+    }
+
+    // Whether array and other, two arrays of the current function, may be the same array: they are
+    // passed by pointer when either is a parameter, and a parameter may be a global or another one
+    bool ContextAnalyzer::mayAlias(Variable *array, Variable *other) const
+    {
+        if (array == other)
+            return false;
+        bool arrayShared = isParameter(array) || isGlobal(array);
+        bool otherShared = isParameter(other) || isGlobal(other);
+        return arrayShared && otherShared && (isParameter(array) || isParameter(other));
+    }
+
+    // Whether variable is declared outside the innermost parallel for around the current scope
+    bool ContextAnalyzer::isSharedByParallelLoop(Variable *variable) const
+    {
+        if (parallelLoops.empty())
+            return false;
+        Scope *loopScope = parallelLoops.back().scope;
+        for (Scope *scope = _currentScope; scope != nullptr; scope = scope->parent())
+        {
+            if (scope->symbols()->getVariable(variable->name, true) == variable)
+                return false;
+            if (scope == loopScope)
+                break;
+        }
+        return true;
+    }
+
+    // Records what changing variable, or calling callee with it, may do to the tasks still running: a
+    // container passed to one of them must keep its buffer, and a global must not change under a
+    // task that reads globals. Which functions resize containers or use globals is only known once
+    // every summary is complete, except for a direct change to a container a task was given.
+    void ContextAnalyzer::recordTaskConflicts(const SourcePosition &position, Variable *variable, Function *callee)
+    {
+        for (auto &task : pendingTasks)
+        {
+            bool passed = variable != nullptr && std::find(task.containers.begin(), task.containers.end(), variable) != task.containers.end();
+            if (passed && callee == nullptr)
+            {
+                errors->addError(Error{ position, Utf8String{ "Can not change " } + variable->name + " while the task " + task.future->name + " that was passed it may still be running" });
+                continue;
+            }
+            if (passed || (variable == nullptr ? callee != nullptr : isGlobal(variable)))
+                taskConflicts.push_back(TaskConflict{ position, task.future, task.function, callee, variable, passed ? TaskConflict::PASSED : TaskConflict::GLOBAL });
+        }
+    }
+
+    // Records reading variable, or passing it to the spawned function as another task, while a task
+    // it was passed to may still be running, which is an error if either of them may write it. A
+    // function the spawner calls may still be given it, so that the spawner can work on one part of
+    // an array while the task works on another, as a divide and conquer sort does.
+    void ContextAnalyzer::recordTaskUse(const SourcePosition &position, Variable *variable, Function *spawned)
+    {
+        for (auto &task : pendingTasks)
+        {
+            if (std::find(task.containers.begin(), task.containers.end(), variable) != task.containers.end())
+                taskConflicts.push_back(TaskConflict{ position, task.future, task.function, spawned, variable, spawned != nullptr ? TaskConflict::SPAWNED : TaskConflict::READ });
+        }
+    }
+
+    // The tasks of the futures declared in scope are awaited when it ends
+    void ContextAnalyzer::endPendingTasks(Scope *scope)
+    {
+        pendingTasks.erase(std::remove_if(pendingTasks.begin(), pendingTasks.end(), [scope](const PendingTask &task) {
+            return task.scope == scope;
+        }), pendingTasks.end());
+    }
+
+    ContextAnalyzer::FunctionSummary *ContextAnalyzer::currentSummary()
+    {
+        if (currentFunction == nullptr)
+            return nullptr;
+        return &summaries[currentFunction];
+    }
+
+    void ContextAnalyzer::inferAttributes()
+    {
+        std::vector<Function*> functions;
+        functions.swap(definedFunctions);
+        auto isDefined = [this](Function *function) {
+            return function->declared && !function->isExtern && summaries.count(function) != 0;
+        };
+
+        // A function defined by an earlier input can not call the ones defined since, so a cycle
+        // only runs through the functions being inferred. A function is recursive when it is in a
+        // cycle of calls, which are found as the strongly connected components of the call graph;
+        // the graph is walked without recursion, as a chain of calls may be as long as the module.
+        std::unordered_set<Function*> inferring{ functions.begin(), functions.end() };
+        std::unordered_map<Function*, bool> recursive;
+        std::unordered_map<Function*, size_t> index, lowLink;
+        size_t visits = 0;
+        std::vector<Function*> component;
+        std::unordered_set<Function*> onComponent;
+        struct Frame
+        {
+            Function *function;
+            size_t next;
+        };
+        for (Function *root : functions)
+        {
+            if (index.count(root) != 0)
+                continue;
+            std::vector<Frame> frames{ Frame{ root, 0 } };
+            index[root] = lowLink[root] = visits++;
+            component.push_back(root);
+            onComponent.insert(root);
+            while (!frames.empty())
+            {
+                Frame &frame = frames.back();
+                Function *function = frame.function;
+                auto &callees = summaries[function].callees;
+                if (frame.next < callees.size())
+                {
+                    Function *callee = callees[frame.next++];
+                    if (callee == function)
+                        recursive[function] = true;
+                    if (!isDefined(callee) || inferring.count(callee) == 0)
+                        continue;
+                    if (index.count(callee) == 0)
+                    {
+                        index[callee] = lowLink[callee] = visits++;
+                        component.push_back(callee);
+                        onComponent.insert(callee);
+                        frames.push_back(Frame{ callee, 0 });
+                    }
+                    else if (onComponent.count(callee) != 0)
+                        lowLink[function] = std::min(lowLink[function], index[callee]);
+                    continue;
+                }
+                frames.pop_back();
+                if (!frames.empty())
+                    lowLink[frames.back().function] = std::min(lowLink[frames.back().function], lowLink[function]);
+                if (lowLink[function] != index[function])
+                    continue;
+                bool cycle = component.back() != function;
+                Function *member;
+                do
+                {
+                    member = component.back();
+                    component.pop_back();
+                    onComponent.erase(member);
+                    if (cycle)
+                        recursive[member] = true;
+                } while (member != function);
+            }
+        }
+
+        // const and pure start from every function whose own body qualifies and lose the
+        // attribute until no callee without it remains. Recursive functions and infinite loops
+        // are excluded since the C compiler may drop calls to functions with these attributes, and so
+        // are functions returning dynamic arrays, since merging two calls would share one buffer.
+        for (Function *function : functions)
+        {
+            FunctionSummary &summary = summaries[function];
+            if (function->returnType->isVoid() || function->returnType->isContainer() || recursive[function] || summary.hasInfiniteLoop || summary.diverges
+                || summary.callsExternal || summary.writesGlobals || summary.writesArrays)
+                continue;
+            function->attributes |= Function::PURE;
+            if (!summary.readsGlobals && !summary.readsArrays)
+                function->attributes |= Function::CONST;
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (Function *function : functions)
+            {
+                for (Function *callee : summaries[function].callees)
+                {
+                    if (function->hasAttribute(Function::CONST) && !callee->hasAttribute(Function::CONST))
+                    {
+                        function->attributes &= ~Function::CONST;
+                        changed = true;
+                    }
+                    if (function->hasAttribute(Function::PURE) && !callee->hasAttribute(Function::PURE))
+                    {
+                        function->attributes &= ~Function::PURE;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // noreturn spreads the other way: a function diverges once it calls a diverging function
+        // before it can return
+        changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (Function *function : functions)
+            {
+                if (function->hasAttribute(Function::NO_RETURN))
+                    continue;
+                FunctionSummary &summary = summaries[function];
+                bool diverges = summary.diverges;
+                for (Function *callee : summary.divergingCallees)
+                    diverges = diverges || callee->hasAttribute(Function::NO_RETURN);
+                if (diverges)
+                {
+                    function->attributes |= Function::NO_RETURN;
+                    changed = true;
+                }
+            }
+        }
+
+        // Spreads a property of the functions' own bodies to every function that calls one having it.
+        // has keeps what was found for the functions analyzed before.
+        auto spread = [&](std::unordered_map<Function*, bool> &has, const std::function<bool(const FunctionSummary&)> &own) -> std::unordered_map<Function*, bool>& {
+            for (Function *function : functions)
+                has[function] = own(summaries[function]);
+            bool grew = true;
+            while (grew)
+            {
+                grew = false;
+                for (Function *function : functions)
+                {
+                    if (has[function])
+                        continue;
+                    for (Function *callee : summaries[function].callees)
+                    {
+                        if (isDefined(callee) && has[callee])
+                        {
+                            has[function] = true;
+                            grew = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            return has;
+        };
+
+        // Restrict is safe when none of the arrays can be written while the function runs, or when
+        // the function is private and every call site passes distinct arrays of its own
+        auto &writesMemory = spread(spreadProperties.writesMemory, [](const FunctionSummary &summary) {
+            return summary.writesGlobals || summary.writesArrays || summary.passesArraysToExternal;
+        });
+
+        // The iterations of a parallel for run at the same time, so they may only call functions that
+        // leave global variables alone, and only pass shared arrays to functions that do not write them
+        auto &writesGlobals = spread(spreadProperties.writesGlobals, [](const FunctionSummary &summary) { return summary.writesGlobals; });
+        for (auto &call : parallelCalls)
+        {
+            if (!isDefined(call.function))
+                continue;
+            if (writesGlobals[call.function])
+                errors->addError(Error{ call.position, Utf8String{ "Function " } + call.function->name + " writes global variables, so it can not be called inside a parallel for" });
+            else if (call.passesSharedArrays && writesMemory[call.function])
+                errors->addError(Error{ call.position, Utf8String{ "Function " } + call.function->name + " may write the arrays passed to it, which the iterations of the parallel for share" });
+        }
+
+        // The arrays are distinct when the function is private and none of its calls pass aliased arrays,
+        // which is what makes its array parameters restrict
+        for (auto &alias : parallelAliases)
+        {
+            if (alias.function->visibility != Visibility::PRIVATE || summaries[alias.function].aliasedArrayArguments)
+                errors->addError(Error{ alias.position, Utf8String{ "Can not read " } + alias.read->name + " inside a parallel for except at index " + alias.loopVariable + ", since its iterations write " + alias.written->name + ", which may be the same array" });
+        }
+
+        // A function that writes the memory it is given may store a value allocated in a region block
+        // in a container from outside the block that it was passed along with it, and one that writes
+        // globals may store it in one of them
+        for (auto &call : regionCalls)
+        {
+            if (!isDefined(call.function))
+                continue;
+            if (call.container == nullptr)
+            {
+                if (writesGlobals[call.function])
+                    errors->addError(Error{ call.position, Utf8String{ "Function " } + call.function->name + " writes global variables, so it may store a value allocated in a region block in one, which outlives it" });
+            }
+            else if (writesMemory[call.function])
+                errors->addError(Error{ call.position, Utf8String{ "Function " } + call.function->name + " may store a value allocated in a region block in " + call.container->name + ", which outlives it" });
+        }
+
+        // A spawned call runs alongside its caller, which may go on using the globals and the
+        // containers the task was given until it awaits the future
+        auto &readsGlobals = spread(spreadProperties.readsGlobals, [](const FunctionSummary &summary) { return summary.readsGlobals; });
+        auto &resizesParameters = spread(spreadProperties.resizesParameters, [](const FunctionSummary &summary) { return summary.resizesParameters; });
+        for (auto &call : spawnCalls)
+        {
+            if (!isDefined(call.function))
+                continue;
+            if (writesGlobals[call.function])
+                errors->addError(Error{ call.position, Utf8String{ "Function " } + call.function->name + " writes global variables, so it can not be spawned" });
+            else if (call.passesContainers && resizesParameters[call.function])
+                errors->addError(Error{ call.position, Utf8String{ "Function " } + call.function->name + " may grow or shrink the dynamic arrays and maps passed to it, so it can not be spawned with them" });
+        }
+        for (auto &conflict : taskConflicts)
+        {
+            Utf8String task = conflict.future->name;
+            bool taskWrites = conflict.task != nullptr && isDefined(conflict.task) && writesMemory[conflict.task];
+            if (conflict.use == TaskConflict::PASSED)
+            {
+                if (isDefined(conflict.callee) && resizesParameters[conflict.callee])
+                    errors->addError(Error{ conflict.position, Utf8String{ "Function " } + conflict.callee->name + " may change " + conflict.variable->name + " while the task " + task + " that was passed it may still be running" });
+            }
+            else if (conflict.use == TaskConflict::READ)
+            {
+                if (taskWrites)
+                    errors->addError(Error{ conflict.position, Utf8String{ "Can not read " } + conflict.variable->name + " while the task " + task + ", which may write it, may still be running" });
+            }
+            else if (conflict.use == TaskConflict::SPAWNED)
+            {
+                if (taskWrites || (isDefined(conflict.callee) && writesMemory[conflict.callee]))
+                    errors->addError(Error{ conflict.position, Utf8String{ "Can not pass " } + conflict.variable->name + " to another task while the task " + task + " that was passed it may still be running, since one of them may write it" });
+            }
+            else if (conflict.task != nullptr && isDefined(conflict.task) && readsGlobals[conflict.task])
+            {
+                if (conflict.callee == nullptr)
+                    errors->addError(Error{ conflict.position, Utf8String{ "Can not change the global " } + conflict.variable->name + " while the task " + task + ", which reads global variables, may still be running" });
+                else if (isDefined(conflict.callee) && writesGlobals[conflict.callee])
+                    errors->addError(Error{ conflict.position, Utf8String{ "Function " } + conflict.callee->name + " writes global variables, which the task " + task + " may still be reading" });
+            }
+        }
+        // Each call is checked once, even when more statements are analyzed afterwards
+        parallelCalls.clear();
+        parallelAliases.clear();
+        regionCalls.clear();
+        spawnCalls.clear();
+        taskConflicts.clear();
+
+        for (Function *function : functions)
+        {
+            FunctionSummary &summary = summaries[function];
+            bool hasArrays = std::any_of(function->parameters.begin(), function->parameters.end(),
+                                         [](Variable *parameter) { return parameter->type != nullptr && parameter->type->isArray(); });
+            bool isPrivate = function->visibility == Visibility::PRIVATE;
+            if (hasArrays && (!writesMemory[function] || (isPrivate && !summary.aliasedArrayArguments)))
+                function->attributes |= Function::RESTRICT_ARRAYS;
+
+            if (function->hasAttribute(Function::NO_RETURN))
+                continue;
+            if (isPrivate && !recursive[function] && summary.size <= Inliner::DEFAULT_THRESHOLD)
+                function->attributes |= Function::ALWAYS_INLINE;
+            else if (recursive[function] && summary.size > Inliner::DEFAULT_THRESHOLD)
+                function->attributes |= Function::NO_INLINE;
+        }
+    }
+
     void* ContextAnalyzer::visit(ast::ArrayIndexReference &a)
     {
+        if (!pendingTasks.empty() && a.array.get() != parallelElement && a.array->nodeType == ast::NodeType::EXP_VAR_LOAD)
+        {
+            Variable *array = _currentScope->symbols()->getVariable(((ast::VariableExpression*) a.array.get())->variable);
+            if (array != nullptr)
+                recordTaskUse(a.position, array, nullptr);
+        }
+        if (!parallelLoops.empty() && a.index->nodeType == ast::NodeType::EXP_VAR_LOAD
+            && _currentScope->symbols()->getVariable(((ast::VariableExpression*) a.index.get())->variable) == parallelLoops.back().variable)
+        {
+            parallelElement = a.array.get();
+        }
         a.array->accept(*this);
         a.index->accept(*this);
 
+        Type *arrayType = a.array->type;
+        Type *elementType = getElementType(arrayType);
+        if (arrayType->isMap())
+        {
+            Variable key{ "", ((MapType*) arrayType)->keyType };
+            checkAssignmentTypes(&key, a.index, a.position);
+        }
+        if (elementType != nullptr)
+        {
+            a.type = elementType;
+        }
+        else
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not index into a value of type '" } + arrayType->name + "'" });
+        }
+
         return nullptr;
     }
 
@@ -86,19 +900,10 @@ namespace px
                     errors->addError(Error{ a.position, Utf8String{ "Can not have an array literal with types '"} + firstType->name + "' and a variable of type" + currentType->name + "' without a cast" });
                 }
             }
-            auto tempType = new ArrayType(firstType, elementCount);
-            Type *type = _currentScope->symbols()->getType(tempType->name);
-            if (type == nullptr) {
-                auto rootScope = _currentScope->root();
-                auto rootSymbols = rootScope->symbols();
-                rootSymbols->addSymbol(tempType);
-                a.type = tempType;
-            } else {
-                a.type = type;
-            }
+            a.type = getArrayType(firstType, elementCount);
         }
         else {
-            a.type = new ArrayType(Type::UNKNOWN, 0);
+            a.type = getArrayType(Type::UNKNOWN, 0);
         }
 
         return nullptr;
@@ -108,8 +913,9 @@ namespace px
     {
         auto symbols = _currentScope->symbols();
 
-        a.reference->accept(*this);
         ast::ArrayIndexReference *array = (ast::ArrayIndexReference*) a.reference.get();
+        parallelElement = array->array.get();
+        a.reference->accept(*this);
         ast::VariableExpression *var = (ast::VariableExpression*) array->array.get();
 
         Variable *variable = symbols->getVariable(var->variable);
@@ -120,22 +926,63 @@ namespace px
         }
 
         a.expression->accept(*this);
+        bool keyEscapes = variable->type->isMap() && escapesRegion(*array->index, variable->regionDepth);
+        if (keyEscapes || escapesRegion(*a.expression, variable->regionDepth))
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not store a value allocated in a region block in " } + var->variable + ", which outlives it" });
+        }
+
+        // Each iteration of a parallel for may write only its own element of a shared array
+        if (isSharedByParallelLoop(variable))
+        {
+            Variable *loopVariable = parallelLoops.back().variable;
+            bool byLoopVariable = array->index->nodeType == ast::NodeType::EXP_VAR_LOAD
+                && symbols->getVariable(((ast::VariableExpression*) array->index.get())->variable) == loopVariable;
+            if (variable->type->isMap())
+                errors->addError(Error{ a.position, Utf8String{ "Can not write to the map " } + var->variable + " inside a parallel for, since its iterations share it" });
+            else if (variable->type->isDynamicArray())
+                errors->addError(Error{ a.position, Utf8String{ "Can not write to the dynamic array " } + var->variable + " inside a parallel for, since its iterations share it" });
+            else if (!byLoopVariable)
+                errors->addError(Error{ a.position, Utf8String{ "Can not write to " } + var->variable + " inside a parallel for except at index " + loopVariable->name });
+            else
+                parallelLoops.back().writtenArrays.push_back(variable);
+        }
+
+        variable->mutated = true;
+        recordTaskConflicts(a.position, variable, nullptr);
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr)
+        {
+            if (isGlobal(variable))
+            {
+                summary->writesGlobals = true;
+            }
+            else if (isParameter(variable))
+            {
+                summary->writesArrays = true;
+                summary->resizesParameters = summary->resizesParameters || variable->type->isMap();
+            }
+        }
 
         TokenType opType = a.opType;
         Type *variableType = variable->type;
         Type *expressionType = a.expression->type;
 
-        if(!variableType->isArray())
+        Type *elementType = getElementType(variableType);
+        if(elementType == nullptr)
         {
             errors->addError(Error{ a.position, Utf8String{ "Variable " } + var->variable + " is not an array" });
             return nullptr;
         }
 
-        ArrayType *arrayType = (ArrayType *) variableType;
-        if (!expressionType->isImpiciltyCastableTo(arrayType->elementType))
+        if (!expressionType->isImpiciltyCastableTo(elementType))
         {
             errors->addError(Error{ a.position, Utf8String{ "Can not implicitly store an element of type '"} + expressionType->name + "' into a array of type " + variableType->name + "'" });
         }
+        if (elementType->isString() && opType != TokenType::OP_ASSIGN && opType != TokenType::OP_ASSIGN_ADD)
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not perform assignment operator '"} + Token::getTokenName(opType) + "' on a string" });
+        }
 
         a.variableType = variableType;
 
@@ -151,8 +998,36 @@ namespace px
             errors->addError(Error{ a.position, Utf8String{ "Variable " } + a.variableName + " is not declared in the current scope" });
             return nullptr;
         }
+        if (variable->readOnly)
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not assign to the loop variable " } + a.variableName });
+        }
+        else if (variable->type->isFuture())
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not assign to the future " } + a.variableName });
+            return nullptr;
+        }
+        else if (isSharedByParallelLoop(variable))
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not assign to " } + a.variableName + " inside a parallel for, since its iterations share it" });
+        }
 
         a.expression->accept(*this);
+        if (escapesRegion(*a.expression, variable->regionDepth))
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not store a value allocated in a region block in " } + a.variableName + ", which outlives it" });
+        }
+
+        variable->mutated = true;
+        recordTaskConflicts(a.position, variable, nullptr);
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr)
+        {
+            if (isGlobal(variable))
+                summary->writesGlobals = true;
+            else if (variable->type->isContainer() && isParameter(variable))
+                summary->resizesParameters = true;
+        }
 
         TokenType opType = a.opType;
         Type *variableType = variable->type;
@@ -160,6 +1035,16 @@ namespace px
 
         a.variableType = variableType;
 
+        if (variableType->isString() && opType != TokenType::OP_ASSIGN && opType != TokenType::OP_ASSIGN_ADD)
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not perform assignment operator '"} + Token::getTokenName(opType) + "' on a string" });
+        }
+        if (variableType->isContainer() && opType != TokenType::OP_ASSIGN)
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not perform assignment operator '"} + Token::getTokenName(opType) + "' on a " + (variableType->isMap() ? "map" : "dynamic array") });
+            return nullptr;
+        }
+
         switch(opType)
         {
             case TokenType::OP_ASSIGN_ADD:
@@ -188,6 +1073,33 @@ namespace px
         return nullptr;
     }
 
+    void* ContextAnalyzer::visit(ast::AwaitExpression &a)
+    {
+        if (a.future->nodeType != ast::NodeType::EXP_VAR_LOAD)
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Only a future variable can be awaited" } });
+            return nullptr;
+        }
+        awaitedFuture = a.future.get();
+        a.future->accept(*this);
+        awaitedFuture = nullptr;
+        Type *type = a.future->type;
+        if (!type->isFuture())
+        {
+            errors->addError(Error{ a.position, Utf8String{ "Can not await a value of type '" } + type->name + "'" });
+            return nullptr;
+        }
+        a.type = ((FutureType*) type)->valueType;
+
+        // The task has finished once it is awaited in the scope that declared it; elsewhere the
+        // await may not run
+        Variable *future = _currentScope->symbols()->getVariable(((ast::VariableExpression&) *a.future).variable);
+        pendingTasks.erase(std::remove_if(pendingTasks.begin(), pendingTasks.end(), [&](const PendingTask &task) {
+            return task.future == future && task.scope == _currentScope;
+        }), pendingTasks.end());
+        return nullptr;
+    }
+
     void* ContextAnalyzer::visit(ast::BinaryOpExpression &b)
     {
         b.left->accept(*this);
@@ -207,7 +1119,31 @@ namespace px
             errors->addError(Error{ leftPosition, Utf8String{ "Can not perform binary '"} + Token::getTokenName(opType) + "' between '"  + leftType->name + "' and '" + rightType->name + "'" });
         }
 
-        if (b.op >= ast::BinaryOperator::OR && b.op <= ast::BinaryOperator::NE)
+        if (leftType->isStringBuilder() || rightType->isStringBuilder())
+        {
+            b.type = Type::UNKNOWN;
+            errors->addError(Error{ leftPosition, Utf8String{ "Can not perform binary '"} + Token::getTokenName(opType) + "' on a StringBuilder" });
+        }
+        else if (leftType->isContainer() || rightType->isContainer())
+        {
+            b.type = Type::UNKNOWN;
+            bool map = leftType->isMap() || rightType->isMap();
+            errors->addError(Error{ leftPosition, Utf8String{ "Can not perform binary '"} + Token::getTokenName(opType) + "' on a " + (map ? "map" : "dynamic array") });
+        }
+        else if (leftType->isString() || rightType->isString())
+        {
+            // Strings are concatenated with + and compared by code point
+            if (b.op == ast::BinaryOperator::ADD)
+                b.type = Type::STRING;
+            else if (b.op >= ast::BinaryOperator::LT && b.op <= ast::BinaryOperator::NE)
+                b.type = Type::BOOL;
+            else
+            {
+                b.type = Type::UNKNOWN;
+                errors->addError(Error{ leftPosition, Utf8String{ "Can not perform binary '"} + Token::getTokenName(opType) + "' on strings" });
+            }
+        }
+        else if (b.op >= ast::BinaryOperator::OR && b.op <= ast::BinaryOperator::NE)
         {
             b.type = Type::BOOL;
             if(b.op == ast::BinaryOperator::OR || b.op == ast::BinaryOperator::AND) {
@@ -253,10 +1189,8 @@ namespace px
         auto current = _currentScope;
         auto newScope = new Scope(current);
         _currentScope = newScope;
-        for (auto &statement : s.statements)
-        {
-            statement->accept(*this);
-        }
+        analyzeStatements(s.statements);
+        endPendingTasks(newScope);
         _currentScope = current;
         return nullptr;
     }
@@ -268,9 +1202,17 @@ namespace px
 
     void* ContextAnalyzer::visit(ast::BreakStatement &b)
     {
-        if (loopDepth == 0)
+        if (loopDepth == 0 && switchDepth == 0)
+        {
+            errors->addError(Error{ b.position, "Can perform a break outside of a loop or switch" });
+        }
+        else if (!parallelLoops.empty() && parallelLoops.back().loopDepth == loopDepth && parallelLoops.back().switchDepth == switchDepth)
+        {
+            errors->addError(Error{ b.position, "Can not break out of a parallel for" });
+        }
+        else
         {
-            errors->addError(Error{ b.position, "Can perform a break outside of a loop" });
+            loopBreaks.back() = true;
         }
         return nullptr;
     }
@@ -322,8 +1264,17 @@ namespace px
         }
 
         ++loopDepth;
+        loopBreaks.push_back(false);
         d.body->accept(*this);
         --loopDepth;
+        bool broken = loopBreaks.back();
+        loopBreaks.pop_back();
+
+        diverges = isInfiniteLoop(*d.condition, broken);
+        divergingCalls.clear();
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr && diverges)
+            summary->hasInfiniteLoop = true;
         return nullptr;
     }
 
@@ -338,11 +1289,115 @@ namespace px
         return nullptr;
     }
 
+    void * ContextAnalyzer::visit(ast::ForStatement &f)
+    {
+        f.start->accept(*this);
+        f.end->accept(*this);
+
+        Type *startType = f.start->type;
+        Type *endType = f.end->type;
+        auto isInteger = [](Type *type) { return type != nullptr && (type->isInt() || type->isUInt()); };
+        if (!isInteger(startType) || !isInteger(endType))
+        {
+            errors->addError(Error{ f.position, Utf8String{ "for loop bounds must be integers" } });
+            return nullptr;
+        }
+
+        Type *type = nullptr;
+        if (f.typeName.length() != 0)
+        {
+            type = _currentScope->symbols()->getType(f.typeName);
+            if (type == nullptr)
+            {
+                errors->addError(Error{ f.position, Utf8String{ "Type " } + f.typeName + " was not found" });
+                return nullptr;
+            }
+        }
+        else
+        {
+            type = startType->isImpiciltyCastableTo(endType) ? endType : startType;
+        }
+        if (!isInteger(type))
+        {
+            errors->addError(Error{ f.position, Utf8String{ "for loop variable must be an integer" } });
+            return nullptr;
+        }
+
+        auto current = _currentScope;
+        _currentScope = new Scope(current);
+        auto variable = new Variable{ f.variableName, type };
+        variable->readOnly = true;
+        _currentScope->symbols()->addSymbol(variable);
+        checkAssignmentTypes(variable, f.start, f.start->position);
+        checkAssignmentTypes(variable, f.end, f.end->position);
+        f.variableType = type;
+
+        if (f.parallel && currentFunction == nullptr)
+        {
+            errors->addError(Error{ f.position, Utf8String{ "A parallel for must be inside a function" } });
+        }
+        ++loopDepth;
+        loopBreaks.push_back(false);
+        if (f.parallel)
+            parallelLoops.push_back(ParallelLoop{ _currentScope, variable, loopDepth, switchDepth });
+        f.body->accept(*this);
+        if (f.parallel)
+        {
+            // Another iteration may be writing any element but its own of an array the loop writes
+            ParallelLoop &loop = parallelLoops.back();
+            for (auto &read : loop.sharedReads)
+            {
+                if (std::find(loop.writtenArrays.begin(), loop.writtenArrays.end(), read.first) != loop.writtenArrays.end())
+                {
+                    errors->addError(Error{ read.second, Utf8String{ "Can not read " } + read.first->name + " inside a parallel for except at index " + variable->name + ", since its iterations write it" });
+                    continue;
+                }
+                auto written = std::find_if(loop.writtenArrays.begin(), loop.writtenArrays.end(), [&](Variable *array) { return mayAlias(array, read.first); });
+                if (written != loop.writtenArrays.end())
+                    parallelAliases.push_back(ParallelAlias{ currentFunction, read.second, read.first, *written, variable->name });
+            }
+            parallelLoops.pop_back();
+        }
+        --loopDepth;
+        loopBreaks.pop_back();
+
+        // Arrays written through a parameter may overlap the other arrays the loop reads unless the
+        // function ends up with restrict array parameters, so the code generator checks for that
+        LoopDependenceChecker checker{ f.variableName };
+        f.body->accept(checker);
+        f.independentIterations = checker.independent();
+        auto symbols = _currentScope->symbols();
+        for (auto &written : checker.writtenArrays)
+        {
+            Variable *array = symbols->getVariable(written);
+            if (array == nullptr || (!isParameter(array) && !isGlobal(array)))
+                continue;
+            for (auto &access : checker.accesses)
+            {
+                Variable *other = symbols->getVariable(access.first);
+                if (other != nullptr && other != array && (isParameter(other) || isGlobal(other)) && (isParameter(array) || isParameter(other)))
+                    f.needsRestrict = true;
+            }
+        }
+        _currentScope = current;
+
+        diverges = false;
+        divergingCalls.clear();
+        return nullptr;
+    }
+
     void * ContextAnalyzer::visit(ast::FunctionCallExpression &f)
     {
         auto currentSymbols = _currentScope->symbols();
         Function *function = currentSymbols->template getSymbol<Function>(f.functionName, SymbolType::FUNCTION);
+        if (function == nullptr && !imports.empty())
+            function = importFunction(f.functionName, f.position);
         if (function == nullptr) {
+            f.containerOperation = getContainerOperation(f.functionName);
+            if (f.containerOperation != ast::ContainerOperation::NONE) {
+                analyzeContainerOperation(f);
+                return nullptr;
+            }
             errors->addError(Error{f.position, Utf8String{"Function "} + f.functionName + " was not found"});
             return nullptr;
         }
@@ -359,6 +1414,76 @@ namespace px
             arg->accept(*this);
         }
 
+        // Array arguments are passed by pointer, so the callee's parameters may only be marked
+        // restrict when every call passes distinct arrays owned by the caller
+        std::vector<Variable*> arrays;
+        bool aliased = false;
+        for (auto &arg : f.arguments) {
+            if ((!arg->type->isArray() && !arg->type->isContainer()) || arg->nodeType != ast::NodeType::EXP_VAR_LOAD)
+                continue;
+            Variable *array = currentSymbols->getVariable(((ast::VariableExpression*) arg.get())->variable);
+            if (array == nullptr)
+                continue;
+            array->mutated = true;
+            if (isGlobal(array) || isParameter(array) || std::find(arrays.begin(), arrays.end(), array) != arrays.end())
+                aliased = true;
+            arrays.push_back(array);
+        }
+        if (aliased)
+        {
+            summaries[function].aliasedArrayArguments = true;
+            if (currentSummary() != nullptr)
+                currentSummary()->aliasedCallees.push_back(function);
+        }
+        if (!pendingTasks.empty())
+        {
+            for (Variable *array : arrays)
+            {
+                if (array->type->isContainer())
+                    recordTaskConflicts(f.position, array, function);
+            }
+            recordTaskConflicts(f.position, nullptr, function);
+        }
+        if (regionDepth > 0)
+        {
+            for (Variable *array : arrays)
+            {
+                Type *elementType = getElementType(array->type);
+                bool holdsRegionMemory = (elementType != nullptr && elementType->holdsRegionMemory())
+                    || (array->type->isMap() && ((MapType*) array->type)->keyType->holdsRegionMemory());
+                bool escapes = holdsRegionMemory && std::any_of(f.arguments.begin(), f.arguments.end(), [&](std::unique_ptr<ast::Expression> &arg) {
+                    return escapesRegion(*arg, array->regionDepth);
+                });
+                if (escapes)
+                {
+                    regionCalls.push_back(RegionCall{ function, f.position, array });
+                    break;
+                }
+            }
+            // Globals outlive every region block
+            bool passesRegionValue = std::any_of(f.arguments.begin(), f.arguments.end(), [&](std::unique_ptr<ast::Expression> &arg) {
+                return escapesRegion(*arg, 0);
+            });
+            if (passesRegionValue)
+                regionCalls.push_back(RegionCall{ function, f.position, nullptr });
+        }
+        if (!parallelLoops.empty())
+        {
+            bool passesShared = std::any_of(arrays.begin(), arrays.end(), [this](Variable *array) { return isSharedByParallelLoop(array); });
+            parallelCalls.push_back(ParallelCall{ function, f.position, passesShared });
+        }
+
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr) {
+            summary->callees.push_back(function);
+            // What an imported function does is only known when it is pure
+            if (function->isExtern || (function->module.length() != 0 && !function->hasAttribute(Function::PURE))) {
+                summary->callsExternal = true;
+                if (!arrays.empty())
+                    summary->passesArraysToExternal = true;
+            }
+        }
+
         return nullptr;
     }
 
@@ -367,23 +1492,27 @@ namespace px
         auto current = _currentScope;
         auto currentSymbols = current->symbols();
         auto prototype = *f.prototype;
-        Type *returnType = currentSymbols->getType(prototype.returnTypeName);
+        Type *returnType = getType(prototype.returnTypeName);
         if (returnType == nullptr)
         {
             errors->addError(Error{ f.position, Utf8String{ "Return type " } + prototype.returnTypeName + " was not found" });
         }
+        else if (returnType->isFuture())
+        {
+            errors->addError(Error{ f.position, Utf8String{ "Function " } + prototype.name + " can not return a future" });
+        }
+        if (prototype.isExtern && prototype.visibility != Visibility::PUBLIC)
+        {
+            errors->addError(Error{ f.position, Utf8String{ "Extern function " } + prototype.name + " must be public" });
+        }
         std::vector<Variable *> parameters;
         for (ast::Parameter param : prototype.parameters)
         {
-            Type *paramType = currentSymbols->getType(param.typeName);
-            if (paramType == nullptr)
-            {
-                errors->addError(Error{ f.position, Utf8String{ "Function parameter type " } + param.typeName + " was not found" });
-            }
+            Type *paramType = getParameterType(param, f.position);
             Variable *parameter = new Variable{ param.name, paramType };
             parameters.push_back(parameter);
         }
-        Function *function = new Function{ prototype.name, parameters, returnType, prototype.isExtern };
+        Function *function = new Function{ prototype.name, parameters, returnType, prototype.isExtern, false, prototype.visibility };
         f.function = function;
         currentSymbols->addSymbol(function);
         return nullptr;
@@ -397,29 +1526,58 @@ namespace px
         auto prototype = *f.prototype;
 
         Function *function = currentSymbols->template getSymbol<Function>(prototype.name, SymbolType::FUNCTION);
+        bool redefined = false;
         if(function == nullptr) {
-            Type *returnType = currentSymbols->getType(prototype.returnTypeName);
+            Type *returnType = getType(prototype.returnTypeName);
             if (returnType == nullptr) {
                 errors->addError(
                         Error{f.position, Utf8String{"Return type "} + prototype.returnTypeName + " was not found"});
+            } else if (returnType->isFuture()) {
+                errors->addError(Error{ f.position, Utf8String{ "Function " } + prototype.name + " can not return a future" });
             }
             std::vector<Variable *> parameters;
             for (ast::Parameter param : prototype.parameters) {
-                Type *paramType = currentSymbols->getType(param.typeName);
-                if (paramType == nullptr) {
-                    errors->addError(Error{f.position,
-                                           Utf8String{"Function parameter type "} + param.typeName + " was not found"});
-                }
+                Type *paramType = getParameterType(param, f.position);
                 Variable *parameter = new Variable{param.name, paramType};
                 parameters.push_back(parameter);
             }
 
-            function = new Function{prototype.name, parameters, returnType, false, true};
+            function = new Function{prototype.name, parameters, returnType, false, true, prototype.visibility};
             currentSymbols->addSymbol(function);
         }
         else
         {
+            if (function->module.length() != 0)
+            {
+                errors->addError(Error{ f.position, Utf8String{ "Function " } + prototype.name + " is already imported from module " + function->module });
+            }
+            else if (function->declared)
+            {
+                errors->addError(Error{ f.position, Utf8String{ "Function " } + prototype.name + " is already defined" });
+                redefined = true;
+            }
             function->declared = true;
+            if (function->visibility != prototype.visibility)
+            {
+                errors->addError(Error{ f.position, Utf8String{ "Function " } + prototype.name + " is defined with a different visibility than it was declared with" });
+            }
+        }
+
+        if (prototype.name == Utf8String{ "main" } && prototype.visibility != Visibility::PUBLIC)
+        {
+            errors->addError(Error{ f.position, Utf8String{ "Function main must be public" } });
+        }
+
+        if (reusedFunctions != nullptr)
+        {
+            auto reused = reusedFunctions->find(prototype.name);
+            if (reused != reusedFunctions->end())
+            {
+                if (!reuseFunction(function, reused->second, f.position))
+                    rejected.push_back(prototype.name);
+                f.function = function;
+                return nullptr;
+            }
         }
 
         if(function->returnType == Type::VOID) {
@@ -432,10 +1590,24 @@ namespace px
         auto newScope = new Scope(current);
         _currentScope = newScope;
         auto newSymbols = newScope->symbols();
+        // The function owns its parameters, so a second definition's body gets parameters of its own
         for (auto &param : function->parameters)
-            newSymbols->addSymbol(param);
-        for(auto &statement : f.block->statements)
-            statement->accept(*this);
+        {
+            if (redefined)
+                newSymbols->addSymbol(new Variable{ param->name, param->type });
+            else
+                newSymbols->addBorrowedSymbol(param);
+        }
+
+        size_t previousReturnCount = returnCount;
+        returnCount = 0;
+        summaries[function].size = Inliner::cost(*f.block);
+        analyzeStatements(f.block->statements);
+        endPendingTasks(newScope);
+        summaries[function].diverges = diverges;
+        summaries[function].divergingCallees = divergingCalls;
+        definedFunctions.push_back(function);
+        returnCount = previousReturnCount;
         _currentScope = current;
         currentFunction = currentFunc;
         
@@ -463,27 +1635,164 @@ namespace px
         return nullptr;
     }
 
+    void ContextAnalyzer::reuseFunctions(const std::unordered_map<Utf8String, FunctionFacts> *reused)
+    {
+        reusedFunctions = reused;
+    }
+
+    void ContextAnalyzer::useInterfaces(InterfaceCache *cache)
+    {
+        interfaceCache = cache;
+    }
+
+    // The function is defined without a scope of its own, since nothing is compiled from its body.
+    // Its callees were all declared before it, so the calls it makes are replayed right away. When
+    // one of them is no longer there, nothing is replayed and the function is rejected.
+    bool ContextAnalyzer::reuseFunction(Function *function, const FunctionFacts &facts, const SourcePosition &position)
+    {
+        auto moduleSymbols = _moduleScope->symbols();
+        for (auto &name : facts.callees)
+        {
+            if (moduleSymbols->template getSymbol<Function>(name, SymbolType::FUNCTION) == nullptr
+                && (imports.empty() || importFunction(name, position) == nullptr))
+                return false;
+        }
+        function->attributes = facts.attributes;
+        summaries[function];
+        spreadProperties.writesMemory[function] = facts.writesMemory;
+        spreadProperties.writesGlobals[function] = facts.writesGlobals;
+        spreadProperties.readsGlobals[function] = facts.readsGlobals;
+        spreadProperties.resizesParameters[function] = facts.resizesParameters;
+        for (auto &name : facts.aliasedCallees)
+        {
+            Function *callee = moduleSymbols->template getSymbol<Function>(name, SymbolType::FUNCTION);
+            if (callee != nullptr)
+                summaries[callee].aliasedArrayArguments = true;
+        }
+        return true;
+    }
+
+    FunctionFacts ContextAnalyzer::facts(Function *function)
+    {
+        FunctionFacts found;
+        FunctionSummary &summary = summaries[function];
+        found.attributes = function->attributes;
+        found.writesMemory = spreadProperties.writesMemory[function];
+        found.writesGlobals = spreadProperties.writesGlobals[function];
+        found.readsGlobals = spreadProperties.readsGlobals[function];
+        found.resizesParameters = spreadProperties.resizesParameters[function];
+        found.aliasedArrayArguments = summary.aliasedArrayArguments;
+        for (Function *callee : summary.callees)
+        {
+            if (std::find(found.callees.begin(), found.callees.end(), callee->name) == found.callees.end())
+                found.callees.push_back(callee->name);
+        }
+        for (Function *callee : summary.aliasedCallees)
+        {
+            if (std::find(found.aliasedCallees.begin(), found.aliasedCallees.end(), callee->name) == found.aliasedCallees.end())
+                found.aliasedCallees.push_back(callee->name);
+        }
+        return found;
+    }
+
     void* ContextAnalyzer::visit(ast::Module &m)
     {
         auto current = _currentScope;
         auto newScope = new Scope(current);
         _currentScope = newScope;
+        _moduleScope = newScope;
+        openImports(m);
         for (auto &statement : m.statements)
         {
             statement->accept(*this);
         }
+        inferAttributes();
         _currentScope = current;
         return nullptr;
     }
 
+    // An imported module's interface is looked for next to the importing module
+    void ContextAnalyzer::openImports(ast::Module &m)
+    {
+        importingModule = &m;
+        std::string directory = m.fileName.toString();
+        size_t slash = directory.find_last_of("/\\");
+        directory = slash == std::string::npos ? std::string{} : directory.substr(0, slash + 1);
+        for (auto &import : m.imports)
+        {
+            std::string path = directory + import.moduleName.toString() + ".pxi";
+            std::shared_ptr<ModuleInterface> interface = interfaceCache != nullptr ? interfaceCache->open(path) : ModuleInterface::open(path);
+            if (interface == nullptr)
+                errors->addError(Error{ import.position, Utf8String{ "Module " } + import.moduleName + " was not found, as " + path + " is missing or is not a module interface" });
+            else if (interface->moduleName() != import.moduleName)
+                errors->addError(Error{ import.position, Utf8String{ path } + " is the interface of module " + interface->moduleName() + ", not " + import.moduleName });
+            else
+                imports.push_back(std::move(interface));
+        }
+    }
+
+    // Makes the Function for name from the first imported module that has it. It goes in the
+    // module scope, so each imported function is only looked up once.
+    Function *ContextAnalyzer::importFunction(const Utf8String &name, const SourcePosition &position)
+    {
+        InterfaceFunction found;
+        for (auto &interface : imports)
+        {
+            if (!interface->findFunction(name, found))
+                continue;
+            Utf8String missingType;
+            Type *returnType = getType(found.returnTypeName);
+            if (returnType == nullptr)
+                missingType = found.returnTypeName;
+            std::vector<Variable*> parameters;
+            for (auto &parameter : found.parameters)
+            {
+                Type *type = getType(parameter.typeName);
+                if (type == nullptr)
+                    missingType = parameter.typeName;
+                else if (parameter.arraySize != 0)
+                    type = getArrayType(type, parameter.arraySize);
+                parameters.push_back(new Variable{ parameter.name, type });
+            }
+            if (missingType.length() != 0)
+            {
+                errors->addError(Error{ position, Utf8String{ "Function " } + name + " of module " + interface->moduleName() + " uses type " + missingType + ", which was not found" });
+                for (Variable *parameter : parameters)
+                    delete parameter;
+                return nullptr;
+            }
+            Function *function = new Function{ name, parameters, returnType, false, false, Visibility::PUBLIC };
+            function->attributes = found.attributes;
+            function->module = interface->moduleName();
+            _moduleScope->symbols()->addSymbol(function);
+            importingModule->importedFunctions.push_back(function);
+            return function;
+        }
+        return nullptr;
+    }
+
     void* ContextAnalyzer::visit(ast::ReturnStatement &s)
     {
+        if (currentFunction == nullptr)
+        {
+            errors->addError(Error{ s.position, "Can not return outside of a function" });
+            return nullptr;
+        }
+        if (!parallelLoops.empty())
+        {
+            errors->addError(Error{ s.position, "Can not return from inside a parallel for" });
+        }
+        ++returnCount;
         auto returnType = currentFunction->returnType;
         if (s.returnValue != nullptr)
         {
             if(!returnType->isVoid())
             {
                 s.returnValue->accept(*this);
+                if (escapesRegion(*s.returnValue, 0))
+                {
+                    errors->addError(Error{ s.position, Utf8String{ "Can not return a value allocated in a region block" } });
+                }
                 auto expType = currentFunction->returnType;
                 if( !expType->isImpiciltyCastableTo(returnType))
                 {
@@ -506,11 +1815,154 @@ namespace px
         return nullptr;
     }
 
+    void* ContextAnalyzer::visit(ast::RegionStatement &r)
+    {
+        ++regionDepth;
+        r.body->accept(*this);
+        --regionDepth;
+        return nullptr;
+    }
+
+    void* ContextAnalyzer::visit(ast::SpawnExpression &s)
+    {
+        if (&s != spawnInitializer)
+        {
+            errors->addError(Error{ s.position, Utf8String{ "spawn can only give the initial value of a future variable" } });
+            return nullptr;
+        }
+        spawnInitializer = nullptr;
+        s.call->accept(*this);
+        Function *function = s.call->function;
+        if (function == nullptr)
+        {
+            if (s.call->containerOperation != ast::ContainerOperation::NONE)
+                errors->addError(Error{ s.position, Utf8String{ "Only calls to functions can be spawned, not " } + s.call->functionName });
+            return nullptr;
+        }
+
+        // The task runs on another thread, so it can not be handed anything that belongs to this one,
+        // and the dynamic arrays and maps it gets are passed by address and must stay where they are
+        Type *returnType = function->returnType;
+        if (returnType != nullptr && (returnType->isContainer() || returnType->isStringBuilder()))
+        {
+            errors->addError(Error{ s.position, Utf8String{ "Function " } + function->name + " returns a value of type '" + returnType->name + "', so it can not be spawned" });
+            return nullptr;
+        }
+        bool passesContainers = false;
+        for (auto &argument : s.call->arguments)
+        {
+            if (argument->type->isStringBuilder())
+            {
+                errors->addError(Error{ argument->position, Utf8String{ "A StringBuilder belongs to one thread, so it can not be passed to a spawned call" } });
+            }
+            else if (argument->type->isContainer())
+            {
+                passesContainers = true;
+                if (argument->nodeType != ast::NodeType::EXP_VAR_LOAD)
+                    errors->addError(Error{ argument->position, Utf8String{ "The dynamic arrays and maps passed to a spawned call must be variables" } });
+            }
+        }
+        spawnCalls.push_back(SpawnCall{ function, s.position, passesContainers });
+        if (returnType != nullptr)
+            s.type = getType(Utf8String{ "future[" } + returnType->name + "]");
+        return nullptr;
+    }
+
     void* ContextAnalyzer::visit(ast::StringLiteral &s)
     {
         return nullptr;
     }
 
+    static bool getCaseConstant(ast::Expression &value, int64_t &constant)
+    {
+        switch (value.nodeType)
+        {
+            case ast::NodeType::LITERAL_INT:
+                constant = ((ast::IntegerLiteral&) value).value;
+                return true;
+            case ast::NodeType::LITERAL_CHAR:
+                constant = ((ast::CharLiteral&) value).literal[0];
+                return true;
+            case ast::NodeType::EXP_UNARY_OP:
+            {
+                auto &unary = (ast::UnaryOpExpression&) value;
+                if (unary.op != ast::UnaryOperator::NEG || unary.expression->nodeType != ast::NodeType::LITERAL_INT)
+                    return false;
+                constant = -((ast::IntegerLiteral&) *unary.expression).value;
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    void* ContextAnalyzer::visit(ast::SwitchStatement &s)
+    {
+        s.scrutinee->accept(*this);
+        Type *type = s.scrutinee->type;
+        if (!type->isInt() && !type->isUInt() && !type->isChar())
+        {
+            errors->addError(Error{ s.position, Utf8String{ "Switch value must be an integer or a char, not '" } + type->name + "'" });
+            return nullptr;
+        }
+
+        int bits = type->size * 8;
+        std::unordered_set<int64_t> seen;
+        for (auto &switchCase : s.cases)
+        {
+            for (auto &value : switchCase.values)
+            {
+                value->accept(*this);
+                int64_t constant;
+                if (!getCaseConstant(*value, constant))
+                {
+                    errors->addError(Error{ value->position, Utf8String{ "Case value must be an integer or char literal" } });
+                    continue;
+                }
+
+                bool isChar = value->nodeType == ast::NodeType::LITERAL_CHAR;
+                if (isChar != type->isChar())
+                {
+                    errors->addError(Error{ value->position, Utf8String{ "Case value of type '" } + value->type->name + "' does not match switch value of type '" + type->name + "'" });
+                    continue;
+                }
+                bool inRange = true;
+                if (type->isInt() && bits < 64)
+                    inRange = constant >= -(INT64_C(1) << (bits - 1)) && constant < (INT64_C(1) << (bits - 1));
+                else if (type->isUInt())
+                    inRange = constant >= 0 && (bits == 64 || constant < (INT64_C(1) << bits));
+                if (!inRange)
+                {
+                    errors->addError(Error{ value->position, Utf8String{ "Case value " } + std::to_string(constant) + " is out of range for type '" + type->name + "'" });
+                    continue;
+                }
+
+                if (!seen.insert(constant).second)
+                {
+                    errors->addError(Error{ value->position, Utf8String{ "Duplicate case value " } + std::to_string(constant) });
+                    continue;
+                }
+                switchCase.constants.push_back(constant);
+            }
+
+            ++switchDepth;
+            loopBreaks.push_back(false);
+            switchCase.body->accept(*this);
+            loopBreaks.pop_back();
+            --switchDepth;
+        }
+
+        if (s.defaultBody)
+        {
+            ++switchDepth;
+            loopBreaks.push_back(false);
+            s.defaultBody->accept(*this);
+            loopBreaks.pop_back();
+            --switchDepth;
+        }
+        return nullptr;
+    }
+
     void *ContextAnalyzer::visit(ast::TernaryOpExpression &t)
     {
         t.condition->accept(*this);
@@ -581,33 +2033,64 @@ namespace px
         Type *type;
         if (d.arraySize) {
             Type *baseType = symbols->getType(typeName);
-            typeName += Utf8String("[") + std::to_string(*d.arraySize) + "]";
-            type = symbols->getType(typeName);
-            if (type == nullptr) {
-                auto rootScope = _currentScope->root();
-                auto rootSymbols = rootScope->symbols();
-                type = new ArrayType(baseType, *d.arraySize);
-                rootSymbols->addSymbol(type);
+            if (baseType == nullptr) {
+                errors->addError(Error{d.position, Utf8String{"Type "} + typeName + " was not found"});
+                return nullptr;
+            }
+            if (baseType->isFuture()) {
+                errors->addError(Error{d.position, Utf8String{"Can not make an array of futures"}});
+                return nullptr;
             }
+            type = getArrayType(baseType, *d.arraySize);
         } else {
-            type = symbols->getType(typeName);
+            type = getType(typeName);
             if (type == nullptr) {
                 errors->addError(Error{d.position, Utf8String{"Type "} + typeName + " was not found"});
                 return nullptr;
             }
         }
+        if (type->isContainer() && d.initialValue && currentFunction == nullptr)
+        {
+            errors->addError(Error{ d.position, Utf8String{ "Module level " } + (type->isMap() ? "map " : "dynamic array ") + d.name + " can not have an initial value" });
+            return nullptr;
+        }
+        bool spawned = type->isFuture() && d.initialValue && d.initialValue->nodeType == ast::NodeType::EXP_SPAWN;
+        if (type->isFuture() && (!spawned || currentFunction == nullptr))
+        {
+            errors->addError(Error{ d.position, Utf8String{ "Future " } + d.name + (currentFunction == nullptr ? " must be declared inside a function" : " must be given a spawned call") });
+            return nullptr;
+        }
         if (symbols->getVariable(d.name, true) != nullptr)
         {
             errors->addError(Error{ d.position, Utf8String{ "Variable " } + d.name + " already delcared in the current scope" });
             return nullptr;
         }
         auto variable = new Variable{ d.name, type };
+        variable->regionDepth = regionDepth;
         symbols->addSymbol(variable);
         if (d.initialValue)
         {
+            if (spawned)
+                spawnInitializer = d.initialValue.get();
             d.initialValue->accept(*this);
+            spawnInitializer = nullptr;
             checkAssignmentTypes(variable, d.initialValue, d.position);
         }
+        if (spawned && d.initialValue->type->isFuture())
+        {
+            auto &call = *((ast::SpawnExpression&) *d.initialValue).call;
+            PendingTask task{ variable, _currentScope, call.function, {} };
+            for (auto &argument : call.arguments)
+            {
+                if ((argument->type->isArray() || argument->type->isContainer()) && argument->nodeType == ast::NodeType::EXP_VAR_LOAD)
+                {
+                    Variable *container = symbols->getVariable(((ast::VariableExpression&) *argument).variable);
+                    recordTaskUse(argument->position, container, call.function);
+                    task.containers.push_back(container);
+                }
+            }
+            pendingTasks.push_back(task);
+        }
         return nullptr;
     }
 
@@ -621,6 +2104,30 @@ namespace px
             return nullptr;
         }
         v.type = variable->type;
+        if (variable->type->isStringBuilder() && isSharedByParallelLoop(variable))
+        {
+            errors->addError(Error{ v.position, Utf8String{ "The StringBuilder " } + v.variable + " belongs to one thread, so it can not be used inside a parallel for" });
+        }
+        if (variable->type->isFuture())
+        {
+            if (&v != awaitedFuture)
+                errors->addError(Error{ v.position, Utf8String{ "The future " } + v.variable + " can only be awaited" });
+            else if (isSharedByParallelLoop(variable))
+                errors->addError(Error{ v.position, Utf8String{ "Can not await " } + v.variable + " inside a parallel for, since its iterations share it" });
+        }
+        if (variable->type->isArray() && &v != parallelElement && isSharedByParallelLoop(variable))
+        {
+            parallelLoops.back().sharedReads.emplace_back(variable, v.position);
+        }
+
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr)
+        {
+            if (isGlobal(variable))
+                summary->readsGlobals = true;
+            else if ((variable->type->isArray() || variable->type->isContainer()) && isParameter(variable))
+                summary->readsArrays = true;
+        }
         return nullptr;
     }
 
@@ -634,8 +2141,17 @@ namespace px
         }
 
         ++loopDepth;
-        w.body->accept(*this);;
+        loopBreaks.push_back(false);
+        w.body->accept(*this);
         --loopDepth;
+        bool broken = loopBreaks.back();
+        loopBreaks.pop_back();
+
+        diverges = isInfiniteLoop(*w.condition, broken);
+        divergingCalls.clear();
+        FunctionSummary *summary = currentSummary();
+        if (summary != nullptr && diverges)
+            summary->hasInfiniteLoop = true;
         return nullptr;
     }
 
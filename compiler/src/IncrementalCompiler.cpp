@@ -0,0 +1,541 @@
+#include "IncrementalCompiler.h"
+
+#include "ModuleInterface.h"
+#include "Parser.h"
+#include "opt/Inliner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace px {
+
+    static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    static const uint64_t FNV_PRIME = 1099511628211ull;
+
+    static void hashBytes(uint64_t &hash, const void *bytes, size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= ((const uint8_t*) bytes)[i];
+            hash *= FNV_PRIME;
+        }
+    }
+
+    // FNV-1a over the code points of source from start up to end
+    static void hashText(uint64_t &hash, const Utf8String &source, size_t start, size_t end)
+    {
+        for (size_t i = start; i < end; ++i)
+        {
+            int32_t codePoint = source[(uint32_t) i];
+            hashBytes(hash, &codePoint, sizeof(codePoint));
+        }
+    }
+
+    static void hashString(uint64_t &hash, const Utf8String &text)
+    {
+        hashBytes(hash, text.c_str(), text.byteLength());
+        hashBytes(hash, "", 1);
+    }
+
+    // Where each top level statement's text starts and ends; a statement runs until the next one
+    static std::vector<std::pair<size_t, size_t>> statementRanges(ast::Module &module, size_t sourceLength)
+    {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        auto &statements = module.statements;
+        for (size_t i = 0; i < statements.size(); ++i)
+        {
+            size_t end = i + 1 < statements.size() ? statements[i + 1]->position.fileOffset : sourceLength;
+            ranges.emplace_back(statements[i]->position.fileOffset, end);
+        }
+        return ranges;
+    }
+
+    static bool sameFacts(const FunctionFacts &a, const FunctionFacts &b)
+    {
+        return a.attributes == b.attributes && a.writesMemory == b.writesMemory && a.writesGlobals == b.writesGlobals
+            && a.readsGlobals == b.readsGlobals && a.resizesParameters == b.resizesParameters;
+    }
+
+    IncrementalCompiler::IncrementalCompiler(const Utf8String &name, const IncrementalOptions &compileOptions)
+        : fileName{ name }, options(compileOptions), cachedShape{ 0 }, nextShape{ 0 }, functions{ 0 }, compiled{ 0 }, rounds{ 0 }
+    {
+    }
+
+    // Hashes what every function definition depends on: the text outside the definitions and which
+    // definition each of its statements follows, the imported interfaces and the options
+    uint64_t IncrementalCompiler::shapeHash(const Utf8String &source) const
+    {
+        uint64_t hash = FNV_OFFSET;
+        uint32_t version = CACHE_VERSION;
+        hashBytes(hash, &version, sizeof(version));
+        hashBytes(hash, &options.inlining, sizeof(options.inlining));
+        uint64_t threshold = options.inlineThreshold;
+        hashBytes(hash, &threshold, sizeof(threshold));
+
+        auto ranges = statementRanges(*_module, source.length());
+        hashText(hash, source, 0, ranges.empty() ? source.length() : ranges.front().first);
+        Utf8String previous;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            auto &statement = *_module->statements[i];
+            if (statement.nodeType == ast::NodeType::DECLARE_FUNC_BODY)
+            {
+                previous = ((ast::FunctionDefinition&) statement).prototype->name;
+                continue;
+            }
+            hashString(hash, previous);
+            hashText(hash, source, ranges[i].first, ranges[i].second);
+        }
+
+        std::string directory = fileName.toString();
+        size_t slash = directory.find_last_of("/\\");
+        directory = slash == std::string::npos ? std::string{} : directory.substr(0, slash + 1);
+        for (auto &import : _module->imports)
+        {
+            std::ifstream in{ directory + import.moduleName.toString() + ".pxi", std::ios::binary };
+            std::stringstream contents;
+            contents << in.rdbuf();
+            std::string bytes = contents.str();
+            hashBytes(hash, bytes.data(), bytes.size());
+        }
+        return hash;
+    }
+
+    Utf8String IncrementalCompiler::signature(Function *function)
+    {
+        Utf8String text = Utf8String{ std::to_string((int) function->visibility) } + " " + function->returnType->name + "(";
+        for (Variable *parameter : function->parameters)
+            text += parameter->type->name + ",";
+        return text + ")";
+    }
+
+    bool IncrementalCompiler::compile(ErrorLog &errors)
+    {
+        std::ifstream in{ fileName.toString() };
+        if (!in.good())
+        {
+            errors.addError(Error{ SourcePosition{ fileName }, Utf8String{ "File " } + fileName + " was not found" });
+            return false;
+        }
+        std::stringstream text;
+        text << in.rdbuf();
+        std::string sourceText = text.str();
+        Utf8String source{ sourceText };
+        std::string cachePath = fileName.toString() + ".pxinc";
+        loadCache(cachePath);
+
+        std::unordered_set<Utf8String> dirty;
+        std::unordered_map<Utf8String, std::vector<Utf8String>> cachedCallers;
+        auto findCallers = [&]() {
+            cachedCallers.clear();
+            for (auto &entry : cache)
+            {
+                for (auto &callee : entry.second.facts.callees)
+                    cachedCallers[callee].push_back(entry.first);
+                for (auto &callee : entry.second.inlined)
+                    cachedCallers[callee].push_back(entry.first);
+            }
+        };
+        findCallers();
+        // What a function's callers may do follows from what it does, so a change reaches all of
+        // the functions calling it, directly or not, and they are all taken at once
+        auto addCallers = [&](const Utf8String &name, std::vector<Utf8String> &added) {
+            std::vector<Utf8String> pending{ name };
+            while (!pending.empty())
+            {
+                auto callers = cachedCallers.find(pending.back());
+                pending.pop_back();
+                if (callers == cachedCallers.end())
+                    continue;
+                for (auto &caller : callers->second)
+                {
+                    if (dirty.insert(caller).second)
+                    {
+                        added.push_back(caller);
+                        pending.push_back(caller);
+                    }
+                }
+            }
+        };
+        // A function that may be inlined takes the functions it may have been inlined into along
+        // when it is compiled again, and so on for those that may be inlined in turn
+        std::unordered_set<Utf8String> inlinable;
+        std::unordered_set<Utf8String> spread;
+        auto mayBeInlined = [&](const Utf8String &name) {
+            auto cached = cache.find(name);
+            return inlinable.count(name) != 0 || (cached != cache.end() && cached->second.inlinable);
+        };
+        auto markDirty = [&](const Utf8String &name) {
+            dirty.insert(name);
+            std::vector<Utf8String> pending{ name };
+            while (!pending.empty())
+            {
+                Utf8String next = pending.back();
+                pending.pop_back();
+                if (!mayBeInlined(next) || !spread.insert(next).second)
+                    continue;
+                for (auto &caller : cachedCallers[next])
+                {
+                    dirty.insert(caller);
+                    pending.push_back(caller);
+                }
+            }
+        };
+
+        // The body of a definition that is not compiled again is only scanned to fingerprint it.
+        // The ones that may be inlined are always parsed, since the Inliner needs their bodies.
+        std::unordered_map<Utf8String, uint64_t> fingerprints;
+        std::unordered_set<Utf8String> skipped;
+        auto skipBody = [&](const ast::FunctionPrototype &prototype, size_t start, size_t end) {
+            uint64_t fingerprint = FNV_OFFSET;
+            hashText(fingerprint, source, start, end);
+            fingerprints[prototype.name] = fingerprint;
+            auto cached = cache.find(prototype.name);
+            if (cached == cache.end() || cached->second.fingerprint != fingerprint)
+                markDirty(prototype.name);
+            if (dirty.count(prototype.name) != 0 || cached->second.inlinable)
+                return false;
+            skipped.insert(prototype.name);
+            return true;
+        };
+
+        rounds = 0;
+        std::unordered_map<Utf8String, std::vector<Utf8String>> inlined;
+        std::unordered_map<Utf8String, FunctionFacts> reused;
+        while (true)
+        {
+            ++rounds;
+            // Each round starts from a fresh parse, as analysis changes the tree
+            analyzer.reset();
+            scopeTree.reset(new ScopeTree{});
+            fingerprints.clear();
+            skipped.clear();
+            Parser parser{ &errors };
+            parser.skipBodies(skipBody);
+            std::istringstream input{ sourceText };
+            try {
+                _module = parser.parse(fileName, input);
+            }
+            catch (const Error &) {
+                return false;
+            }
+
+            if (rounds == 1)
+            {
+                // Nothing cached can be used, so the module is parsed again in full
+                nextShape = shapeHash(source);
+                if (nextShape != cachedShape && !cache.empty())
+                {
+                    cache.clear();
+                    findCallers();
+                    rounds = 0;
+                    continue;
+                }
+                // Calls to a function that is gone have to be reported
+                std::vector<Utf8String> added;
+                for (auto &entry : cache)
+                {
+                    if (fingerprints.count(entry.first) == 0)
+                        addCallers(entry.first, added);
+                }
+            }
+
+            inlined.clear();
+            inlinable.clear();
+            if (options.inlining)
+            {
+                Inliner inliner{ options.inlineThreshold };
+                for (auto &name : skipped)
+                {
+                    auto &entry = cache[name];
+                    std::vector<Utf8String> callees = entry.facts.callees;
+                    callees.insert(callees.end(), entry.inlined.begin(), entry.inlined.end());
+                    inliner.assumeCalls(name, callees);
+                }
+                inliner.run(*_module);
+                for (auto &decision : inliner.decisions())
+                {
+                    auto &callees = inlined[decision.caller];
+                    if (decision.inlined && std::find(callees.begin(), callees.end(), decision.callee) == callees.end())
+                        callees.push_back(decision.callee);
+                }
+                for (auto &entry : fingerprints)
+                {
+                    if (inliner.inlinable(entry.first))
+                        inlinable.insert(entry.first);
+                }
+                // A function that may be inlined now but could not be before takes its callers along
+                std::vector<Utf8String> changed{ dirty.begin(), dirty.end() };
+                for (auto &name : changed)
+                    markDirty(name);
+            }
+
+            bool skippedDirty = false;
+            for (auto &name : skipped)
+                skippedDirty = skippedDirty || dirty.count(name) != 0;
+            if (skippedDirty)
+                continue;
+
+            reused.clear();
+            for (auto &entry : fingerprints)
+            {
+                if (dirty.count(entry.first) == 0)
+                    reused[entry.first] = cache[entry.first].facts;
+            }
+            analyzer.reset(new ContextAnalyzer{ scopeTree->current(), &errors });
+            analyzer->reuseFunctions(&reused);
+            analyzer->useInterfaces(options.interfaces);
+            analyzer->analyze(*_module);
+            if (errors.count() > 0)
+                return false;
+            if (!analyzer->rejectedFunctions().empty())
+            {
+                for (auto &name : analyzer->rejectedFunctions())
+                    dirty.insert(name);
+                continue;
+            }
+
+            // The functions depending on one whose facts changed are compiled again in another round
+            std::vector<Utf8String> added;
+            for (auto &statement : _module->statements)
+            {
+                if (statement->nodeType != ast::NodeType::DECLARE_FUNC_BODY)
+                    continue;
+                Function *function = ((ast::FunctionDefinition&) *statement).function;
+                auto cached = cache.find(function->name);
+                FunctionFacts found = analyzer->facts(function);
+                if (dirty.count(function->name) == 0)
+                {
+                    if (found.aliasedArrayArguments != cached->second.facts.aliasedArrayArguments)
+                    {
+                        dirty.insert(function->name);
+                        added.push_back(function->name);
+                    }
+                }
+                else if (cached != cache.end() && (!sameFacts(found, cached->second.facts) || signature(function) != cached->second.signature))
+                {
+                    addCallers(function->name, added);
+                }
+            }
+            if (added.empty())
+                break;
+        }
+
+        std::unordered_map<Utf8String, FunctionFragment> fragments;
+        std::unordered_set<Utf8String> reusedNames;
+        for (auto &entry : reused)
+        {
+            fragments[entry.first] = std::move(cache[entry.first].fragment);
+            reusedNames.insert(entry.first);
+        }
+        CCompiler compiler{ scopeTree.get() };
+        compiler.compileFragments(&fragments, &reusedNames);
+        compiler.compile(*_module);
+
+        nextCache.clear();
+        functions = 0;
+        compiled = 0;
+        for (auto &statement : _module->statements)
+        {
+            if (statement->nodeType != ast::NodeType::DECLARE_FUNC_BODY)
+                continue;
+            Function *function = ((ast::FunctionDefinition&) *statement).function;
+            CachedFunction &entry = nextCache[function->name];
+            ++functions;
+            if (reusedNames.count(function->name) != 0)
+            {
+                entry = std::move(cache[function->name]);
+                entry.facts.aliasedArrayArguments = analyzer->facts(function).aliasedArrayArguments;
+            }
+            else
+            {
+                ++compiled;
+                entry.signature = signature(function);
+                entry.facts = analyzer->facts(function);
+                entry.inlined = inlined[function->name];
+                entry.inlinable = inlinable.count(function->name) != 0;
+            }
+            entry.fingerprint = fingerprints[function->name];
+            entry.fragment = std::move(fragments[function->name]);
+        }
+        // The cache would be written as it was read
+        if (compiled > 0 || functions != cache.size() || nextShape != cachedShape)
+            writeCache(cachePath);
+        cache.clear();
+        return true;
+    }
+
+    void IncrementalCompiler::outputReport() const
+    {
+        std::cerr << fileName.toString() << ": compiled " << compiled << " of " << functions << " functions in "
+                  << rounds << (rounds == 1 ? " round" : " rounds") << std::endl;
+    }
+
+    namespace
+    {
+        // Reads the cache file, failing once anything runs past its end
+        class CacheReader
+        {
+        public:
+            explicit CacheReader(const std::string &contents) : data{ contents }, offset{ 0 }, failed{ false }
+            {
+            }
+
+            template<typename T>
+            T read()
+            {
+                T value{};
+                if (offset + sizeof(T) > data.size())
+                {
+                    failed = true;
+                    return value;
+                }
+                std::memcpy(&value, data.data() + offset, sizeof(T));
+                offset += sizeof(T);
+                return value;
+            }
+
+            Utf8String readString()
+            {
+                uint32_t length = read<uint32_t>();
+                if (failed || offset + length > data.size())
+                {
+                    failed = true;
+                    return Utf8String{};
+                }
+                offset += length;
+                return Utf8String{ data.substr(offset - length, length) };
+            }
+
+            std::vector<Utf8String> readStrings()
+            {
+                std::vector<Utf8String> strings;
+                uint32_t count = read<uint32_t>();
+                for (uint32_t i = 0; i < count && !failed; ++i)
+                    strings.push_back(readString());
+                return strings;
+            }
+
+            const std::string &data;
+            size_t offset;
+            bool failed;
+        };
+
+        class CacheWriter
+        {
+        public:
+            template<typename T>
+            void write(T value)
+            {
+                data.append((const char*) &value, sizeof(T));
+            }
+
+            void writeString(const Utf8String &text)
+            {
+                write((uint32_t) text.byteLength());
+                data.append(text.c_str(), text.byteLength());
+            }
+
+            void writeStrings(const std::vector<Utf8String> &strings)
+            {
+                write((uint32_t) strings.size());
+                for (auto &text : strings)
+                    writeString(text);
+            }
+
+            std::string data;
+        };
+    }
+
+    // The cache is a header of magic, version, shape hash and function count, then each function's
+    // name, fingerprint, signature, facts, inlined callees and fragment, with strings stored as a
+    // byte length and their bytes. A cache that can not be read is the same as none.
+    void IncrementalCompiler::loadCache(const std::string &path)
+    {
+        cache.clear();
+        cachedShape = 0;
+        std::ifstream in{ path, std::ios::binary };
+        if (!in.good())
+            return;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string contents = buffer.str();
+        CacheReader reader{ contents };
+        if (reader.read<uint32_t>() != CACHE_MAGIC || reader.read<uint32_t>() != CACHE_VERSION)
+            return;
+        uint64_t shape = reader.read<uint64_t>();
+        uint32_t count = reader.read<uint32_t>();
+        for (uint32_t i = 0; i < count && !reader.failed; ++i)
+        {
+            Utf8String name = reader.readString();
+            CachedFunction &entry = cache[name];
+            entry.fingerprint = reader.read<uint64_t>();
+            entry.signature = reader.readString();
+            entry.facts.attributes = reader.read<uint32_t>();
+            uint8_t flags = reader.read<uint8_t>();
+            entry.facts.writesMemory = (flags & 1) != 0;
+            entry.facts.writesGlobals = (flags & 2) != 0;
+            entry.facts.readsGlobals = (flags & 4) != 0;
+            entry.facts.resizesParameters = (flags & 8) != 0;
+            entry.facts.aliasedArrayArguments = (flags & 16) != 0;
+            entry.inlinable = (flags & 32) != 0;
+            entry.facts.callees = reader.readStrings();
+            entry.facts.aliasedCallees = reader.readStrings();
+            entry.inlined = reader.readStrings();
+            entry.fragment.code = reader.readString();
+            uint32_t mapCount = reader.read<uint32_t>();
+            for (uint32_t j = 0; j < mapCount && !reader.failed; ++j)
+            {
+                FragmentMap map;
+                map.typeName = reader.readString();
+                map.name = reader.readString();
+                map.definition = reader.readString();
+                entry.fragment.maps.push_back(map);
+            }
+        }
+        if (reader.failed || reader.offset != contents.size())
+        {
+            cache.clear();
+            return;
+        }
+        cachedShape = shape;
+    }
+
+    void IncrementalCompiler::writeCache(const std::string &path) const
+    {
+        CacheWriter writer;
+        writer.write(CACHE_MAGIC);
+        writer.write(CACHE_VERSION);
+        writer.write(nextShape);
+        writer.write((uint32_t) nextCache.size());
+        for (auto &entry : nextCache)
+        {
+            const CachedFunction &function = entry.second;
+            const FunctionFacts &facts = function.facts;
+            writer.writeString(entry.first);
+            writer.write(function.fingerprint);
+            writer.writeString(function.signature);
+            writer.write(facts.attributes);
+            writer.write((uint8_t) ((facts.writesMemory ? 1 : 0) | (facts.writesGlobals ? 2 : 0) | (facts.readsGlobals ? 4 : 0)
+                                    | (facts.resizesParameters ? 8 : 0) | (facts.aliasedArrayArguments ? 16 : 0)
+                                    | (function.inlinable ? 32 : 0)));
+            writer.writeStrings(facts.callees);
+            writer.writeStrings(facts.aliasedCallees);
+            writer.writeStrings(function.inlined);
+            writer.writeString(function.fragment.code);
+            writer.write((uint32_t) function.fragment.maps.size());
+            for (auto &map : function.fragment.maps)
+            {
+                writer.writeString(map.typeName);
+                writer.writeString(map.name);
+                writer.writeString(map.definition);
+            }
+        }
+        std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+        out.write(writer.data.data(), (std::streamsize) writer.data.size());
+    }
+
+}
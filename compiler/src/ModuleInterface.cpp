@@ -0,0 +1,281 @@
+#include "ModuleInterface.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace px {
+
+    static const uint32_t HEADER_WORDS = 5;
+    static const uint32_t FUNCTION_WORDS = 4;
+    static const uint32_t PARAMETER_WORDS = 3;
+    static const uint32_t EXPORTED_ATTRIBUTES = Function::PURE | Function::CONST | Function::NO_RETURN;
+
+    // FNV-1a over the UTF-8 bytes of a name
+    static uint32_t hashName(const char *bytes, size_t length)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= (uint8_t) bytes[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // The type a parameter is recorded with, and the length when it is a fixed size array
+    static Utf8String parameterTypeName(Type *type, uint32_t &arraySize)
+    {
+        arraySize = 0;
+        if (type->isArray())
+        {
+            auto array = (ArrayType*) type;
+            arraySize = (uint32_t) array->count;
+            return array->elementType->name;
+        }
+        return type->name;
+    }
+
+    std::vector<Function*> ModuleInterface::exports(const SymbolTable &moduleSymbols)
+    {
+        std::vector<Function*> functions;
+        for (Function *function : moduleSymbols.getLocalFunctions())
+        {
+            // main would clash with the importing program's own
+            if (function->declared && !function->isExtern && function->visibility != Visibility::PRIVATE
+                && function->module.length() == 0 && function->name != Utf8String{ "main" })
+                functions.push_back(function);
+        }
+        std::sort(functions.begin(), functions.end(), [](Function *a, Function *b) { return a->name.toString() < b->name.toString(); });
+        return functions;
+    }
+
+    bool ModuleInterface::write(const std::string &path, const Utf8String &moduleName, const std::vector<Function*> &functions)
+    {
+        // Twice as many slots as functions keeps the probes short
+        uint32_t slotCount = 2;
+        while (slotCount < functions.size() * 2)
+            slotCount *= 2;
+
+        uint32_t functionWords = 0;
+        for (Function *function : functions)
+            functionWords += FUNCTION_WORDS + PARAMETER_WORDS * (uint32_t) function->parameters.size();
+        uint32_t stringsStart = (HEADER_WORDS + 2 * slotCount + functionWords) * sizeof(uint32_t);
+
+        // Each distinct string is stored once
+        std::string strings;
+        std::unordered_map<std::string, uint32_t> stringOffsets;
+        auto addString = [&](const Utf8String &text) {
+            std::string bytes = text.toString();
+            auto entry = stringOffsets.find(bytes);
+            if (entry != stringOffsets.end())
+                return entry->second;
+            uint32_t offset = stringsStart + (uint32_t) strings.size();
+            uint32_t length = (uint32_t) bytes.size();
+            strings.append((const char*) &length, sizeof(length));
+            strings += bytes;
+            strings.resize((strings.size() + 3) & ~(size_t) 3, '\0');
+            stringOffsets[bytes] = offset;
+            return offset;
+        };
+
+        std::vector<uint32_t> words{ MAGIC, VERSION, addString(moduleName), slotCount, (uint32_t) functions.size() };
+        words.resize(HEADER_WORDS + 2 * slotCount, 0);
+        for (Function *function : functions)
+        {
+            uint32_t offset = (uint32_t) (words.size() * sizeof(uint32_t));
+            std::string bytes = function->name.toString();
+            uint32_t hash = hashName(bytes.data(), bytes.size());
+            uint32_t slot = hash & (slotCount - 1);
+            while (words[HEADER_WORDS + 2 * slot + 1] != 0)
+                slot = (slot + 1) & (slotCount - 1);
+            words[HEADER_WORDS + 2 * slot] = hash;
+            words[HEADER_WORDS + 2 * slot + 1] = offset;
+
+            words.push_back(addString(function->name));
+            words.push_back(addString(function->returnType->name));
+            words.push_back(function->attributes & EXPORTED_ATTRIBUTES);
+            words.push_back((uint32_t) function->parameters.size());
+            for (Variable *parameter : function->parameters)
+            {
+                uint32_t arraySize;
+                Utf8String typeName = parameterTypeName(parameter->type, arraySize);
+                words.push_back(addString(parameter->name));
+                words.push_back(addString(typeName));
+                words.push_back(arraySize);
+            }
+        }
+
+        std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+        out.write((const char*) words.data(), (std::streamsize) (words.size() * sizeof(uint32_t)));
+        out.write(strings.data(), (std::streamsize) strings.size());
+        return out.good();
+    }
+
+    std::unique_ptr<ModuleInterface> ModuleInterface::open(const std::string &path)
+    {
+    #if !defined(_WIN32)
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return nullptr;
+        struct stat status;
+        void *data = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0)
+            data = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (data == MAP_FAILED)
+            return nullptr;
+        std::unique_ptr<ModuleInterface> interface{ new ModuleInterface{ (const uint8_t*) data, (size_t) status.st_size, true } };
+        if (!interface->valid())
+            return nullptr;
+        return interface;
+    #else
+        return read(path);
+    #endif
+    }
+
+    std::unique_ptr<ModuleInterface> ModuleInterface::read(const std::string &path)
+    {
+        std::ifstream in{ path, std::ios::binary };
+        if (!in.good())
+            return nullptr;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string contents = buffer.str();
+        uint8_t *data = new uint8_t[contents.size()];
+        std::memcpy(data, contents.data(), contents.size());
+        std::unique_ptr<ModuleInterface> interface{ new ModuleInterface{ data, contents.size(), false } };
+        if (!interface->valid())
+            return nullptr;
+        return interface;
+    }
+
+    ModuleInterface::ModuleInterface(const uint8_t *bytes, size_t length, bool isMapped)
+        : data{ bytes }, size{ length }, mapped{ isMapped }, slotCount{ 0 }
+    {
+    }
+
+    ModuleInterface::~ModuleInterface()
+    {
+    #if !defined(_WIN32)
+        if (mapped)
+        {
+            munmap((void*) data, size);
+            return;
+        }
+    #endif
+        delete[] data;
+    }
+
+    std::shared_ptr<ModuleInterface> InterfaceCache::open(const std::string &path)
+    {
+    #if !defined(_WIN32)
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+        {
+            entries.erase(path);
+            return nullptr;
+        }
+        int64_t modified = (int64_t) status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        auto entry = entries.find(path);
+        if (entry != entries.end() && entry->second.modified == modified && entry->second.size == (int64_t) status.st_size
+            && entry->second.inode == (uint64_t) status.st_ino && now - modified > 2000000000)
+            return entry->second.interface;
+        std::shared_ptr<ModuleInterface> interface{ ModuleInterface::read(path) };
+        if (interface != nullptr)
+            entries[path] = Entry{ modified, (int64_t) status.st_size, (uint64_t) status.st_ino, interface };
+        else
+            entries.erase(path);
+        return interface;
+    #else
+        return ModuleInterface::read(path);
+    #endif
+    }
+
+    // Only the header is checked here; the rest is checked as it is read
+    bool ModuleInterface::valid()
+    {
+        if (size < HEADER_WORDS * sizeof(uint32_t) || word(0) != MAGIC || word(4) != VERSION)
+            return false;
+        slotCount = word(12);
+        if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0
+            || (HEADER_WORDS + 2 * (uint64_t) slotCount) * sizeof(uint32_t) > size)
+            return false;
+        return readString(word(8), name);
+    }
+
+    uint32_t ModuleInterface::word(uint32_t offset) const
+    {
+        if (offset % sizeof(uint32_t) != 0 || (uint64_t) offset + sizeof(uint32_t) > size)
+            return 0;
+        uint32_t value;
+        std::memcpy(&value, data + offset, sizeof(value));
+        return value;
+    }
+
+    bool ModuleInterface::readString(uint32_t offset, Utf8String &text) const
+    {
+        uint32_t length = word(offset);
+        if (offset == 0 || (uint64_t) offset + sizeof(uint32_t) + length > size)
+            return false;
+        text = Utf8String{ std::string{ (const char*) data + offset + sizeof(uint32_t), length } };
+        return true;
+    }
+
+    bool ModuleInterface::stringEquals(uint32_t offset, const Utf8String &text) const
+    {
+        uint32_t length = word(offset);
+        return offset != 0 && length == text.byteLength() && (uint64_t) offset + sizeof(uint32_t) + length <= size
+            && std::memcmp(data + offset + sizeof(uint32_t), text.c_str(), length) == 0;
+    }
+
+    uint32_t ModuleInterface::functionCount() const
+    {
+        return word(16);
+    }
+
+    bool ModuleInterface::findFunction(const Utf8String &functionName, InterfaceFunction &function) const
+    {
+        uint32_t hash = hashName(functionName.c_str(), functionName.byteLength());
+        uint32_t slot = hash & (slotCount - 1);
+        for (uint32_t probes = 0; probes < slotCount; ++probes, slot = (slot + 1) & (slotCount - 1))
+        {
+            uint32_t slotOffset = (HEADER_WORDS + 2 * slot) * sizeof(uint32_t);
+            uint32_t offset = word(slotOffset + sizeof(uint32_t));
+            if (offset == 0)
+                return false;
+            if (word(slotOffset) != hash || !stringEquals(word(offset), functionName))
+                continue;
+
+            function.name = functionName;
+            uint32_t parameterCount = word(offset + 12);
+            if (!readString(word(offset + 4), function.returnTypeName)
+                || (uint64_t) offset + (FUNCTION_WORDS + PARAMETER_WORDS * (uint64_t) parameterCount) * sizeof(uint32_t) > size)
+                return false;
+            function.attributes = word(offset + 8) & EXPORTED_ATTRIBUTES;
+            function.parameters.resize(parameterCount);
+            uint32_t parameterOffset = offset + FUNCTION_WORDS * sizeof(uint32_t);
+            for (InterfaceParameter &parameter : function.parameters)
+            {
+                if (!readString(word(parameterOffset), parameter.name) || !readString(word(parameterOffset + 4), parameter.typeName))
+                    return false;
+                parameter.arraySize = word(parameterOffset + 8);
+                parameterOffset += PARAMETER_WORDS * sizeof(uint32_t);
+            }
+            return true;
+        }
+        return false;
+    }
+
+}
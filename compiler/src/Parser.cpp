@@ -1,6 +1,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <typeinfo>
 #include "Parser.h"
 #include <ast/Literal.h>
@@ -13,10 +14,30 @@ using namespace px::ast;
 
 namespace px {
 
-    Parser::Parser(ErrorLog *errorLog) : errors{ errorLog }
+    Parser::Parser(ErrorLog *errorLog) : errors{ errorLog }, pipelineThreshold{ defaultPipelineThreshold() }
     {
     }
 
+    void Parser::skipBodies(const BodyFilter &skip)
+    {
+        skipBody = skip;
+    }
+
+    size_t Parser::defaultPipelineThreshold()
+    {
+        return std::thread::hardware_concurrency() > 1 ? PIPELINE_THRESHOLD : SIZE_MAX;
+    }
+
+    void Parser::pipelineFrom(size_t bytes)
+    {
+        pipelineThreshold = bytes;
+    }
+
+    bool Parser::pipelines(const Utf8String &source) const
+    {
+        return source.byteLength() >= pipelineThreshold;
+    }
+
     void Parser::accept()
     {
         scanner->accept();
@@ -57,9 +78,30 @@ namespace px {
 
     std::unique_ptr<ast::Module> Parser::parse(const Utf8String &fileName, std::istream &in)
     {
-        Utf8String source = readFile(in);
+        return parse(fileName, readFile(in));
+    }
 
+    std::unique_ptr<ast::Module> Parser::parse(const Utf8String &fileName, const Utf8String &source)
+    {
+        scanner.reset(new Scanner(fileName, source, pipelines(source)));
+        std::unique_ptr<Module> module = parseModuleHeader(fileName);
+        parseModuleStatements(*module);
+        return module;
+    }
+
+    std::unique_ptr<ast::Module> Parser::parseHeader(const Utf8String &fileName, std::istream &in)
+    {
+        return parseHeader(fileName, readFile(in));
+    }
+
+    std::unique_ptr<ast::Module> Parser::parseHeader(const Utf8String &fileName, const Utf8String &source)
+    {
         scanner.reset(new Scanner(fileName, source));
+        return parseModuleHeader(fileName);
+    }
+
+    std::unique_ptr<ast::Module> Parser::parseModuleHeader(const Utf8String &fileName)
+    {
         currentToken.reset(new Token(scanner->nextToken()));
 
         auto startPosition = currentToken->position;
@@ -69,19 +111,40 @@ namespace px {
         expect(TokenType::OP_END_STATEMENT);
 
         std::unique_ptr<Module> module = std::make_unique<ast::Module>(startPosition, moduleName, fileName);
+        // Imports come before everything else
+        while (currentToken->type == TokenType::KW_IMPORT)
+        {
+            auto importPosition = currentToken->position;
+            accept();
+            Utf8String importName = currentToken->str;
+            expect(TokenType::IDENTIFIER);
+            expect(TokenType::OP_END_STATEMENT);
+            module->imports.emplace_back(importPosition, importName);
+        }
+        return module;
+    }
 
+    std::unique_ptr<ast::Module> Parser::parseStatements(const Utf8String &fileName, const Utf8String &source)
+    {
+        scanner.reset(new Scanner(fileName, source));
+        currentToken.reset(new Token(scanner->nextToken()));
+
+        // An input has no module header, so it is named after the file
+        std::unique_ptr<Module> module = std::make_unique<ast::Module>(currentToken->position, fileName, fileName);
+        parseModuleStatements(*module);
+        return module;
+    }
+
+    void Parser::parseModuleStatements(ast::Module &module)
+    {
         while (currentToken->type != TokenType::END_FILE && currentToken->type != TokenType::BAD)
         {
             //std::cout << "Parsing statement " << statements.size() << std::endl;
             std::unique_ptr<Statement> statement = parseStatement();
 
             //	std::cout << "Adding statement " << typeid(*statement).name() << std::endl;
-            module->addStatement(std::move(statement));
+            module.addStatement(std::move(statement));
         }
-
-        //std::cout << "Statements :" << statements.size() << std::endl;;
-        return module;
-
     }
 
     std::unique_ptr<Statement> Parser::parseStatement()
@@ -96,11 +159,22 @@ namespace px {
                 return parseDoWhileStatement();
             case TokenType::KW_EXTERN:
             case TokenType::KW_FUNC:
+            case TokenType::KW_PRIVATE:
+            case TokenType::KW_PROTECTED:
+            case TokenType::KW_PUBLIC:
                 return parseFunctionDeclaration();
+            case TokenType::KW_FOR:
+                return parseForStatement();
             case TokenType::KW_IF:
                 return parseIfStatement();
+            case TokenType::KW_PARALLEL:
+                return parseForStatement();
+            case TokenType::KW_REGION:
+                return parseRegionStatement();
             case TokenType::KW_RETURN:
                 return parseReturnStatement();
+            case TokenType::KW_SWITCH:
+                return parseSwitchStatement();
             case TokenType::KW_WHILE:
                 return parseWhileStatement();
             case TokenType::LBRACKET:
@@ -117,9 +191,15 @@ namespace px {
                 {
                     bool hasArrayRef = false;
                     if(next.type == TokenType::LSQUARE_BRACKET) {
+                        // The index may itself index into an array, as in counts[values[i]] += 1
+                        int depth = 1;
                         do {
                             next = scanner->nextToken();
-                        } while(next.type != TokenType::RSQUARE_BRACKET);
+                            if (next.type == TokenType::LSQUARE_BRACKET)
+                                ++depth;
+                            else if (next.type == TokenType::RSQUARE_BRACKET)
+                                --depth;
+                        } while(depth != 0 && next.type != TokenType::END_FILE);
                         next = scanner->nextToken();
                         hasArrayRef = true;
                     }
@@ -183,6 +263,38 @@ namespace px {
         return block;
     }
 
+    // Scans to the end of the block, and goes back to its start when skipBody wants it parsed after all.
+    // The tokens are taken from the scanner as they are, without the copies accept makes.
+    bool Parser::skipBlockStatement(const ast::FunctionPrototype &prototype, const SourcePosition &start)
+    {
+        if (currentToken->type != TokenType::LBRACKET)
+            return false;
+        Scanner::State blockStart = scanner->save();
+        size_t depth = 0;
+        size_t end = 0;
+        const Token *token = currentToken.get();
+        do
+        {
+            if (token->type == TokenType::LBRACKET)
+                ++depth;
+            else if (token->type == TokenType::RBRACKET)
+                --depth;
+            else if (token->type == TokenType::END_FILE || token->type == TokenType::BAD)
+                break;
+            end = token->position.fileOffset + 1;
+            scanner->accept();
+            token = &scanner->nextToken();
+        } while (depth > 0);
+
+        if (depth == 0 && skipBody(prototype, start.fileOffset, end))
+        {
+            currentToken.reset(new Token(*token));
+            return true;
+        }
+        scanner->restore(blockStart);
+        return false;
+    }
+
     std::unique_ptr<ast::BreakStatement> Parser::parseBreakStatement()
     {
         SourcePosition start = currentToken->position;
@@ -214,6 +326,27 @@ namespace px {
         return std::make_unique<DoWhileStatement>(startPos, std::move(condition), std::move(body));
     }
 
+    std::unique_ptr<ast::ForStatement> Parser::parseForStatement()
+    {
+        auto startPos = currentToken->position;
+        bool parallel = accept(TokenType::KW_PARALLEL);
+        expect(TokenType::KW_FOR);
+        Utf8String name = currentToken->str;
+        expect(TokenType::IDENTIFIER);
+        Utf8String typeName;
+        if (accept(TokenType::OP_COLON))
+        {
+            typeName = currentToken->str;
+            expect(TokenType::IDENTIFIER);
+        }
+        expect(TokenType::KW_IN);
+        std::unique_ptr<Expression> start = parseExpression();
+        expect(TokenType::OP_RANGE);
+        std::unique_ptr<Expression> end = parseExpression();
+        std::unique_ptr<Statement> body = parseStatement();
+        return std::make_unique<ForStatement>(startPos, name, typeName, std::move(start), std::move(end), std::move(body), parallel);
+    }
+
     std::unique_ptr<ast::ExpressionStatement> Parser::parseExpressionStatement()
     {
         auto startPos = currentToken->position;
@@ -233,6 +366,11 @@ namespace px {
         }
         else
         {
+            if (skipBody && skipBlockStatement(*prototype, startPos))
+            {
+                auto block = std::make_unique<BlockStatement>(startPos);
+                return std::make_unique<FunctionDefinition>(startPos, std::move(prototype), std::move(block));
+            }
             std::unique_ptr<ast::BlockStatement> block = parseBlockStatement();
             return std::make_unique<FunctionDefinition>(startPos, std::move(prototype), std::move(block));
         }
@@ -241,6 +379,13 @@ namespace px {
 
     std::unique_ptr<ast::FunctionPrototype> Parser::parseFunctionPrototype()
     {
+        Visibility visibility = Visibility::PUBLIC;
+        if (accept(TokenType::KW_PRIVATE))
+            visibility = Visibility::PRIVATE;
+        else if (accept(TokenType::KW_PROTECTED))
+            visibility = Visibility::PROTECTED;
+        else
+            accept(TokenType::KW_PUBLIC);
         bool isExtern = accept(TokenType::KW_EXTERN);
         expect(TokenType::KW_FUNC);
         Utf8String functionName = currentToken->str;
@@ -254,16 +399,34 @@ namespace px {
                 Utf8String argName = currentToken->str;
                 expect(TokenType::IDENTIFIER);
                 expect(TokenType::OP_COLON);
-                Utf8String argTypeName = currentToken->str;
-                expect(TokenType::IDENTIFIER);
-                arguments.push_back({ argName, argTypeName });
+                Utf8String argTypeName = parseTypeName();
+                int64_t *arraySize = nullptr;
+                if (accept(TokenType::LSQUARE_BRACKET))
+                {
+                    if (currentToken->type == TokenType::INTEGER)
+                    {
+                        std::string tokenString = currentToken->str.toString();
+                        arraySize = new int64_t(std::stoll(tokenString, nullptr, currentToken->integerBase));
+                        accept();
+                    }
+                    else
+                    {
+                        argTypeName += "[]";
+                    }
+                    expect(TokenType::RSQUARE_BRACKET);
+                }
+                arguments.push_back({ argName, argTypeName, arraySize });
             } while (accept(TokenType::OP_COMMA));
         }
         expect(TokenType::RPAREN);
         expect(TokenType::OP_COLON);
-        Utf8String returnType = currentToken->str;
-        expect(TokenType::IDENTIFIER);
-        return std::make_unique<FunctionPrototype>(functionName, returnType, arguments, isExtern);
+        Utf8String returnType = parseTypeName();
+        if (accept(TokenType::LSQUARE_BRACKET))
+        {
+            returnType += "[]";
+            expect(TokenType::RSQUARE_BRACKET);
+        }
+        return std::make_unique<FunctionPrototype>(functionName, returnType, arguments, isExtern, visibility);
     }
 
     std::unique_ptr<ast::IfStatement> Parser::parseIfStatement()
@@ -280,6 +443,14 @@ namespace px {
         return std::make_unique<IfStatement>(startPos, std::move(condition), std::move(trueClause), std::move(elseClause));
     }
 
+    std::unique_ptr<ast::RegionStatement> Parser::parseRegionStatement()
+    {
+        auto startPos = currentToken->position;
+        expect(TokenType::KW_REGION);
+        std::unique_ptr<BlockStatement> body = parseBlockStatement();
+        return std::make_unique<RegionStatement>(startPos, std::move(body));
+    }
+
     std::unique_ptr<ReturnStatement> Parser::parseReturnStatement()
     {
         auto startPos = currentToken->position;
@@ -294,6 +465,57 @@ namespace px {
         return std::make_unique<ReturnStatement>(startPos, std::move(retValue));
     }
 
+    std::unique_ptr<ast::SwitchStatement> Parser::parseSwitchStatement()
+    {
+        auto startPos = currentToken->position;
+        expect(TokenType::KW_SWITCH);
+        expect(TokenType::LPAREN);
+        std::unique_ptr<Expression> scrutinee = parseExpression();
+        expect(TokenType::RPAREN);
+        expect(TokenType::LBRACKET);
+
+        std::vector<SwitchCase> cases;
+        std::unique_ptr<BlockStatement> defaultBody = nullptr;
+        while (currentToken->type != TokenType::RBRACKET)
+        {
+            auto casePos = currentToken->position;
+            if (accept(TokenType::KW_DEFAULT))
+            {
+                if (defaultBody)
+                {
+                    compilerError(casePos, "A switch can only have one default case");
+                }
+                expect(TokenType::OP_COLON);
+                defaultBody = parseCaseBody();
+            }
+            else
+            {
+                expect(TokenType::KW_CASE);
+                std::vector<std::unique_ptr<Expression>> values;
+                do
+                {
+                    values.push_back(parseExpression());
+                } while (accept(TokenType::OP_COMMA));
+                expect(TokenType::OP_COLON);
+                cases.emplace_back(casePos, std::move(values), parseCaseBody());
+            }
+        }
+        accept();
+        return std::make_unique<SwitchStatement>(startPos, std::move(scrutinee), std::move(cases), std::move(defaultBody));
+    }
+
+    std::unique_ptr<ast::BlockStatement> Parser::parseCaseBody()
+    {
+        auto startPos = currentToken->position;
+        std::unique_ptr<BlockStatement> block{ new BlockStatement{ startPos } };
+        while (currentToken->type != TokenType::KW_CASE && currentToken->type != TokenType::KW_DEFAULT
+               && currentToken->type != TokenType::RBRACKET)
+        {
+            block->addStatement(parseStatement());
+        }
+        return block;
+    }
+
     std::unique_ptr<ast::WhileStatement> Parser::parseWhileStatement()
     {
         auto startPos = currentToken->position;
@@ -305,6 +527,28 @@ namespace px {
         return std::make_unique<WhileStatement>(startPos, std::move(condition), std::move(body));
     }
 
+    // A type name, where map[K, V] names a map from K to V and future[T] the result of a spawned call
+    Utf8String Parser::parseTypeName()
+    {
+        Utf8String typeName = currentToken->str;
+        expect(TokenType::IDENTIFIER);
+        if (typeName == "map" && accept(TokenType::LSQUARE_BRACKET))
+        {
+            Utf8String keyType = parseTypeName();
+            expect(TokenType::OP_COMMA);
+            Utf8String valueType = parseTypeName();
+            expect(TokenType::RSQUARE_BRACKET);
+            typeName = Utf8String{"map["} + keyType + ", " + valueType + "]";
+        }
+        else if (typeName == "future" && accept(TokenType::LSQUARE_BRACKET))
+        {
+            Utf8String valueType = parseTypeName();
+            expect(TokenType::RSQUARE_BRACKET);
+            typeName = Utf8String{"future["} + valueType + "]";
+        }
+        return typeName;
+    }
+
     std::unique_ptr<VariableDeclaration> Parser::parseVariableDeclaration()
     {
         SourcePosition start = currentToken->position;
@@ -313,14 +557,15 @@ namespace px {
         Utf8String variableName = currentToken->str;
         expect(TokenType::IDENTIFIER);
         expect(TokenType::OP_COLON);
-        Utf8String typeName = currentToken->str;
-        expect(TokenType::IDENTIFIER);
+        Utf8String typeName = parseTypeName();
         if (accept(TokenType::LSQUARE_BRACKET))
         {
             if(currentToken->type == TokenType::INTEGER) {
                 std::string tokenString = currentToken->str.toString();
                 arraySize = new int64_t(std::stoll(tokenString, nullptr, currentToken->integerBase));
                 accept();
+            } else {
+                typeName += "[]";
             }
             expect(TokenType::RSQUARE_BRACKET);
         }
@@ -473,6 +718,19 @@ namespace px {
                 accept();
                 right = parseUnary();
                 result = std::make_unique<UnaryOpExpression>(start, UnaryOperator::CMPL, opType, std::move(right));
+            case TokenType::KW_AWAIT:
+                accept();
+                right = parseUnary();
+                return std::make_unique<AwaitExpression>(start, std::move(right));
+            case TokenType::KW_SPAWN:
+            {
+                accept();
+                right = parseValue();
+                if (right == nullptr || right->nodeType != NodeType::EXP_FUNC_CALL)
+                    compilerError(start, Utf8String{ "Expected a function call after spawn" });
+                std::unique_ptr<FunctionCallExpression> call{ (FunctionCallExpression*) right.release() };
+                return std::make_unique<SpawnExpression>(start, std::move(call));
+            }
             case TokenType::LPAREN:
             {
                 accept();
@@ -0,0 +1,62 @@
+
+#include "CompileServer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+//===----------------------------------------------------------------------===//
+// pxc-client: has a running pxc --server compile, taking the same arguments as pxc.
+//   pxc-client [--socket=path] arguments...
+//   pxc-client [--socket=path] --stop
+//===----------------------------------------------------------------------===//
+
+int main(int argc, char **argv)
+{
+    std::string socketPath = px::CompileServer::defaultSocketPath();
+    std::vector<std::string> arguments;
+    bool stop = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arguments.empty() && arg.compare(0, 9, "--socket=") == 0)
+            socketPath = arg.substr(9);
+        else if (arguments.empty() && arg == "--stop")
+            stop = true;
+        else
+            arguments.push_back(arg);
+    }
+
+    if (stop)
+    {
+        if (!px::CompileServer::stop(socketPath))
+        {
+            std::cerr << "No pxc --server is listening on " << socketPath << std::endl;
+            return -5;
+        }
+        return 0;
+    }
+
+    std::string directory = ".";
+#if !defined(_WIN32)
+    char *current = getcwd(nullptr, 0);
+    if (current != nullptr)
+        directory = current;
+    std::free(current);
+#endif
+    px::CompileReply reply;
+    if (!px::CompileServer::request(socketPath, directory, arguments, reply))
+    {
+        std::cerr << "No pxc --server is listening on " << socketPath << std::endl;
+        return -5;
+    }
+    std::fwrite(reply.out.data(), 1, reply.out.size(), stdout);
+    std::fwrite(reply.err.data(), 1, reply.err.size(), stderr);
+    return reply.exitCode;
+}
@@ -1,20 +1,70 @@
 
 #include "Parser.h"
+#include "AstCache.h"
 #include "Error.h"
+#include "CompileServer.h"
 #include "ContextAnalyzer.h"
+#include "IncrementalCompiler.h"
+#include "ModuleInterface.h"
+#include "Watcher.h"
 #include "cg/CCompiler.h"
+#include "opt/Inliner.h"
+#include "vm/BytecodeCompiler.h"
+#include "vm/Interpreter.h"
+#include "vm/Repl.h"
+#include "vm/TieredCompiler.h"
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#if defined(_WIN32)
+#include <io.h>
+#define isatty _isatty
+#define STDIN_FILENO 0
+#else
+#include <unistd.h>
+#endif
 
 using namespace px;
 
+// The interface of moduleName, which is looked for next to the modules importing it
+static std::string interfacePath(const px::Utf8String &fileName, const px::Utf8String &moduleName)
+{
+    std::string path = fileName.toString();
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string{} : path.substr(0, slash + 1)) + moduleName.toString() + ".pxi";
+}
+
+// Other modules import a module through its interface, written next to it
+static void writeInterface(const px::Utf8String &fileName, const px::Utf8String &moduleName, px::Scope *moduleScope)
+{
+    std::string path = interfacePath(fileName, moduleName);
+    if (!px::ModuleInterface::write(path, moduleName, px::ModuleInterface::exports(*moduleScope->symbols())))
+        std::cerr << "Could not write " << path << std::endl;
+}
+
+// What the server needs to know of a module it compiled: the interfaces it imported and the files
+// it wrote
+static void recordModule(px::CompileRecord *record, const px::Utf8String &fileName, const px::ast::Module &module)
+{
+    if (record == nullptr)
+        return;
+    for (auto &import : module.imports)
+        record->inputs.push_back(interfacePath(fileName, import.moduleName));
+    record->outputs.push_back(fileName.toString() + ".c");
+    record->outputs.push_back(interfacePath(fileName, module.moduleName));
+}
+
 //===----------------------------------------------------------------------===//
 // Main driver code.
 //===----------------------------------------------------------------------===//
 
-int main(int argc, char **argv)
+// Compiles as pxc does with arguments. pxc --server passes record, to learn which files the compile
+// depends on, and interfaces, to keep the imported interfaces between compiles.
+static int compile(const std::vector<std::string> &arguments, px::CompileRecord *record, px::InterfaceCache *interfaces)
 {
-    if (argc < 2)
+    if (arguments.empty())
     {
         std::cerr << "No filename given" << std::endl;
         return -1;
@@ -22,28 +72,197 @@ int main(int argc, char **argv)
 
     //std::cout << "Building Symbol Table " << std::endl;
 
-    for (size_t i = 1; i < argc; i++) {
+    // The server has no terminal of the client's to read from or run a program on
+    if (record != nullptr && (arguments[0] == "repl" || arguments[0] == "run"))
+    {
+        std::cerr << "pxc " << arguments[0] << " can not be served by pxc --server" << std::endl;
+        return -1;
+    }
+
+    // pxc repl reads statements from standard input and runs each as it is read
+    if (arguments[0] == "repl")
+    {
+        px::Repl repl;
+        repl.run(std::cin, isatty(STDIN_FILENO) != 0);
+        return 0;
+    }
+
+    // pxc run file.px interprets the module instead of writing C for it
+    bool run = arguments[0] == "run";
+    bool inlining = true;
+    bool inlineReport = false;
+    size_t inlineThreshold = px::Inliner::DEFAULT_THRESHOLD;
+    bool tiered = false;
+    bool tierReport = false;
+    uint32_t tierThreshold = px::TieredCompiler::DEFAULT_THRESHOLD;
+    bool incremental = false;
+    bool incrementalReport = false;
+    bool astCache = false;
+    bool astCacheReport = false;
+    size_t pipelineThreshold = px::Parser::defaultPipelineThreshold();
+    bool parseReport = false;
+    bool watch = false;
+    unsigned debounce = px::Watcher::DEFAULT_DEBOUNCE;
+    std::vector<std::string> files;
+    std::vector<std::string> options;
+    for (size_t i = run ? 1 : 0; i < arguments.size(); i++) {
+        const std::string &arg = arguments[i];
+        if (arg == "--watch")
+            watch = true;
+        else if (arg.compare(0, 11, "--debounce=") == 0)
+            debounce = (unsigned) std::stoul(arg.substr(11));
+        else if (arg.compare(0, 2, "--") == 0)
+            options.push_back(arg);
+        else
+            files.push_back(arg);
+
+        if (arg == "--no-inline")
+            inlining = false;
+        else if (arg == "--inline-report")
+            inlineReport = true;
+        else if (arg.compare(0, 19, "--inline-threshold=") == 0)
+            inlineThreshold = std::stoul(arg.substr(19));
+        else if (arg == "--tiered")
+            tiered = true;
+        else if (arg == "--tier-report")
+            tierReport = true;
+        else if (arg.compare(0, 17, "--tier-threshold=") == 0)
+            tierThreshold = (uint32_t) std::stoul(arg.substr(17));
+        else if (arg == "--incremental")
+            incremental = true;
+        else if (arg == "--incremental-report")
+            incremental = incrementalReport = true;
+        else if (arg == "--ast-cache")
+            astCache = true;
+        else if (arg == "--ast-cache-report")
+            astCache = astCacheReport = true;
+        else if (arg.compare(0, 21, "--pipeline-threshold=") == 0)
+            pipelineThreshold = std::stoul(arg.substr(21));
+        else if (arg == "--parse-report")
+            parseReport = true;
+    }
+
+    // pxc --watch dir compiles the modules in dir again as they change, each with the other options
+    if (watch)
+    {
+        if (run || record != nullptr || files.size() != 1)
+        {
+            std::cerr << "pxc --watch takes one directory, and can not run a module or be served" << std::endl;
+            return -1;
+        }
+        px::InterfaceCache cache;
+        px::Watcher watcher{ files[0], debounce, [&](const std::string &path) {
+            std::vector<std::string> request = options;
+            request.push_back(path);
+            return compile(request, nullptr, &cache) == 0;
+        }, std::cout };
+        if (!watcher.start())
+            return -1;
+        watcher.run();
+        return 0;
+    }
+
+    for (const std::string &fileArg : files) {
+        if (record != nullptr)
+            record->inputs.push_back(fileArg);
+        // pxc --incremental file.px only generates the functions an edit affected again
+        if (incremental && !run)
+        {
+            px::ErrorLog errors;
+            px::IncrementalCompiler compiler{ fileArg, px::IncrementalOptions{ inlining, inlineThreshold, interfaces } };
+            if (!compiler.compile(errors))
+            {
+                errors.output();
+                return -2;
+            }
+            if (incrementalReport)
+                compiler.outputReport();
+            writeInterface(fileArg, compiler.module().moduleName, compiler.moduleScope());
+            recordModule(record, fileArg, compiler.module());
+            if (record != nullptr)
+                record->outputs.push_back(fileArg + ".pxinc");
+            continue;
+        }
+
         px::ScopeTree scopeTree;
         px::ErrorLog errors;
 
-        const char* fileArg = argv[i];
-        px::Utf8String fileName = fileArg;
+        px::Utf8String fileName{ fileArg };
         px::Parser parser{&errors};
+        parser.pipelineFrom(pipelineThreshold);
         std::ifstream fis(fileArg);
         if(!fis.good()) {
             std::cerr << "File " << fileArg << " was not found" << std::endl;
             return -3;
         }
+        // The tiered compiler parses the module again, so it keeps the source
+        std::stringstream source;
+        source << fis.rdbuf();
         std::unique_ptr<px::ast::Module> ast;
-        try {
-            ast = parser.parse(fileName, fis);
+        // pxc --ast-cache keeps the parsed module in file.px.pxast and only parses it again when
+        // its source changed
+        if (astCache)
+        {
+            auto start = std::chrono::steady_clock::now();
+            px::Utf8String text{ source.str() };
+            uint64_t hash = px::AstCache::hash(text);
+            std::string cachePath = fileArg + ".pxast";
+            ast = px::AstCache::read(cachePath, hash, fileName);
+            bool hit = ast != nullptr;
+            if (!hit)
+            {
+                try {
+                    ast = parser.parse(fileName, text);
+                }
+                catch (const px::Error &) {
+                    errors.output();
+                    return -2;
+                }
+                if (!px::AstCache::write(cachePath, hash, *ast))
+                    std::cerr << "Could not write " << cachePath << std::endl;
+            }
+            if (record != nullptr)
+                record->outputs.push_back(cachePath);
+            if (astCacheReport)
+            {
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                char line[128];
+                std::snprintf(line, sizeof(line), "%s: %s in %.1f ms\n", fileArg.c_str(), hit ? "AST loaded from the cache" : "parsed and cached", milliseconds);
+                std::cerr << line;
+            }
         }
-        catch (const px::Error &) {
-            errors.output();
-            return -2;
+        else
+        {
+            px::Utf8String text{ source.str() };
+            auto start = std::chrono::steady_clock::now();
+            try {
+                ast = parser.parse(fileName, text);
+            }
+            catch (const px::Error &) {
+                errors.output();
+                return -2;
+            }
+            // pxc --parse-report prints how long parsing took and whether the module was scanned on
+            // a thread of its own
+            if (parseReport)
+            {
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                char line[128];
+                std::snprintf(line, sizeof(line), "%s: parsed %s in %.1f ms\n", fileArg.c_str(), parser.pipelines(text) ? "pipelined" : "serially", milliseconds);
+                std::cerr << line;
+            }
+        }
+
+        if (inlining)
+        {
+            px::Inliner inliner{ inlineThreshold };
+            inliner.run(*ast);
+            if (inlineReport)
+                inliner.outputReport();
         }
 
         px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+        analyzer.useInterfaces(interfaces);
         analyzer.analyze(*ast);
 
         if (errors.count() > 0)
@@ -52,9 +271,67 @@ int main(int argc, char **argv)
             return -2;
         }
 
+        if (run)
+        {
+            px::BytecodeCompiler compiler{ &scopeTree, &errors };
+            std::unique_ptr<px::Program> program = compiler.compile(*ast);
+            if (errors.count() > 0)
+            {
+                errors.output();
+                return -2;
+            }
+            try {
+                px::Interpreter interpreter{ *program };
+                if (!tiered)
+                    return interpreter.run();
+
+                px::TieringOptions options{ tierThreshold, inlining, inlineThreshold, tierReport };
+                px::TieredCompiler tiers{ *program, interpreter, fileName, source.str(), options };
+                interpreter.setTiering(&tiers, tierThreshold, tierReport);
+                int32_t exitCode = interpreter.run();
+                tiers.stop();
+                if (tierReport)
+                {
+                    pxFlush();
+                    tiers.outputReport();
+                }
+                return exitCode;
+            }
+            catch (const px::StackOverflow &overflow) {
+                std::cerr << overflow.what() << std::endl;
+                return -4;
+            }
+        }
+
         px::CCompiler compiler{ &scopeTree };
         compiler.compile(*ast);
+
+        writeInterface(fileName, ast->moduleName, analyzer.moduleScope());
+        recordModule(record, fileName, *ast);
     }
 
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> arguments{ argv + 1, argv + argc };
+
+    // pxc --server [socket] compiles for pxc-client until it is stopped
+    if (!arguments.empty() && arguments[0] == "--server")
+    {
+        std::string socketPath = arguments.size() > 1 ? arguments[1] : px::CompileServer::defaultSocketPath();
+        px::InterfaceCache interfaces;
+        px::CompileServer server{ socketPath, [&interfaces](const std::vector<std::string> &request, px::CompileRecord &record) {
+            int exitCode = compile(request, &record, &interfaces);
+            u_fflush(u_get_stdout());
+            return exitCode;
+        } };
+        if (!server.listen())
+            return -1;
+        server.run();
+        return 0;
+    }
+
+    return compile(arguments, nullptr, nullptr);
+}
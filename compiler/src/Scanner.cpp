@@ -3,6 +3,11 @@
 
 #include <unicode/uchar.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #define RETURN_OP(tok, length) \
 do { \
     token = current; \
@@ -12,9 +17,10 @@ do { \
 
 namespace px {
 
-    std::unordered_map<Utf8String, TokenType> Scanner::keywords = {
+    const std::unordered_map<Utf8String, TokenType> Scanner::keywords = {
         { "abstract", TokenType::KW_ABSTRACT},
         { "as", TokenType::KW_AS},
+        { "await", TokenType::KW_AWAIT},
         { "break", TokenType::KW_BREAK},
         { "case", TokenType::KW_CASE},
         { "concept", TokenType::KW_CONCEPT},
@@ -28,14 +34,19 @@ namespace px {
         { "func", TokenType::KW_FUNC },
         { "if", TokenType::KW_IF},
         { "implementation", TokenType::KW_IMPLEMENTATION},
+        { "import", TokenType::KW_IMPORT},
+        { "in", TokenType::KW_IN},
         { "interface", TokenType::KW_INTERFACE},
         { "module", TokenType::KW_MODULE},
         { "new", TokenType::KW_NEW},
+        { "parallel", TokenType::KW_PARALLEL},
         { "private", TokenType::KW_PRIVATE},
         { "protected", TokenType::KW_PROTECTED},
         { "public", TokenType::KW_PUBLIC},
         { "ref", TokenType::KW_REF},
+        { "region", TokenType::KW_REGION},
         { "return", TokenType::KW_RETURN},
+        { "spawn", TokenType::KW_SPAWN},
         { "state", TokenType::KW_STATE},
         { "switch", TokenType::KW_SWITCH},
         { "true", TokenType::KW_TRUE},
@@ -43,13 +54,159 @@ namespace px {
         { "while", TokenType::KW_WHILE},
     };
 
-    Scanner::Scanner(const Utf8String &fileName, const Utf8String &code) : source{ code }, length { source.length() }, currentPos{ fileName }, peekPos{ fileName }, peekToken{ peekPos }
+    static const size_t CACHE_LINE = 64;
+    static const size_t NOT_SAVED = SIZE_MAX;
+
+    // Only the producer writes the ring and only the parser reads it: the producer fills the slot at
+    // written and then moves written on, and the parser empties the slots up to written and then
+    // moves read on, so neither waits on a lock, only for the other when the ring is full or empty
+    struct Scanner::Pipeline
+    {
+        static const size_t CAPACITY = 4096;
+
+        Pipeline(const Utf8String &fileName, const Utf8String &source)
+            : scanner{ fileName, source }, slots(CAPACITY), written{ 0 }, read{ 0 }, stopping{ false }
+        {
+        }
+
+        void produce();
+
+        Scanner scanner;
+        std::vector<ScannedToken> slots;
+        alignas(CACHE_LINE) std::atomic<size_t> written;
+        alignas(CACHE_LINE) std::atomic<size_t> read;
+        std::atomic<bool> stopping;
+        std::thread producer;
+    };
+
+    void Scanner::Pipeline::produce()
+    {
+        size_t next = 0;
+        bool last = false;
+        while (!last)
+        {
+            while (next - read.load(std::memory_order_acquire) == CAPACITY)
+            {
+                if (stopping.load(std::memory_order_relaxed))
+                    return;
+                std::this_thread::yield();
+            }
+            if (stopping.load(std::memory_order_relaxed))
+                return;
+            ScannedToken &slot = slots[next % CAPACITY];
+            try {
+                size_t start = scanner.peekPos.fileOffset;
+                Token &token = scanner.nextToken();
+                scanner.accept();
+                const SourcePosition &end = scanner.position();
+                slot.type = token.type;
+                slot.integerBase = token.integerBase;
+                slot.suffixType = token.suffixType;
+                slot.offset = (uint32_t) token.position.fileOffset;
+                slot.line = (uint32_t) token.position.line;
+                slot.column = (uint32_t) token.position.lineColumn;
+                slot.endOffset = (uint32_t) end.fileOffset;
+                slot.endLine = (uint32_t) end.line;
+                slot.endColumn = (uint32_t) end.lineColumn;
+                slot.str = token.str;
+                slot.failure = nullptr;
+                // Scanning again at the end of the file, or at a character that is not scanned,
+                // gives the same token
+                last = token.type == TokenType::END_FILE || (token.type == TokenType::BAD && end.fileOffset == start);
+            }
+            catch (...) {
+                slot.type = TokenType::BAD;
+                slot.failure = std::current_exception();
+                last = true;
+            }
+            slot.last = last;
+            written.store(++next, std::memory_order_release);
+        }
+    }
+
+    Scanner::Scanner(const Utf8String &fileName, const Utf8String &code, bool pipelined)
+        : source{ pipelined ? Utf8String{} : code }, length { source.length() }, currentPos{ fileName }, peekPos{ fileName }, peekToken{ peekPos },
+          windowStart{ 0 }, currentIndex{ 0 }, peekIndex{ 0 }, savedIndex{ NOT_SAVED }
+    {
+        if (pipelined)
+        {
+            pipeline.reset(new Pipeline{ fileName, code });
+            pipeline->producer = std::thread{ &Pipeline::produce, pipeline.get() };
+        }
+    }
+
+    Scanner::~Scanner()
+    {
+        if (pipeline)
+        {
+            pipeline->stopping.store(true, std::memory_order_relaxed);
+            pipeline->producer.join();
+        }
+    }
+
+    // Waits for the token at index, taking all the tokens the producer has scanned by then
+    const Scanner::ScannedToken &Scanner::scanned(size_t index)
+    {
+        while (index >= windowStart + window.size())
+        {
+            size_t read = pipeline->read.load(std::memory_order_relaxed);
+            size_t written = pipeline->written.load(std::memory_order_acquire);
+            if (read == written)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (; read < written; ++read)
+            {
+                // The text is swapped for that of a token dropped before, so the slot and the token
+                // both keep room for text and are filled again without allocating
+                if (spare.empty())
+                    window.emplace_back();
+                else
+                {
+                    window.push_back(std::move(spare.back()));
+                    spare.pop_back();
+                }
+                ScannedToken &slot = pipeline->slots[read % Pipeline::CAPACITY];
+                ScannedToken &token = window.back();
+                std::swap(token.str, slot.str);
+                token.type = slot.type;
+                token.integerBase = slot.integerBase;
+                token.suffixType = slot.suffixType;
+                token.offset = slot.offset;
+                token.line = slot.line;
+                token.column = slot.column;
+                token.endOffset = slot.endOffset;
+                token.endLine = slot.endLine;
+                token.endColumn = slot.endColumn;
+                token.failure = std::move(slot.failure);
+                token.last = slot.last;
+            }
+            pipeline->read.store(read, std::memory_order_release);
+        }
+        return window[index - windowStart];
+    }
+
+    // The tokens before the one at currentPos are not needed again, unless a saved state needs them
+    void Scanner::dropAccepted()
     {
+        size_t needed = std::min(currentIndex, savedIndex);
+        while (windowStart < needed && !window.empty())
+        {
+            spare.push_back(std::move(window.front()));
+            window.pop_front();
+            ++windowStart;
+        }
     }
 
     bool Scanner::accept()
     {
         currentPos.setLocation(peekPos);
+        if (pipeline)
+        {
+            currentIndex = peekIndex;
+            dropAccepted();
+        }
         return true;
     }
 
@@ -78,13 +235,54 @@ namespace px {
     void Scanner::rewind()
     {
         peekPos.setLocation(currentPos);
+        peekIndex = currentIndex;
+    }
+
+    Scanner::State Scanner::save()
+    {
+        savedIndex = currentIndex;
+        return State{ currentPos, peekPos, peekToken, currentIndex, peekIndex };
+    }
+
+    void Scanner::restore(const State &state)
+    {
+        currentPos.setLocation(state.current);
+        peekPos.setLocation(state.peek);
+        peekToken = state.token;
+        currentIndex = state.currentIndex;
+        peekIndex = state.peekIndex;
+        savedIndex = NOT_SAVED;
     }
 
     Token &Scanner::nextToken()
     {
         Token &token = peekToken;
         token.clear();
-        token.type = scan();
+        if (!pipeline)
+        {
+            token.type = scan();
+            return token;
+        }
+
+        const ScannedToken &next = scanned(peekIndex);
+        if (next.failure)
+            std::rethrow_exception(next.failure);
+        token.type = next.type;
+        token.str = next.str;
+        token.suffixType = next.suffixType;
+        token.integerBase = next.integerBase;
+        // The end of the file keeps the position of the token before, as scan leaves it
+        if (next.type != TokenType::END_FILE)
+        {
+            token.position.fileOffset = next.offset;
+            token.position.line = next.line;
+            token.position.lineColumn = next.column;
+        }
+        peekPos.fileOffset = next.endOffset;
+        peekPos.line = next.endLine;
+        peekPos.lineColumn = next.endColumn;
+        if (!next.last)
+            ++peekIndex;
         return token;
     }
 
@@ -187,7 +385,7 @@ namespace px {
             }
 
             bool isFloat = false;
-            if (current == '.')
+            if (current == '.' && peekCharacter() != '.')
             {
                 do
                 {
@@ -400,7 +598,14 @@ namespace px {
                 case ']':	    RETURN_OP(RSQUARE_BRACKET, 1);
                 case ';':	    RETURN_OP(OP_END_STATEMENT, 1);
                 case ',':	    RETURN_OP(OP_COMMA, 1);
-                case '.':	    RETURN_OP(OP_DOT, 1);
+                case '.':
+                {
+                    uint32_t next = peekCharacter();
+                    if (next == '.')
+                        RETURN_OP(OP_RANGE, 2);
+                    else
+                        RETURN_OP(OP_DOT, 1);
+                }
                 case '~':	    RETURN_OP(OP_COMPL, 1);
                 case '^':	    RETURN_OP(OP_BIT_XOR, 1);
                 case '?':	    RETURN_OP(OP_QUESTION, 1);
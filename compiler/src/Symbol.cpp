@@ -1,6 +1,9 @@
 
 #include <Symbol.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace px
 {
     Type * const Type::UNKNOWN{ new Type{ std::string{"<<unknown>>"}, nullptr, 0, Type::NONE } };
@@ -19,4 +22,25 @@ namespace px
     Type * const Type::FLOAT64{ new Type{ std::string{"float64"}, Type::OBJECT, 8, Type::BUILTIN_FLOAT | Type::SEALED} };
     Type * const Type::CHAR{ new Type{ std::string{"char"}, Type::OBJECT, 4, Type::BUILTIN_CHAR | Type::SEALED } };
     Type * const Type::STRING{ new Type{ std::string{"string"}, Type::OBJECT, 4, Type::BUILTIN_STRING | Type::SEALED} };
+    Type * const Type::STRING_BUILDER{ new Type{ std::string{"StringBuilder"}, Type::OBJECT, sizeof(void*), Type::BUILTIN_STRING_BUILDER | Type::SEALED} };
+
+    bool Type::holdsRegionMemory() const
+    {
+        if (isArray())
+            return ((const ArrayType*) this)->elementType->holdsRegionMemory();
+        return isString() || isStringBuilder() || isContainer();
+    }
+
+    bool Type::isPredefined() const
+    {
+        static const Type * const predefined[] = { UNKNOWN, OBJECT, VOID, BOOL, INT8, INT16, INT32, INT64, UINT8, UINT16,
+                                                   UINT32, UINT64, FLOAT32, FLOAT64, CHAR, STRING, STRING_BUILDER };
+        return std::find(std::begin(predefined), std::end(predefined), this) != std::end(predefined);
+    }
+
+    Function::~Function()
+    {
+        for (Variable *parameter : parameters)
+            delete parameter;
+    }
 }
@@ -4,7 +4,7 @@
 namespace px
 {
 
-    std::unordered_map<TokenType, const Utf8String> Token::tokenNames = {
+    const std::unordered_map<TokenType, const Utf8String> Token::tokenNames = {
         { TokenType::BAD, "bad token" },
         { TokenType::IDENTIFIER, "identifer" },
         { TokenType::INTEGER, "integer literal" },
@@ -13,6 +13,7 @@ namespace px
         { TokenType::STRING, "string literal" },
         { TokenType::KW_ABSTRACT, "abstract" },
         { TokenType::KW_AS, "as" },
+        { TokenType::KW_AWAIT, "await" },
         { TokenType::KW_BREAK, "break" },
         { TokenType::KW_CASE, "case" },
         { TokenType::KW_CONCEPT, "concept" },
@@ -26,14 +27,19 @@ namespace px
         { TokenType::KW_FUNC, "func" },
         { TokenType::KW_IF , "if" },
         { TokenType::KW_IMPLEMENTATION, "implementation" },
+        { TokenType::KW_IMPORT, "import" },
+        { TokenType::KW_IN, "in" },
         { TokenType::KW_INTERFACE, "interface" },
         { TokenType::KW_MODULE, "module" },
         { TokenType::KW_NEW , "new" },
+        { TokenType::KW_PARALLEL, "parallel" },
         { TokenType::KW_PRIVATE, "private" },
         { TokenType::KW_PROTECTED, "protected" },
         { TokenType::KW_PUBLIC, "public" },
         { TokenType::KW_REF, "ref" },
+        { TokenType::KW_REGION, "region" },
         { TokenType::KW_RETURN, "return" },
+        { TokenType::KW_SPAWN, "spawn" },
         { TokenType::KW_STATE, "state" },
         { TokenType::KW_SWITCH, "switch" },
         { TokenType::KW_TRUE, "true" },
@@ -72,6 +78,7 @@ namespace px
         { TokenType::OP_NOT_EQUAL, "!=" },
         { TokenType::OP_OR, "||" },
         { TokenType::OP_QUESTION, "?" },
+        { TokenType::OP_RANGE, ".." },
         { TokenType::OP_RIGHT_SHIFT, ">>" },
         { TokenType::OP_STAR, "*" },
         { TokenType::OP_SUB, "-" },
@@ -84,7 +91,7 @@ namespace px
         {
             return it->second;
         }
-        return tokenNames[TokenType::BAD];
+        return tokenNames.at(TokenType::BAD);
     }
 }
 
@@ -0,0 +1,279 @@
+#include "Watcher.h"
+
+#include "Error.h"
+#include "Parser.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace px {
+
+    static bool isModuleFile(const std::string &name)
+    {
+        return name.size() > 3 && name.compare(name.size() - 3, 3, ".px") == 0;
+    }
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    Watcher::Watcher(const std::string &watched, unsigned debounceMilliseconds, const CompileFunction &compileModule, std::ostream &output)
+        : directory{ watched }, debounce{ debounceMilliseconds }, compile{ compileModule }, log(output), notify{ -1 }
+    {
+    }
+
+    std::string Watcher::path(const std::string &name) const
+    {
+        return directory + "/" + name;
+    }
+
+    // The interface is written next to the module, as pxc does
+    std::string Watcher::readInterface(const Utf8String &moduleName) const
+    {
+        if (moduleName.byteLength() == 0)
+            return std::string{};
+        std::ifstream in{ path(moduleName.toString() + ".pxi"), std::ios::binary };
+        std::stringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    // Imported modules come before the modules importing them. A module imported from outside the
+    // directory, or one in a cycle, does not hold anything up.
+    std::vector<std::string> Watcher::buildOrder() const
+    {
+        std::unordered_map<Utf8String, std::string> modules;
+        for (auto &file : files)
+        {
+            if (file.second.moduleName.byteLength() > 0)
+                modules[file.second.moduleName] = file.first;
+        }
+        std::vector<std::string> order;
+        std::set<std::string> visited;
+        std::function<void(const std::string&)> visit = [&](const std::string &name) {
+            if (!visited.insert(name).second)
+                return;
+            for (auto &import : files.at(name).imports)
+            {
+                auto imported = modules.find(import);
+                if (imported != modules.end())
+                    visit(imported->second);
+            }
+            order.push_back(name);
+        };
+        for (auto &file : files)
+            visit(file.first);
+        return order;
+    }
+
+    std::vector<std::string> Watcher::rebuild(const std::set<std::string> &changed, std::chrono::steady_clock::time_point firstChange, bool initial)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::set<std::string> dirty;
+        for (auto &name : changed)
+        {
+            std::ifstream in{ path(name), std::ios::binary };
+            if (!in.good())
+            {
+                files.erase(name);
+                continue;
+            }
+            std::stringstream contents;
+            contents << in.rdbuf();
+            std::string text = contents.str();
+            uint64_t hash = 14695981039346656037ull;
+            for (char c : text)
+            {
+                hash ^= (uint8_t) c;
+                hash *= 1099511628211ull;
+            }
+            auto file = files.find(name);
+            if (file != files.end() && file->second.hash == hash)
+                continue;
+
+            WatchedFile &watched = files[name];
+            watched.hash = hash;
+            watched.moduleName = Utf8String{};
+            watched.imports.clear();
+            ErrorLog errors;
+            Parser parser{ &errors };
+            Utf8String fileName{ path(name) };
+            try {
+                auto header = parser.parseHeader(fileName, Utf8String{ text });
+                watched.moduleName = header->moduleName;
+                for (auto &import : header->imports)
+                    watched.imports.push_back(import.moduleName);
+            }
+            catch (const Error &) {
+                // The compile reports it
+            }
+            dirty.insert(name);
+        }
+
+        std::vector<std::string> compiled;
+        std::vector<std::string> failed;
+        for (auto &name : buildOrder())
+        {
+            if (dirty.count(name) == 0)
+                continue;
+            WatchedFile &watched = files[name];
+            if (!compile(path(name)))
+                failed.push_back(name);
+            compiled.push_back(name);
+
+            std::string interface = readInterface(watched.moduleName);
+            if (interface == watched.interface)
+                continue;
+            watched.interface = interface;
+            for (auto &file : files)
+            {
+                auto &imports = file.second.imports;
+                if (std::find(imports.begin(), imports.end(), watched.moduleName) != imports.end())
+                    dirty.insert(file.first);
+            }
+        }
+
+        if (!compiled.empty())
+        {
+            bool first = true;
+            for (auto &name : compiled)
+            {
+                if (std::find(failed.begin(), failed.end(), name) != failed.end())
+                    continue;
+                log << (first ? "Compiled " : ", ") << name;
+                first = false;
+            }
+            for (size_t i = 0; i < failed.size(); ++i)
+                log << (i > 0 ? ", " : first ? "" : "; ") << failed[i];
+            if (!failed.empty())
+                log << " failed";
+            char times[96];
+            if (initial)
+                std::snprintf(times, sizeof(times), " in %.1f ms", millisecondsSince(start));
+            else
+                std::snprintf(times, sizeof(times), " in %.1f ms, %.1f ms after the first change", millisecondsSince(start),
+                              millisecondsSince(firstChange));
+            log << times << std::endl;
+        }
+        return compiled;
+    }
+
+#if defined(__linux__)
+
+    Watcher::~Watcher()
+    {
+        if (notify >= 0)
+            close(notify);
+    }
+
+    bool Watcher::start()
+    {
+        notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify < 0 || inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)
+        {
+            log << "Could not watch " << directory << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        std::set<std::string> all;
+        DIR *entries = opendir(directory.c_str());
+        if (entries == nullptr)
+        {
+            log << "Could not read " << directory << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        while (dirent *entry = readdir(entries))
+        {
+            struct stat status;
+            std::string name = entry->d_name;
+            if (isModuleFile(name) && stat(path(name).c_str(), &status) == 0 && S_ISREG(status.st_mode))
+                all.insert(name);
+        }
+        closedir(entries);
+        rebuild(all, std::chrono::steady_clock::now(), true);
+        return true;
+    }
+
+    // Gives whether there were any events, adding the module files they name to changed
+    bool Watcher::readEvents(std::set<std::string> &changed)
+    {
+        alignas(inotify_event) char buffer[16384];
+        bool any = false;
+        ssize_t length;
+        while ((length = read(notify, buffer, sizeof(buffer))) > 0)
+        {
+            any = true;
+            for (char *next = buffer; next < buffer + length; )
+            {
+                auto event = (inotify_event*) next;
+                if (event->len > 0 && isModuleFile(event->name))
+                    changed.insert(event->name);
+                next += sizeof(inotify_event) + event->len;
+            }
+        }
+        return any;
+    }
+
+    std::vector<std::string> Watcher::waitAndRebuild(int timeout)
+    {
+        pollfd waiting{ notify, POLLIN, 0 };
+        if (poll(&waiting, 1, timeout) <= 0)
+            return std::vector<std::string>{};
+        auto firstChange = std::chrono::steady_clock::now();
+        std::set<std::string> changed;
+        readEvents(changed);
+        // The burst is over once nothing happens for the debounce time
+        while (poll(&waiting, 1, (int) debounce) > 0 && readEvents(changed))
+        {
+        }
+        return rebuild(changed, firstChange, false);
+    }
+
+    void Watcher::run()
+    {
+        while (true)
+            waitAndRebuild(-1);
+    }
+
+#else
+
+    Watcher::~Watcher()
+    {
+    }
+
+    bool Watcher::start()
+    {
+        log << "pxc --watch needs inotify" << std::endl;
+        return false;
+    }
+
+    bool Watcher::readEvents(std::set<std::string> &changed)
+    {
+        return false;
+    }
+
+    std::vector<std::string> Watcher::waitAndRebuild(int timeout)
+    {
+        return std::vector<std::string>{};
+    }
+
+    void Watcher::run()
+    {
+    }
+
+#endif
+
+}
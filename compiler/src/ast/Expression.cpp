@@ -8,12 +8,16 @@ namespace px
     {
         void *ArrayIndexReference::accept(Visitor &visitor) { return visitor.visit(*this); }
 
+        void *AwaitExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
+
         void *BinaryOpExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
 
         void *CastExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
 
         void *FunctionCallExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
 
+        void *SpawnExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
+
         void *TernaryOpExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
 
         void *UnaryOpExpression::accept(Visitor &visitor) { return visitor.visit(*this); }
@@ -0,0 +1,228 @@
+
+#include <ast/RecursiveVisitor.h>
+
+namespace px
+{
+    namespace ast
+    {
+        void RecursiveVisitor::traverse(std::unique_ptr<Expression> &expression)
+        {
+            expression->accept(*this);
+        }
+
+        void RecursiveVisitor::traverse(std::unique_ptr<Statement> &statement)
+        {
+            statement->accept(*this);
+        }
+
+        void *RecursiveVisitor::visit(ArrayIndexReference &a)
+        {
+            traverse(a.array);
+            traverse(a.index);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(ArrayLiteral &a)
+        {
+            for (auto &value : a.values)
+                traverse(value);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(ArrayIndexAssignmentStatement &a)
+        {
+            traverse(a.reference);
+            traverse(a.expression);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(AssignmentStatement &a)
+        {
+            traverse(a.expression);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(AwaitExpression &a)
+        {
+            traverse(a.future);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(BinaryOpExpression &b)
+        {
+            traverse(b.left);
+            traverse(b.right);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(BlockStatement &s)
+        {
+            for (auto &statement : s.statements)
+                traverse(statement);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(BoolLiteral &b)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(BreakStatement &b)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(CastExpression &c)
+        {
+            traverse(c.expression);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(CharLiteral &c)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(ContinueStatement &c)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(DoWhileStatement &d)
+        {
+            traverse(d.body);
+            traverse(d.condition);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(ExpressionStatement &s)
+        {
+            traverse(s.expression);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(FloatLiteral &f)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(ForStatement &f)
+        {
+            traverse(f.start);
+            traverse(f.end);
+            traverse(f.body);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(FunctionCallExpression &f)
+        {
+            for (auto &argument : f.arguments)
+                traverse(argument);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(FunctionDeclaration &f)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(FunctionDefinition &f)
+        {
+            f.block->accept(*this);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(IfStatement &i)
+        {
+            traverse(i.condition);
+            traverse(i.trueStatement);
+            if (i.elseStatement)
+                traverse(i.elseStatement);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(IntegerLiteral &i)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(Module &m)
+        {
+            for (auto &statement : m.statements)
+                traverse(statement);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(RegionStatement &r)
+        {
+            r.body->accept(*this);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(ReturnStatement &s)
+        {
+            if (s.returnValue)
+                traverse(s.returnValue);
+            return nullptr;
+        }
+
+        // The call itself is not passed to traverse, since a spawned call can only be replaced by another call
+        void *RecursiveVisitor::visit(SpawnExpression &s)
+        {
+            s.call->accept(*this);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(StringLiteral &s)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(SwitchStatement &s)
+        {
+            traverse(s.scrutinee);
+            for (auto &switchCase : s.cases)
+            {
+                for (auto &value : switchCase.values)
+                    traverse(value);
+                switchCase.body->accept(*this);
+            }
+            if (s.defaultBody)
+                s.defaultBody->accept(*this);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(TernaryOpExpression &t)
+        {
+            traverse(t.condition);
+            traverse(t.trueExpr);
+            traverse(t.falseExpr);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(UnaryOpExpression &u)
+        {
+            traverse(u.expression);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(VariableDeclaration &v)
+        {
+            if (v.initialValue)
+                traverse(v.initialValue);
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(VariableExpression &v)
+        {
+            return nullptr;
+        }
+
+        void *RecursiveVisitor::visit(WhileStatement &w)
+        {
+            traverse(w.condition);
+            traverse(w.body);
+            return nullptr;
+        }
+    }
+}
@@ -18,12 +18,18 @@ namespace px
 
         void *DoWhileStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
 
+        void *ForStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
+
         void *IfStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
 
         void *ExpressionStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
 
+        void *RegionStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
+
         void *ReturnStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
 
+        void *SwitchStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
+
         void *WhileStatement::accept(Visitor &visitor) { return visitor.visit(*this); }
     }
 }
@@ -1,14 +1,21 @@
 #include "cg/CCompiler.h"
+#include "ast/RecursiveVisitor.h"
 #include "IO.h"
 #include "Token.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <functional>
 #include <iostream>
 
 namespace px
 {
 
-    CCompiler::CCompiler(ScopeTree *tree) : currentFunction{ nullptr }, scopeTree{ tree }, indentLevel{}
+    // PX_STRING_INLINE_CAPACITY in PxRuntime.h
+    static const size_t STRING_INLINE_CAPACITY = 15;
+
+    CCompiler::CCompiler(ScopeTree *tree) : indentLevel{}, parallelCount{}, regionDepth{}, switchCount{}, forCount{}, currentFunction{ nullptr }, onlyFunctions{ nullptr },
+                                            writeFile{ true }, fragments{ nullptr }, reusedFragments{ nullptr }, fragmentMaps{ nullptr }, scopeTree{ tree }
     {
         currentScope = tree->current();
     }
@@ -61,6 +68,12 @@ namespace px
             return "int32_t";
         else if (pxType->isString())
             return "PxString";
+        else if (pxType->isStringBuilder())
+            return "PxStringBuilder*";
+        else if (pxType->isDynamicArray())
+            return "PxVector";
+        else if (pxType->isMap())
+            return "PxMap";
 
         return "";
     }
@@ -107,16 +120,361 @@ namespace px
         ast.accept(*this);
     }
 
+    Utf8String CCompiler::compileToString(ast::Module &module)
+    {
+        writeFile = false;
+        module.accept(*this);
+        writeFile = true;
+        return code;
+    }
+
+    Utf8String CCompiler::compileFunctions(ast::Module &module, const std::unordered_set<Utf8String> &functions)
+    {
+        onlyFunctions = &functions;
+        module.accept(*this);
+        onlyFunctions = nullptr;
+        return code;
+    }
+
+    void CCompiler::compileFragments(std::unordered_map<Utf8String, FunctionFragment> *functionFragments, const std::unordered_set<Utf8String> *reused)
+    {
+        fragments = functionFragments;
+        reusedFragments = reused;
+    }
+
+    Utf8String CCompiler::render(ast::AST &node)
+    {
+        // The code so far is swapped out rather than copied, which would take as long as the module
+        Utf8String outer;
+        swap(outer, code);
+        node.accept(*this);
+        swap(outer, code);
+        return outer;
+    }
+
+    static Utf8String escapeCString(const Utf8String &text)
+    {
+        std::string escaped;
+        const char *bytes = text.c_str();
+        for (size_t i = 0; i < text.byteLength(); ++i)
+        {
+            unsigned char c = bytes[i];
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (c < 0x20 || c == 0x7F)
+            {
+                char octal[5];
+                snprintf(octal, sizeof(octal), "\\%03o", c);
+                escaped += octal;
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    Utf8String CCompiler::poolString(const Utf8String &literal)
+    {
+        auto entry = stringPool.find(literal);
+        size_t index;
+        if (entry != stringPool.end())
+        {
+            index = entry->second;
+        }
+        else
+        {
+            index = stringPool.size();
+            stringPool[literal] = index;
+            // Short literals are stored inline in the PxString itself, matching what the runtime creates
+            Utf8String bytes = literal.byteLength() <= STRING_INLINE_CAPACITY
+                ? Utf8String{"{ .inlineBytes = u8\""} + escapeCString(literal) + "\" }"
+                : Utf8String{"{ .bytes = (const int8_t*) u8\""} + escapeCString(literal) + "\" }";
+            stringTable += Utf8String{"    { "} + bytes + ", " + std::to_string(literal.length()) + ", " + std::to_string(literal.byteLength()) + " },\n";
+        }
+        return Utf8String{"_pxStrings"} + fragmentPrefix + "[" + std::to_string(index) + "]";
+    }
+
+    Utf8String CCompiler::stringTableDefinition() const
+    {
+        return Utf8String{"static const PxString _pxStrings"} + fragmentPrefix + "[" + std::to_string(stringPool.size()) + "] = {\n" + stringTable + "};\n\n";
+    }
+
+    Utf8String CCompiler::poolArray(const Utf8String &elementType, size_t count, const Utf8String &initializer)
+    {
+        Utf8String key = elementType + "[" + std::to_string(count) + "]" + initializer;
+        auto entry = arrayPool.find(key);
+        if (entry != arrayPool.end())
+            return entry->second;
+
+        Utf8String name = Utf8String{"_pxArray"} + fragmentPrefix + std::to_string(arrayPool.size());
+        arrayPool[key] = name;
+        constantArrays += Utf8String{"static const "} + elementType + " " + name + "[" + std::to_string(count) + "] = " + initializer + ";\n";
+        return name;
+    }
+
+    static bool isConstant(const ast::Expression &expression)
+    {
+        switch (expression.nodeType)
+        {
+            case ast::NodeType::LITERAL_BOOL:
+            case ast::NodeType::LITERAL_CHAR:
+            case ast::NodeType::LITERAL_FLOAT:
+            case ast::NodeType::LITERAL_INT:
+                return true;
+            case ast::NodeType::EXP_CAST:
+                return isConstant(*((const ast::CastExpression&) expression).expression);
+            case ast::NodeType::EXP_UNARY_OP:
+                return isConstant(*((const ast::UnaryOpExpression&) expression).expression);
+            case ast::NodeType::EXP_BINARY_OP:
+            {
+                auto &binary = (const ast::BinaryOpExpression&) expression;
+                return isConstant(*binary.left) && isConstant(*binary.right);
+            }
+            default:
+                return false;
+        }
+    }
+
+    static bool isConstantArray(const ast::Expression &expression)
+    {
+        if (expression.nodeType != ast::NodeType::LITERAL_ARRAY)
+            return false;
+        auto &values = ((const ast::ArrayLiteral&) expression).values;
+        return !values.empty() && std::all_of(values.begin(), values.end(), [](const std::unique_ptr<ast::Expression> &value) {
+            return isConstant(*value);
+        });
+    }
+
+    static bool isMoved(const ast::Expression &expression)
+    {
+        return expression.nodeType == ast::NodeType::EXP_FUNC_CALL;
+    }
+
+    Utf8String CCompiler::elementSize(Type *elementType)
+    {
+        return Utf8String{"sizeof("} + pxTypeToCType(elementType) + ")";
+    }
+
+    bool CCompiler::isContainerParameter(const Utf8String &name)
+    {
+        if (currentFunction == nullptr)
+            return false;
+        Variable *variable = currentScope->symbols()->getVariable(name);
+        auto &parameters = currentFunction->parameters;
+        return variable != nullptr && variable->type->isContainer() && std::find(parameters.begin(), parameters.end(), variable) != parameters.end();
+    }
+
+    // Whether a returned dynamic array or map belongs to the returning function, so it can be moved to the caller
+    bool CCompiler::returnsOwnContainer(ast::Expression &expression)
+    {
+        if (isMoved(expression))
+            return true;
+        if (expression.nodeType != ast::NodeType::EXP_VAR_LOAD)
+            return false;
+        auto &name = ((ast::VariableExpression&) expression).variable;
+        if (isContainerParameter(name))
+            return false;
+        // Locals live in the scopes below the module's
+        for (Scope *scope = currentScope; scope->parent() != nullptr && scope->parent()->parent() != nullptr; scope = scope->parent())
+        {
+            if (scope->symbols()->getVariable(name, true) != nullptr)
+                return true;
+        }
+        return false;
+    }
+
+    // A pointer to a dynamic array or map expression; values that are not variables are put in a temporary
+    Utf8String CCompiler::containerAddress(ast::Expression &expression)
+    {
+        if (expression.nodeType == ast::NodeType::EXP_VAR_LOAD)
+            return Utf8String{"&"} + render(expression);
+        return Utf8String{"("} + pxTypeToCType(expression.type) + "[]){ " + render(expression) + " }";
+    }
+
+    // The suffix of the functions PX_MAP_DEFINE generates for a map type, which is defined on first use
+    Utf8String CCompiler::mapName(Type *type)
+    {
+        auto entry = mapNames.find(type->name);
+        if (entry != mapNames.end())
+        {
+            if (fragmentMaps != nullptr)
+                fragmentMaps->insert(type->name);
+            return entry->second;
+        }
+
+        auto mapType = (MapType*) type;
+        Utf8String keyType = pxTypeToCType(mapType->keyType);
+        Utf8String valueType = pxTypeToCType(mapType->valueType);
+        std::string name = (keyType + "_" + valueType).toString();
+        std::replace(name.begin(), name.end(), '*', 'P');
+        bool stringKeys = mapType->keyType->isString();
+        defineMap(type->name, name, Utf8String{"PX_MAP_DEFINE("} + name + ", " + keyType + ", " + valueType
+            + (stringKeys ? ", pxStringHash, pxStringEquals)\n" : ", pxHashInteger, PX_MAP_EQUALS)\n"));
+        return name;
+    }
+
+    void CCompiler::defineMap(const Utf8String &typeName, const Utf8String &name, const Utf8String &definition)
+    {
+        mapNames[typeName] = name;
+        mapLines[typeName] = definition;
+        mapDefinitions += definition;
+        if (fragmentMaps != nullptr)
+            fragmentMaps->insert(typeName);
+    }
+
+    // Copies the value of a dynamic array or map expression into the variable name of type
+    void CCompiler::assignContainer(const Utf8String &name, Type *type, ast::Expression &expression)
+    {
+        if (type->isMap())
+            add(Utf8String{"pxMapAssign(&"} + name + ", " + containerAddress(expression) + ", sizeof(PxMapEntry_" + mapName(type) + "));");
+        else
+            assignVector(name, ((DynamicArrayType*) type)->elementType, expression);
+    }
+
+    // Copies the elements of a fixed or dynamic array expression into the dynamic array variable name
+    void CCompiler::assignVector(const Utf8String &name, Type *elementType, ast::Expression &expression)
+    {
+        Utf8String size = elementSize(elementType);
+        Type *type = expression.type;
+        if (type->isArray())
+        {
+            size_t length = ((ArrayType*) type)->count;
+            Utf8String count = std::to_string(length);
+            Utf8String elements = length == 0 ? Utf8String{"NULL"} : expression.nodeType == ast::NodeType::LITERAL_ARRAY
+                ? Utf8String{"("} + pxTypeToCType(elementType) + "[]) " + render(expression)
+                : render(expression);
+            add(Utf8String{"pxVectorAssign(&"} + name + ", " + elements + ", " + count + ", " + size + ");");
+        }
+        else if (expression.nodeType == ast::NodeType::EXP_VAR_LOAD)
+        {
+            Utf8String source = render(expression);
+            add(Utf8String{"pxVectorAssign(&"} + name + ", " + source + ".data, " + source + ".length, " + size + ");");
+        }
+        else
+        {
+            add(Utf8String{"{ PxVector _pxSource = "} + render(expression) + "; pxVectorAssign(&" + name + ", _pxSource.data, _pxSource.length, " + size + "); }");
+        }
+    }
+
+    void CCompiler::compileContainerOperation(ast::FunctionCallExpression &f, bool statement)
+    {
+        Type *containerType = f.arguments[0]->type;
+        if (containerType->isMap())
+        {
+            Utf8String name = mapName(containerType);
+            Utf8String map = containerAddress(*f.arguments[0]);
+            switch (f.containerOperation)
+            {
+                case ast::ContainerOperation::RESERVE:
+                    add(Utf8String{"pxMapReserve_"} + name + "(" + map + ", " + render(*f.arguments[1]) + ")");
+                    break;
+                case ast::ContainerOperation::LENGTH:
+                    add(Utf8String{"((int64_t) "} + render(*f.arguments[0]) + ".length)");
+                    break;
+                case ast::ContainerOperation::CONTAINS:
+                    add(Utf8String{"pxMapContains_"} + name + "(" + map + ", " + render(*f.arguments[1]) + ")");
+                    break;
+                case ast::ContainerOperation::REMOVE:
+                    add(Utf8String{"pxMapRemove_"} + name + "(" + map + ", " + render(*f.arguments[1]) + ")");
+                    break;
+                case ast::ContainerOperation::KEYS:
+                    add(Utf8String{"pxMapKeys_"} + name + "(" + map + ")");
+                    break;
+                default:
+                    break;
+            }
+            if (statement)
+                add(Token::getTokenName(TokenType::OP_END_STATEMENT));
+            return;
+        }
+
+        Type *elementType = ((DynamicArrayType*) containerType)->elementType;
+        Utf8String cType = pxTypeToCType(elementType);
+        Utf8String size = elementSize(elementType);
+        switch (f.containerOperation)
+        {
+            case ast::ContainerOperation::PUSH:
+                // The value is computed first, since it may read the array that is growing
+                if (statement)
+                    add(Utf8String{"{ "} + cType + " _pxValue = " + render(*f.arguments[1]) + "; *(" + cType + "*) pxVectorPush(" + containerAddress(*f.arguments[0]) + ", " + size + ") = _pxValue; }");
+                else
+                    add(Utf8String{"(void) (*("} + cType + "*) pxVectorPush(" + containerAddress(*f.arguments[0]) + ", " + size + ") = " + render(*f.arguments[1]) + ")");
+                break;
+            case ast::ContainerOperation::POP:
+                add(Utf8String{"(("} + cType + "*) " + render(*f.arguments[0]) + ".data)[pxVectorPop(" + containerAddress(*f.arguments[0]) + ")]");
+                break;
+            case ast::ContainerOperation::RESERVE:
+                add(Utf8String{"pxVectorReserve("} + containerAddress(*f.arguments[0]) + ", " + render(*f.arguments[1]) + ", " + size + ")");
+                break;
+            case ast::ContainerOperation::APPEND:
+                add(Utf8String{"pxVectorAppend("} + containerAddress(*f.arguments[0]) + ", " + containerAddress(*f.arguments[1]) + ", " + size + ")");
+                break;
+            case ast::ContainerOperation::LENGTH:
+                add(Utf8String{"((int64_t) "} + render(*f.arguments[0]) + ".length)");
+                break;
+            default:
+                break;
+        }
+        if (statement)
+            add(Token::getTokenName(TokenType::OP_END_STATEMENT));
+    }
+
     void* CCompiler::visit(ast::ArrayIndexAssignmentStatement &a)
     {
+        auto reference = (ast::ArrayIndexReference*) a.reference.get();
+        Type *arrayType = reference->array->type;
+        if (arrayType->isMap())
+        {
+            // The value is computed before the slot is found, since computing it may change the map
+            Type *valueType = ((MapType*) arrayType)->valueType;
+            Utf8String cType = pxTypeToCType(valueType);
+            Utf8String slot = Utf8String{"pxMapSlot_"} + mapName(arrayType) + "(" + containerAddress(*reference->array) + ", " + render(*reference->index) + ")";
+            add(Utf8String{"{ "} + cType + " _pxValue = " + render(*a.expression) + "; ");
+            if (a.opType == TokenType::OP_ASSIGN_ADD && valueType->isString())
+                add(Utf8String{"PxString *_pxElement = "} + slot + "; *_pxElement = pxStringConcat(*_pxElement, _pxValue); }");
+            else
+                add(Utf8String{"*"} + slot + Token::getTokenName(a.opType) + "_pxValue; }");
+            return nullptr;
+        }
+        if (a.opType == TokenType::OP_ASSIGN_ADD && a.expression->type->isString())
+        {
+            // The element is named once so its index is only evaluated once
+            add(Utf8String{"{ PxString *_pxElement = &"});
+            a.reference->accept(*this);
+            add(Utf8String{"; *_pxElement = pxStringConcat(*_pxElement, "});
+            a.expression->accept(*this);
+            add(Utf8String{"); }"});
+            return nullptr;
+        }
         a.reference->accept(*this);
         add(Token::getTokenName(a.opType));
         a.expression->accept(*this);
         add(Token::getTokenName(TokenType::OP_END_STATEMENT));
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::ArrayIndexReference &a)
     {
+        Type *arrayType = a.array->type;
+        if (arrayType->isMap())
+        {
+            add(Utf8String{"pxMapGet_"} + mapName(arrayType) + "(" + containerAddress(*a.array) + ", " + render(*a.index) + ")");
+            return nullptr;
+        }
+        if (arrayType->isDynamicArray())
+        {
+            add(Utf8String{"(("} + pxTypeToCType(((DynamicArrayType*) arrayType)->elementType) + "*) ");
+            a.array->accept(*this);
+            add(Utf8String{".data)["});
+            a.index->accept(*this);
+            add(Utf8String{"]"});
+            return nullptr;
+        }
         a.array->accept(*this);
         add(Utf8String{"["} );
         a.index->accept(*this);
@@ -138,22 +496,76 @@ namespace px
         }
 
         add(Utf8String{ " }" });
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::AssignmentStatement &a)
     {
         auto symbolTable = currentScope->symbols();
         Variable *variable = symbolTable->getVariable(a.variableName);
+        if (a.opType == TokenType::OP_ASSIGN_ADD && variable->type->isString())
+        {
+            add(variable->name + " = pxStringConcat(" + variable->name + ", ");
+            a.expression->accept(*this);
+            add(Utf8String{");"});
+            return nullptr;
+        }
+        if (variable->type->isContainer() && !isMoved(*a.expression))
+        {
+            Utf8String target = isContainerParameter(variable->name) ? Utf8String{"(*"} + variable->name + ")" : variable->name;
+            assignContainer(target, variable->type, *a.expression);
+            return nullptr;
+        }
+        if (isContainerParameter(variable->name))
+        {
+            add(Utf8String{"*"});
+        }
         add(Utf8String{ variable->name + Token::getTokenName(a.opType)});
         a.expression->accept(*this);
         add(Token::getTokenName(TokenType::OP_END_STATEMENT));
+        return nullptr;
+    }
+
+    void* CCompiler::visit(ast::AwaitExpression &a)
+    {
+        Utf8String future = ((ast::VariableExpression&) *a.future).variable;
+        if (a.type->isVoid())
+            add(Utf8String{"pxAwait(&"} + future + ".task)");
+        else
+            add(Utf8String{"(pxAwait(&"} + future + ".task), " + future + ".result)");
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::BinaryOpExpression &b)
     {
         px::Type *leftType = b.left->type;
         Utf8String opToken;
-        if (leftType->isInt() || leftType->isUInt())
+        if (leftType->isString())
+        {
+            Utf8String function;
+            Utf8String compare;
+            switch (b.op)
+            {
+                case ast::BinaryOperator::ADD:  function = "pxStringConcat("; break;
+                case ast::BinaryOperator::EQ:   function = "pxStringEquals("; break;
+                case ast::BinaryOperator::NE:   function = "!pxStringEquals("; break;
+                case ast::BinaryOperator::LT:
+                case ast::BinaryOperator::LTE:
+                case ast::BinaryOperator::GT:
+                case ast::BinaryOperator::GTE:
+                    function = "(pxStringCompare(";
+                    compare = Utf8String{") "} + Token::getTokenName(b.token) + " 0";
+                    break;
+                default:	return nullptr;
+            }
+            add(function);
+            b.left->accept(*this);
+            add(Utf8String{", "});
+            b.right->accept(*this);
+            add(compare + ")");
+            return nullptr;
+        }
+        else if (leftType->isInt() || leftType->isUInt())
         {
             switch (b.op)
             {
@@ -234,12 +646,30 @@ namespace px
 
         add(Utf8String{"{"} );
         indent();
+        pendingTasks.emplace_back();
         for (auto const& statement : s.statements)
         {
             newLine();
             statement->accept(*this);
 
         }
+        // Tasks still running when the block ends normally are awaited there
+        bool leaves = false;
+        if (!s.statements.empty())
+        {
+            ast::NodeType last = s.statements.back()->nodeType;
+            leaves = last == ast::NodeType::STMT_RETURN || last == ast::NodeType::STMT_BREAK || last == ast::NodeType::STMT_CONTINUE;
+        }
+        if (!leaves)
+        {
+            auto &futures = pendingTasks.back();
+            for (auto future = futures.rbegin(); future != futures.rend(); ++future)
+            {
+                newLine();
+                add(Utf8String{"pxAwait(&"} + *future + ".task);");
+            }
+        }
+        pendingTasks.pop_back();
         unindent();
         newLine();
         add(Utf8String{ "}" });
@@ -252,18 +682,43 @@ namespace px
     void* CCompiler::visit(ast::BoolLiteral &b)
     {
         add( b.literal );
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::BreakStatement &b)
     {
-        add(Token::getTokenName(TokenType::KW_BREAK) );
-        add(Token::getTokenName(TokenType::OP_END_STATEMENT) );
+        // The exits are braced with the jump, since it may be the whole body of an if or a loop
+        bool exits = !breakDepths.empty() && leavesScopes(breakDepths.back());
+        if (exits)
+        {
+            add(Utf8String{"{ "});
+            exitScopes(breakDepths.back());
+        }
+        if (!breakLabels.empty() && breakLabels.back().length() != 0)
+            add(Utf8String{"goto "} + breakLabels.back() + ";");
+        else
+        {
+            add(Token::getTokenName(TokenType::KW_BREAK) );
+            add(Token::getTokenName(TokenType::OP_END_STATEMENT) );
+        }
+        if (exits)
+            add(Utf8String{" }"});
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::ContinueStatement &c)
     {
+        bool exits = !continueDepths.empty() && leavesScopes(continueDepths.back());
+        if (exits)
+        {
+            add(Utf8String{"{ "});
+            exitScopes(continueDepths.back());
+        }
         add(Token::getTokenName(TokenType::KW_CONTINUE) );
         add(Token::getTokenName(TokenType::OP_END_STATEMENT) );
+        if (exits)
+            add(Utf8String{" }"});
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::CastExpression &e) {
@@ -296,7 +751,10 @@ namespace px
 
 
         if (doCast) {
-            add(Utf8String{"("} + newTypeName + ") " );
+            add(Utf8String{"(("} + newTypeName + ") " );
+            e.expression->accept(*this);
+            add(Utf8String{")"} );
+        } else {
             e.expression->accept(*this);
         }
         return nullptr;
@@ -304,6 +762,13 @@ namespace px
 
     void* CCompiler::visit(ast::CharLiteral &c)
     {
+        // char is a code point, and a C character constant can only hold one byte
+        if (c.literal.length() == 1 && c.literal.byteLength() > 1)
+        {
+            Utf8Iterator iterator{ c.literal };
+            add(Utf8String{ std::to_string(*iterator) });
+            return nullptr;
+        }
         add(Utf8String{"'"} + c.literal + "'" );
         return nullptr;
     }
@@ -314,7 +779,13 @@ namespace px
         indent(d.body.get());
         newLine();
 
+        breakLabels.push_back("");
+        breakDepths.push_back(exitDepths());
+        continueDepths.push_back(exitDepths());
         d.body->accept(*this);
+        continueDepths.pop_back();
+        breakDepths.pop_back();
+        breakLabels.pop_back();
         unindent(d.body.get());
         newLine();
 
@@ -328,6 +799,24 @@ namespace px
 
     void* CCompiler::visit(ast::ExpressionStatement &e)
     {
+        if (e.expression->nodeType == ast::NodeType::EXP_AWAIT)
+        {
+            auto &future = (ast::VariableExpression&) *((ast::AwaitExpression&) *e.expression).future;
+            add(Utf8String{"pxAwait(&"} + future.variable + ".task);");
+            // Once awaited in the block that declared it, the future need not be awaited when leaving it
+            auto &futures = pendingTasks.back();
+            futures.erase(std::remove(futures.begin(), futures.end(), future.variable), futures.end());
+            return nullptr;
+        }
+        if (e.expression->nodeType == ast::NodeType::EXP_FUNC_CALL)
+        {
+            auto &call = (ast::FunctionCallExpression&) *e.expression;
+            if (call.containerOperation != ast::ContainerOperation::NONE)
+            {
+                compileContainerOperation(call, true);
+                return nullptr;
+            }
+        }
         e.expression->accept(*this);
         add(Token::getTokenName(TokenType::OP_END_STATEMENT) );
         return nullptr;
@@ -339,8 +828,267 @@ namespace px
         return nullptr;
     }
 
+    // The names of the variables a statement reads or writes
+    class VariableCollector : public ast::RecursiveVisitor
+    {
+    public:
+        std::vector<Utf8String> names;
+
+        void *visit(ast::VariableExpression &v) override
+        {
+            if (std::find(names.begin(), names.end(), v.variable) == names.end())
+                names.push_back(v.variable);
+            return nullptr;
+        }
+    };
+
+    // The body of a parallel for becomes a function of the range of iterations to run, which finds the
+    // locals it uses in an environment struct built on the caller's stack. Scalars are copied in, since
+    // the iterations can not assign to them; arrays, dynamic arrays and maps are passed by address so
+    // the elements the iterations write are the caller's.
+    void CCompiler::compileParallelFor(ast::ForStatement &f)
+    {
+        auto current = currentScope;
+        Utf8String name = Utf8String{"_pxParallel"} + fragmentPrefix + std::to_string(++parallelCount);
+        Utf8String environmentType = name + "Environment";
+
+        VariableCollector collector;
+        f.body->accept(collector);
+        Utf8String fields, initializers;
+        std::vector<Utf8String> unpacking;
+        for (auto &captured : collector.names)
+        {
+            Variable *variable = current->symbols()->getVariable(captured);
+            bool local = false;
+            for (Scope *scope = current; scope->parent() != nullptr && scope->parent()->parent() != nullptr; scope = scope->parent())
+                local = local || scope->symbols()->getVariable(captured, true) == variable;
+            if (variable == nullptr || !local)
+                continue;
+
+            Type *type = variable->type;
+            Utf8String cType, initializer = captured;
+            if (type->isArray())
+            {
+                cType = pxTypeToCType(((ArrayType*) type)->elementType) + " *";
+                initializer = Utf8String{"("} + cType + ") " + captured;
+                unpacking.push_back(cType + captured + " = _pxEnvironment->" + captured + ";");
+            }
+            else if (type->isContainer())
+            {
+                cType = pxTypeToCType(type) + " *";
+                if (isContainerParameter(captured))
+                {
+                    unpacking.push_back(cType + captured + " = _pxEnvironment->" + captured + ";");
+                }
+                else
+                {
+                    initializer = Utf8String{"&"} + captured;
+                    unpacking.push_back(pxTypeToCType(type) + " " + captured + " = *_pxEnvironment->" + captured + ";");
+                }
+            }
+            else
+            {
+                cType = pxTypeToCType(type) + " ";
+                unpacking.push_back(cType + captured + " = _pxEnvironment->" + captured + ";");
+            }
+            fields += Utf8String{"    "} + cType + captured + ";\n";
+            if (initializers.length() != 0)
+                initializers += ", ";
+            initializers += initializer;
+        }
+        bool hasEnvironment = !unpacking.empty();
+
+        currentScope = scopeTree->enterScope();
+        Utf8String cType = pxTypeToCType(f.variableType);
+        Utf8String start = render(*f.start);
+        Utf8String end = render(*f.end);
+
+        Utf8String outer;
+        swap(outer, code);
+        unsigned int outerIndent = indentLevel;
+        size_t outerRegionDepth = regionDepth;
+        std::vector<std::vector<Utf8String>> outerTasks;
+        outerTasks.swap(pendingTasks);
+        indentLevel = 0;
+        regionDepth = 0;
+        add(Utf8String{"static void "} + name + "(void *_pxData, int64_t _pxStart, int64_t _pxEnd)");
+        newLine();
+        add(Utf8String{"{"});
+        indent();
+        if (hasEnvironment)
+        {
+            newLine();
+            add(environmentType + " *_pxEnvironment = (" + environmentType + "*) _pxData;");
+            for (auto &line : unpacking)
+            {
+                newLine();
+                add(line);
+            }
+        }
+        newLine();
+        if (f.independentIterations && !f.needsRestrict)
+        {
+            add(Utf8String{"PX_INDEPENDENT_LOOP"});
+            newLine();
+        }
+        add(Utf8String{"for ("} + cType + " " + f.variableName + " = (" + cType + ") _pxStart; " + f.variableName + " < (" + cType + ") _pxEnd; ++" + f.variableName + ")");
+        indent(f.body.get());
+        newLine();
+        breakLabels.push_back("");
+        breakDepths.push_back(ExitDepths{ 0, 0 });
+        continueDepths.push_back(ExitDepths{ 0, 0 });
+        f.body->accept(*this);
+        continueDepths.pop_back();
+        breakDepths.pop_back();
+        breakLabels.pop_back();
+        unindent(f.body.get());
+        unindent();
+        newLine();
+        add(Utf8String{"}"});
+        newLine();
+        outlinedFunctions += Utf8String{"\n"} + code;
+        swap(outer, code);
+        indentLevel = outerIndent;
+        regionDepth = outerRegionDepth;
+        pendingTasks.swap(outerTasks);
+
+        if (hasEnvironment)
+            outlinedDeclarations += Utf8String{"typedef struct\n{\n"} + fields + "} " + environmentType + ";\n";
+        outlinedDeclarations += Utf8String{"static void "} + name + "(void *_pxData, int64_t _pxStart, int64_t _pxEnd);\n";
+
+        Utf8String environment = "NULL";
+        add(Utf8String{"{"});
+        indent();
+        if (hasEnvironment)
+        {
+            environment = Utf8String{"&"} + name + "Data";
+            newLine();
+            add(environmentType + " " + name + "Data = { " + initializers + " };");
+        }
+        newLine();
+        add(Utf8String{"pxParallelFor((int64_t) ("} + start + "), (int64_t) (" + end + "), " + name + ", " + environment + ");");
+        unindent();
+        newLine();
+        add(Utf8String{"}"});
+
+        scopeTree->endScope();
+        currentScope = current;
+    }
+
+    // A future is the task struct for its function, on the spawning function's stack: the arguments
+    // are stored in it before it is handed to the pool, and the call's result is stored in it
+    void CCompiler::compileSpawn(ast::VariableDeclaration &v)
+    {
+        auto &call = *((ast::SpawnExpression&) *v.initialValue).call;
+        add(spawnTaskType(call.function) + " " + v.name + ";");
+        for (size_t i = 0; i < call.arguments.size(); ++i)
+        {
+            auto &argument = *call.arguments[i];
+            Utf8String value = argument.type->isContainer() ? containerAddress(argument) : render(argument);
+            add(Utf8String{" "} + v.name + ".argument" + std::to_string(i) + " = " + value + ";");
+        }
+        add(Utf8String{" pxSpawn(&"} + v.name + ".task, _pxSpawn_" + fragmentPrefix + call.function->name + ");");
+        pendingTasks.back().push_back(v.name);
+    }
+
+    // The struct a call to function is spawned in, declared with the function the pool runs for it on first use
+    Utf8String CCompiler::spawnTaskType(Function *function)
+    {
+        Utf8String name = Utf8String{"_pxSpawn_"} + fragmentPrefix + function->name;
+        Utf8String taskType = name + "Task";
+        if (!spawnedFunctions.insert(function->name).second)
+            return taskType;
+
+        Utf8String fields = "    PxTask task;\n";
+        if (!function->returnType->isVoid())
+            fields += Utf8String{"    "} + pxTypeToCType(function->returnType) + " result;\n";
+        Utf8String arguments;
+        for (size_t i = 0; i < function->parameters.size(); ++i)
+        {
+            Type *type = function->parameters[i]->type;
+            Utf8String argument = Utf8String{"argument"} + std::to_string(i);
+            if (type->isArray())
+                fields += Utf8String{"    "} + pxTypeToCType(((ArrayType*) type)->elementType) + " *" + argument + ";\n";
+            else if (type->isContainer())
+                fields += Utf8String{"    "} + pxTypeToCType(type) + " *" + argument + ";\n";
+            else
+                fields += Utf8String{"    "} + pxTypeToCType(type) + " " + argument + ";\n";
+            if (i != 0)
+                arguments += ", ";
+            arguments += Utf8String{"_pxData->"} + argument;
+        }
+        outlinedDeclarations += Utf8String{"typedef struct\n{\n"} + fields + "} " + taskType + ";\n";
+        outlinedDeclarations += Utf8String{"static void "} + name + "(PxTask *_pxTask);\n";
+
+        Utf8String result = function->returnType->isVoid() ? Utf8String{""} : Utf8String{"_pxData->result = "};
+        outlinedFunctions += Utf8String{"\nstatic void "} + name + "(PxTask *_pxTask)\n{\n"
+            + "    " + taskType + " *_pxData = (" + taskType + "*) _pxTask;\n"
+            + "    " + result + function->name + "(" + arguments + ");\n}\n";
+        return taskType;
+    }
+
+    void* CCompiler::visit(ast::ForStatement &f)
+    {
+        if (f.parallel)
+        {
+            compileParallelFor(f);
+            return nullptr;
+        }
+        auto current = currentScope;
+        currentScope = scopeTree->enterScope();
+
+        // The end is evaluated once, into a constant, so the C compiler sees a countable loop
+        Utf8String cType = pxTypeToCType(f.variableType);
+        Utf8String end = render(*f.end);
+        bool hoistEnd = !isConstant(*f.end);
+        if (hoistEnd)
+        {
+            Utf8String name = Utf8String{"_pxfor"} + std::to_string(++forCount) + "_end";
+            add(Utf8String{"{"});
+            indent();
+            newLine();
+            add(Utf8String{"const "} + cType + " " + name + " = " + end + ";");
+            newLine();
+            end = name;
+        }
+        bool restrict = currentFunction != nullptr && currentFunction->hasAttribute(Function::RESTRICT_ARRAYS);
+        if (f.independentIterations && (!f.needsRestrict || restrict))
+        {
+            add(Utf8String{"PX_INDEPENDENT_LOOP"});
+            newLine();
+        }
+        add(Utf8String{"for ("} + cType + " " + f.variableName + " = " + render(*f.start) + "; " + f.variableName + " < " + end + "; ++" + f.variableName + ")");
+
+        indent(f.body.get());
+        newLine();
+        breakLabels.push_back("");
+        breakDepths.push_back(exitDepths());
+        continueDepths.push_back(exitDepths());
+        f.body->accept(*this);
+        continueDepths.pop_back();
+        breakDepths.pop_back();
+        breakLabels.pop_back();
+        unindent(f.body.get());
+
+        if (hoistEnd)
+        {
+            unindent();
+            newLine();
+            add(Utf8String{"}"});
+        }
+        scopeTree->endScope();
+        currentScope = current;
+
+        return nullptr;
+    }
+
     void* CCompiler::visit(ast::FunctionCallExpression &f)
     {
+        if (f.containerOperation != ast::ContainerOperation::NONE)
+        {
+            compileContainerOperation(f, false);
+            return nullptr;
+        }
         Function *pxFunction = f.function;
         Utf8String name = pxFunction->name;
         int a = 0, end = f.arguments.size();
@@ -348,7 +1096,11 @@ namespace px
         add(Utf8String{ name + "("});
         for (auto &arg : f.arguments)
         {
-            arg->accept(*this);
+            // Dynamic arrays and maps are passed by pointer so the callee can change them
+            if (arg->type->isContainer())
+                add(containerAddress(*arg));
+            else
+                arg->accept(*this);
             if(++a < end) {
                 add(", ");
             }
@@ -367,20 +1119,19 @@ namespace px
     void* CCompiler::visit(ast::FunctionDefinition &f)
     {
         Function *function = f.function;
-        Utf8String RT = pxTypeToCType(function->returnType);
-        int a = 0, end = function->parameters.size();
-
-        add(Utf8String{ RT + " " + function->name + "("});
-        for (const Variable *arg : function->parameters)
+        if (onlyFunctions != nullptr && onlyFunctions->count(function->name) == 0)
         {
-            Utf8String argType = pxTypeToCType(arg->type);
-            add(argType + " " + arg->name);
-            if(++a < end) {
-                add(", ");
-            }
+            // The function's scope is stepped over so the ones after it still line up
+            scopeTree->enterScope();
+            scopeTree->endScope();
+            return nullptr;
         }
-
-        add(Utf8String{ ")"});
+        if (fragments != nullptr)
+        {
+            compileFragment(f);
+            return nullptr;
+        }
+        add(buildFunctionSignature(function));
         Function *prevFunction = currentFunction;
         currentFunction = function;
 
@@ -391,6 +1142,74 @@ namespace px
         return nullptr;
     }
 
+    // A fragment pools its literals and outlines its parallel loops and spawns under names of its own,
+    // mangled with the function's name and its length so no two functions' names can run together,
+    // and declares them ahead of the function. It can then be put in any module that has the same
+    // function without the rest of that module's C being generated again.
+    void CCompiler::compileFragment(ast::FunctionDefinition &f)
+    {
+        Function *function = f.function;
+        FunctionFragment &fragment = (*fragments)[function->name];
+        if (reusedFragments->count(function->name) != 0)
+        {
+            for (auto &map : fragment.maps)
+            {
+                if (mapNames.count(map.typeName) == 0)
+                    defineMap(map.typeName, map.name, map.definition);
+            }
+            add(fragment.code);
+            return;
+        }
+
+        std::unordered_map<Utf8String, size_t> moduleStrings;
+        Utf8String moduleStringTable;
+        std::unordered_map<Utf8String, Utf8String> moduleArrays;
+        Utf8String moduleConstantArrays, moduleDeclarations, moduleOutlined, moduleCode;
+        std::unordered_set<Utf8String> moduleSpawned;
+        std::unordered_set<Utf8String> maps;
+        std::swap(stringPool, moduleStrings);
+        std::swap(stringTable, moduleStringTable);
+        std::swap(arrayPool, moduleArrays);
+        std::swap(constantArrays, moduleConstantArrays);
+        std::swap(outlinedDeclarations, moduleDeclarations);
+        std::swap(outlinedFunctions, moduleOutlined);
+        std::swap(spawnedFunctions, moduleSpawned);
+        std::swap(code, moduleCode);
+        size_t moduleParallelCount = parallelCount;
+        parallelCount = 0;
+        fragmentPrefix = Utf8String{"_"} + std::to_string(function->name.byteLength()) + function->name + "_";
+        fragmentMaps = &maps;
+
+        add(buildFunctionSignature(function));
+        Function *prevFunction = currentFunction;
+        currentFunction = function;
+        newLine();
+        f.block->accept(*this);
+        currentFunction = prevFunction;
+
+        Utf8String declarations = outlinedDeclarations;
+        if (!stringPool.empty())
+            declarations += stringTableDefinition();
+        declarations += constantArrays;
+        fragment.code = declarations + code + outlinedFunctions;
+        fragment.maps.clear();
+        for (auto &typeName : maps)
+            fragment.maps.push_back(FragmentMap{ typeName, mapNames[typeName], mapLines[typeName] });
+
+        std::swap(stringPool, moduleStrings);
+        std::swap(stringTable, moduleStringTable);
+        std::swap(arrayPool, moduleArrays);
+        std::swap(constantArrays, moduleConstantArrays);
+        std::swap(outlinedDeclarations, moduleDeclarations);
+        std::swap(outlinedFunctions, moduleOutlined);
+        std::swap(spawnedFunctions, moduleSpawned);
+        std::swap(code, moduleCode);
+        parallelCount = moduleParallelCount;
+        fragmentPrefix = Utf8String{};
+        fragmentMaps = nullptr;
+        add(fragment.code);
+    }
+
     void* CCompiler::visit(ast::IfStatement & i)
     {
         add(Utf8String{"if ("} );
@@ -426,6 +1245,7 @@ namespace px
     void* CCompiler::visit(ast::IntegerLiteral &i)
     {
         add(Utf8String{ std::to_string(i.value) });
+        return nullptr;
     }
 
     void * CCompiler::visit(ast::Module & m)
@@ -433,10 +1253,7 @@ namespace px
         auto current = currentScope;
         currentScope = scopeTree->enterScope();
 
-        code = "#include <PxRuntime.h>\n\n";
-        add(toPreDeclare);
-
-        Utf8String statementCode;
+        code = "";
         for (auto const& statement : m.statements)
         {
             statement->accept(*this);
@@ -446,6 +1263,33 @@ namespace px
         scopeTree->endScope();
         currentScope = current;
 
+        // The functions of imported modules are defined in their own C files
+        for (Function *function : m.importedFunctions)
+            toPreDeclare += buildFunctionProto(function);
+
+        // Literals are pooled while the statements are generated, so their tables go in front afterwards
+        Utf8String header = Utf8String{"#include <PxRuntime.h>\n"};
+        if (!mapNames.empty())
+        {
+            header += Utf8String{"#include <PxMap.h>\n\n"} + mapDefinitions;
+        }
+        header += Utf8String{"\n"} + toPreDeclare;
+        if (outlinedDeclarations.length() != 0)
+        {
+            header += Utf8String{"\n"} + outlinedDeclarations + "\n";
+        }
+        if (!stringPool.empty())
+        {
+            header += stringTableDefinition();
+        }
+        if (!arrayPool.empty())
+        {
+            header += constantArrays + "\n";
+        }
+        code = header + code + outlinedFunctions;
+        if (onlyFunctions != nullptr || !writeFile)
+            return nullptr;
+
         Utf8String outputName = m.fileName + ".c";
         UFILE *out = u_fopen(outputName.toString().c_str(), "w", NULL, NULL);
         writeString(out, code);
@@ -453,8 +1297,101 @@ namespace px
         return nullptr;
     }
 
+    CCompiler::ExitDepths CCompiler::exitDepths() const
+    {
+        return ExitDepths{ pendingTasks.size(), regionDepth };
+    }
+
+    bool CCompiler::leavesScopes(const ExitDepths &depths) const
+    {
+        if (regionDepth > depths.regions)
+            return true;
+        for (size_t i = depths.tasks; i < pendingTasks.size(); ++i)
+        {
+            if (!pendingTasks[i].empty())
+                return true;
+        }
+        return false;
+    }
+
+    // Leaving a block waits for its tasks before freeing its regions, since the tasks may use them
+    void CCompiler::exitScopes(const ExitDepths &depths)
+    {
+        awaitTasks(depths.tasks);
+        exitRegions(depths.regions);
+    }
+
+    // Awaits the futures declared in the blocks from depth in, innermost first
+    void CCompiler::awaitTasks(size_t depth)
+    {
+        for (size_t i = pendingTasks.size(); i > depth; --i)
+        {
+            auto &futures = pendingTasks[i - 1];
+            for (auto future = futures.rbegin(); future != futures.rend(); ++future)
+                add(Utf8String{"pxAwait(&"} + *future + ".task); ");
+        }
+    }
+
+    void CCompiler::exitRegions(size_t depth)
+    {
+        for (size_t i = depth; i < regionDepth; ++i)
+            add(Utf8String{"pxRegionExit(); "});
+    }
+
+    void* CCompiler::visit(ast::RegionStatement &r)
+    {
+        add(Utf8String{"pxRegionEnter();"});
+        newLine();
+        ++regionDepth;
+        r.body->accept(*this);
+        --regionDepth;
+        newLine();
+        add(Utf8String{"pxRegionExit();"});
+        return nullptr;
+    }
+
     void* CCompiler::visit(ast::ReturnStatement &s)
     {
+        if (currentFunction != nullptr && currentFunction->hasAttribute(Function::NO_RETURN))
+        {
+            add(Utf8String{"PX_UNREACHABLE();"});
+            return nullptr;
+        }
+        bool exits = leavesScopes(ExitDepths{ 0, 0 });
+        if (exits)
+            add(Utf8String{"{ "});
+        awaitTasks(0);
+        compileReturn(s);
+        if (exits)
+            add(Utf8String{" }"});
+        return nullptr;
+    }
+
+    void CCompiler::compileReturn(ast::ReturnStatement &s)
+    {
+        if (s.returnValue != nullptr && s.returnValue->type->isContainer() && !returnsOwnContainer(*s.returnValue))
+        {
+            // Containers the function does not own are copied into the caller's region after leaving its own
+            Type *type = s.returnValue->type;
+            add(Utf8String{"{ "} + pxTypeToCType(type) + " _pxSource = " + render(*s.returnValue) + "; ");
+            exitRegions(0);
+            if (type->isMap())
+                add(Utf8String{"return pxMapCopy(&_pxSource, sizeof(PxMapEntry_"} + mapName(type) + ")); }");
+            else
+                add(Utf8String{"return pxVectorFromElements(_pxSource.data, _pxSource.length, "} + elementSize(((DynamicArrayType*) type)->elementType) + "); }");
+            return;
+        }
+        if (s.returnValue != nullptr && regionDepth != 0)
+        {
+            // The value is computed before its regions are freed
+            add(Utf8String{"{ "} + pxTypeToCType(currentFunction->returnType) + " _pxResult = ");
+            s.returnValue->accept(*this);
+            add(Utf8String{"; "});
+            exitRegions(0);
+            add(Utf8String{"return _pxResult; }"});
+            return;
+        }
+        exitRegions(0);
         if (s.returnValue != nullptr)
         {
             add(Utf8String{"return "});
@@ -465,20 +1402,152 @@ namespace px
         add(Token::getTokenName(TokenType::OP_END_STATEMENT) );
     }
 
+    // Spawns are compiled with the future they start
+    void* CCompiler::visit(ast::SpawnExpression &s)
+    {
+        return nullptr;
+    }
+
     void* CCompiler::visit(ast::StringLiteral &s)
     {
-        Utf8String literal = s.literal;
-        add( Utf8String{"(PxString) { "} + "u8\"" + literal + "\", " + std::to_string(literal.length())  + ", " +  std::to_string(literal.byteLength()) + " }");
+        add(poolString(s.literal));
+        return nullptr;
+    }
+
+    void* CCompiler::visit(ast::SwitchStatement &s)
+    {
+        std::vector<std::pair<int64_t, size_t>> targets;
+        for (size_t i = 0; i < s.cases.size(); ++i)
+        {
+            for (int64_t constant : s.cases[i].constants)
+                targets.emplace_back(constant, i);
+        }
+        std::sort(targets.begin(), targets.end());
+
+        // Dense case sets are left to the C compiler's jump tables, sparse ones are searched in place
+        bool dense = targets.size() < SPARSE_SWITCH_MIN_CASES
+                     || (uint64_t) targets.back().first - (uint64_t) targets.front().first < targets.size() * SPARSE_SWITCH_SPREAD;
+        if (dense)
+        {
+            add(Utf8String{"switch ("});
+            s.scrutinee->accept(*this);
+            add(Utf8String{")"});
+            newLine();
+            add(Utf8String{"{"});
+            indent();
+            breakLabels.push_back("");
+            breakDepths.push_back(exitDepths());
+            for (auto &switchCase : s.cases)
+            {
+                for (int64_t constant : switchCase.constants)
+                {
+                    newLine();
+                    add(Utf8String{"case "} + std::to_string(constant) + ":");
+                }
+                newLine();
+                switchCase.body->accept(*this);
+                newLine();
+                add(Utf8String{"break;"});
+            }
+            if (s.defaultBody)
+            {
+                newLine();
+                add(Utf8String{"default:"});
+                newLine();
+                s.defaultBody->accept(*this);
+                newLine();
+                add(Utf8String{"break;"});
+            }
+            breakDepths.pop_back();
+            breakLabels.pop_back();
+            unindent();
+            newLine();
+            add(Utf8String{"}"});
+            return nullptr;
+        }
+
+        Utf8String prefix = Utf8String{"_pxsw"} + std::to_string(++switchCount);
+        Utf8String endLabel = prefix + "_end";
+        Utf8String defaultLabel = s.defaultBody ? prefix + "_default" : endLabel;
+
+        add(Utf8String{"{"});
+        indent();
+        newLine();
+        add(Utf8String{"const "} + pxTypeToCType(s.scrutinee->type) + " " + prefix + " = ");
+        s.scrutinee->accept(*this);
+        add(Utf8String{";"});
+
+        std::function<void(size_t, size_t)> search = [&](size_t begin, size_t end) {
+            if (end - begin <= SPARSE_SWITCH_LINEAR_CASES)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    newLine();
+                    add(Utf8String{"if ("} + prefix + " == " + std::to_string(targets[i].first) + ") goto " + prefix + "_case" + std::to_string(targets[i].second) + ";");
+                }
+                return;
+            }
+            size_t middle = begin + (end - begin) / 2;
+            newLine();
+            add(Utf8String{"if ("} + prefix + " < " + std::to_string(targets[middle].first) + ")");
+            newLine();
+            add(Utf8String{"{"});
+            indent();
+            search(begin, middle);
+            unindent();
+            newLine();
+            add(Utf8String{"}"});
+            newLine();
+            add(Utf8String{"else"});
+            newLine();
+            add(Utf8String{"{"});
+            indent();
+            search(middle, end);
+            unindent();
+            newLine();
+            add(Utf8String{"}"});
+        };
+        search(0, targets.size());
+        newLine();
+        add(Utf8String{"goto "} + defaultLabel + ";");
+
+        breakLabels.push_back(endLabel);
+        breakDepths.push_back(exitDepths());
+        for (size_t i = 0; i < s.cases.size(); ++i)
+        {
+            newLine();
+            add(prefix + "_case" + std::to_string(i) + ":");
+            newLine();
+            s.cases[i].body->accept(*this);
+            newLine();
+            add(Utf8String{"goto "} + endLabel + ";");
+        }
+        if (s.defaultBody)
+        {
+            newLine();
+            add(defaultLabel + ":");
+            newLine();
+            s.defaultBody->accept(*this);
+        }
+        breakDepths.pop_back();
+        breakLabels.pop_back();
+        newLine();
+        add(endLabel + ":;");
+        unindent();
+        newLine();
+        add(Utf8String{"}"});
         return nullptr;
     }
 
     void* CCompiler::visit(ast::TernaryOpExpression &t)
     {
+        add(Utf8String{"(" });
         t.condition->accept(*this);
         add(Utf8String{" ? " });
-        Utf8String *trueExpr = (Utf8String*) t.trueExpr->accept(*this);
+        t.trueExpr->accept(*this);
         add(Utf8String{" : " });
-        Utf8String *falseExpr = (Utf8String*) t.falseExpr->accept(*this);
+        t.falseExpr->accept(*this);
+        add(Utf8String{")" });
         return nullptr;
     }
 
@@ -524,7 +1593,14 @@ namespace px
         }
 
         add( Utf8String{ opToken  });
+        // A cast that needs no conversion is left out, so either operand could start with an
+        // operator of its own, and two minuses would read as a decrement
+        bool nested = e.expression->nodeType == ast::NodeType::EXP_UNARY_OP || e.expression->nodeType == ast::NodeType::EXP_CAST;
+        if (nested)
+            add(Utf8String{"("});
         e.expression->accept(*this);
+        if (nested)
+            add(Utf8String{")"});
         return nullptr;
     }
 
@@ -532,10 +1608,47 @@ namespace px
     {
         auto symbolTable = currentScope->symbols();
         auto pxType = symbolTable->getType(v.typeName);
+        if (pxType->isFuture())
+        {
+            compileSpawn(v);
+            return nullptr;
+        }
         Utf8String cTypeName = pxTypeToCType(pxType);
+        if (pxType->isContainer() && (v.initialValue == nullptr || !isMoved(*v.initialValue)))
+        {
+            if (currentFunction == nullptr)
+            {
+                add(cTypeName + " " + v.name + " = { 0 };");
+                return nullptr;
+            }
+            add(cTypeName + " " + v.name + (pxType->isMap() ? " = pxMapCreate();" : " = pxVectorCreate();"));
+            if (v.initialValue != nullptr)
+            {
+                add(Utf8String{" "});
+                assignContainer(v.name, pxType, *v.initialValue);
+            }
+            return nullptr;
+        }
         Utf8String arrayIndex;
         if (v.arraySize != nullptr) {
             arrayIndex = Utf8String("[") + std::to_string(*v.arraySize) + "]";
+
+            // A local array initialized with constants is not rebuilt on the stack each time the
+            // declaration runs: read-only arrays become static const, others copy a pooled constant
+            bool local = currentFunction != nullptr;
+            if (local && v.initialValue != nullptr && isConstantArray(*v.initialValue)) {
+                Variable *variable = symbolTable->getVariable(v.name, true);
+                Utf8String initializer = render(*v.initialValue);
+                if (variable != nullptr && !variable->mutated) {
+                    add(Utf8String{"static const "} + cTypeName + " " + v.name + arrayIndex + " = " + initializer + ";");
+                } else {
+                    Utf8String constant = poolArray(cTypeName, *v.arraySize, initializer);
+                    add(cTypeName + " " + v.name + arrayIndex + ";");
+                    newLine();
+                    add(Utf8String{"memcpy("} + v.name + ", " + constant + ", sizeof(" + v.name + "));");
+                }
+                return nullptr;
+            }
         }
         add(cTypeName + " " + v.name + arrayIndex);
         if (v.initialValue != nullptr) {
@@ -543,11 +1656,18 @@ namespace px
             v.initialValue->accept(*this);
         }
         add(Token::getTokenName(TokenType::OP_END_STATEMENT));
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::VariableExpression &v)
     {
+        if (isContainerParameter(v.variable))
+        {
+            add(Utf8String{"(*"} + v.variable + ")");
+            return nullptr;
+        }
         add( v.variable );
+        return nullptr;
     }
 
     void* CCompiler::visit(ast::WhileStatement & w)
@@ -558,30 +1678,73 @@ namespace px
 
         indent(w.body.get());
         newLine();
+        breakLabels.push_back("");
+        breakDepths.push_back(exitDepths());
+        continueDepths.push_back(exitDepths());
         w.body->accept(*this);
+        continueDepths.pop_back();
+        breakDepths.pop_back();
+        breakLabels.pop_back();
         unindent(w.body.get());
 
         return nullptr;
     }
 
-    Utf8String CCompiler::buildFunctionProto(Function *function) {
+    Utf8String CCompiler::buildFunctionSignature(Function *function) {
         Utf8String RT = pxTypeToCType(function->returnType);
+        bool restrict = function->hasAttribute(Function::RESTRICT_ARRAYS);
         Utf8String argsText;
         int a = 0, end = function->parameters.size();
         for (const Variable *arg : function->parameters)
         {
-            Utf8String argType = pxTypeToCType(arg->type);
-            argsText += argType + " " + arg->name;
+            if (arg->type->isArray())
+            {
+                Utf8String elementType = pxTypeToCType(((ArrayType*) arg->type)->elementType);
+                argsText += elementType + (restrict ? " *PX_RESTRICT " : " *") + arg->name;
+            }
+            else if (arg->type->isContainer())
+            {
+                argsText += pxTypeToCType(arg->type) + " *" + arg->name;
+            }
+            else
+            {
+                argsText += pxTypeToCType(arg->type) + " " + arg->name;
+            }
             if(++a < end)
             {
                 argsText += ", ";
             }
         }
+
         Utf8String flags;
         if(function->isExtern)
         {
             flags += "extern ";
         }
-        return flags + RT + " " + function->name + "(" + argsText + ");\n";
+        else if (function->visibility == Visibility::PRIVATE)
+        {
+            flags += "static ";
+        }
+        else if (function->visibility == Visibility::PROTECTED)
+        {
+            flags += "PX_HIDDEN ";
+        }
+
+        if (function->hasAttribute(Function::ALWAYS_INLINE))
+            flags += "PX_ALWAYS_INLINE ";
+        else if (function->hasAttribute(Function::NO_INLINE))
+            flags += "PX_NOINLINE ";
+        if (function->hasAttribute(Function::CONST))
+            flags += "PX_CONST ";
+        else if (function->hasAttribute(Function::PURE))
+            flags += "PX_PURE ";
+        if (function->hasAttribute(Function::NO_RETURN))
+            flags += "PX_NORETURN ";
+
+        return flags + RT + " " + function->name + "(" + argsText + ")";
+    }
+
+    Utf8String CCompiler::buildFunctionProto(Function *function) {
+        return buildFunctionSignature(function) + ";\n";
     }
 }
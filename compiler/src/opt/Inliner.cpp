@@ -0,0 +1,818 @@
+
+#include "opt/Inliner.h"
+#include "IO.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+namespace px
+{
+    namespace
+    {
+        class NodeCounter : public ast::RecursiveVisitor
+        {
+        public:
+            size_t count = 0;
+
+        protected:
+            void traverse(std::unique_ptr<ast::Expression> &expression) override
+            {
+                ++count;
+                expression->accept(*this);
+            }
+
+            void traverse(std::unique_ptr<ast::Statement> &statement) override
+            {
+                ++count;
+                statement->accept(*this);
+            }
+        };
+
+        class CallCollector : public ast::RecursiveVisitor
+        {
+        public:
+            std::vector<Utf8String> callees;
+
+            void *visit(ast::FunctionCallExpression &f) override
+            {
+                callees.push_back(f.functionName);
+                return RecursiveVisitor::visit(f);
+            }
+        };
+
+        class UseCounter : public ast::RecursiveVisitor
+        {
+        public:
+            std::unordered_map<Utf8String, size_t> uses;
+
+            void *visit(ast::VariableExpression &v) override
+            {
+                ++uses[v.variable];
+                return nullptr;
+            }
+        };
+
+        // Finds the names of the variables a subtree reads or assigns
+        class NameCollector : public ast::RecursiveVisitor
+        {
+        public:
+            std::unordered_set<Utf8String> names;
+
+            void *visit(ast::AssignmentStatement &a) override
+            {
+                names.insert(a.variableName);
+                return RecursiveVisitor::visit(a);
+            }
+
+            void *visit(ast::VariableExpression &v) override
+            {
+                names.insert(v.variable);
+                return nullptr;
+            }
+        };
+
+        // Finds the variables that are only evaluated under a condition: in the branches of ?: and
+        // on the right of && and ||
+        class ConditionalUseFinder : public ast::RecursiveVisitor
+        {
+        public:
+            std::unordered_set<Utf8String> conditional;
+
+            void *visit(ast::BinaryOpExpression &b) override
+            {
+                b.left->accept(*this);
+                bool shortCircuit = b.op == ast::BinaryOperator::AND || b.op == ast::BinaryOperator::OR;
+                depth += shortCircuit ? 1 : 0;
+                b.right->accept(*this);
+                depth -= shortCircuit ? 1 : 0;
+                return nullptr;
+            }
+
+            void *visit(ast::TernaryOpExpression &t) override
+            {
+                t.condition->accept(*this);
+                ++depth;
+                t.trueExpr->accept(*this);
+                t.falseExpr->accept(*this);
+                --depth;
+                return nullptr;
+            }
+
+            void *visit(ast::VariableExpression &v) override
+            {
+                if (depth > 0)
+                    conditional.insert(v.variable);
+                return nullptr;
+            }
+
+        private:
+            size_t depth = 0;
+        };
+
+        class DeclarationCollector : public ast::RecursiveVisitor
+        {
+        public:
+            std::unordered_set<Utf8String> names;
+            bool hasReturn = false;
+
+            void *visit(ast::VariableDeclaration &v) override
+            {
+                names.insert(v.name);
+                return RecursiveVisitor::visit(v);
+            }
+
+            void *visit(ast::ForStatement &f) override
+            {
+                names.insert(f.variableName);
+                return RecursiveVisitor::visit(f);
+            }
+
+            void *visit(ast::ReturnStatement &s) override
+            {
+                hasReturn = true;
+                return RecursiveVisitor::visit(s);
+            }
+        };
+
+        // Deep copies a subtree, renaming variables and substituting parameters on the way.
+        class Cloner : public ast::Visitor
+        {
+        public:
+            std::unordered_map<Utf8String, Utf8String> renames;
+            std::unordered_map<Utf8String, ast::Expression*> substitutions;
+
+            std::unique_ptr<ast::Expression> clone(const std::unique_ptr<ast::Expression> &expression)
+            {
+                return std::unique_ptr<ast::Expression>{ (ast::Expression*) expression->accept(*this) };
+            }
+
+            std::unique_ptr<ast::Statement> clone(const std::unique_ptr<ast::Statement> &statement)
+            {
+                return std::unique_ptr<ast::Statement>{ (ast::Statement*) statement->accept(*this) };
+            }
+
+            const Utf8String &rename(const Utf8String &name) const
+            {
+                auto it = renames.find(name);
+                return it != renames.end() ? it->second : name;
+            }
+
+            void *visit(ast::ArrayIndexReference &a) override
+            {
+                return new ast::ArrayIndexReference{ a.position, clone(a.array), clone(a.index) };
+            }
+
+            void *visit(ast::ArrayLiteral &a) override
+            {
+                auto literal = new ast::ArrayLiteral{ a.position };
+                for (auto &value : a.values)
+                    literal->addValue(clone(value));
+                return literal;
+            }
+
+            void *visit(ast::ArrayIndexAssignmentStatement &a) override
+            {
+                return new ast::ArrayIndexAssignmentStatement{ a.position, clone(a.reference), a.opType, clone(a.expression) };
+            }
+
+            void *visit(ast::AssignmentStatement &a) override
+            {
+                return new ast::AssignmentStatement{ a.position, rename(a.variableName), a.opType, clone(a.expression) };
+            }
+
+            void *visit(ast::AwaitExpression &a) override
+            {
+                return new ast::AwaitExpression{ a.position, clone(a.future) };
+            }
+
+            void *visit(ast::BinaryOpExpression &b) override
+            {
+                return new ast::BinaryOpExpression{ b.position, b.op, b.token, clone(b.left), clone(b.right) };
+            }
+
+            void *visit(ast::BlockStatement &s) override
+            {
+                auto block = new ast::BlockStatement{ s.position };
+                for (auto &statement : s.statements)
+                    block->addStatement(clone(statement));
+                return block;
+            }
+
+            void *visit(ast::BoolLiteral &b) override
+            {
+                return new ast::BoolLiteral{ b.position, b.literal };
+            }
+
+            void *visit(ast::BreakStatement &b) override
+            {
+                return new ast::BreakStatement{ b.position };
+            }
+
+            void *visit(ast::CastExpression &c) override
+            {
+                return new ast::CastExpression{ c.position, c.newTypeName, clone(c.expression) };
+            }
+
+            void *visit(ast::CharLiteral &c) override
+            {
+                return new ast::CharLiteral{ c.position, c.literal };
+            }
+
+            void *visit(ast::ContinueStatement &c) override
+            {
+                return new ast::ContinueStatement{ c.position };
+            }
+
+            void *visit(ast::DoWhileStatement &d) override
+            {
+                return new ast::DoWhileStatement{ d.position, clone(d.condition), clone(d.body) };
+            }
+
+            void *visit(ast::ExpressionStatement &s) override
+            {
+                return new ast::ExpressionStatement{ s.position, clone(s.expression) };
+            }
+
+            void *visit(ast::FloatLiteral &f) override
+            {
+                return new ast::FloatLiteral{ f.position, f.type, f.literal };
+            }
+
+            void *visit(ast::ForStatement &f) override
+            {
+                return new ast::ForStatement{ f.position, rename(f.variableName), f.typeName, clone(f.start), clone(f.end), clone(f.body), f.parallel };
+            }
+
+            void *visit(ast::FunctionCallExpression &f) override
+            {
+                std::vector<std::unique_ptr<ast::Expression>> arguments;
+                for (auto &argument : f.arguments)
+                    arguments.push_back(clone(argument));
+                return new ast::FunctionCallExpression{ f.position, f.functionName, std::move(arguments) };
+            }
+
+            void *visit(ast::FunctionDeclaration &f) override
+            {
+                return nullptr;
+            }
+
+            void *visit(ast::FunctionDefinition &f) override
+            {
+                return nullptr;
+            }
+
+            void *visit(ast::IfStatement &i) override
+            {
+                std::unique_ptr<ast::Statement> elseStatement;
+                if (i.elseStatement)
+                    elseStatement = clone(i.elseStatement);
+                return new ast::IfStatement{ i.position, clone(i.condition), clone(i.trueStatement), std::move(elseStatement) };
+            }
+
+            void *visit(ast::IntegerLiteral &i) override
+            {
+                return new ast::IntegerLiteral{ i.position, i.type, i.literal, i.value };
+            }
+
+            void *visit(ast::Module &m) override
+            {
+                return nullptr;
+            }
+
+            void *visit(ast::RegionStatement &r) override
+            {
+                return new ast::RegionStatement{ r.position, cloneBlock(*r.body) };
+            }
+
+            void *visit(ast::ReturnStatement &s) override
+            {
+                std::unique_ptr<ast::Expression> value;
+                if (s.returnValue)
+                    value = clone(s.returnValue);
+                return new ast::ReturnStatement{ s.position, std::move(value) };
+            }
+
+            void *visit(ast::SpawnExpression &s) override
+            {
+                auto call = (ast::FunctionCallExpression*) s.call->accept(*this);
+                return new ast::SpawnExpression{ s.position, std::unique_ptr<ast::FunctionCallExpression>{ call } };
+            }
+
+            void *visit(ast::StringLiteral &s) override
+            {
+                return new ast::StringLiteral{ s.position, s.literal };
+            }
+
+            void *visit(ast::SwitchStatement &s) override
+            {
+                std::vector<ast::SwitchCase> cases;
+                for (auto &switchCase : s.cases)
+                {
+                    std::vector<std::unique_ptr<ast::Expression>> values;
+                    for (auto &value : switchCase.values)
+                        values.push_back(clone(value));
+                    cases.emplace_back(switchCase.position, std::move(values), cloneBlock(*switchCase.body));
+                }
+                std::unique_ptr<ast::BlockStatement> defaultBody;
+                if (s.defaultBody)
+                    defaultBody = cloneBlock(*s.defaultBody);
+                return new ast::SwitchStatement{ s.position, clone(s.scrutinee), std::move(cases), std::move(defaultBody) };
+            }
+
+            std::unique_ptr<ast::BlockStatement> cloneBlock(ast::BlockStatement &block)
+            {
+                return std::unique_ptr<ast::BlockStatement>{ (ast::BlockStatement*) block.accept(*this) };
+            }
+
+            void *visit(ast::TernaryOpExpression &t) override
+            {
+                return new ast::TernaryOpExpression{ t.position, clone(t.condition), clone(t.trueExpr), clone(t.falseExpr) };
+            }
+
+            void *visit(ast::UnaryOpExpression &u) override
+            {
+                return new ast::UnaryOpExpression{ u.position, u.op, u.token, clone(u.expression) };
+            }
+
+            void *visit(ast::VariableDeclaration &v) override
+            {
+                std::unique_ptr<ast::Expression> value;
+                if (v.initialValue)
+                    value = clone(v.initialValue);
+                int64_t *arraySize = v.arraySize != nullptr ? new int64_t(*v.arraySize) : nullptr;
+                return new ast::VariableDeclaration{ v.position, v.typeName, rename(v.name), std::move(value), arraySize };
+            }
+
+            void *visit(ast::VariableExpression &v) override
+            {
+                auto substitution = substitutions.find(v.variable);
+                if (substitution != substitutions.end())
+                {
+                    // The argument belongs to the caller, so it is copied without renaming.
+                    Cloner argumentCloner;
+                    return substitution->second->accept(argumentCloner);
+                }
+                return new ast::VariableExpression{ v.position, rename(v.variable) };
+            }
+
+            void *visit(ast::WhileStatement &w) override
+            {
+                return new ast::WhileStatement{ w.position, clone(w.condition), clone(w.body) };
+            }
+        };
+
+        bool hasCall(std::unique_ptr<ast::Expression> &expression)
+        {
+            CallCollector collector;
+            expression->accept(collector);
+            return !collector.callees.empty();
+        }
+
+        bool isTrivial(const ast::Expression &expression)
+        {
+            switch (expression.nodeType)
+            {
+                case ast::NodeType::EXP_VAR_LOAD:
+                case ast::NodeType::LITERAL_BOOL:
+                case ast::NodeType::LITERAL_CHAR:
+                case ast::NodeType::LITERAL_FLOAT:
+                case ast::NodeType::LITERAL_INT:
+                case ast::NodeType::LITERAL_STRING:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    }
+
+    Inliner::Inliner(size_t inlineThreshold) : threshold{ inlineThreshold }, inlineCount{ 0 }
+    {
+    }
+
+    size_t Inliner::cost(ast::AST &node)
+    {
+        NodeCounter counter;
+        node.accept(counter);
+        return counter.count;
+    }
+
+    void Inliner::run(ast::Module &module)
+    {
+        std::vector<Utf8String> order;
+        for (auto &statement : module.statements)
+        {
+            if (statement->nodeType != ast::NodeType::DECLARE_FUNC_BODY)
+                continue;
+
+            auto definition = (ast::FunctionDefinition*) statement.get();
+            const Utf8String &name = definition->prototype->name;
+            if (candidates.count(name) != 0)
+                continue;
+
+            candidates[name] = Candidate{ definition, Shape::NONE, 0, false, {} };
+            auto assumed = assumedCalls.find(name);
+            if (assumed != assumedCalls.end())
+            {
+                callGraph[name] = assumed->second;
+                continue;
+            }
+            CallCollector collector;
+            definition->block->accept(collector);
+            callGraph[name] = std::move(collector.callees);
+            order.push_back(name);
+        }
+
+        findRecursion();
+
+        // Inline bottom-up so that a callee's body is final before it is copied into its callers.
+        std::unordered_set<Utf8String> visited;
+        std::function<void(const Utf8String&)> process = [&](const Utf8String &name)
+        {
+            if (!visited.insert(name).second)
+                return;
+            for (auto &callee : callGraph[name])
+            {
+                if (candidates.count(callee) != 0 && assumedCalls.count(callee) == 0)
+                    process(callee);
+            }
+            Candidate &candidate = candidates[name];
+            candidate.definition->accept(*this);
+            analyzeCandidate(candidate);
+            findGlobals(candidate);
+        };
+        for (auto &name : order)
+            process(name);
+
+        currentFunction = Utf8String{ "<module>" };
+        callerNames.clear();
+        for (auto &statement : module.statements)
+        {
+            if (statement->nodeType != ast::NodeType::DECLARE_FUNC_BODY)
+                traverse(statement);
+        }
+    }
+
+    void Inliner::assumeCalls(const Utf8String &function, const std::vector<Utf8String> &callees)
+    {
+        assumedCalls[function] = callees;
+    }
+
+    bool Inliner::inlinable(const Utf8String &function) const
+    {
+        auto candidate = candidates.find(function);
+        return candidate != candidates.end() && candidate->second.shape != Shape::NONE && candidate->second.cost <= threshold;
+    }
+
+    void Inliner::findRecursion()
+    {
+        // Tarjan's strongly connected components over the call graph of the module.
+        std::unordered_map<Utf8String, size_t> index, lowLink;
+        std::unordered_set<Utf8String> onStack;
+        std::vector<Utf8String> stack;
+        size_t nextIndex = 0;
+
+        std::function<void(const Utf8String&)> connect = [&](const Utf8String &name)
+        {
+            index[name] = lowLink[name] = nextIndex++;
+            stack.push_back(name);
+            onStack.insert(name);
+            for (auto &callee : callGraph[name])
+            {
+                if (candidates.count(callee) == 0)
+                    continue;
+                if (index.count(callee) == 0)
+                {
+                    connect(callee);
+                    lowLink[name] = std::min(lowLink[name], lowLink[callee]);
+                }
+                else if (onStack.count(callee) != 0)
+                {
+                    lowLink[name] = std::min(lowLink[name], index[callee]);
+                }
+            }
+
+            if (lowLink[name] == index[name])
+            {
+                std::vector<Utf8String> component;
+                Utf8String member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack.erase(member);
+                    component.push_back(member);
+                } while (member != name);
+
+                auto &callees = callGraph[name];
+                bool selfCall = std::find(callees.begin(), callees.end(), name) != callees.end();
+                if (component.size() > 1 || selfCall)
+                {
+                    for (auto &recursive : component)
+                        candidates[recursive].recursive = true;
+                }
+            }
+        };
+
+        for (auto &entry : candidates)
+        {
+            if (index.count(entry.first) == 0)
+                connect(entry.first);
+        }
+    }
+
+    void Inliner::analyzeCandidate(Candidate &candidate)
+    {
+        ast::FunctionDefinition &definition = *candidate.definition;
+        auto &statements = definition.block->statements;
+        candidate.cost = cost(*definition.block);
+
+        if (statements.size() == 1 && statements[0]->nodeType == ast::NodeType::STMT_RETURN
+            && ((ast::ReturnStatement*) statements[0].get())->returnValue != nullptr)
+        {
+            candidate.shape = Shape::EXPRESSION;
+            return;
+        }
+
+        if (definition.prototype->returnTypeName != Utf8String{ "void" })
+            return;
+
+        DeclarationCollector collector;
+        for (size_t i = 0; i < statements.size(); ++i)
+        {
+            bool trailingReturn = i + 1 == statements.size() && statements[i]->nodeType == ast::NodeType::STMT_RETURN;
+            if (!trailingReturn)
+                statements[i]->accept(collector);
+        }
+        if (!collector.hasReturn)
+            candidate.shape = Shape::BLOCK;
+    }
+
+    void Inliner::findGlobals(Candidate &candidate)
+    {
+        ast::FunctionDefinition &definition = *candidate.definition;
+        NameCollector used;
+        definition.block->accept(used);
+        DeclarationCollector declared;
+        definition.block->accept(declared);
+        candidate.globals.clear();
+        for (auto &name : used.names)
+        {
+            bool parameter = std::any_of(definition.prototype->parameters.begin(), definition.prototype->parameters.end(),
+                    [&](const ast::Parameter &p) { return p.name == name; });
+            if (!parameter && declared.names.count(name) == 0)
+                candidate.globals.insert(name);
+        }
+    }
+
+    Inliner::Candidate *Inliner::lookupCandidate(ast::FunctionCallExpression &call)
+    {
+        auto it = candidates.find(call.functionName);
+        if (it == candidates.end())
+            return nullptr;
+        return &it->second;
+    }
+
+    void Inliner::record(ast::FunctionCallExpression &call, const Candidate &candidate, bool inlined, const Utf8String &reason)
+    {
+        decisionLog.push_back(InlineDecision{ call.position, currentFunction, call.functionName, inlined, candidate.cost, reason });
+    }
+
+    bool Inliner::rejectArguments(Candidate &candidate, ast::FunctionCallExpression &call, Utf8String &reason)
+    {
+        auto &parameters = candidate.definition->prototype->parameters;
+        if (parameters.size() != call.arguments.size())
+        {
+            reason = "argument count does not match";
+            return true;
+        }
+        if (candidate.recursive)
+        {
+            reason = "recursive";
+            return true;
+        }
+        for (auto &parameter : parameters)
+        {
+            if (parameter.arraySize != nullptr)
+            {
+                reason = Utf8String{ "array parameter '" } + parameter.name + "' is passed by pointer";
+                return true;
+            }
+            if (parameter.typeName.endsWith("[]"))
+            {
+                reason = Utf8String{ "dynamic array parameter '" } + parameter.name + "' is passed by pointer";
+                return true;
+            }
+            if (parameter.typeName.startsWith("map["))
+            {
+                reason = Utf8String{ "map parameter '" } + parameter.name + "' is passed by pointer";
+                return true;
+            }
+        }
+        auto &returnTypeName = candidate.definition->prototype->returnTypeName;
+        if (returnTypeName.endsWith("[]") || returnTypeName.startsWith("map["))
+        {
+            reason = returnTypeName.startsWith("map[") ? "returns a map" : "returns a dynamic array";
+            return true;
+        }
+        if (candidate.cost > threshold)
+        {
+            reason = Utf8String{ "too large (cost " } + std::to_string(candidate.cost) + " > " + std::to_string(threshold) + ")";
+            return true;
+        }
+        if (candidate.shape == Shape::NONE)
+        {
+            reason = "body is not a single return expression";
+            return true;
+        }
+        // Names are not resolved yet, so a global of the callee would bind to a local of the caller
+        // with the same name
+        for (auto &global : candidate.globals)
+        {
+            if (callerNames.count(global) != 0)
+            {
+                reason = Utf8String{ "'" } + global + "' would refer to the caller's own variable";
+                return true;
+            }
+        }
+        if (candidate.shape != Shape::EXPRESSION)
+            return false;
+
+        // The arguments are substituted into the returned expression, so each one must still be
+        // evaluated exactly as often as the call would have evaluated it, and one with calls must
+        // still be evaluated before anything the body calls. C leaves the order of most operands
+        // open, so a body with calls of its own takes no argument with calls.
+        auto returnStatement = (ast::ReturnStatement*) candidate.definition->block->statements[0].get();
+        UseCounter counter;
+        returnStatement->returnValue->accept(counter);
+        ConditionalUseFinder conditionalUses;
+        returnStatement->returnValue->accept(conditionalUses);
+        bool bodyCalls = hasCall(returnStatement->returnValue);
+        size_t impureArguments = 0;
+        for (size_t i = 0; i < parameters.size(); ++i)
+        {
+            size_t uses = counter.uses[parameters[i].name];
+            auto &argument = call.arguments[i];
+            if (hasCall(argument))
+            {
+                ++impureArguments;
+                if (uses != 1)
+                {
+                    reason = Utf8String{ "argument for '" } + parameters[i].name + "' has side effects";
+                    return true;
+                }
+                if (conditionalUses.conditional.count(parameters[i].name) != 0)
+                {
+                    reason = Utf8String{ "argument for '" } + parameters[i].name + "' has side effects and would only be evaluated conditionally";
+                    return true;
+                }
+                if (bodyCalls)
+                {
+                    reason = Utf8String{ "argument for '" } + parameters[i].name + "' has side effects and the body's calls could run before it";
+                    return true;
+                }
+            }
+            else if (uses > 1 && !isTrivial(*argument))
+            {
+                reason = Utf8String{ "argument for '" } + parameters[i].name + "' would be evaluated " + std::to_string(uses) + " times";
+                return true;
+            }
+        }
+        if (impureArguments > 1)
+        {
+            reason = "would reorder side effects of the arguments";
+            return true;
+        }
+        return false;
+    }
+
+    std::unique_ptr<ast::Expression> Inliner::inlineExpression(Candidate &candidate, ast::FunctionCallExpression &call)
+    {
+        auto &prototype = *candidate.definition->prototype;
+        auto returnStatement = (ast::ReturnStatement*) candidate.definition->block->statements[0].get();
+
+        // Every argument is converted to its parameter's type, as the call would have done.
+        std::vector<std::unique_ptr<ast::Expression>> converted;
+        Cloner cloner;
+        for (size_t i = 0; i < prototype.parameters.size(); ++i)
+        {
+            auto &parameter = prototype.parameters[i];
+            auto &argument = call.arguments[i];
+            converted.push_back(std::make_unique<ast::CastExpression>(argument->position, parameter.typeName, std::move(argument)));
+            cloner.substitutions[parameter.name] = converted.back().get();
+        }
+
+        return std::make_unique<ast::CastExpression>(call.position, prototype.returnTypeName, cloner.clone(returnStatement->returnValue));
+    }
+
+    std::unique_ptr<ast::Statement> Inliner::inlineBlock(Candidate &candidate, ast::FunctionCallExpression &call)
+    {
+        auto &prototype = *candidate.definition->prototype;
+        auto &statements = candidate.definition->block->statements;
+        Utf8String prefix = Utf8String{ "_inl" } + std::to_string(++inlineCount) + "_";
+
+        // Parameters and locals of the callee get names that can not be written in px source,
+        // so they never capture or shadow the caller's variables.
+        DeclarationCollector collector;
+        candidate.definition->block->accept(collector);
+        Cloner cloner;
+        for (auto &name : collector.names)
+            cloner.renames[name] = prefix + name;
+        for (auto &parameter : prototype.parameters)
+            cloner.renames[parameter.name] = prefix + parameter.name;
+
+        auto block = std::make_unique<ast::BlockStatement>(call.position);
+        for (size_t i = 0; i < prototype.parameters.size(); ++i)
+        {
+            auto &parameter = prototype.parameters[i];
+            block->addStatement(std::make_unique<ast::VariableDeclaration>(call.arguments[i]->position, parameter.typeName,
+                    prefix + parameter.name, std::move(call.arguments[i]), nullptr));
+        }
+        for (auto &statement : statements)
+        {
+            if (statement->nodeType == ast::NodeType::STMT_RETURN)
+                continue;
+            block->addStatement(cloner.clone(statement));
+        }
+        return block;
+    }
+
+    void *Inliner::visit(ast::FunctionDefinition &f)
+    {
+        Utf8String previousFunction = currentFunction;
+        auto previousNames = std::move(callerNames);
+        currentFunction = f.prototype->name;
+        DeclarationCollector collector;
+        f.block->accept(collector);
+        callerNames = std::move(collector.names);
+        for (auto &parameter : f.prototype->parameters)
+            callerNames.insert(parameter.name);
+        f.block->accept(*this);
+        currentFunction = previousFunction;
+        callerNames = std::move(previousNames);
+        return nullptr;
+    }
+
+    void Inliner::traverse(std::unique_ptr<ast::Expression> &expression)
+    {
+        expression->accept(*this);
+        if (expression->nodeType != ast::NodeType::EXP_FUNC_CALL)
+            return;
+
+        auto call = (ast::FunctionCallExpression*) expression.get();
+        Candidate *candidate = lookupCandidate(*call);
+        if (candidate == nullptr || candidate->shape == Shape::BLOCK)
+            return;
+
+        Utf8String reason;
+        if (rejectArguments(*candidate, *call, reason))
+        {
+            record(*call, *candidate, false, reason);
+            return;
+        }
+
+        record(*call, *candidate, true, reason);
+        expression = inlineExpression(*candidate, *call);
+    }
+
+    void Inliner::traverse(std::unique_ptr<ast::Statement> &statement)
+    {
+        statement->accept(*this);
+        if (statement->nodeType != ast::NodeType::STMT_EXP)
+            return;
+
+        auto expression = ((ast::ExpressionStatement*) statement.get())->expression.get();
+        if (expression->nodeType != ast::NodeType::EXP_FUNC_CALL)
+            return;
+
+        auto call = (ast::FunctionCallExpression*) expression;
+        Candidate *candidate = lookupCandidate(*call);
+        if (candidate == nullptr || candidate->shape != Shape::BLOCK)
+            return;
+
+        Utf8String reason;
+        if (rejectArguments(*candidate, *call, reason))
+        {
+            record(*call, *candidate, false, reason);
+            return;
+        }
+
+        record(*call, *candidate, true, reason);
+        statement = inlineBlock(*candidate, *call);
+    }
+
+    void Inliner::outputReport() const
+    {
+        UFILE *out = u_get_stdout();
+        for (auto &decision : decisionLog)
+        {
+            auto &position = decision.position;
+            Utf8String message = position.fileName + "(" + std::to_string(position.line) + ", " + std::to_string(position.lineColumn) + "): ";
+            if (decision.inlined)
+                message += Utf8String{ "inlined '" } + decision.callee + "' into '" + decision.caller + "' (cost " + std::to_string(decision.cost) + ")";
+            else
+                message += Utf8String{ "not inlined '" } + decision.callee + "' into '" + decision.caller + "': " + decision.reason;
+            writeString(out, message);
+        }
+    }
+}
@@ -0,0 +1,1235 @@
+#include "vm/BytecodeCompiler.h"
+#include "vm/Natives.h"
+#include "Token.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace px
+{
+
+    // Switches whose cases spread over more than this many values per case, or over more than
+    // DENSE_SWITCH_MAX_TARGETS values, search a sorted table instead of indexing one that spans them
+    static const uint64_t SPARSE_SWITCH_SPREAD = 3;
+    static const uint64_t DENSE_SWITCH_MAX_TARGETS = 4096;
+
+    BytecodeCompiler::BytecodeCompiler(ScopeTree *tree, ErrorLog *log)
+        : scopeTree{ tree }, currentScope{ tree->current() }, moduleScope{}, errors{ log }, state{}, initializer{}, target{}
+    {
+    }
+
+    void BytecodeCompiler::startProgram(const char *initializerName)
+    {
+        program.reset(new Program{});
+        program->globalCount = 0;
+        program->main = -1;
+        program->initializer = 0;
+        program->functions.push_back(BytecodeFunction{ initializerName, {}, 0, 0, false });
+    }
+
+    std::unique_ptr<Program> BytecodeCompiler::compile(ast::Module &module)
+    {
+        startProgram("<init>");
+        state = &initializer;
+        beginFunction(program->initializer, nullptr);
+
+        module.accept(*this);
+
+        for (auto &use : firstUses)
+        {
+            if (!program->functions[functionIndexes[use.first]].defined)
+                error(use.second, Utf8String{ "Function " } + use.first->name + " is declared but never defined");
+        }
+        return std::move(program);
+    }
+
+    bool BytecodeCompiler::isDisplayable(const Type *type)
+    {
+        return type->isBool() || type->isInt() || type->isUInt() || type->isFloat() || type->isChar() || type->isString();
+    }
+
+    // Every input is compiled into the initializer, which the REPL calls on its own. The module scope
+    // is entered once, by the first input, and stays entered.
+    uint32_t BytecodeCompiler::compileInput(ast::Module &input)
+    {
+        if (program == nullptr)
+        {
+            startProgram("<input>");
+            currentScope = scopeTree->enterScope();
+            moduleScope = currentScope;
+        }
+        state = &initializer;
+        beginFunction(program->initializer, nullptr);
+        for (size_t i = 0; i < input.statements.size(); ++i)
+        {
+            ast::Statement &statement = *input.statements[i];
+            // An input that ends with a scalar or string expression gives its value
+            ast::Expression *value = nullptr;
+            if (i + 1 == input.statements.size() && statement.nodeType == ast::NodeType::STMT_EXP)
+                value = ((ast::ExpressionStatement&) statement).expression.get();
+            if (value != nullptr && isDisplayable(value->type))
+                emit(Opcode::RETURN, operand(*value));
+            else
+                statement.accept(*this);
+            state->nextRegister = state->localsTop;
+        }
+        endFunction(input.position);
+        return program->initializer;
+    }
+
+    void BytecodeCompiler::skipInput()
+    {
+        if (program == nullptr)
+        {
+            startProgram("<input>");
+            currentScope = scopeTree->enterScope();
+            moduleScope = currentScope;
+        }
+        currentScope->skipScopes();
+    }
+
+    size_t BytecodeCompiler::emit(Opcode op, uint32_t a, uint32_t b, uint32_t c)
+    {
+        // Compiled code would have its own copies of the module's variables
+        if (op == Opcode::LOAD_GLOBAL || op == Opcode::STORE_GLOBAL || op == Opcode::GLOBAL_ADDRESS)
+            uncompilable("it uses module variables");
+        auto &code = program->functions[state->index].code;
+        code.push_back(Instruction{ op, (uint16_t) a, (uint16_t) b, (uint16_t) c });
+        return code.size() - 1;
+    }
+
+    size_t BytecodeCompiler::emitWide(Opcode op, uint32_t a, int32_t wide)
+    {
+        size_t instruction = emit(op, a);
+        program->functions[state->index].code[instruction].setWide(wide);
+        return instruction;
+    }
+
+    size_t BytecodeCompiler::here() const
+    {
+        return program->functions[state->index].code.size();
+    }
+
+    void BytecodeCompiler::patch(size_t jump, size_t target)
+    {
+        program->functions[state->index].code[jump].setWide((int32_t) target);
+    }
+
+    uint16_t BytecodeCompiler::allocate(uint32_t count)
+    {
+        uint32_t first = state->nextRegister;
+        state->nextRegister += count;
+        state->registerCount = std::max(state->registerCount, state->nextRegister);
+        return (uint16_t) first;
+    }
+
+    uint32_t BytecodeCompiler::allocateStorage(uint32_t count)
+    {
+        uint32_t offset = state->storageSize;
+        state->storageSize += count;
+        return offset;
+    }
+
+    // Points target at storage, whose offset is only known once every register has been allocated
+    void BytecodeCompiler::addressStorage(uint16_t target, uint32_t offset)
+    {
+        state->storageAddresses.push_back(emitWide(Opcode::ADDRESS, target, (int32_t) offset));
+    }
+
+    uint32_t BytecodeCompiler::constant(const Value &value)
+    {
+        program->constants.push_back(value);
+        return (uint32_t) program->constants.size() - 1;
+    }
+
+    // Strings are built the way the CCompiler pools them: short ones inline, long ones pointing at their bytes
+    uint32_t BytecodeCompiler::stringConstant(const Utf8String &text)
+    {
+        auto entry = stringConstants.find(text);
+        if (entry != stringConstants.end())
+            return entry->second;
+
+        Value value;
+        std::memset(&value, 0, sizeof(value));
+        size_t byteLength = text.byteLength();
+        if (byteLength <= PX_STRING_INLINE_CAPACITY)
+        {
+            std::memcpy(value.s.data.inlineBytes, text.c_str(), byteLength);
+        }
+        else
+        {
+            program->strings.emplace_back(text.c_str(), byteLength);
+            value.s.data.bytes = (const int8_t*) program->strings.back().data();
+        }
+        value.s.length = (intptr_t) text.length();
+        value.s.byteLength = (intptr_t) byteLength;
+        uint32_t index = constant(value);
+        stringConstants[text] = index;
+        return index;
+    }
+
+    uint32_t BytecodeCompiler::functionIndex(Function *function, const SourcePosition &position)
+    {
+        auto entry = functionIndexes.find(function);
+        if (entry != functionIndexes.end())
+            return entry->second;
+
+        uint32_t index = (uint32_t) program->functions.size();
+        // Until it is defined, calling the function stops the program, which only the REPL can do
+        program->functions.push_back(BytecodeFunction{ function->name, { Instruction{ Opcode::UNDEFINED, 0, 0, 0 } },
+                                                       (uint32_t) function->parameters.size(), 0, false });
+        functionIndexes[function] = index;
+        firstUses.emplace_back(function, position);
+        return index;
+    }
+
+    // The index of the runtime function an extern function calls, or -1 when the interpreter has none
+    int32_t BytecodeCompiler::nativeIndex(Function *function)
+    {
+        auto entry = nativeIndexes.find(function);
+        if (entry != nativeIndexes.end())
+            return entry->second;
+
+        int32_t index = -1;
+        NativeFunction native = findNative(function->name);
+        if (native != nullptr)
+        {
+            index = (int32_t) program->natives.size();
+            program->natives.push_back(native);
+        }
+        nativeIndexes[function] = index;
+        return index;
+    }
+
+    // Keeps the first reason found
+    void BytecodeCompiler::uncompilable(const char *reason)
+    {
+        auto &function = program->functions[state->index];
+        if (function.uncompilable.length() == 0)
+            function.uncompilable = reason;
+    }
+
+    void BytecodeCompiler::error(const SourcePosition &position, const Utf8String &message)
+    {
+        errors->addError(Error{ position, message });
+    }
+
+    Variable *BytecodeCompiler::lookup(const Utf8String &name)
+    {
+        return currentScope->symbols()->getVariable(name);
+    }
+
+    bool BytecodeCompiler::isParameter(Variable *variable) const
+    {
+        if (state->function == nullptr)
+            return false;
+        auto &parameters = state->function->parameters;
+        return std::find(parameters.begin(), parameters.end(), variable) != parameters.end();
+    }
+
+    void BytecodeCompiler::compileInto(ast::Expression &expression, uint16_t into)
+    {
+        uint16_t outer = target;
+        target = into;
+        expression.accept(*this);
+        target = outer;
+    }
+
+    // The register holding the value of expression: a local variable's own register, or a new temporary
+    uint16_t BytecodeCompiler::operand(ast::Expression &expression)
+    {
+        if (expression.nodeType == ast::NodeType::EXP_VAR_LOAD)
+        {
+            auto local = state->locals.find(lookup(((ast::VariableExpression&) expression).variable));
+            if (local != state->locals.end())
+                return local->second;
+        }
+        uint16_t value = allocate();
+        compileInto(expression, value);
+        return value;
+    }
+
+    // A register pointing to a dynamic array. Calls give the vector itself, which is kept in a temporary.
+    uint16_t BytecodeCompiler::containerPointer(ast::Expression &expression)
+    {
+        if (expression.nodeType != ast::NodeType::EXP_FUNC_CALL)
+            return operand(expression);
+        uint16_t value = allocate();
+        compileInto(expression, value);
+        uint16_t pointer = allocate();
+        emitWide(Opcode::ADDRESS, pointer, value);
+        return pointer;
+    }
+
+    void BytecodeCompiler::compileArithmetic(ast::BinaryOperator op, Type *type, uint16_t into, uint16_t left, uint16_t right)
+    {
+        bool isFloat = type->isFloat();
+        bool isUnsigned = type->isUInt();
+        switch (op)
+        {
+            case ast::BinaryOperator::ADD:
+                emit(isFloat ? Opcode::ADD_F : Opcode::ADD_I, into, left, right);
+                break;
+            case ast::BinaryOperator::SUB:
+                emit(isFloat ? Opcode::SUB_F : Opcode::SUB_I, into, left, right);
+                break;
+            case ast::BinaryOperator::MUL:
+                emit(isFloat ? Opcode::MUL_F : Opcode::MUL_I, into, left, right);
+                break;
+            case ast::BinaryOperator::DIV:
+                emit(isFloat ? Opcode::DIV_F : isUnsigned ? Opcode::DIV_U : Opcode::DIV_I, into, left, right);
+                break;
+            case ast::BinaryOperator::MOD:
+                emit(isUnsigned ? Opcode::MOD_U : Opcode::MOD_I, into, left, right);
+                return;
+            case ast::BinaryOperator::LSH:
+                emit(Opcode::SHL, into, left, right);
+                break;
+            // These can not leave the range of their operands
+            case ast::BinaryOperator::RSH:
+                emit(isUnsigned ? Opcode::SHR_U : Opcode::SHR_I, into, left, right);
+                return;
+            case ast::BinaryOperator::BIT_AND:
+                emit(Opcode::AND, into, left, right);
+                return;
+            case ast::BinaryOperator::BIT_OR:
+                emit(Opcode::OR, into, left, right);
+                return;
+            case ast::BinaryOperator::BIT_XOR:
+                emit(Opcode::XOR, into, left, right);
+                return;
+            default:
+                return;
+        }
+        narrow(type, into);
+    }
+
+    // Wraps a result computed in 64 bits around to the width of type, or rounds it to float precision
+    void BytecodeCompiler::narrow(Type *type, uint16_t into)
+    {
+        if (type->isFloat())
+        {
+            if (type->size == 4)
+                emit(Opcode::ROUND_F32, into);
+            return;
+        }
+        if (!type->isInt() && !type->isUInt())
+            return;
+        bool isUnsigned = type->isUInt();
+        switch (type->size)
+        {
+            case 1:
+                emit(isUnsigned ? Opcode::NARROW_U8 : Opcode::NARROW_I8, into);
+                break;
+            case 2:
+                emit(isUnsigned ? Opcode::NARROW_U16 : Opcode::NARROW_I16, into);
+                break;
+            case 4:
+                emit(isUnsigned ? Opcode::NARROW_U32 : Opcode::NARROW_I32, into);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // The arguments go in consecutive registers, where the callee's frame starts for a call
+    void BytecodeCompiler::compileCall(ast::FunctionCallExpression &call, uint16_t into)
+    {
+        if (call.containerOperation != ast::ContainerOperation::NONE)
+        {
+            compileContainerOperation(call, into);
+            return;
+        }
+        Function *function = call.function;
+        uint16_t base = allocate((uint32_t) call.arguments.size());
+        for (size_t i = 0; i < call.arguments.size(); ++i)
+        {
+            auto &argument = *call.arguments[i];
+            uint16_t slot = (uint16_t) (base + i);
+            if (argument.type->isContainer())
+            {
+                uint16_t pointer = containerPointer(argument);
+                if (pointer != slot)
+                    emit(Opcode::MOVE, slot, pointer);
+            }
+            else
+            {
+                compileInto(argument, slot);
+            }
+        }
+
+        if (function->isExtern)
+        {
+            int32_t native = nativeIndex(function);
+            if (native < 0)
+                error(call.position, Utf8String{ "Function " } + function->name + " is not available in pxc run");
+            else
+                emit(Opcode::CALL_NATIVE, into, (uint32_t) native, base);
+            return;
+        }
+        if (function->module.length() != 0)
+        {
+            error(call.position, Utf8String{ "Function " } + function->name + " is imported from module " + function->module + ", which pxc run can not load");
+            return;
+        }
+        uint32_t index = functionIndex(function, call.position);
+        if (index > UINT16_MAX)
+            error(call.position, Utf8String{ "Too many functions to call " } + function->name + " in pxc run");
+        emit(Opcode::CALL, into, index, base);
+    }
+
+    void BytecodeCompiler::storeArrayLiteral(ast::ArrayLiteral &literal, uint16_t array)
+    {
+        uint32_t mark = state->nextRegister;
+        for (size_t i = 0; i < literal.values.size(); ++i)
+        {
+            uint16_t value = operand(*literal.values[i]);
+            uint16_t index = allocate();
+            emitWide(Opcode::LOAD_INT, index, (int32_t) i);
+            emit(Opcode::ARRAY_STORE, array, index, value);
+            state->nextRegister = mark;
+        }
+    }
+
+    void BytecodeCompiler::compileContainerOperation(ast::FunctionCallExpression &call, uint16_t into)
+    {
+        if (call.arguments[0]->type->isMap())
+        {
+            error(call.position, Utf8String{ "Maps are not supported by pxc run" });
+            return;
+        }
+        switch (call.containerOperation)
+        {
+            case ast::ContainerOperation::PUSH:
+            {
+                // The value is computed first, since it may read the array that is growing
+                uint16_t value = operand(*call.arguments[1]);
+                emit(Opcode::VECTOR_PUSH, containerPointer(*call.arguments[0]), 0, value);
+                break;
+            }
+            case ast::ContainerOperation::POP:
+                emit(Opcode::VECTOR_POP, into, containerPointer(*call.arguments[0]));
+                break;
+            case ast::ContainerOperation::RESERVE:
+            {
+                uint16_t count = operand(*call.arguments[1]);
+                emit(Opcode::VECTOR_RESERVE, containerPointer(*call.arguments[0]), count);
+                break;
+            }
+            case ast::ContainerOperation::APPEND:
+            {
+                uint16_t vector = containerPointer(*call.arguments[0]);
+                emit(Opcode::VECTOR_APPEND, vector, containerPointer(*call.arguments[1]));
+                break;
+            }
+            case ast::ContainerOperation::LENGTH:
+                emit(Opcode::VECTOR_LENGTH, into, containerPointer(*call.arguments[0]));
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Copies the elements of a fixed or dynamic array expression into the dynamic array vector points to
+    void BytecodeCompiler::assignVector(uint16_t vector, ast::Expression &expression)
+    {
+        if (expression.type->isArray())
+        {
+            uint16_t elements = operand(expression);
+            uint16_t count = allocate();
+            emitWide(Opcode::LOAD_INT, count, (int32_t) ((ArrayType*) expression.type)->count);
+            emit(Opcode::VECTOR_ASSIGN_ARRAY, vector, elements, count);
+            return;
+        }
+        emit(Opcode::VECTOR_ASSIGN, vector, containerPointer(expression));
+    }
+
+    BytecodeCompiler::JumpTarget BytecodeCompiler::compileBody(ast::Statement &body, bool loop)
+    {
+        state->targets.push_back(JumpTarget{ loop, state->regionDepth, {}, {} });
+        body.accept(*this);
+        JumpTarget jumps = std::move(state->targets.back());
+        state->targets.pop_back();
+        return jumps;
+    }
+
+    void BytecodeCompiler::exitRegions(size_t depth)
+    {
+        for (size_t i = depth; i < state->regionDepth; ++i)
+            emit(Opcode::REGION_EXIT);
+    }
+
+    // The parameters are the first registers of the frame
+    void BytecodeCompiler::beginFunction(uint32_t index, Function *function)
+    {
+        program->functions[index].code.clear();
+        state->index = index;
+        state->function = function;
+        state->locals.clear();
+        state->nextRegister = 0;
+        state->storageSize = 0;
+        state->storageAddresses.clear();
+        state->targets.clear();
+        state->regionDepth = 0;
+        if (function != nullptr)
+        {
+            // Compiled code takes and returns values in their C types, which arrays do not map to
+            bool scalar = !function->returnType->isArray() && !function->returnType->isContainer();
+            for (Variable *parameter : function->parameters)
+            {
+                state->locals[parameter] = (uint16_t) state->nextRegister++;
+                scalar = scalar && !parameter->type->isArray() && !parameter->type->isContainer();
+            }
+            if (!scalar)
+                uncompilable("it takes or returns an array");
+        }
+        else
+        {
+            uncompilable("it initializes the module's variables");
+        }
+        state->localsTop = state->nextRegister;
+        state->registerCount = state->nextRegister;
+    }
+
+    void BytecodeCompiler::endFunction(const SourcePosition &position)
+    {
+        emit(Opcode::RETURN_VOID);
+        auto &bytecode = program->functions[state->index];
+        for (size_t address : state->storageAddresses)
+        {
+            Instruction &instruction = bytecode.code[address];
+            instruction.setWide(instruction.wide() + (int32_t) state->registerCount);
+        }
+        if (state->registerCount > UINT16_MAX)
+            error(position, Utf8String{ "Function " } + bytecode.name + " has too many values for pxc run");
+        bytecode.frameSize = state->registerCount + state->storageSize;
+        bytecode.defined = true;
+    }
+
+    void *BytecodeCompiler::visit(ast::ArrayIndexReference &a)
+    {
+        Type *arrayType = a.array->type;
+        if (arrayType->isMap())
+        {
+            error(a.position, Utf8String{ "Maps are not supported by pxc run" });
+            return nullptr;
+        }
+        bool vector = arrayType->isDynamicArray();
+        uint16_t array = vector ? containerPointer(*a.array) : operand(*a.array);
+        uint16_t index = operand(*a.index);
+        emit(vector ? Opcode::VECTOR_LOAD : Opcode::ARRAY_LOAD, target, array, index);
+        return nullptr;
+    }
+
+    static ast::BinaryOperator assignmentOperator(TokenType opType)
+    {
+        switch (opType)
+        {
+            case TokenType::OP_ASSIGN_ADD:          return ast::BinaryOperator::ADD;
+            case TokenType::OP_ASSIGN_SUB:          return ast::BinaryOperator::SUB;
+            case TokenType::OP_ASSIGN_STAR:         return ast::BinaryOperator::MUL;
+            case TokenType::OP_ASSIGN_DIV:          return ast::BinaryOperator::DIV;
+            case TokenType::OP_ASSIGN_MOD:          return ast::BinaryOperator::MOD;
+            case TokenType::OP_ASSIGN_BIT_AND:      return ast::BinaryOperator::BIT_AND;
+            case TokenType::OP_ASSIGN_BIT_OR:       return ast::BinaryOperator::BIT_OR;
+            case TokenType::OP_ASSIGN_BIT_XOR:      return ast::BinaryOperator::BIT_XOR;
+            case TokenType::OP_ASSIGN_LEFT_SHIFT:   return ast::BinaryOperator::LSH;
+            case TokenType::OP_ASSIGN_RIGHT_SHIFT:  return ast::BinaryOperator::RSH;
+            default:                                return ast::BinaryOperator::BAD;
+        }
+    }
+
+    void *BytecodeCompiler::visit(ast::ArrayIndexAssignmentStatement &a)
+    {
+        auto &reference = (ast::ArrayIndexReference&) *a.reference;
+        Type *arrayType = reference.array->type;
+        if (arrayType->isMap())
+        {
+            error(a.position, Utf8String{ "Maps are not supported by pxc run" });
+            return nullptr;
+        }
+        bool vector = arrayType->isDynamicArray();
+        Type *elementType = vector ? ((DynamicArrayType*) arrayType)->elementType : ((ArrayType*) arrayType)->elementType;
+        uint16_t value = operand(*a.expression);
+        uint16_t array = vector ? containerPointer(*reference.array) : operand(*reference.array);
+        uint16_t index = operand(*reference.index);
+        Opcode store = vector ? Opcode::VECTOR_STORE : Opcode::ARRAY_STORE;
+        if (a.opType == TokenType::OP_ASSIGN)
+        {
+            emit(store, array, index, value);
+            return nullptr;
+        }
+
+        uint16_t element = allocate();
+        emit(vector ? Opcode::VECTOR_LOAD : Opcode::ARRAY_LOAD, element, array, index);
+        if (elementType->isString())
+            emit(Opcode::CONCAT, element, element, value);
+        else
+            compileArithmetic(assignmentOperator(a.opType), elementType, element, element, value);
+        emit(store, array, index, element);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::ArrayLiteral &a)
+    {
+        addressStorage(target, allocateStorage((uint32_t) a.values.size()));
+        storeArrayLiteral(a, target);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::AssignmentStatement &a)
+    {
+        Variable *variable = lookup(a.variableName);
+        Type *type = variable->type;
+        if (type->isMap())
+        {
+            error(a.position, Utf8String{ "Maps are not supported by pxc run" });
+            return nullptr;
+        }
+        auto local = state->locals.find(variable);
+        bool global = local == state->locals.end();
+
+        if (type->isDynamicArray())
+        {
+            uint16_t vector = global ? allocate() : local->second;
+            if (global)
+                emitWide(Opcode::GLOBAL_ADDRESS, vector, (int32_t) globals[variable]);
+            if (a.expression->nodeType == ast::NodeType::EXP_FUNC_CALL)
+            {
+                // The vector a call returns is its caller's, so it is moved in instead of copied
+                uint16_t value = allocate();
+                compileInto(*a.expression, value);
+                emit(Opcode::STORE_INDIRECT, vector, value);
+            }
+            else
+            {
+                assignVector(vector, *a.expression);
+            }
+            return nullptr;
+        }
+
+        uint16_t value = global ? allocate() : local->second;
+        if (a.opType == TokenType::OP_ASSIGN)
+        {
+            compileInto(*a.expression, value);
+        }
+        else
+        {
+            if (global)
+                emitWide(Opcode::LOAD_GLOBAL, value, (int32_t) globals[variable]);
+            uint16_t right = operand(*a.expression);
+            if (type->isString())
+                emit(Opcode::CONCAT, value, value, right);
+            else
+                compileArithmetic(assignmentOperator(a.opType), type, value, value, right);
+        }
+        if (global)
+            emitWide(Opcode::STORE_GLOBAL, value, (int32_t) globals[variable]);
+        return nullptr;
+    }
+
+    // Spawned calls have already run, so their futures hold their results
+    void *BytecodeCompiler::visit(ast::AwaitExpression &a)
+    {
+        uint16_t future = operand(*a.future);
+        if (!a.type->isVoid() && future != target)
+            emit(Opcode::MOVE, target, future);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::BinaryOpExpression &b)
+    {
+        if (b.op == ast::BinaryOperator::AND || b.op == ast::BinaryOperator::OR)
+        {
+            // The right side may read the variable being assigned, so that is only written at the end
+            uint16_t result = target < state->localsTop ? allocate() : target;
+            compileInto(*b.left, result);
+            size_t skip = emitWide(b.op == ast::BinaryOperator::AND ? Opcode::JUMP_UNLESS : Opcode::JUMP_IF, result, 0);
+            compileInto(*b.right, result);
+            patch(skip, here());
+            if (result != target)
+                emit(Opcode::MOVE, target, result);
+            return nullptr;
+        }
+
+        Type *type = b.left->type;
+        uint16_t left = operand(*b.left);
+        uint16_t right = operand(*b.right);
+        if (type->isString())
+        {
+            switch (b.op)
+            {
+                case ast::BinaryOperator::ADD:  emit(Opcode::CONCAT, target, left, right); break;
+                case ast::BinaryOperator::EQ:   emit(Opcode::STR_EQ, target, left, right); break;
+                case ast::BinaryOperator::NE:   emit(Opcode::STR_NE, target, left, right); break;
+                case ast::BinaryOperator::LT:   emit(Opcode::STR_LT, target, left, right); break;
+                case ast::BinaryOperator::LTE:  emit(Opcode::STR_LE, target, left, right); break;
+                case ast::BinaryOperator::GT:   emit(Opcode::STR_LT, target, right, left); break;
+                case ast::BinaryOperator::GTE:  emit(Opcode::STR_LE, target, right, left); break;
+                default:                        break;
+            }
+            return nullptr;
+        }
+
+        // Greater than comparisons are less than ones with their operands swapped
+        bool isFloat = type->isFloat();
+        bool isUnsigned = type->isUInt();
+        Opcode less = isFloat ? Opcode::LT_F : isUnsigned ? Opcode::LT_U : Opcode::LT_I;
+        Opcode lessEqual = isFloat ? Opcode::LE_F : isUnsigned ? Opcode::LE_U : Opcode::LE_I;
+        switch (b.op)
+        {
+            case ast::BinaryOperator::EQ:   emit(isFloat ? Opcode::EQ_F : Opcode::EQ_I, target, left, right); break;
+            case ast::BinaryOperator::NE:   emit(isFloat ? Opcode::NE_F : Opcode::NE_I, target, left, right); break;
+            case ast::BinaryOperator::LT:   emit(less, target, left, right); break;
+            case ast::BinaryOperator::LTE:  emit(lessEqual, target, left, right); break;
+            case ast::BinaryOperator::GT:   emit(less, target, right, left); break;
+            case ast::BinaryOperator::GTE:  emit(lessEqual, target, right, left); break;
+            default:
+                compileArithmetic(b.op, type, target, left, right);
+                break;
+        }
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::BoolLiteral &b)
+    {
+        emitWide(Opcode::LOAD_INT, target, b.value ? 1 : 0);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::BlockStatement &s)
+    {
+        auto current = currentScope;
+        currentScope = scopeTree->enterScope();
+
+        // The variables of the block go above the temporaries of any statement it is part of
+        uint32_t outerLocalsTop = state->localsTop;
+        uint32_t outerNextRegister = state->nextRegister;
+        state->localsTop = state->nextRegister;
+        for (auto const &statement : s.statements)
+        {
+            statement->accept(*this);
+            state->nextRegister = state->localsTop;
+        }
+        state->localsTop = outerLocalsTop;
+        state->nextRegister = outerNextRegister;
+
+        scopeTree->endScope();
+        currentScope = current;
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::BreakStatement &b)
+    {
+        JumpTarget &jumps = state->targets.back();
+        exitRegions(jumps.regionDepth);
+        jumps.breaks.push_back(emitWide(Opcode::JUMP, 0, 0));
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::CastExpression &c)
+    {
+        Type *type = c.type;
+        Type *from = c.expression->type;
+        compileInto(*c.expression, target);
+        if (type == from)
+            return nullptr;
+
+        bool toInteger = type->isInt() || type->isUInt();
+        bool fromInteger = from->isInt() || from->isUInt();
+        if (toInteger && fromInteger)
+        {
+            if (type->size < from->size || type->isInt() != from->isInt())
+                narrow(type, target);
+        }
+        else if (toInteger && from->isFloat())
+        {
+            emit(type->isUInt() ? Opcode::F_TO_U : Opcode::F_TO_I, target, target);
+            narrow(type, target);
+        }
+        else if (type->isFloat() && fromInteger)
+        {
+            emit(from->isUInt() ? Opcode::U_TO_F : Opcode::I_TO_F, target, target);
+            narrow(type, target);
+        }
+        else if (type->isFloat() && from->isFloat() && type->size < from->size)
+        {
+            narrow(type, target);
+        }
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::CharLiteral &c)
+    {
+        // char is a code point
+        Utf8Iterator iterator{ c.literal };
+        emitWide(Opcode::LOAD_INT, target, (int32_t) *iterator);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::ContinueStatement &c)
+    {
+        auto jumps = std::find_if(state->targets.rbegin(), state->targets.rend(), [](const JumpTarget &jumps) { return jumps.loop; });
+        exitRegions(jumps->regionDepth);
+        jumps->continues.push_back(emitWide(Opcode::JUMP, 0, 0));
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::DoWhileStatement &d)
+    {
+        size_t top = here();
+        JumpTarget jumps = compileBody(*d.body, true);
+        size_t next = here();
+        uint16_t condition = operand(*d.condition);
+        emitWide(Opcode::JUMP_IF, condition, (int32_t) top);
+        for (size_t jump : jumps.continues)
+            patch(jump, next);
+        for (size_t jump : jumps.breaks)
+            patch(jump, here());
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::ExpressionStatement &s)
+    {
+        // Spawned calls run where they are spawned, so awaiting one has nothing left to do
+        if (s.expression->nodeType == ast::NodeType::EXP_AWAIT)
+            return nullptr;
+        compileInto(*s.expression, allocate());
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::FloatLiteral &f)
+    {
+        Value value;
+        std::memset(&value, 0, sizeof(value));
+        value.f = f.type->size == 4 ? (double) (float) f.value : f.value;
+        emitWide(Opcode::LOAD_CONST, target, (int32_t) constant(value));
+        return nullptr;
+    }
+
+    // The loop variable and the end it counts to are kept in consecutive registers for FOR_NEXT
+    void *BytecodeCompiler::visit(ast::ForStatement &f)
+    {
+        auto current = currentScope;
+        currentScope = scopeTree->enterScope();
+        uint32_t outerLocalsTop = state->localsTop;
+        uint32_t outerNextRegister = state->nextRegister;
+        if (f.parallel)
+            uncompilable("it has a parallel for");
+
+        Variable *variable = currentScope->symbols()->getVariable(f.variableName, true);
+        uint16_t counter = allocate(2);
+        state->locals[variable] = counter;
+        state->localsTop = state->nextRegister;
+        compileInto(*f.start, counter);
+        compileInto(*f.end, (uint16_t) (counter + 1));
+        bool isUnsigned = f.variableType->isUInt();
+        uint16_t inRange = allocate();
+        emit(isUnsigned ? Opcode::LT_U : Opcode::LT_I, inRange, counter, counter + 1);
+        size_t skip = emitWide(Opcode::JUMP_UNLESS, inRange, 0);
+        state->nextRegister = state->localsTop;
+
+        size_t top = here();
+        JumpTarget jumps = compileBody(*f.body, true);
+        size_t next = here();
+        emitWide(isUnsigned ? Opcode::FOR_NEXT_U : Opcode::FOR_NEXT, counter, (int32_t) top);
+        size_t end = here();
+        patch(skip, end);
+        for (size_t jump : jumps.continues)
+            patch(jump, next);
+        for (size_t jump : jumps.breaks)
+            patch(jump, end);
+
+        state->localsTop = outerLocalsTop;
+        state->nextRegister = outerNextRegister;
+        scopeTree->endScope();
+        currentScope = current;
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::FunctionCallExpression &f)
+    {
+        compileCall(f, target);
+        return nullptr;
+    }
+
+    // Declared functions are given their index when first called
+    void *BytecodeCompiler::visit(ast::FunctionDeclaration &f)
+    {
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::FunctionDefinition &f)
+    {
+        Function *function = f.function;
+        bool unsupported = function->returnType->isMap();
+        for (Variable *parameter : function->parameters)
+            unsupported = unsupported || parameter->type->isMap();
+        if (unsupported)
+        {
+            error(f.position, Utf8String{ "Maps are not supported by pxc run" });
+            // The function's scope is stepped over so the ones after it still line up
+            scopeTree->enterScope();
+            scopeTree->endScope();
+            return nullptr;
+        }
+
+        uint32_t index = functionIndex(function, f.position);
+        FunctionState *outer = state;
+        FunctionState current;
+        state = &current;
+        beginFunction(index, function);
+        f.block->accept(*this);
+        endFunction(f.position);
+        state = outer;
+
+        if (function->name == Utf8String{ "main" })
+            program->main = (int32_t) index;
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::IfStatement &i)
+    {
+        uint16_t condition = operand(*i.condition);
+        size_t skip = emitWide(Opcode::JUMP_UNLESS, condition, 0);
+        i.trueStatement->accept(*this);
+        if (i.elseStatement)
+        {
+            size_t end = emitWide(Opcode::JUMP, 0, 0);
+            patch(skip, here());
+            i.elseStatement->accept(*this);
+            patch(end, here());
+        }
+        else
+        {
+            patch(skip, here());
+        }
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::IntegerLiteral &i)
+    {
+        loadInteger(i.value, target);
+        return nullptr;
+    }
+
+    void BytecodeCompiler::loadInteger(int64_t integer, uint16_t into)
+    {
+        if (integer >= INT32_MIN && integer <= INT32_MAX)
+        {
+            emitWide(Opcode::LOAD_INT, into, (int32_t) integer);
+            return;
+        }
+        Value value;
+        std::memset(&value, 0, sizeof(value));
+        value.i = integer;
+        emitWide(Opcode::LOAD_CONST, into, (int32_t) constant(value));
+    }
+
+    // The initializers of module level variables make up a function that runs before main
+    void *BytecodeCompiler::visit(ast::Module &m)
+    {
+        auto current = currentScope;
+        currentScope = scopeTree->enterScope();
+        moduleScope = currentScope;
+
+        for (auto const &statement : m.statements)
+        {
+            statement->accept(*this);
+            state->nextRegister = state->localsTop;
+        }
+        endFunction(m.position);
+
+        scopeTree->endScope();
+        currentScope = current;
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::RegionStatement &r)
+    {
+        emit(Opcode::REGION_ENTER);
+        ++state->regionDepth;
+        r.body->accept(*this);
+        --state->regionDepth;
+        emit(Opcode::REGION_EXIT);
+        return nullptr;
+    }
+
+    // Values are computed before the regions they may be in are freed. A dynamic array the function
+    // does not own is copied into the caller's region after that.
+    void *BytecodeCompiler::visit(ast::ReturnStatement &s)
+    {
+        if (s.returnValue == nullptr)
+        {
+            exitRegions(0);
+            emit(Opcode::RETURN_VOID);
+            return nullptr;
+        }
+
+        ast::Expression &value = *s.returnValue;
+        if (!value.type->isContainer())
+        {
+            uint16_t result = operand(value);
+            exitRegions(0);
+            emit(Opcode::RETURN, result);
+            return nullptr;
+        }
+
+        uint16_t result = allocate();
+        if (value.nodeType == ast::NodeType::EXP_FUNC_CALL)
+        {
+            compileInto(value, result);
+            exitRegions(0);
+            emit(Opcode::RETURN, result);
+            return nullptr;
+        }
+        if (value.nodeType == ast::NodeType::EXP_VAR_LOAD)
+        {
+            Variable *variable = lookup(((ast::VariableExpression&) value).variable);
+            auto local = state->locals.find(variable);
+            if (local != state->locals.end() && !isParameter(variable))
+            {
+                emit(Opcode::LOAD_INDIRECT, result, local->second);
+                exitRegions(0);
+                emit(Opcode::RETURN, result);
+                return nullptr;
+            }
+        }
+        uint16_t source = containerPointer(value);
+        exitRegions(0);
+        emit(Opcode::VECTOR_COPY, result, source);
+        emit(Opcode::RETURN, result);
+        return nullptr;
+    }
+
+    // spawn runs the call straight away, leaving its result in the future
+    void *BytecodeCompiler::visit(ast::SpawnExpression &s)
+    {
+        uncompilable("it spawns tasks");
+        compileCall(*s.call, target);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::StringLiteral &s)
+    {
+        emitWide(Opcode::LOAD_CONST, target, (int32_t) stringConstant(s.literal));
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::SwitchStatement &s)
+    {
+        std::vector<std::pair<int64_t, size_t>> cases;
+        for (size_t i = 0; i < s.cases.size(); ++i)
+        {
+            for (int64_t constant : s.cases[i].constants)
+                cases.emplace_back(constant, i);
+        }
+        std::sort(cases.begin(), cases.end());
+
+        // Dense case sets index a table of targets, sparse ones search the sorted keys. Unlike a C
+        // switch, the table is as long as the cases' spread, however few cases there are.
+        uint64_t spread = cases.empty() ? 0 : (uint64_t) cases.back().first - (uint64_t) cases.front().first;
+        bool dense = spread < cases.size() * SPARSE_SWITCH_SPREAD && spread < DENSE_SWITCH_MAX_TARGETS;
+        uint32_t table = (uint32_t) program->switchTables.size();
+        program->switchTables.emplace_back();
+        uint16_t value = operand(*s.scrutinee);
+        emitWide(dense ? Opcode::JUMP_TABLE : Opcode::LOOKUP_SWITCH, value, (int32_t) table);
+
+        state->targets.push_back(JumpTarget{ false, state->regionDepth, {}, {} });
+        std::vector<int32_t> starts;
+        for (auto &switchCase : s.cases)
+        {
+            starts.push_back((int32_t) here());
+            switchCase.body->accept(*this);
+            state->targets.back().breaks.push_back(emitWide(Opcode::JUMP, 0, 0));
+        }
+        int32_t defaultStart = (int32_t) here();
+        if (s.defaultBody)
+            s.defaultBody->accept(*this);
+        JumpTarget jumps = std::move(state->targets.back());
+        state->targets.pop_back();
+        int32_t end = (int32_t) here();
+        for (size_t jump : jumps.breaks)
+            patch(jump, (size_t) end);
+
+        SwitchTable &switchTable = program->switchTables[table];
+        switchTable.defaultTarget = s.defaultBody ? defaultStart : end;
+        switchTable.low = cases.empty() ? 0 : cases.front().first;
+        if (dense)
+        {
+            if (!cases.empty())
+                switchTable.targets.assign((uint64_t) cases.back().first - (uint64_t) cases.front().first + 1, switchTable.defaultTarget);
+            for (auto &entry : cases)
+                switchTable.targets[(uint64_t) entry.first - (uint64_t) switchTable.low] = starts[entry.second];
+        }
+        else
+        {
+            for (auto &entry : cases)
+            {
+                switchTable.keys.push_back(entry.first);
+                switchTable.targets.push_back(starts[entry.second]);
+            }
+        }
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::TernaryOpExpression &t)
+    {
+        bool container = t.type->isContainer();
+        auto compileBranch = [&](ast::Expression &branch) {
+            if (!container)
+            {
+                compileInto(branch, target);
+                return;
+            }
+            uint16_t pointer = containerPointer(branch);
+            if (pointer != target)
+                emit(Opcode::MOVE, target, pointer);
+        };
+
+        uint16_t condition = operand(*t.condition);
+        size_t skip = emitWide(Opcode::JUMP_UNLESS, condition, 0);
+        compileBranch(*t.trueExpr);
+        size_t end = emitWide(Opcode::JUMP, 0, 0);
+        patch(skip, here());
+        compileBranch(*t.falseExpr);
+        patch(end, here());
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::UnaryOpExpression &u)
+    {
+        // A negated literal is one constant, as it is in C, so it keeps a value too large for the
+        // literal's type, which is int32 however large the literal is. Unsigned ones still wrap.
+        if (u.op == ast::UnaryOperator::NEG && u.expression->nodeType == ast::NodeType::LITERAL_INT)
+        {
+            loadInteger((int64_t) (0 - (uint64_t) ((ast::IntegerLiteral&) *u.expression).value), target);
+            if (u.type->isUInt())
+                narrow(u.type, target);
+            return nullptr;
+        }
+        uint16_t value = operand(*u.expression);
+        switch (u.op)
+        {
+            case ast::UnaryOperator::NEG:
+                if (u.type->isFloat())
+                {
+                    emit(Opcode::NEG_F, target, value);
+                    return nullptr;
+                }
+                emit(Opcode::NEG_I, target, value);
+                break;
+            case ast::UnaryOperator::CMPL:
+                emit(Opcode::CMPL, target, value);
+                break;
+            case ast::UnaryOperator::NOT:
+                emit(Opcode::NOT, target, value);
+                return nullptr;
+        }
+        narrow(u.type, target);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::VariableDeclaration &v)
+    {
+        Variable *variable = currentScope->symbols()->getVariable(v.name, true);
+        Type *type = variable->type;
+        if (type->isMap())
+        {
+            error(v.position, Utf8String{ "Maps are not supported by pxc run" });
+            return nullptr;
+        }
+
+        // Module level variables live in the globals, where arrays take a value per element
+        if (currentScope == moduleScope)
+        {
+            uint32_t index = program->globalCount;
+            program->globalCount += type->isArray() ? (uint32_t) ((ArrayType*) type)->count : 1;
+            globals[variable] = index;
+            if (v.initialValue == nullptr)
+                return nullptr;
+            uint16_t value = allocate();
+            if (v.initialValue->nodeType == ast::NodeType::LITERAL_ARRAY)
+            {
+                emitWide(Opcode::GLOBAL_ADDRESS, value, (int32_t) index);
+                storeArrayLiteral((ast::ArrayLiteral&) *v.initialValue, value);
+                return nullptr;
+            }
+            compileInto(*v.initialValue, value);
+            emitWide(Opcode::STORE_GLOBAL, value, (int32_t) index);
+            return nullptr;
+        }
+
+        uint16_t local = allocate();
+        state->locals[variable] = local;
+        state->localsTop = state->nextRegister;
+        if (type->isArray())
+        {
+            addressStorage(local, allocateStorage((uint32_t) ((ArrayType*) type)->count));
+            if (v.initialValue != nullptr && v.initialValue->nodeType == ast::NodeType::LITERAL_ARRAY)
+                storeArrayLiteral((ast::ArrayLiteral&) *v.initialValue, local);
+        }
+        else if (type->isDynamicArray())
+        {
+            addressStorage(local, allocateStorage(1));
+            if (v.initialValue != nullptr && v.initialValue->nodeType == ast::NodeType::EXP_FUNC_CALL)
+            {
+                uint16_t value = allocate();
+                compileInto(*v.initialValue, value);
+                emit(Opcode::STORE_INDIRECT, local, value);
+                return nullptr;
+            }
+            emit(Opcode::VECTOR_NEW, local);
+            if (v.initialValue != nullptr)
+                assignVector(local, *v.initialValue);
+        }
+        else if (v.initialValue != nullptr)
+        {
+            compileInto(*v.initialValue, local);
+        }
+        else if (type->isString())
+        {
+            emitWide(Opcode::LOAD_CONST, local, (int32_t) stringConstant(Utf8String{ "" }));
+        }
+        else
+        {
+            emitWide(Opcode::LOAD_INT, local, 0);
+        }
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::VariableExpression &v)
+    {
+        Variable *variable = lookup(v.variable);
+        auto local = state->locals.find(variable);
+        if (local != state->locals.end())
+        {
+            if (local->second != target)
+                emit(Opcode::MOVE, target, local->second);
+            return nullptr;
+        }
+        // Arrays and dynamic arrays are used through their address
+        Type *type = variable->type;
+        bool address = type->isArray() || type->isDynamicArray();
+        emitWide(address ? Opcode::GLOBAL_ADDRESS : Opcode::LOAD_GLOBAL, target, (int32_t) globals[variable]);
+        return nullptr;
+    }
+
+    void *BytecodeCompiler::visit(ast::WhileStatement &w)
+    {
+        // The condition is tested at the bottom, so each iteration takes one jump
+        size_t entry = emitWide(Opcode::JUMP, 0, 0);
+        size_t top = here();
+        JumpTarget jumps = compileBody(*w.body, true);
+        size_t next = here();
+        patch(entry, next);
+        uint16_t condition = operand(*w.condition);
+        emitWide(Opcode::JUMP_IF, condition, (int32_t) top);
+        for (size_t jump : jumps.continues)
+            patch(jump, next);
+        for (size_t jump : jumps.breaks)
+            patch(jump, here());
+        return nullptr;
+    }
+
+}
@@ -0,0 +1,349 @@
+#include "vm/Interpreter.h"
+#include "vm/TieredCompiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace px
+{
+
+    Interpreter::Interpreter(const Program &p)
+        : program{ p }, stack{ new Value[STACK_VALUES] }, compiled{ new std::atomic<NativeFunction>[p.functions.size()] },
+          compiledCapacity{ p.functions.size() }, tiers{}, threshold{}, timed{}, totalTime{}, compiledTime{}
+    {
+        Value zero;
+        std::memset(&zero, 0, sizeof(zero));
+        globals.assign(program.globalCount, zero);
+        counters.assign(program.functions.size(), 0);
+        for (size_t i = 0; i < program.functions.size(); ++i)
+            compiled[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    int32_t Interpreter::run()
+    {
+        auto start = std::chrono::steady_clock::now();
+        execute(program.initializer);
+        int32_t exitCode = 0;
+        if (program.main >= 0)
+            exitCode = (int32_t) execute((uint32_t) program.main).i;
+        totalTime = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        return exitCode;
+    }
+
+    Value Interpreter::call(uint32_t function)
+    {
+        // The program may have grown since the last call
+        Value zero;
+        std::memset(&zero, 0, sizeof(zero));
+        globals.resize(program.globalCount, zero);
+        counters.resize(program.functions.size(), 0);
+        if (program.functions.size() > compiledCapacity)
+        {
+            size_t capacity = std::max(program.functions.size(), compiledCapacity * 2);
+            std::unique_ptr<std::atomic<NativeFunction>[]> grown{ new std::atomic<NativeFunction>[capacity] };
+            for (size_t i = 0; i < capacity; ++i)
+                grown[i].store(i < compiledCapacity ? compiled[i].load(std::memory_order_relaxed) : nullptr, std::memory_order_relaxed);
+            compiled = std::move(grown);
+            compiledCapacity = capacity;
+        }
+        return execute(function);
+    }
+
+    void Interpreter::setTiering(TieredCompiler *compiler, uint32_t hotThreshold, bool time)
+    {
+        tiers = compiler;
+        threshold = hotThreshold;
+        timed = time;
+    }
+
+    void Interpreter::install(uint32_t function, NativeFunction code)
+    {
+        compiled[function].store(code, std::memory_order_release);
+    }
+
+    void Interpreter::hot(uint32_t function)
+    {
+        if (tiers != nullptr)
+            tiers->request(function);
+    }
+
+    namespace
+    {
+        // What a call needs to carry on in its caller once it returns
+        struct CallRecord
+        {
+            const Instruction *returnAddress;
+            const Instruction *code;
+            Value *frame;
+            Value *result;
+            uint32_t frameSize;
+            uint32_t function;
+        };
+    }
+
+    // Instructions are dispatched with computed gotos where the compiler has them, so each handler
+    // jumps straight to the next, and with a switch in a loop elsewhere
+    #if defined(__GNUC__)
+        #define PX_HANDLER(name) op_##name:
+        #define PX_DISPATCH() goto *handlers[(size_t) ip->op]
+    #else
+        #define PX_HANDLER(name) case Opcode::name:
+        #define PX_DISPATCH() continue
+    #endif
+    #define PX_NEXT() { ++ip; PX_DISPATCH(); }
+    #define PX_JUMP(target) { ip = code + (target); PX_DISPATCH(); }
+    #define R(operand) frame[ip->operand]
+    // Loops count towards their function's tiering threshold each time they go around
+    #define PX_BACKEDGE() { if (++counts[index] == threshold) hot(index); }
+
+    Value Interpreter::execute(uint32_t function)
+    {
+    #if defined(__GNUC__)
+        static void *const handlers[] = {
+        #define PX_OPCODE_LABEL(name) &&op_##name,
+            PX_OPCODES(PX_OPCODE_LABEL)
+        #undef PX_OPCODE_LABEL
+        };
+    #endif
+
+        const Value *constants = program.constants.data();
+        Value *values = globals.data();
+        Value *const stackEnd = stack.get() + STACK_VALUES;
+        uint32_t *counts = counters.data();
+        std::vector<CallRecord> calls;
+        Value result;
+        std::memset(&result, 0, sizeof(result));
+
+        uint32_t index = function;
+        const BytecodeFunction *current = &program.functions[function];
+        if (current->frameSize > STACK_VALUES)
+            throw StackOverflow{ current->name };
+        Value *frame = stack.get();
+        uint32_t frameSize = current->frameSize;
+        const Instruction *code = current->code.data();
+        const Instruction *ip = code;
+
+    #if defined(__GNUC__)
+        PX_DISPATCH();
+    #else
+        for (;;)
+        switch (ip->op)
+    #endif
+        {
+            PX_HANDLER(MOVE)            R(a) = R(b); PX_NEXT()
+            PX_HANDLER(LOAD_INT)        R(a).i = ip->wide(); PX_NEXT()
+            PX_HANDLER(LOAD_CONST)      R(a) = constants[ip->wide()]; PX_NEXT()
+            PX_HANDLER(LOAD_GLOBAL)     R(a) = values[ip->wide()]; PX_NEXT()
+            PX_HANDLER(STORE_GLOBAL)    values[ip->wide()] = R(a); PX_NEXT()
+            PX_HANDLER(GLOBAL_ADDRESS)  R(a).p = values + ip->wide(); PX_NEXT()
+            PX_HANDLER(ADDRESS)         R(a).p = frame + ip->wide(); PX_NEXT()
+            PX_HANDLER(LOAD_INDIRECT)   R(a) = *(Value*) R(b).p; PX_NEXT()
+            PX_HANDLER(STORE_INDIRECT)  *(Value*) R(a).p = R(b); PX_NEXT()
+
+            // Integer arithmetic wraps around, as it does in the C code pxc generates
+            PX_HANDLER(ADD_I)   R(a).u = R(b).u + R(c).u; PX_NEXT()
+            PX_HANDLER(SUB_I)   R(a).u = R(b).u - R(c).u; PX_NEXT()
+            PX_HANDLER(MUL_I)   R(a).u = R(b).u * R(c).u; PX_NEXT()
+            PX_HANDLER(DIV_I)   R(a).i = R(b).i / R(c).i; PX_NEXT()
+            PX_HANDLER(MOD_I)   R(a).i = R(b).i % R(c).i; PX_NEXT()
+            PX_HANDLER(DIV_U)   R(a).u = R(b).u / R(c).u; PX_NEXT()
+            PX_HANDLER(MOD_U)   R(a).u = R(b).u % R(c).u; PX_NEXT()
+            PX_HANDLER(AND)     R(a).u = R(b).u & R(c).u; PX_NEXT()
+            PX_HANDLER(OR)      R(a).u = R(b).u | R(c).u; PX_NEXT()
+            PX_HANDLER(XOR)     R(a).u = R(b).u ^ R(c).u; PX_NEXT()
+            PX_HANDLER(SHL)     R(a).u = R(b).u << (R(c).u & 63); PX_NEXT()
+            PX_HANDLER(SHR_I)   R(a).i = R(b).i >> (R(c).u & 63); PX_NEXT()
+            PX_HANDLER(SHR_U)   R(a).u = R(b).u >> (R(c).u & 63); PX_NEXT()
+
+            PX_HANDLER(ADD_F)   R(a).f = R(b).f + R(c).f; PX_NEXT()
+            PX_HANDLER(SUB_F)   R(a).f = R(b).f - R(c).f; PX_NEXT()
+            PX_HANDLER(MUL_F)   R(a).f = R(b).f * R(c).f; PX_NEXT()
+            PX_HANDLER(DIV_F)   R(a).f = R(b).f / R(c).f; PX_NEXT()
+
+            PX_HANDLER(NEG_I)   R(a).u = 0 - R(b).u; PX_NEXT()
+            PX_HANDLER(CMPL)    R(a).u = ~R(b).u; PX_NEXT()
+            PX_HANDLER(NEG_F)   R(a).f = -R(b).f; PX_NEXT()
+            PX_HANDLER(NOT)     R(a).i = R(b).i == 0; PX_NEXT()
+
+            PX_HANDLER(EQ_I)    R(a).i = R(b).i == R(c).i; PX_NEXT()
+            PX_HANDLER(NE_I)    R(a).i = R(b).i != R(c).i; PX_NEXT()
+            PX_HANDLER(LT_I)    R(a).i = R(b).i < R(c).i; PX_NEXT()
+            PX_HANDLER(LE_I)    R(a).i = R(b).i <= R(c).i; PX_NEXT()
+            PX_HANDLER(LT_U)    R(a).i = R(b).u < R(c).u; PX_NEXT()
+            PX_HANDLER(LE_U)    R(a).i = R(b).u <= R(c).u; PX_NEXT()
+            PX_HANDLER(EQ_F)    R(a).i = R(b).f == R(c).f; PX_NEXT()
+            PX_HANDLER(NE_F)    R(a).i = R(b).f != R(c).f; PX_NEXT()
+            PX_HANDLER(LT_F)    R(a).i = R(b).f < R(c).f; PX_NEXT()
+            PX_HANDLER(LE_F)    R(a).i = R(b).f <= R(c).f; PX_NEXT()
+
+            PX_HANDLER(NARROW_I8)   R(a).i = (int8_t) R(a).i; PX_NEXT()
+            PX_HANDLER(NARROW_I16)  R(a).i = (int16_t) R(a).i; PX_NEXT()
+            PX_HANDLER(NARROW_I32)  R(a).i = (int32_t) R(a).i; PX_NEXT()
+            PX_HANDLER(NARROW_U8)   R(a).u = (uint8_t) R(a).u; PX_NEXT()
+            PX_HANDLER(NARROW_U16)  R(a).u = (uint16_t) R(a).u; PX_NEXT()
+            PX_HANDLER(NARROW_U32)  R(a).u = (uint32_t) R(a).u; PX_NEXT()
+            PX_HANDLER(ROUND_F32)   R(a).f = (float) R(a).f; PX_NEXT()
+
+            PX_HANDLER(I_TO_F)  R(a).f = (double) R(b).i; PX_NEXT()
+            PX_HANDLER(U_TO_F)  R(a).f = (double) R(b).u; PX_NEXT()
+            PX_HANDLER(F_TO_I)  R(a).i = (int64_t) R(b).f; PX_NEXT()
+            PX_HANDLER(F_TO_U)  R(a).u = (uint64_t) R(b).f; PX_NEXT()
+
+            PX_HANDLER(CONCAT)  R(a).s = pxStringConcat(R(b).s, R(c).s); PX_NEXT()
+            PX_HANDLER(STR_EQ)  R(a).i = pxStringEquals(R(b).s, R(c).s); PX_NEXT()
+            PX_HANDLER(STR_NE)  R(a).i = !pxStringEquals(R(b).s, R(c).s); PX_NEXT()
+            PX_HANDLER(STR_LT)  R(a).i = pxStringCompare(R(b).s, R(c).s) < 0; PX_NEXT()
+            PX_HANDLER(STR_LE)  R(a).i = pxStringCompare(R(b).s, R(c).s) <= 0; PX_NEXT()
+
+            PX_HANDLER(JUMP)
+                if (ip->wide() <= ip - code)
+                    PX_BACKEDGE()
+                PX_JUMP(ip->wide())
+            PX_HANDLER(JUMP_IF)
+                if (R(a).i != 0)
+                {
+                    if (ip->wide() <= ip - code)
+                        PX_BACKEDGE()
+                    PX_JUMP(ip->wide())
+                }
+                PX_NEXT()
+            PX_HANDLER(JUMP_UNLESS)
+                if (R(a).i == 0)
+                    PX_JUMP(ip->wide())
+                PX_NEXT()
+            PX_HANDLER(FOR_NEXT)
+            {
+                Value *counter = &R(a);
+                if (++counter[0].i < counter[1].i)
+                {
+                    PX_BACKEDGE()
+                    PX_JUMP(ip->wide())
+                }
+                PX_NEXT()
+            }
+            PX_HANDLER(FOR_NEXT_U)
+            {
+                Value *counter = &R(a);
+                if (++counter[0].u < counter[1].u)
+                {
+                    PX_BACKEDGE()
+                    PX_JUMP(ip->wide())
+                }
+                PX_NEXT()
+            }
+            PX_HANDLER(JUMP_TABLE)
+            {
+                const SwitchTable &table = program.switchTables[ip->wide()];
+                uint64_t index = R(a).u - (uint64_t) table.low;
+                PX_JUMP(index < table.targets.size() ? table.targets[index] : table.defaultTarget)
+            }
+            PX_HANDLER(LOOKUP_SWITCH)
+            {
+                const SwitchTable &table = program.switchTables[ip->wide()];
+                auto key = std::lower_bound(table.keys.begin(), table.keys.end(), R(a).i);
+                bool found = key != table.keys.end() && *key == R(a).i;
+                PX_JUMP(found ? table.targets[key - table.keys.begin()] : table.defaultTarget)
+            }
+
+            PX_HANDLER(CALL)
+            {
+                // A function the tiered compiler has compiled runs as C from then on
+                NativeFunction native = compiled[ip->b].load(std::memory_order_acquire);
+                if (native != nullptr)
+                {
+                    if (!timed)
+                    {
+                        native(&R(a), &R(c));
+                        PX_NEXT()
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    native(&R(a), &R(c));
+                    compiledTime += (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                    PX_NEXT()
+                }
+                if (++counts[ip->b] == threshold)
+                    hot(ip->b);
+
+                const BytecodeFunction &callee = program.functions[ip->b];
+                Value *calleeFrame = frame + frameSize;
+                if (calleeFrame + callee.frameSize > stackEnd)
+                    throw StackOverflow{ callee.name };
+                std::copy(&R(c), &R(c) + callee.parameterCount, calleeFrame);
+                calls.push_back(CallRecord{ ip + 1, code, frame, &R(a), frameSize, index });
+                index = ip->b;
+                frame = calleeFrame;
+                frameSize = callee.frameSize;
+                code = callee.code.data();
+                ip = code;
+                PX_DISPATCH();
+            }
+            PX_HANDLER(CALL_NATIVE)
+                program.natives[ip->b](&R(a), &R(c));
+                PX_NEXT()
+            PX_HANDLER(RETURN)
+                if (calls.empty())
+                    return R(a);
+                *calls.back().result = R(a);
+                // Falls through to the rest of the return
+            PX_HANDLER(RETURN_VOID)
+            {
+                if (calls.empty())
+                    return result;
+                CallRecord &caller = calls.back();
+                ip = caller.returnAddress;
+                code = caller.code;
+                frame = caller.frame;
+                frameSize = caller.frameSize;
+                index = caller.function;
+                calls.pop_back();
+                PX_DISPATCH();
+            }
+            PX_HANDLER(UNDEFINED)
+                throw UndefinedFunction{ program.functions[index].name };
+
+            // Every element takes a value, so an array is a run of values
+            PX_HANDLER(ARRAY_LOAD)      R(a) = ((Value*) R(b).p)[R(c).i]; PX_NEXT()
+            PX_HANDLER(ARRAY_STORE)     ((Value*) R(a).p)[R(b).i] = R(c); PX_NEXT()
+            PX_HANDLER(VECTOR_LOAD)     R(a) = ((Value*) ((PxVector*) R(b).p)->data)[R(c).i]; PX_NEXT()
+            PX_HANDLER(VECTOR_STORE)    ((Value*) ((PxVector*) R(a).p)->data)[R(b).i] = R(c); PX_NEXT()
+            PX_HANDLER(VECTOR_NEW)      *(PxVector*) R(a).p = pxVectorCreate(); PX_NEXT()
+            PX_HANDLER(VECTOR_LENGTH)   R(a).i = ((PxVector*) R(b).p)->length; PX_NEXT()
+            PX_HANDLER(VECTOR_PUSH)     *(Value*) pxVectorPush((PxVector*) R(a).p, sizeof(Value)) = R(c); PX_NEXT()
+            PX_HANDLER(VECTOR_POP)
+            {
+                PxVector *vector = (PxVector*) R(b).p;
+                intptr_t index = pxVectorPop(vector);
+                R(a) = ((Value*) vector->data)[index];
+                PX_NEXT()
+            }
+            PX_HANDLER(VECTOR_RESERVE)  pxVectorReserve((PxVector*) R(a).p, (intptr_t) R(b).i, sizeof(Value)); PX_NEXT()
+            PX_HANDLER(VECTOR_APPEND)   pxVectorAppend((PxVector*) R(a).p, (PxVector*) R(b).p, sizeof(Value)); PX_NEXT()
+            PX_HANDLER(VECTOR_ASSIGN)
+            {
+                PxVector *source = (PxVector*) R(b).p;
+                pxVectorAssign((PxVector*) R(a).p, source->data, source->length, sizeof(Value));
+                PX_NEXT()
+            }
+            PX_HANDLER(VECTOR_ASSIGN_ARRAY) pxVectorAssign((PxVector*) R(a).p, R(b).p, (intptr_t) R(c).i, sizeof(Value)); PX_NEXT()
+            PX_HANDLER(VECTOR_COPY)
+            {
+                PxVector *source = (PxVector*) R(b).p;
+                R(a).v = pxVectorFromElements(source->data, source->length, sizeof(Value));
+                PX_NEXT()
+            }
+
+            PX_HANDLER(REGION_ENTER)    pxRegionEnter(); PX_NEXT()
+            PX_HANDLER(REGION_EXIT)     pxRegionExit(); PX_NEXT()
+        }
+        return result;
+    }
+
+    #undef PX_BACKEDGE
+    #undef R
+    #undef PX_JUMP
+    #undef PX_NEXT
+    #undef PX_DISPATCH
+    #undef PX_HANDLER
+
+}
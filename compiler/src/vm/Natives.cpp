@@ -0,0 +1,50 @@
+#include "vm/Natives.h"
+
+#include <cstring>
+
+namespace px {
+
+    struct NativeEntry
+    {
+        const char *name;
+        NativeFunction function;
+    };
+
+    // Each entry unpacks the registers holding the arguments into the C types pxruntime takes
+    #define PX_NATIVE(name, call) { #name, [](Value *result, const Value *arguments) { call; } }
+
+    static const NativeEntry NATIVES[] = {
+        PX_NATIVE(printInt, printInt((int32_t) arguments[0].i)),
+        PX_NATIVE(printInt64, printInt64(arguments[0].i)),
+        PX_NATIVE(printUInt64, printUInt64(arguments[0].u)),
+        PX_NATIVE(printFloat, printFloat((float) arguments[0].f)),
+        PX_NATIVE(printFloat64, printFloat64(arguments[0].f)),
+        PX_NATIVE(printString, printString(arguments[0].s)),
+        PX_NATIVE(pxFlush, pxFlush()),
+        PX_NATIVE(newStringBuilder, result->p = newStringBuilder()),
+        PX_NATIVE(reserveStringBuilder, reserveStringBuilder((PxStringBuilder*) arguments[0].p, arguments[1].i)),
+        PX_NATIVE(appendInt, appendInt((PxStringBuilder*) arguments[0].p, (int32_t) arguments[1].i)),
+        PX_NATIVE(appendInt64, appendInt64((PxStringBuilder*) arguments[0].p, arguments[1].i)),
+        PX_NATIVE(appendUInt64, appendUInt64((PxStringBuilder*) arguments[0].p, arguments[1].u)),
+        PX_NATIVE(appendFloat, appendFloat((PxStringBuilder*) arguments[0].p, (float) arguments[1].f)),
+        PX_NATIVE(appendFloat64, appendFloat64((PxStringBuilder*) arguments[0].p, arguments[1].f)),
+        PX_NATIVE(appendBool, appendBool((PxStringBuilder*) arguments[0].p, arguments[1].i != 0)),
+        PX_NATIVE(appendChar, appendChar((PxStringBuilder*) arguments[0].p, (int32_t) arguments[1].i)),
+        PX_NATIVE(appendString, appendString((PxStringBuilder*) arguments[0].p, arguments[1].s)),
+        PX_NATIVE(finishStringBuilder, result->s = finishStringBuilder((PxStringBuilder*) arguments[0].p)),
+        PX_NATIVE(pxStringArenaReset, pxStringArenaReset()),
+    };
+
+    #undef PX_NATIVE
+
+    NativeFunction findNative(const Utf8String &name)
+    {
+        for (auto &entry : NATIVES)
+        {
+            if (std::strcmp(entry.name, name.c_str()) == 0)
+                return entry.function;
+        }
+        return nullptr;
+    }
+
+}
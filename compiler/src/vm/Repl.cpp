@@ -0,0 +1,254 @@
+#include "vm/Repl.h"
+
+#include <cctype>
+#include <iostream>
+#include <string>
+
+namespace px {
+
+    Repl::Repl()
+        : analyzer{ scopeTree.current(), &errorLog }, compiler{ &scopeTree, &errorLog }, inputCount{ 0 }
+    {
+    }
+
+    ReplResult Repl::evaluate(const Utf8String &input)
+    {
+        ReplResult result{ false, nullptr, Value{} };
+        errorLog.clear();
+        // Errors point at the input they are in
+        Utf8String name = Utf8String{ "<input " } + std::to_string(++inputCount) + Utf8String{ ">" };
+        Parser parser{ &errorLog };
+        std::unique_ptr<ast::Module> module;
+        try {
+            module = parser.parseStatements(name, input);
+        }
+        catch (const Error &) {
+            return result;
+        }
+
+        analyzer.analyzeInput(*module);
+        if (errorLog.count() > 0)
+        {
+            compiler.skipInput();
+            return result;
+        }
+        uint32_t function = compiler.compileInput(*module);
+        if (errorLog.count() > 0)
+            return result;
+
+        if (interpreter == nullptr)
+            interpreter.reset(new Interpreter{ compiler.inputProgram() });
+        try {
+            result.value = interpreter->call(function);
+        }
+        catch (const std::runtime_error &error) {
+            errorLog.addError(Error{ module->position, Utf8String{ error.what() } });
+            return result;
+        }
+        result.ok = true;
+        auto &statements = module->statements;
+        if (!statements.empty() && statements.back()->nodeType == ast::NodeType::STMT_EXP)
+        {
+            Type *type = ((ast::ExpressionStatement&) *statements.back()).expression->type;
+            if (BytecodeCompiler::isDisplayable(type))
+                result.type = type;
+        }
+        return result;
+    }
+
+    void Repl::display(const Type *type, const Value &value)
+    {
+        PxStringBuilder *builder = newStringBuilder();
+        if (type->isBool())
+            appendBool(builder, value.i != 0);
+        else if (type->isChar())
+            appendChar(builder, (int32_t) value.i);
+        else if (type->isUInt())
+            appendUInt64(builder, value.u);
+        else if (type->isInt())
+            appendInt64(builder, value.i);
+        else if (type == Type::FLOAT32)
+            appendFloat(builder, (float) value.f);
+        else if (type->isFloat())
+            appendFloat64(builder, value.f);
+        else
+            appendString(builder, value.s);
+        appendChar(builder, '\n');
+        printString(finishStringBuilder(builder));
+    }
+
+    namespace
+    {
+        bool isWordCharacter(char c)
+        {
+            return isalnum((unsigned char) c) || c == '_';
+        }
+
+        // An input as it is typed, with the semicolons its lines may leave out put back: one at the
+        // end of a line where a statement ends, and one before a } that closes a block after one
+        class Input
+        {
+        public:
+            // Adds line, leaving out the braces, parentheses and semicolons in literals
+            void add(const std::string &line)
+            {
+                size_t keywordStart;
+                std::string keyword = firstKeyword(line, keywordStart);
+                bool condition = keyword == "if" || keyword == "while" || keyword == "switch";
+                // A for loop has no parentheses to tell where its range ends, so a line with one
+                // and no block has the loop's statement on the next line
+                bool loop = keyword == "for" || keyword == "parallel";
+                // How many braces and parentheses are open where the keyword starts
+                size_t base = open.size();
+                bool conditionClosed = false;
+                std::string word;
+                char quote = 0;
+                for (size_t i = 0; i < line.size(); ++i)
+                {
+                    char c = line[i];
+                    if (i == keywordStart)
+                        base = open.size();
+                    text += c;
+                    if (quote != 0)
+                    {
+                        if (c == '\\' && i + 1 < line.size())
+                            text += line[++i];
+                        else if (c == quote)
+                            quote = 0;
+                        continue;
+                    }
+                    if (c == ' ' || c == '\t' || c == '\r')
+                        continue;
+                    if (c == '}' && endsStatement())
+                        text.insert(text.size() - 1, ";");
+                    if (c == '"' || c == '\'')
+                        quote = c;
+                    else if (c == '{' || c == '(')
+                        open += c;
+                    else if ((c == '}' || c == ')') && !open.empty())
+                        open.pop_back();
+                    if (c == '{' && open.size() == base + 1)
+                        loop = false;
+                    // The statement of an if, while or switch comes after its condition, and a
+                    // do loop ends with the condition of its while
+                    awaitsStatement = condition && !conditionClosed && c == ')' && open.size() == base;
+                    conditionClosed = conditionClosed || awaitsStatement;
+                    word = isWordCharacter(c) ? word + c : "";
+                    last = c;
+                }
+                // else and do also have their statement after them
+                if (loop || word == "else" || word == "do")
+                    awaitsStatement = true;
+                if ((open.empty() || open.back() == '{') && endsStatement())
+                {
+                    text += ';';
+                    last = ';';
+                }
+                text += '\n';
+            }
+
+            // Whether every brace and parenthesis the input opened has been closed
+            bool complete() const
+            {
+                return open.empty();
+            }
+
+            // Whether the input has nothing in it but spaces
+            bool blank() const
+            {
+                return last == 0;
+            }
+
+            // The input, and starts the next one
+            std::string finish()
+            {
+                std::string input;
+                input.swap(text);
+                clear();
+                return input;
+            }
+
+            void clear()
+            {
+                text.clear();
+                open.clear();
+                last = 0;
+                awaitsStatement = false;
+            }
+
+        private:
+            // The keyword line starts with, after the } and else that close the statement before it,
+            // and where it starts
+            static std::string firstKeyword(const std::string &line, size_t &start)
+            {
+                size_t i = 0;
+                while (true)
+                {
+                    while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '}'))
+                        ++i;
+                    start = i;
+                    while (i < line.size() && isWordCharacter(line[i]))
+                        ++i;
+                    std::string word = line.substr(start, i - start);
+                    if (word != "else")
+                        return word;
+                }
+            }
+
+            // Whether what the input has so far ends a statement with no semicolon after it
+            bool endsStatement() const
+            {
+                return last != 0 && !awaitsStatement && last != ';' && last != '{' && last != '}'
+                    && last != ':' && last != ',';
+            }
+
+            std::string text;
+            // The braces and parentheses that are open, innermost last
+            std::string open;
+            // The last character outside literals that is not a space
+            char last = 0;
+            // Whether the input ends where a statement has yet to start, or with a do loop
+            bool awaitsStatement = false;
+        };
+    }
+
+    void Repl::run(std::istream &input, bool prompt)
+    {
+        Input text;
+        std::string line;
+        while (true)
+        {
+            if (prompt)
+                std::cout << (text.blank() ? "px> " : "...> ") << std::flush;
+            if (!std::getline(input, line))
+                break;
+            if (text.blank() && line == ":quit")
+                break;
+            text.add(line);
+            if (!text.complete())
+                continue;
+            if (text.blank())
+            {
+                text.clear();
+                continue;
+            }
+
+            ReplResult result = evaluate(Utf8String{ text.finish() });
+            // What the input printed comes out before its value or errors
+            pxFlush();
+            if (!result.ok)
+            {
+                errorLog.output();
+                u_fflush(u_get_stdout());
+            }
+            else if (result.type != nullptr)
+            {
+                display(result.type, result.value);
+                pxFlush();
+            }
+        }
+        if (prompt)
+            std::cout << std::endl;
+    }
+
+}
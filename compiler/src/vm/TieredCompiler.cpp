@@ -0,0 +1,406 @@
+#include "vm/TieredCompiler.h"
+#include "vm/Interpreter.h"
+#include "cg/CCompiler.h"
+#include "opt/Inliner.h"
+#include "ContextAnalyzer.h"
+#include "Parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+#ifndef PX_RUNTIME_INCLUDE_DIR
+#define PX_RUNTIME_INCLUDE_DIR "runtime/include"
+#endif
+
+namespace px
+{
+
+    TieredCompiler::TieredCompiler(const Program &p, Interpreter &i, const Utf8String &file, const std::string &text,
+                                   const TieringOptions &o)
+        : program{ p }, interpreter{ i }, fileName{ file }, source{ text }, options{ o },
+          start{ std::chrono::steady_clock::now() }, busy{ false }, stopping{ false }, compilerProcess{}, compileTime{}
+    {
+        size_t count = program.functions.size();
+        callees.resize(count);
+        requested.assign(count, false);
+        for (size_t function = 0; function < count; ++function)
+        {
+            reasons.push_back(program.functions[function].uncompilable);
+            for (const Instruction &instruction : program.functions[function].code)
+            {
+                if (instruction.op == Opcode::CALL)
+                    callees[function].push_back(instruction.b);
+            }
+        }
+
+        // A function can not be compiled if it calls one that can not be, however indirectly
+        bool spread = true;
+        while (spread)
+        {
+            spread = false;
+            for (size_t function = 0; function < count; ++function)
+            {
+                if (reasons[function].length() != 0)
+                    continue;
+                for (uint32_t callee : callees[function])
+                {
+                    if (reasons[callee].length() != 0)
+                    {
+                        reasons[function] = Utf8String{ "it calls " } + program.functions[callee].name + ", which can not be compiled";
+                        spread = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    TieredCompiler::~TieredCompiler()
+    {
+        stop();
+    #if !defined(_WIN32)
+        for (void *library : libraries)
+            dlclose(library);
+        if (!directory.empty())
+            rmdir(directory.c_str());
+    #endif
+    }
+
+    uint64_t TieredCompiler::elapsed() const
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void TieredCompiler::request(uint32_t function)
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (requested[function] || stopping)
+            return;
+        requested[function] = true;
+        if (reasons[function].length() != 0)
+        {
+            log.push_back(TierEvent{ program.functions[function].name, elapsed(), 0, false, reasons[function] });
+            return;
+        }
+        queue.push_back(function);
+        // The thread is only started once there is something to compile, so short runs never pay for it
+        if (!worker.joinable())
+            worker = std::thread{ &TieredCompiler::work, this };
+        changed.notify_all();
+    }
+
+    void TieredCompiler::finish()
+    {
+        std::unique_lock<std::mutex> lock{ mutex };
+        changed.wait(lock, [this] { return queue.empty() && !busy; });
+    }
+
+    void TieredCompiler::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            stopping = true;
+        #if !defined(_WIN32)
+            if (compilerProcess != 0)
+                kill(compilerProcess, SIGKILL);
+        #endif
+            for (uint32_t function : queue)
+                log.push_back(TierEvent{ program.functions[function].name, elapsed(), 0, false, "the run ended first" });
+            queue.clear();
+            changed.notify_all();
+        }
+        if (worker.joinable())
+            worker.join();
+    }
+
+    std::vector<TierEvent> TieredCompiler::events() const
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return log;
+    }
+
+    void TieredCompiler::work()
+    {
+        std::unique_lock<std::mutex> lock{ mutex };
+        for (;;)
+        {
+            changed.wait(lock, [this] { return !queue.empty() || stopping; });
+            if (queue.empty())
+                return;
+            uint32_t function = queue.front();
+            queue.pop_front();
+            busy = true;
+            TierEvent event{ program.functions[function].name, elapsed(), 0, false, {} };
+            lock.unlock();
+
+            auto compileStart = std::chrono::steady_clock::now();
+            compile(function, event);
+            event.compileNanoseconds = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - compileStart).count();
+
+            lock.lock();
+            compileTime += event.compileNanoseconds;
+            log.push_back(event);
+            busy = false;
+            changed.notify_all();
+        }
+    }
+
+    // The C expression that reads an argument of the given type out of an interpreter value
+    static Utf8String readValue(Type *type, const Utf8String &value)
+    {
+        Utf8String cast = Utf8String{ "(" } + CCompiler::pxTypeToCType(type) + ") ";
+        if (type->isString())
+            return value + ".s";
+        if (type->isStringBuilder())
+            return cast + value + ".p";
+        if (type->isBool())
+            return value + ".i != 0";
+        if (type->isFloat())
+            return cast + value + ".f";
+        if (type->isUInt())
+            return cast + value + ".u";
+        return cast + value + ".i";
+    }
+
+    // The member of an interpreter value that a result of the given type is kept in
+    static const char *valueMember(Type *type)
+    {
+        if (type->isString())
+            return "s";
+        if (type->isStringBuilder())
+            return "p";
+        if (type->isFloat())
+            return "f";
+        if (type->isUInt())
+            return "u";
+        return "i";
+    }
+
+    // A wrapper with the signature of a NativeFunction, so the interpreter can call the function
+    // the way it calls the runtime's
+    static Utf8String entryPoint(Function *function)
+    {
+        Utf8String call = function->name + "(";
+        for (size_t i = 0; i < function->parameters.size(); ++i)
+        {
+            if (i > 0)
+                call += ", ";
+            call += readValue(function->parameters[i]->type, Utf8String{ "arguments[" } + std::to_string(i) + "]");
+        }
+        call += ")";
+
+        Utf8String entry = "\ntypedef union { int64_t i; uint64_t u; double f; void *p; PxString s; PxVector v; } PxTierValue;\n\n";
+        entry += Utf8String{ "__attribute__((visibility(\"default\"))) void pxTier_" } + function->name + "(PxTierValue *result, const PxTierValue *arguments)\n{\n    ";
+        if (!function->returnType->isVoid())
+            entry += Utf8String{ "result->" } + valueMember(function->returnType) + " = ";
+        entry += call + ";\n}\n";
+        return entry;
+    }
+
+    static Utf8String firstLine(const std::string &path)
+    {
+        std::ifstream log{ path };
+        std::string line;
+        std::getline(log, line);
+        return line;
+    }
+
+    bool TieredCompiler::stopped() const
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return stopping;
+    }
+
+    // Runs the C compiler with its output going to the file named output and gives its exit status,
+    // or -1 when it could not be started.
+    // The process is kept where stop can kill it, so a run does not wait for a compile it has no use for.
+    int TieredCompiler::runCompiler(const std::vector<std::string> &arguments, const std::string &output)
+    {
+    #if defined(_WIN32)
+        return -1;
+    #else
+        std::vector<char*> argv;
+        for (const std::string &argument : arguments)
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        argv.push_back(nullptr);
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+        int status = -1;
+        std::unique_lock<std::mutex> lock{ mutex };
+        if (!stopping && posix_spawnp(&compilerProcess, argv[0], &actions, nullptr, argv.data(), environ) == 0)
+        {
+            lock.unlock();
+            waitpid(compilerProcess, &status, 0);
+            lock.lock();
+            compilerProcess = 0;
+        }
+        posix_spawn_file_actions_destroy(&actions);
+        return status;
+    #endif
+    }
+
+    void TieredCompiler::compile(uint32_t function, TierEvent &event)
+    {
+    #if defined(_WIN32)
+        event.reason = "tiered compilation is not supported on this platform";
+    #else
+        if (directory.empty())
+        {
+            char pattern[] = "/tmp/pxc-tier-XXXXXX";
+            if (mkdtemp(pattern) == nullptr)
+            {
+                event.reason = "a directory to build in could not be made";
+                return;
+            }
+            directory = pattern;
+        }
+
+        ErrorLog errors;
+        Parser parser{ &errors };
+        std::stringstream input{ source };
+        std::unique_ptr<ast::Module> module;
+        try {
+            module = parser.parse(fileName, input);
+        }
+        catch (const Error &) {
+            event.reason = "the module no longer parses";
+            return;
+        }
+        if (options.inlining)
+        {
+            Inliner inliner{ options.inlineThreshold };
+            inliner.run(*module);
+        }
+        ScopeTree scopeTree;
+        ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+        analyzer.analyze(*module);
+        if (errors.count() > 0)
+        {
+            event.reason = "the module no longer analyzes";
+            return;
+        }
+
+        // The function goes in the library with everything it calls
+        std::unordered_set<Utf8String> names;
+        std::vector<uint32_t> pending{ function };
+        while (!pending.empty())
+        {
+            uint32_t next = pending.back();
+            pending.pop_back();
+            if (!names.insert(program.functions[next].name).second)
+                continue;
+            pending.insert(pending.end(), callees[next].begin(), callees[next].end());
+        }
+
+        Function *compiledFunction = nullptr;
+        for (auto &statement : module->statements)
+        {
+            if (statement->nodeType == ast::NodeType::DECLARE_FUNC_BODY)
+            {
+                Function *candidate = ((ast::FunctionDefinition*) statement.get())->function;
+                if (candidate->name == event.function)
+                    compiledFunction = candidate;
+            }
+        }
+        if (compiledFunction == nullptr)
+        {
+            event.reason = "its definition was not found";
+            return;
+        }
+
+        CCompiler compiler{ &scopeTree };
+        Utf8String code = compiler.compileFunctions(*module, names) + entryPoint(compiledFunction);
+
+        std::string base = directory + "/" + event.function.toString() + "_" + std::to_string(libraries.size());
+        std::string cFile = base + ".c", library = base + ".so", output = base + ".log";
+        {
+            std::ofstream out{ cFile, std::ios::binary };
+            out << code.toString();
+        }
+        const char *cc = std::getenv("CC");
+        const char *include = std::getenv("PX_RUNTIME_INCLUDE");
+        std::string includeFlag = std::string{ "-I" } + (include != nullptr ? include : PX_RUNTIME_INCLUDE_DIR);
+        std::vector<std::string> arguments{ cc != nullptr ? cc : "cc", "-O2", "-shared", "-fPIC", "-fvisibility=hidden", "-w",
+                                            includeFlag, "-o", library, cFile };
+        int status = runCompiler(arguments, output);
+        std::remove(cFile.c_str());
+        if (status != 0)
+        {
+            if (stopped())
+                event.reason = "the run ended first";
+            else if (status == -1)
+                event.reason = Utf8String{ "the C compiler " } + arguments[0] + " could not be run";
+            else
+                event.reason = Utf8String{ "the C compiler failed: " } + firstLine(output);
+            std::remove(output.c_str());
+            std::remove(library.c_str());
+            return;
+        }
+        std::remove(output.c_str());
+
+        void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        std::remove(library.c_str());
+        if (handle == nullptr)
+        {
+            event.reason = Utf8String{ "the library did not load: " } + dlerror();
+            return;
+        }
+        void *entry = dlsym(handle, (Utf8String{ "pxTier_" } + event.function).c_str());
+        if (entry == nullptr)
+        {
+            dlclose(handle);
+            event.reason = "the library has no entry point";
+            return;
+        }
+        libraries.push_back(handle);
+        interpreter.install(function, (NativeFunction) entry);
+        event.compiled = true;
+    #endif
+    }
+
+    static std::string milliseconds(uint64_t nanoseconds)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.1f ms", nanoseconds / 1e6);
+        return text;
+    }
+
+    void TieredCompiler::outputReport() const
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        for (const TierEvent &event : log)
+        {
+            std::cerr << event.function.toString() << ": hot at " << milliseconds(event.hotNanoseconds) << ", ";
+            if (event.compiled)
+                std::cerr << "compiled in " << milliseconds(event.compileNanoseconds) << std::endl;
+            else
+                std::cerr << "not compiled: " << event.reason.toString() << std::endl;
+        }
+        uint64_t total = interpreter.runNanoseconds();
+        uint64_t compiled = interpreter.compiledNanoseconds();
+        std::cerr << "interpreted " << milliseconds(total - std::min(total, compiled));
+        if (options.timed)
+            std::cerr << ", compiled code " << milliseconds(compiled);
+        std::cerr << ", compiling " << milliseconds(compileTime) << " on the tiering thread" << std::endl;
+    }
+
+}
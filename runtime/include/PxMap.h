@@ -0,0 +1,260 @@
+#ifndef PX_PXMAP_H
+#define PX_PXMAP_H
+
+#include "PxRuntime.h"
+
+// The hash map behind px's map[K, V]: an open addressing table in the style of Swiss tables. Each
+// slot has a control byte that is EMPTY, DELETED or, for a full slot, the low 7 bits of its key's
+// hash. Slots are probed a group of 16 at a time: the control bytes of a group are compared with
+// the hash bits in one SSE2 instruction, so only keys that match them are compared. Groups are
+// visited in triangular order from the one picked by the rest of the hash, and at most 7/8 of the
+// slots are ever used, so a lookup always ends at a group with an empty slot.
+//
+// The table itself is generic; PX_MAP_DEFINE generates the functions for one key and value type,
+// which pxc emits for every map type a program uses. Tables live in the region the map was created
+// in and grow by doubling, so growing leaves the old table to be reclaimed with its region.
+// Defining PX_MAP_NO_SSE2 selects the portable byte-at-a-time probe instead.
+#if !defined(PX_MAP_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PX_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define PX_MAP_GROUP_SIZE 16
+#define PX_MAP_EMPTY ((int8_t) -128)
+#define PX_MAP_DELETED ((int8_t) -2)
+
+typedef struct _PxMap
+{
+    int8_t *control;
+    void *entries;
+    intptr_t capacity;
+    intptr_t length;
+    // Empty slots that can still be filled before the table is rebuilt
+    intptr_t growthLeft;
+    PxRegion *region;
+} PxMap;
+
+static inline PxMap pxMapCreate(void)
+{
+    PxMap map = { NULL, NULL, 0, 0, 0, pxCurrentRegion() };
+    return map;
+}
+
+// Replaces the table of map with an empty one of capacity slots; capacity is a power of two of at
+// least PX_MAP_GROUP_SIZE
+void pxMapAllocate(PxMap *map, intptr_t capacity, size_t entrySize);
+// The smallest capacity that holds count entries
+intptr_t pxMapCapacityFor(intptr_t count);
+// A map in the current region holding a copy of the entries of map
+PxMap pxMapCopy(const PxMap *map, size_t entrySize);
+// Replaces the entries of map with a copy of those of source
+void pxMapAssign(PxMap *map, const PxMap *source, size_t entrySize);
+
+static inline uint64_t pxHashInteger(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+#define PX_MAP_EQUALS(a, b) ((a) == (b))
+
+static inline uint32_t pxMapLowestBit(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t) __builtin_ctz(mask);
+#else
+    uint32_t bit = 0;
+    while ((mask & 1) == 0)
+    {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// A bit for each slot of the group whose control byte is tag
+static inline uint32_t pxMapMatch(const int8_t *control, int8_t tag)
+{
+#ifdef PX_MAP_SSE2
+    __m128i group = _mm_load_si128((const __m128i*) control);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < PX_MAP_GROUP_SIZE; ++i)
+        mask |= (uint32_t) (control[i] == tag) << i;
+    return mask;
+#endif
+}
+
+// A bit for each slot of the group that is empty or deleted, the control bytes with the sign bit set
+static inline uint32_t pxMapMatchFree(const int8_t *control)
+{
+#ifdef PX_MAP_SSE2
+    return (uint32_t) _mm_movemask_epi8(_mm_load_si128((const __m128i*) control));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < PX_MAP_GROUP_SIZE; ++i)
+        mask |= (uint32_t) (control[i] < 0) << i;
+    return mask;
+#endif
+}
+
+// The first free slot on the probe sequence of hash
+static inline intptr_t pxMapFindFree(const PxMap *map, uint64_t hash)
+{
+    size_t groupMask = (size_t) map->capacity / PX_MAP_GROUP_SIZE - 1;
+    size_t group = (size_t) (hash >> 7) & groupMask;
+    for (size_t step = 1; ; ++step)
+    {
+        uint32_t slots = pxMapMatchFree(map->control + group * PX_MAP_GROUP_SIZE);
+        if (slots != 0)
+            return (intptr_t) (group * PX_MAP_GROUP_SIZE + pxMapLowestBit(slots));
+        group = (group + step) & groupMask;
+    }
+}
+
+// The capacity to rebuild a full table with: the same when at least half of its used slots are
+// deleted entries, otherwise double
+static inline intptr_t pxMapGrownCapacity(const PxMap *map)
+{
+    if (map->capacity == 0)
+        return PX_MAP_GROUP_SIZE;
+    return map->length * 16 <= map->capacity * 7 ? map->capacity : map->capacity * 2;
+}
+
+// A slot becomes empty again when its group has never been full, since then no probe sequence
+// went on past the group; otherwise it is marked deleted so lookups keep probing past it
+static inline void pxMapErase(PxMap *map, intptr_t index)
+{
+    const int8_t *group = map->control + (index & ~(intptr_t) (PX_MAP_GROUP_SIZE - 1));
+    if (pxMapMatch(group, PX_MAP_EMPTY) != 0)
+    {
+        map->control[index] = PX_MAP_EMPTY;
+        ++map->growthLeft;
+    }
+    else
+        map->control[index] = PX_MAP_DELETED;
+    --map->length;
+}
+
+// Defines PxMapEntry_NAME and the pxMap..._NAME functions for a map from K to V. HASH(key) returns a
+// uint64_t and EQUALS(a, b) compares two keys.
+#define PX_MAP_DEFINE(NAME, K, V, HASH, EQUALS) \
+    typedef struct { K key; V value; } PxMapEntry_##NAME; \
+    \
+    static inline PxMapEntry_##NAME *pxMapFind_##NAME(const PxMap *map, K key, uint64_t hash) \
+    { \
+        if (map->length == 0) \
+            return NULL; \
+        PxMapEntry_##NAME *entries = (PxMapEntry_##NAME*) map->entries; \
+        int8_t tag = (int8_t) (hash & 0x7F); \
+        size_t groupMask = (size_t) map->capacity / PX_MAP_GROUP_SIZE - 1; \
+        size_t group = (size_t) (hash >> 7) & groupMask; \
+        for (size_t step = 1; ; ++step) \
+        { \
+            const int8_t *control = map->control + group * PX_MAP_GROUP_SIZE; \
+            for (uint32_t match = pxMapMatch(control, tag); match != 0; match &= match - 1) \
+            { \
+                PxMapEntry_##NAME *entry = &entries[group * PX_MAP_GROUP_SIZE + pxMapLowestBit(match)]; \
+                if (EQUALS(entry->key, key)) \
+                    return entry; \
+            } \
+            if (pxMapMatch(control, PX_MAP_EMPTY) != 0) \
+                return NULL; \
+            group = (group + step) & groupMask; \
+        } \
+    } \
+    \
+    static inline void pxMapRehash_##NAME(PxMap *map, intptr_t capacity) \
+    { \
+        PxMap old = *map; \
+        pxMapAllocate(map, capacity, sizeof(PxMapEntry_##NAME)); \
+        PxMapEntry_##NAME *oldEntries = (PxMapEntry_##NAME*) old.entries; \
+        for (intptr_t i = 0; i < old.capacity; ++i) \
+        { \
+            if (old.control[i] < 0) \
+                continue; \
+            uint64_t hash = HASH(oldEntries[i].key); \
+            intptr_t index = pxMapFindFree(map, hash); \
+            map->control[index] = (int8_t) (hash & 0x7F); \
+            ((PxMapEntry_##NAME*) map->entries)[index] = oldEntries[i]; \
+        } \
+        map->length = old.length; \
+        map->growthLeft -= old.length; \
+    } \
+    \
+    /* The value stored for key, or zero */ \
+    static inline V pxMapGet_##NAME(const PxMap *map, K key) \
+    { \
+        PxMapEntry_##NAME *entry = pxMapFind_##NAME(map, key, HASH(key)); \
+        if (entry != NULL) \
+            return entry->value; \
+        V zero; \
+        memset(&zero, 0, sizeof(zero)); \
+        return zero; \
+    } \
+    \
+    /* The value stored for key, which is added with a zero value when it is missing */ \
+    static inline V *pxMapSlot_##NAME(PxMap *map, K key) \
+    { \
+        uint64_t hash = HASH(key); \
+        PxMapEntry_##NAME *entry = pxMapFind_##NAME(map, key, hash); \
+        if (entry != NULL) \
+            return &entry->value; \
+        if (map->growthLeft == 0) \
+            pxMapRehash_##NAME(map, pxMapGrownCapacity(map)); \
+        intptr_t index = pxMapFindFree(map, hash); \
+        if (map->control[index] == PX_MAP_EMPTY) \
+            --map->growthLeft; \
+        map->control[index] = (int8_t) (hash & 0x7F); \
+        ++map->length; \
+        entry = &((PxMapEntry_##NAME*) map->entries)[index]; \
+        entry->key = key; \
+        memset(&entry->value, 0, sizeof(entry->value)); \
+        return &entry->value; \
+    } \
+    \
+    static inline bool pxMapContains_##NAME(const PxMap *map, K key) \
+    { \
+        return pxMapFind_##NAME(map, key, HASH(key)) != NULL; \
+    } \
+    \
+    static inline bool pxMapRemove_##NAME(PxMap *map, K key) \
+    { \
+        PxMapEntry_##NAME *entry = pxMapFind_##NAME(map, key, HASH(key)); \
+        if (entry == NULL) \
+            return false; \
+        pxMapErase(map, entry - (PxMapEntry_##NAME*) map->entries); \
+        return true; \
+    } \
+    \
+    /* Makes room for at least count more entries */ \
+    static inline void pxMapReserve_##NAME(PxMap *map, int64_t count) \
+    { \
+        intptr_t capacity = pxMapCapacityFor(map->length + (intptr_t) count); \
+        if (capacity > map->capacity) \
+            pxMapRehash_##NAME(map, capacity); \
+    } \
+    \
+    /* The keys in table order, as a dynamic array in the current region */ \
+    static inline PxVector pxMapKeys_##NAME(const PxMap *map) \
+    { \
+        PxVector keys = pxVectorCreate(); \
+        if (map->length == 0) \
+            return keys; \
+        pxVectorReserve(&keys, map->length, sizeof(K)); \
+        PxMapEntry_##NAME *entries = (PxMapEntry_##NAME*) map->entries; \
+        for (intptr_t i = 0; i < map->capacity; ++i) \
+        { \
+            if (map->control[i] >= 0) \
+                ((K*) keys.data)[keys.length++] = entries[i].key; \
+        } \
+        return keys; \
+    }
+
+#endif //PX_PXMAP_H
@@ -3,16 +3,300 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+
+// Function attributes and qualifiers emitted by pxc where analysis proves them
+#if defined(__GNUC__) || defined(__clang__)
+#define PX_PURE __attribute__((pure))
+#define PX_CONST __attribute__((const))
+#define PX_NOINLINE __attribute__((noinline))
+#define PX_ALWAYS_INLINE inline __attribute__((always_inline))
+#define PX_NORETURN __attribute__((noreturn))
+#define PX_HIDDEN __attribute__((visibility("hidden")))
+#define PX_RESTRICT __restrict__
+#define PX_UNREACHABLE() __builtin_unreachable()
+#elif defined(_MSC_VER)
+#define PX_PURE
+#define PX_CONST
+#define PX_NOINLINE __declspec(noinline)
+#define PX_ALWAYS_INLINE __forceinline
+#define PX_NORETURN __declspec(noreturn)
+#define PX_HIDDEN
+#define PX_RESTRICT __restrict
+#define PX_UNREACHABLE() __assume(0)
+#else
+#define PX_PURE
+#define PX_CONST
+#define PX_NOINLINE
+#define PX_ALWAYS_INLINE inline
+#define PX_NORETURN
+#define PX_HIDDEN
+#define PX_RESTRICT
+#define PX_UNREACHABLE() ((void) 0)
+#endif
+
+// Placed before a for loop whose iterations pxc has proven independent, so it vectorizes without runtime alias checks
+#if defined(__clang__)
+#define PX_INDEPENDENT_LOOP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define PX_INDEPENDENT_LOOP _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#define PX_INDEPENDENT_LOOP __pragma(loop(ivdep))
+#elif defined(_OPENMP)
+#define PX_INDEPENDENT_LOOP _Pragma("omp simd")
+#else
+#define PX_INDEPENDENT_LOOP
+#endif
+
+// A region hands out memory by bumping a pointer through large chunks and frees all of it at once.
+// Each thread has a default region, and region blocks in px push a new one that is released when the
+// block ends; strings, string builders and pxNew allocate from the thread's innermost region.
+// Released chunks are kept for reuse by the releasing thread, up to a limit.
+typedef struct _PxRegion PxRegion;
+
+PxRegion *pxRegionCreate(void);
+// alignment must be a power of two
+void *pxRegionAllocate(PxRegion *region, size_t size, size_t alignment);
+// Frees everything allocated from region, and region itself
+void pxRegionRelease(PxRegion *region);
+void pxRegionEnter(void);
+void pxRegionExit(void);
+PxRegion *pxCurrentRegion(void);
+void *pxNew(size_t size);
+// Backs new chunks with transparent huge pages where the system supports it (Linux madvise)
+void pxRegionUseHugePages(bool enable);
+
+// The storage of a px dynamic array (T[]): length elements of one type in a buffer of capacity
+// elements, which lives in region. A NULL region stands for the owning thread's default region.
+// pxc reads and writes elements directly through data and only calls into the runtime to grow the
+// buffer. Growth extends the buffer in place when it is the region's last allocation and otherwise
+// moves it; the old buffer is reclaimed with its region.
+typedef struct _PxVector
+{
+    void *data;
+    intptr_t length;
+    intptr_t capacity;
+    PxRegion *region;
+} PxVector;
+
+static inline PxVector pxVectorCreate(void)
+{
+    PxVector vector = { NULL, 0, 0, pxCurrentRegion() };
+    return vector;
+}
+
+// Makes room for at least count more elements, growing the capacity by the growth factor or more
+void pxVectorReserve(PxVector *vector, intptr_t count, size_t elementSize);
+// A vector in the current region holding a copy of count elements
+PxVector pxVectorFromElements(const void *elements, intptr_t count, size_t elementSize);
+// Replaces the elements of vector with a copy of count elements, reusing its buffer when it is large enough
+void pxVectorAssign(PxVector *vector, const void *elements, intptr_t count, size_t elementSize);
+void pxVectorAppend(PxVector *vector, const PxVector *other, size_t elementSize);
+// Sets how much the capacity is multiplied by when a vector grows; at least 1.1, 2 by default
+void pxVectorSetGrowthFactor(double factor);
+PX_NORETURN void pxVectorPopEmpty(void);
+
+// The slot for a new last element
+static inline void *pxVectorPush(PxVector *vector, size_t elementSize)
+{
+    if (vector->length == vector->capacity)
+        pxVectorReserve(vector, 1, elementSize);
+    return (int8_t*) vector->data + elementSize * vector->length++;
+}
+
+// Removes the last element and returns its index, where it can still be read
+static inline intptr_t pxVectorPop(PxVector *vector)
+{
+    if (vector->length == 0)
+        pxVectorPopEmpty();
+    return --vector->length;
+}
+
+// A precise mark-sweep collector for heap objects. Every thread has its own heap; objects must only
+// be used by the thread that allocated them. A PxGcType gives the byte offsets of the pointers in an
+// object, so only those are traced, and they must point to the start of another collected object or
+// be NULL. Roots are the pointer variables registered through shadow stack frames and pxGcAddRoot.
+// Objects are zero filled. Small objects come from per-size-class free lists that are rebuilt by
+// sweeping lazily as they are needed; objects over PX_GC_LARGE_OBJECT_SIZE bytes are allocated singly.
+#define PX_GC_LARGE_OBJECT_SIZE 2048
+#define PX_GC_PAUSE_BUCKETS 16
+
+typedef struct _PxGcType
+{
+    size_t size;
+    size_t pointerCount;
+    const size_t *pointerOffsets;
+} PxGcType;
+
+// The roots of one function call: roots holds the addresses of count pointer variables, which must
+// be NULL or valid whenever a collection can happen. Frames are pushed on entry and popped in
+// reverse order:
+//     Node *head = NULL, *node = NULL;
+//     void **roots[] = { (void**) &head, (void**) &node };
+//     PxGcFrame frame = { NULL, 2, roots };
+//     pxGcPushFrame(&frame);
+//     ...
+//     pxGcPopFrame(&frame);
+typedef struct _PxGcFrame
+{
+    struct _PxGcFrame *previous;
+    size_t count;
+    void **const *roots;
+} PxGcFrame;
+
+// A collection starts when the bytes allocated since the last one exceed the larger of
+// minimumHeapBytes and the bytes that survived it times (growthFactor - 1)
+typedef struct _PxGcConfig
+{
+    size_t minimumHeapBytes;
+    double growthFactor;
+} PxGcConfig;
+
+// Totals for the calling thread's heap. pauseHistogram[i] counts the collections that took less than
+// 2^i microseconds and not less than 2^(i-1); the last bucket also counts every longer one.
+typedef struct _PxGcStats
+{
+    uint64_t collections;
+    uint64_t bytesAllocated;
+    uint64_t bytesFreed;
+    size_t heapBytes;
+    size_t liveBytes;
+    uint64_t totalPauseNanoseconds;
+    uint64_t maxPauseNanoseconds;
+    uint64_t pauseHistogram[PX_GC_PAUSE_BUCKETS];
+} PxGcStats;
+
+void *pxGcAllocate(const PxGcType *type);
+// An array of count elements laid out like type, each traced through its pointer offsets
+void *pxGcAllocateArray(const PxGcType *type, size_t count);
+void pxGcPushFrame(PxGcFrame *frame);
+void pxGcPopFrame(PxGcFrame *frame);
+// Registers a pointer variable that lives outside any frame, such as a global
+void pxGcAddRoot(void **root);
+void pxGcRemoveRoot(void **root);
+void pxGcCollect(void);
+// Applies to collections started afterwards, on every thread
+void pxGcConfigure(PxGcConfig config);
+PxGcStats pxGcStats(void);
+
+// A pool of worker threads that runs px's parallel for loops and spawned tasks. Each worker keeps
+// its pending tasks in a Chase-Lev deque: it pushes and takes at the bottom while idle workers steal the oldest task from
+// the top of a random victim, and workers that find nothing to steal go to sleep until new work is
+// queued. A loop's range is split lazily: a worker running a range pushes its upper half whenever
+// its deque is empty, so ranges are only divided when some worker is free to take them, and
+// otherwise runs the range a chunk at a time. The pool starts on first use.
+typedef void (*PxRangeFunction)(void *environment, int64_t start, int64_t end);
+
+// workers is the number of threads in the pool, 0 for one per processor or the PX_WORKERS
+// environment variable when it is set; it only takes effect before the pool starts. Ranges of
+// minimumChunk iterations or fewer are never split, 0 picks a size from the iteration count.
+typedef struct _PxSchedulerConfig
+{
+    int32_t workers;
+    int64_t minimumChunk;
+} PxSchedulerConfig;
+
+// Calls body for consecutive subranges that together cover start up to end, in parallel, and
+// returns once every call has. Workers that call it help run the loop while they wait.
+void pxParallelFor(int64_t start, int64_t end, PxRangeFunction body, void *environment);
+void pxSchedulerConfigure(PxSchedulerConfig config);
+// The number of threads the pool has, or will have once it starts
+int32_t pxSchedulerWorkers(void);
+
+// A call started with pxSpawn, which the pool runs alongside its caller. pxc embeds the task at the
+// start of a struct holding the call's arguments and result, which body reads and writes. The
+// caller must await every task it spawns before the task's memory goes away. A worker that awaits
+// a task which has not finished runs other tasks meanwhile, starting with the newest in its own
+// deque, which is usually the one awaited; other threads sleep until it is done. Tasks run in the
+// default region of the thread that runs them.
+typedef struct _PxTask
+{
+    // Used by the scheduler
+    void (*run)(struct _PxTask *task);
+    struct _PxTask *next;
+    void (*body)(struct _PxTask *task);
+    int32_t state;
+} PxTask;
+
+void pxSpawn(PxTask *task, void (*body)(PxTask *task));
+// Returns once task's body has returned, with everything it wrote visible
+void pxAwait(PxTask *task);
+
+// A UTF-8 string value. Strings of up to PX_STRING_INLINE_CAPACITY bytes are stored inline, padded
+// with zeros; longer ones point into immutable storage that is never written after creation: the
+// literal itself, or memory in the current region. Substrings of long strings share bytes
+// with the original. length counts code points.
+#define PX_STRING_INLINE_CAPACITY 15
 
 typedef struct _PxString
 {
-    int8_t *bytes;
+    union
+    {
+        int8_t inlineBytes[PX_STRING_INLINE_CAPACITY + 1];
+        const int8_t *bytes;
+    } data;
     intptr_t length;
     intptr_t byteLength;
 } PxString;
 
+static inline const int8_t *pxStringBytes(const PxString *str)
+{
+    return str->byteLength <= PX_STRING_INLINE_CAPACITY ? str->data.inlineBytes : str->data.bytes;
+}
+
+PxString pxStringFromBytes(const int8_t *bytes, intptr_t byteLength);
+PxString pxStringConcat(PxString left, PxString right);
+bool pxStringEquals(PxString left, PxString right);
+// Orders by code point, negative when left comes first
+int32_t pxStringCompare(PxString left, PxString right);
+// The code point at index, or -1 when index is out of range
+int32_t pxStringCharAt(PxString str, intptr_t index);
+// The code points from start up to end, clamped to the string
+PxString pxStringSlice(PxString str, intptr_t start, intptr_t end);
+uint64_t pxStringHash(PxString str);
+// Frees everything in the calling thread's default region; any string created there must no
+// longer be used
+void pxStringArenaReset(void);
+
+// Output goes through a per-thread buffer that is written out when it fills, when pxFlush is
+// called and when the thread or the program exits
 void printInt(int32_t i);
+void printInt64(int64_t i);
+void printUInt64(uint64_t i);
 void printFloat(float f);
+void printFloat64(double d);
 void printString(PxString str);
+void pxFlush(void);
+
+// Writes the shortest text that reads back as the same value (0.1, 100.0, 1e+30) and returns its
+// length. text must hold PX_FLOAT_TEXT_SIZE bytes; the result is not NUL terminated.
+#define PX_FLOAT_TEXT_SIZE 32
+int32_t pxFormatFloat32(float f, char *text);
+int32_t pxFormatFloat64(double d, char *text);
+
+// Builds a string with amortized constant time appends. The buffer grows geometrically inside the
+// region the builder was created in, and finishStringBuilder hands it to a PxString without
+// copying, after which the builder is empty again. Builders belong to the thread that created them.
+typedef struct _PxStringBuilder
+{
+    PxRegion *region;
+    int8_t *bytes;
+    intptr_t length;
+    intptr_t byteLength;
+    intptr_t capacity;
+} PxStringBuilder;
+
+PxStringBuilder *newStringBuilder(void);
+// Makes room for at least bytes more bytes
+void reserveStringBuilder(PxStringBuilder *builder, int64_t bytes);
+void appendInt(PxStringBuilder *builder, int32_t i);
+void appendInt64(PxStringBuilder *builder, int64_t i);
+void appendUInt64(PxStringBuilder *builder, uint64_t i);
+void appendFloat(PxStringBuilder *builder, float f);
+void appendFloat64(PxStringBuilder *builder, double d);
+void appendBool(PxStringBuilder *builder, bool b);
+void appendChar(PxStringBuilder *builder, int32_t c);
+void appendString(PxStringBuilder *builder, PxString str);
+PxString finishStringBuilder(PxStringBuilder *builder);
 
 #endif //PX_PXRUNTIME_H
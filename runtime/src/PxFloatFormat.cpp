@@ -0,0 +1,468 @@
+extern "C" {
+    #include "PxRuntime.h"
+}
+
+#include "PxFormat.h"
+#include "RyuTables.h"
+
+// Shortest round-trip formatting after Ulf Adams, "Ryu: fast float-to-string conversion", PLDI 2018.
+// The digits printed are the fewest that parse back to the same value, and among those the closest
+// to the exact binary value.
+
+namespace {
+
+    const int DOUBLE_MANTISSA_BITS = 52;
+    const int DOUBLE_EXPONENT_BITS = 11;
+    const int DOUBLE_BIAS = 1023;
+    const int FLOAT_MANTISSA_BITS = 23;
+    const int FLOAT_EXPONENT_BITS = 8;
+    const int FLOAT_BIAS = 127;
+
+    // A value equal to mantissa * 10^exponent
+    struct Decimal
+    {
+        uint64_t mantissa;
+        int32_t exponent;
+    };
+
+    // ceil(log2(5^e)), or 1 for e == 0
+    inline int32_t pow5bits(int32_t e)
+    {
+        return (int32_t) (((uint32_t) e * 1217359) >> 19) + 1;
+    }
+
+    // floor(log10(2^e))
+    inline uint32_t log10Pow2(int32_t e)
+    {
+        return ((uint32_t) e * 78913) >> 18;
+    }
+
+    // floor(log10(5^e))
+    inline uint32_t log10Pow5(int32_t e)
+    {
+        return ((uint32_t) e * 732923) >> 20;
+    }
+
+    inline uint32_t pow5Factor(uint64_t value)
+    {
+        uint32_t count = 0;
+        while (value % 5 == 0)
+        {
+            value /= 5;
+            ++count;
+        }
+        return count;
+    }
+
+    inline bool multipleOfPowerOf5(uint64_t value, uint32_t p)
+    {
+        return pow5Factor(value) >= p;
+    }
+
+    inline bool multipleOfPowerOf2(uint64_t value, uint32_t p)
+    {
+        return (value & ((1ull << p) - 1)) == 0;
+    }
+
+    // (m * mul) >> j, where mul is a 128-bit factor stored low word first and j >= 64
+    inline uint64_t mulShift64(uint64_t m, const uint64_t *mul, int32_t j)
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 low = (unsigned __int128) m * mul[0];
+        unsigned __int128 high = (unsigned __int128) m * mul[1];
+        return (uint64_t) (((low >> 64) + high) >> (j - 64));
+#else
+        // 64 x 64 -> 128 bit products from 32-bit halves
+        auto multiply = [](uint64_t a, uint64_t b, uint64_t *productHigh) {
+            uint64_t aLow = (uint32_t) a, aHigh = a >> 32;
+            uint64_t bLow = (uint32_t) b, bHigh = b >> 32;
+            uint64_t lowLow = aLow * bLow;
+            uint64_t lowHigh = aLow * bHigh;
+            uint64_t highLow = aHigh * bLow;
+            uint64_t highHigh = aHigh * bHigh;
+            uint64_t middle = (lowLow >> 32) + (uint32_t) lowHigh + (uint32_t) highLow;
+            *productHigh = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+            return (middle << 32) | (uint32_t) lowLow;
+        };
+        uint64_t high0, high1;
+        multiply(m, mul[0], &high0);
+        uint64_t low1 = multiply(m, mul[1], &high1);
+        uint64_t sumLow = low1 + high0;
+        uint64_t sumHigh = high1 + (sumLow < high0);
+        int32_t shift = j - 64;
+        if (shift == 0)
+            return sumLow;
+        if (shift >= 64)
+            return sumHigh >> (shift - 64);
+        return (sumHigh << (64 - shift)) | (sumLow >> shift);
+#endif
+    }
+
+    // (m * factor) >> shift for a 64-bit factor and shift > 32
+    inline uint32_t mulShift32(uint32_t m, uint64_t factor, int32_t shift)
+    {
+        uint64_t low = (uint64_t) m * (uint32_t) factor;
+        uint64_t high = (uint64_t) m * (uint32_t) (factor >> 32);
+        return (uint32_t) (((low >> 32) + high) >> (shift - 32));
+    }
+
+    Decimal shortestDouble(uint64_t ieeeMantissa, uint32_t ieeeExponent)
+    {
+        int32_t e2;
+        uint64_t m2;
+        if (ieeeExponent == 0)
+        {
+            e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+            m2 = ieeeMantissa;
+        }
+        else
+        {
+            e2 = (int32_t) ieeeExponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+            m2 = (1ull << DOUBLE_MANTISSA_BITS) | ieeeMantissa;
+        }
+        const bool acceptBounds = (m2 & 1) == 0;
+
+        // The interval of values that round to this double is [mm, mp] in units of 2^e2,
+        // asymmetric below powers of two
+        const uint64_t mv = 4 * m2;
+        const uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+
+        uint64_t vr, vp, vm;
+        int32_t e10;
+        bool vmIsTrailingZeros = false;
+        bool vrIsTrailingZeros = false;
+        if (e2 >= 0)
+        {
+            const uint32_t q = log10Pow2(e2) - (e2 > 3);
+            e10 = (int32_t) q;
+            const int32_t k = DOUBLE_POW5_INV_BITCOUNT + pow5bits((int32_t) q) - 1;
+            const int32_t i = -e2 + (int32_t) q + k;
+            vr = mulShift64(mv, DOUBLE_POW5_INV_SPLIT[q], i);
+            vp = mulShift64(mv + 2, DOUBLE_POW5_INV_SPLIT[q], i);
+            vm = mulShift64(mv - 1 - mmShift, DOUBLE_POW5_INV_SPLIT[q], i);
+            if (q <= 21)
+            {
+                // At most one of mp, mv and mm is a multiple of 5
+                if (mv % 5 == 0)
+                    vrIsTrailingZeros = multipleOfPowerOf5(mv, q);
+                else if (acceptBounds)
+                    vmIsTrailingZeros = multipleOfPowerOf5(mv - 1 - mmShift, q);
+                else
+                    vp -= multipleOfPowerOf5(mv + 2, q);
+            }
+        }
+        else
+        {
+            const uint32_t q = log10Pow5(-e2) - (-e2 > 1);
+            e10 = (int32_t) q + e2;
+            const int32_t i = -e2 - (int32_t) q;
+            const int32_t k = pow5bits(i) - DOUBLE_POW5_BITCOUNT;
+            const int32_t j = (int32_t) q - k;
+            vr = mulShift64(mv, DOUBLE_POW5_SPLIT[i], j);
+            vp = mulShift64(mv + 2, DOUBLE_POW5_SPLIT[i], j);
+            vm = mulShift64(mv - 1 - mmShift, DOUBLE_POW5_SPLIT[i], j);
+            if (q <= 1)
+            {
+                // mv = 4 * m2 always has at least two trailing zero bits
+                vrIsTrailingZeros = true;
+                if (acceptBounds)
+                    vmIsTrailingZeros = mmShift == 1;
+                else
+                    --vp;
+            }
+            else if (q < 63)
+            {
+                vrIsTrailingZeros = multipleOfPowerOf2(mv, q);
+            }
+        }
+
+        // Remove digits while the interval still holds more than one candidate
+        int32_t removed = 0;
+        uint8_t lastRemovedDigit = 0;
+        uint64_t output;
+        if (vmIsTrailingZeros || vrIsTrailingZeros)
+        {
+            while (vp / 10 > vm / 10)
+            {
+                vmIsTrailingZeros &= vm % 10 == 0;
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = (uint8_t) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+            if (vmIsTrailingZeros)
+            {
+                while (vm % 10 == 0)
+                {
+                    vrIsTrailingZeros &= lastRemovedDigit == 0;
+                    lastRemovedDigit = (uint8_t) (vr % 10);
+                    vr /= 10;
+                    vp /= 10;
+                    vm /= 10;
+                    ++removed;
+                }
+            }
+            // Round half to even when the exact value ends in 5 followed by zeros
+            if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+                lastRemovedDigit = 4;
+            output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+        }
+        else
+        {
+            bool roundUp = false;
+            if (vp / 100 > vm / 100)
+            {
+                roundUp = vr % 100 >= 50;
+                vr /= 100;
+                vp /= 100;
+                vm /= 100;
+                removed += 2;
+            }
+            while (vp / 10 > vm / 10)
+            {
+                roundUp = vr % 10 >= 5;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+            output = vr + (vr == vm || roundUp);
+        }
+        return Decimal{ output, e10 + removed };
+    }
+
+    Decimal shortestFloat(uint32_t ieeeMantissa, uint32_t ieeeExponent)
+    {
+        int32_t e2;
+        uint32_t m2;
+        if (ieeeExponent == 0)
+        {
+            e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+            m2 = ieeeMantissa;
+        }
+        else
+        {
+            e2 = (int32_t) ieeeExponent - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+            m2 = (1u << FLOAT_MANTISSA_BITS) | ieeeMantissa;
+        }
+        const bool acceptBounds = (m2 & 1) == 0;
+
+        const uint32_t mv = 4 * m2;
+        const uint32_t mp = 4 * m2 + 2;
+        const uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+        const uint32_t mm = 4 * m2 - 1 - mmShift;
+
+        uint32_t vr, vp, vm;
+        int32_t e10;
+        bool vmIsTrailingZeros = false;
+        bool vrIsTrailingZeros = false;
+        uint8_t lastRemovedDigit = 0;
+        if (e2 >= 0)
+        {
+            const uint32_t q = log10Pow2(e2);
+            e10 = (int32_t) q;
+            const int32_t k = FLOAT_POW5_INV_BITCOUNT + pow5bits((int32_t) q) - 1;
+            const int32_t i = -e2 + (int32_t) q + k;
+            vr = mulShift32(mv, FLOAT_POW5_INV_SPLIT[q], i);
+            vp = mulShift32(mp, FLOAT_POW5_INV_SPLIT[q], i);
+            vm = mulShift32(mm, FLOAT_POW5_INV_SPLIT[q], i);
+            if (q != 0 && (vp - 1) / 10 <= vm / 10)
+            {
+                // The loop below removes no digit, but rounding still needs the first removed one
+                const int32_t l = FLOAT_POW5_INV_BITCOUNT + pow5bits((int32_t) (q - 1)) - 1;
+                lastRemovedDigit = (uint8_t) (mulShift32(mv, FLOAT_POW5_INV_SPLIT[q - 1], -e2 + (int32_t) q - 1 + l) % 10);
+            }
+            if (q <= 9)
+            {
+                if (mv % 5 == 0)
+                    vrIsTrailingZeros = multipleOfPowerOf5(mv, q);
+                else if (acceptBounds)
+                    vmIsTrailingZeros = multipleOfPowerOf5(mm, q);
+                else
+                    vp -= multipleOfPowerOf5(mp, q);
+            }
+        }
+        else
+        {
+            const uint32_t q = log10Pow5(-e2);
+            e10 = (int32_t) q + e2;
+            const int32_t i = -e2 - (int32_t) q;
+            const int32_t k = pow5bits(i) - FLOAT_POW5_BITCOUNT;
+            int32_t j = (int32_t) q - k;
+            vr = mulShift32(mv, FLOAT_POW5_SPLIT[i], j);
+            vp = mulShift32(mp, FLOAT_POW5_SPLIT[i], j);
+            vm = mulShift32(mm, FLOAT_POW5_SPLIT[i], j);
+            if (q != 0 && (vp - 1) / 10 <= vm / 10)
+            {
+                j = (int32_t) q - 1 - (pow5bits(i + 1) - FLOAT_POW5_BITCOUNT);
+                lastRemovedDigit = (uint8_t) (mulShift32(mv, FLOAT_POW5_SPLIT[i + 1], j) % 10);
+            }
+            if (q <= 1)
+            {
+                vrIsTrailingZeros = true;
+                if (acceptBounds)
+                    vmIsTrailingZeros = mmShift == 1;
+                else
+                    --vp;
+            }
+            else if (q < 31)
+            {
+                vrIsTrailingZeros = multipleOfPowerOf2(mv, q - 1);
+            }
+        }
+
+        int32_t removed = 0;
+        uint32_t output;
+        if (vmIsTrailingZeros || vrIsTrailingZeros)
+        {
+            while (vp / 10 > vm / 10)
+            {
+                vmIsTrailingZeros &= vm % 10 == 0;
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = (uint8_t) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+            if (vmIsTrailingZeros)
+            {
+                while (vm % 10 == 0)
+                {
+                    vrIsTrailingZeros &= lastRemovedDigit == 0;
+                    lastRemovedDigit = (uint8_t) (vr % 10);
+                    vr /= 10;
+                    vp /= 10;
+                    vm /= 10;
+                    ++removed;
+                }
+            }
+            if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+                lastRemovedDigit = 4;
+            output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+        }
+        else
+        {
+            while (vp / 10 > vm / 10)
+            {
+                lastRemovedDigit = (uint8_t) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+            output = vr + (vr == vm || lastRemovedDigit >= 5);
+        }
+        return Decimal{ output, e10 + removed };
+    }
+
+    int32_t writeSpecial(bool sign, bool mantissa, bool exponent, char *text)
+    {
+        char *start = text;
+        if (mantissa)
+        {
+            memcpy(text, "nan", 3);
+            return 3;
+        }
+        if (sign)
+            *text++ = '-';
+        if (exponent)
+        {
+            memcpy(text, "inf", 3);
+            text += 3;
+        }
+        else
+        {
+            memcpy(text, "0.0", 3);
+            text += 3;
+        }
+        return (int32_t) (text - start);
+    }
+
+    // Plain notation while the decimal point stays within 21 digits to the right or 6 zeros to the
+    // left of the digits, scientific notation otherwise. Integral values keep a ".0".
+    int32_t writeDecimal(bool sign, Decimal decimal, char *text)
+    {
+        char digits[24];
+        char *digitsEnd = digits + sizeof(digits);
+        char *digitsStart = px::formatDigits(decimal.mantissa, digitsEnd);
+        const int32_t length = (int32_t) (digitsEnd - digitsStart);
+        const int32_t point = length + decimal.exponent;
+
+        char *start = text;
+        if (sign)
+            *text++ = '-';
+        if (point >= length && point <= 21)
+        {
+            memcpy(text, digitsStart, length);
+            text += length;
+            memset(text, '0', point - length);
+            text += point - length;
+            memcpy(text, ".0", 2);
+            text += 2;
+        }
+        else if (point > 0 && point < length)
+        {
+            memcpy(text, digitsStart, point);
+            text += point;
+            *text++ = '.';
+            memcpy(text, digitsStart + point, length - point);
+            text += length - point;
+        }
+        else if (point <= 0 && point > -6)
+        {
+            memcpy(text, "0.", 2);
+            text += 2;
+            memset(text, '0', -point);
+            text += -point;
+            memcpy(text, digitsStart, length);
+            text += length;
+        }
+        else
+        {
+            *text++ = digitsStart[0];
+            if (length > 1)
+            {
+                *text++ = '.';
+                memcpy(text, digitsStart + 1, length - 1);
+                text += length - 1;
+            }
+            int32_t exponent = point - 1;
+            *text++ = 'e';
+            *text++ = exponent < 0 ? '-' : '+';
+            char exponentDigits[4];
+            char *exponentEnd = exponentDigits + sizeof(exponentDigits);
+            char *exponentStart = px::formatDigits(exponent < 0 ? -exponent : exponent, exponentEnd);
+            memcpy(text, exponentStart, exponentEnd - exponentStart);
+            text += exponentEnd - exponentStart;
+        }
+        return (int32_t) (text - start);
+    }
+
+}
+
+extern "C" int32_t pxFormatFloat32(float f, char *text)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(f));
+    const bool sign = (bits >> (FLOAT_MANTISSA_BITS + FLOAT_EXPONENT_BITS)) != 0;
+    const uint32_t ieeeMantissa = bits & ((1u << FLOAT_MANTISSA_BITS) - 1);
+    const uint32_t ieeeExponent = (bits >> FLOAT_MANTISSA_BITS) & ((1u << FLOAT_EXPONENT_BITS) - 1);
+    if (ieeeExponent == (1u << FLOAT_EXPONENT_BITS) - 1 || (ieeeExponent == 0 && ieeeMantissa == 0))
+        return writeSpecial(sign, ieeeMantissa != 0, ieeeExponent != 0, text);
+    return writeDecimal(sign, shortestFloat(ieeeMantissa, ieeeExponent), text);
+}
+
+extern "C" int32_t pxFormatFloat64(double d, char *text)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(d));
+    const bool sign = (bits >> (DOUBLE_MANTISSA_BITS + DOUBLE_EXPONENT_BITS)) != 0;
+    const uint64_t ieeeMantissa = bits & ((1ull << DOUBLE_MANTISSA_BITS) - 1);
+    const uint32_t ieeeExponent = (uint32_t) ((bits >> DOUBLE_MANTISSA_BITS) & ((1u << DOUBLE_EXPONENT_BITS) - 1));
+    if (ieeeExponent == (1u << DOUBLE_EXPONENT_BITS) - 1 || (ieeeExponent == 0 && ieeeMantissa == 0))
+        return writeSpecial(sign, ieeeMantissa != 0, ieeeExponent != 0, text);
+    return writeDecimal(sign, shortestDouble(ieeeMantissa, ieeeExponent), text);
+}
@@ -0,0 +1,16 @@
+#ifndef PX_PXFORMAT_H
+#define PX_PXFORMAT_H
+
+#include <stdint.h>
+
+namespace px {
+
+    // Writes the decimal digits of value ending just before end and returns where they start
+    char *formatDigits(uint64_t value, char *end);
+
+    // Writes out whatever the calling thread has buffered, without flushing stdout when it is nothing
+    void flushOutput();
+
+}
+
+#endif //PX_PXFORMAT_H
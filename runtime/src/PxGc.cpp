@@ -0,0 +1,426 @@
+extern "C" {
+    #include "PxRuntime.h"
+}
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+    const size_t BLOCK_SIZE = 64 * 1024;
+    const size_t CLASS_COUNT = 24;
+    const size_t CLASS_SIZES[CLASS_COUNT] = {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        160, 192, 224, 256, 320, 384, 448, 512,
+        640, 768, 896, 1024, 1280, 1536, 1792, PX_GC_LARGE_OBJECT_SIZE
+    };
+    const size_t MARK_STACK_MINIMUM = 1024;
+
+    // Precedes every object; 16 bytes so the object after it keeps malloc's alignment
+    struct Header
+    {
+        // nullptr while the slot is on a free list
+        const PxGcType *type;
+        uint32_t count;
+        // The last collection that found the object reachable
+        uint32_t markedIn;
+    };
+
+    static_assert(sizeof(Header) == 16, "object headers must keep 16 byte alignment");
+
+    struct Block
+    {
+        Block *next;
+        size_t sizeClass;
+    };
+
+    struct LargeObject
+    {
+        LargeObject *next;
+        size_t size;
+    };
+
+    struct Heap
+    {
+        // Slots known to be free; a free slot keeps the next free header in its first word
+        Header *freeLists[CLASS_COUNT];
+        Block *blocks[CLASS_COUNT];
+        // The blocks not yet swept since the last collection run from here to the end of the list;
+        // blocks made since are added at the front and need no sweep. A collection can start before
+        // every block is swept, since an object is only live when it is marked with the latest epoch.
+        Block *unswept[CLASS_COUNT];
+        uint32_t epoch;
+        LargeObject *largeObjects;
+        size_t allocatedSinceCollection;
+        size_t collectAfter;
+        PxGcFrame *frames;
+        void ***roots;
+        size_t rootCount;
+        size_t rootCapacity;
+        Header **markStack;
+        size_t markCount;
+        size_t markCapacity;
+        PxGcStats stats;
+    };
+
+    std::atomic<size_t> minimumHeapBytes{ 4 * 1024 * 1024 };
+    std::atomic<double> growthFactor{ 2.0 };
+
+    thread_local Heap heap;
+
+    // Size classes for every multiple of 16 bytes up to the largest class
+    struct ClassTable
+    {
+        uint8_t classes[PX_GC_LARGE_OBJECT_SIZE / 16 + 1];
+
+        ClassTable()
+        {
+            size_t sizeClass = 0;
+            for (size_t i = 0; i <= PX_GC_LARGE_OBJECT_SIZE / 16; ++i)
+            {
+                while (CLASS_SIZES[sizeClass] < i * 16)
+                    ++sizeClass;
+                classes[i] = (uint8_t) sizeClass;
+            }
+        }
+    };
+
+    const ClassTable classTable;
+
+    uint64_t nanoseconds()
+    {
+#if defined(_WIN32)
+        LARGE_INTEGER counter, frequency;
+        QueryPerformanceCounter(&counter);
+        QueryPerformanceFrequency(&frequency);
+        return (uint64_t) ((double) counter.QuadPart * 1e9 / (double) frequency.QuadPart);
+#else
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
+#endif
+    }
+
+    void *allocateOrAbort(size_t size)
+    {
+        void *memory = malloc(size);
+        if (memory == nullptr)
+            abort();
+        return memory;
+    }
+
+    size_t slotSize(size_t sizeClass)
+    {
+        return sizeof(Header) + CLASS_SIZES[sizeClass];
+    }
+
+    int8_t *firstSlot(Block *block)
+    {
+        return (int8_t*) (block + 1);
+    }
+
+    int8_t *slotsEnd(Block *block)
+    {
+        size_t size = slotSize(block->sizeClass);
+        int8_t *first = firstSlot(block);
+        return first + ((int8_t*) block + BLOCK_SIZE - first) / size * size;
+    }
+
+    Header *&nextFree(Header *header)
+    {
+        return *(Header**) (header + 1);
+    }
+
+    size_t objectSize(const Header *header)
+    {
+        return header->type->size * header->count;
+    }
+
+    void pushMark(Header *header)
+    {
+        if (heap.markCount == heap.markCapacity)
+        {
+            heap.markCapacity = heap.markCapacity == 0 ? MARK_STACK_MINIMUM : heap.markCapacity * 2;
+            heap.markStack = (Header**) realloc(heap.markStack, heap.markCapacity * sizeof(Header*));
+            if (heap.markStack == nullptr)
+                abort();
+        }
+        heap.markStack[heap.markCount++] = header;
+    }
+
+    void mark(void *object)
+    {
+        if (object == nullptr)
+            return;
+        Header *header = (Header*) object - 1;
+        if (header->markedIn == heap.epoch)
+            return;
+        header->markedIn = heap.epoch;
+        heap.stats.liveBytes += objectSize(header);
+        if (header->type->pointerCount != 0)
+            pushMark(header);
+    }
+
+    void traceMarked()
+    {
+        while (heap.markCount != 0)
+        {
+            Header *header = heap.markStack[--heap.markCount];
+            const PxGcType *type = header->type;
+            auto element = (int8_t*) (header + 1);
+            for (uint32_t i = 0; i < header->count; ++i, element += type->size)
+            {
+                for (size_t p = 0; p < type->pointerCount; ++p)
+                    mark(*(void**) (element + type->pointerOffsets[p]));
+            }
+        }
+    }
+
+    // Frees the objects in block the latest collection did not reach and puts every free slot on its
+    // class's free list
+    void sweep(Block *block)
+    {
+        size_t size = slotSize(block->sizeClass);
+        Header *&freeList = heap.freeLists[block->sizeClass];
+        int8_t *end = slotsEnd(block);
+        for (int8_t *slot = firstSlot(block); slot != end; slot += size)
+        {
+            auto header = (Header*) slot;
+            if (header->type != nullptr)
+            {
+                if (header->markedIn == heap.epoch)
+                    continue;
+                heap.stats.bytesFreed += objectSize(header);
+                header->type = nullptr;
+            }
+            nextFree(header) = freeList;
+            freeList = header;
+        }
+    }
+
+    // Large objects are few, so they are swept at the end of the collection rather than lazily
+    void sweepLargeObjects()
+    {
+        LargeObject **link = &heap.largeObjects;
+        while (*link != nullptr)
+        {
+            LargeObject *object = *link;
+            auto header = (Header*) (object + 1);
+            if (header->markedIn == heap.epoch)
+            {
+                link = &object->next;
+                continue;
+            }
+            *link = object->next;
+            heap.stats.bytesFreed += objectSize(header);
+            heap.stats.heapBytes -= object->size;
+            free(object);
+        }
+    }
+
+    void recordPause(uint64_t pause)
+    {
+        PxGcStats &stats = heap.stats;
+        ++stats.collections;
+        stats.totalPauseNanoseconds += pause;
+        if (pause > stats.maxPauseNanoseconds)
+            stats.maxPauseNanoseconds = pause;
+        size_t bucket = 0;
+        for (uint64_t micros = pause / 1000; micros != 0 && bucket < PX_GC_PAUSE_BUCKETS - 1; micros >>= 1)
+            ++bucket;
+        ++stats.pauseHistogram[bucket];
+    }
+
+    void collect()
+    {
+        uint64_t start = nanoseconds();
+
+        // Every block is swept again after marking, which finds the slots already free as well
+        for (Header *&freeList : heap.freeLists)
+            freeList = nullptr;
+        ++heap.epoch;
+
+        heap.stats.liveBytes = 0;
+        for (PxGcFrame *frame = heap.frames; frame != nullptr; frame = frame->previous)
+        {
+            for (size_t i = 0; i < frame->count; ++i)
+                mark(*frame->roots[i]);
+        }
+        for (size_t i = 0; i < heap.rootCount; ++i)
+            mark(*heap.roots[i]);
+        traceMarked();
+
+        sweepLargeObjects();
+        for (size_t sizeClass = 0; sizeClass < CLASS_COUNT; ++sizeClass)
+            heap.unswept[sizeClass] = heap.blocks[sizeClass];
+
+        double growth = growthFactor.load(std::memory_order_relaxed) - 1.0;
+        size_t scaled = (size_t) ((double) heap.stats.liveBytes * (growth > 0 ? growth : 0));
+        size_t minimum = minimumHeapBytes.load(std::memory_order_relaxed);
+        heap.collectAfter = scaled > minimum ? scaled : minimum;
+        heap.allocatedSinceCollection = 0;
+
+        recordPause(nanoseconds() - start);
+    }
+
+    bool shouldCollect()
+    {
+        if (heap.collectAfter == 0)
+            heap.collectAfter = minimumHeapBytes.load(std::memory_order_relaxed);
+        return heap.allocatedSinceCollection >= heap.collectAfter;
+    }
+
+    void addBlock(size_t sizeClass)
+    {
+        auto block = (Block*) allocateOrAbort(BLOCK_SIZE);
+        block->next = heap.blocks[sizeClass];
+        block->sizeClass = sizeClass;
+        heap.blocks[sizeClass] = block;
+        heap.stats.heapBytes += BLOCK_SIZE;
+
+        size_t size = slotSize(sizeClass);
+        Header *&freeList = heap.freeLists[sizeClass];
+        int8_t *end = slotsEnd(block);
+        for (int8_t *slot = end - size; slot >= firstSlot(block); slot -= size)
+        {
+            auto header = (Header*) slot;
+            header->type = nullptr;
+            header->markedIn = 0;
+            nextFree(header) = freeList;
+            freeList = header;
+        }
+    }
+
+    // Sweeps the class's blocks until one yields a free slot, collecting or growing the heap when
+    // none are left
+    Header *refill(size_t sizeClass)
+    {
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            while (heap.freeLists[sizeClass] == nullptr && heap.unswept[sizeClass] != nullptr)
+            {
+                Block *block = heap.unswept[sizeClass];
+                heap.unswept[sizeClass] = block->next;
+                sweep(block);
+            }
+            if (heap.freeLists[sizeClass] != nullptr)
+                return heap.freeLists[sizeClass];
+            if (attempt != 0 || !shouldCollect())
+                break;
+            collect();
+        }
+        addBlock(sizeClass);
+        return heap.freeLists[sizeClass];
+    }
+
+    Header *allocateLarge(size_t size)
+    {
+        heap.allocatedSinceCollection += size;
+        if (shouldCollect())
+            collect();
+        size_t total = sizeof(LargeObject) + sizeof(Header) + size;
+        auto object = (LargeObject*) allocateOrAbort(total);
+        object->next = heap.largeObjects;
+        object->size = total;
+        heap.largeObjects = object;
+        heap.stats.heapBytes += total;
+
+        auto header = (Header*) (object + 1);
+        header->markedIn = 0;
+        return header;
+    }
+
+}
+
+static_assert(sizeof(Block) % sizeof(Header) == 0 && sizeof(LargeObject) % sizeof(Header) == 0,
+              "objects must keep 16 byte alignment");
+
+extern "C" void *pxGcAllocate(const PxGcType *type)
+{
+    return pxGcAllocateArray(type, 1);
+}
+
+extern "C" void *pxGcAllocateArray(const PxGcType *type, size_t count)
+{
+    if (count > UINT32_MAX || (type->size != 0 && count > SIZE_MAX / type->size))
+        abort();
+    size_t size = type->size * count;
+    Header *header;
+    if (size > PX_GC_LARGE_OBJECT_SIZE)
+    {
+        header = allocateLarge(size);
+    }
+    else
+    {
+        size_t sizeClass = classTable.classes[(size + 15) / 16];
+        heap.allocatedSinceCollection += CLASS_SIZES[sizeClass];
+        header = heap.freeLists[sizeClass];
+        if (header == nullptr)
+            header = refill(sizeClass);
+        heap.freeLists[sizeClass] = nextFree(header);
+    }
+    header->type = type;
+    header->count = (uint32_t) count;
+    heap.stats.bytesAllocated += size;
+    void *object = header + 1;
+    memset(object, 0, size);
+    return object;
+}
+
+extern "C" void pxGcPushFrame(PxGcFrame *frame)
+{
+    frame->previous = heap.frames;
+    heap.frames = frame;
+}
+
+extern "C" void pxGcPopFrame(PxGcFrame *frame)
+{
+    heap.frames = frame->previous;
+}
+
+extern "C" void pxGcAddRoot(void **root)
+{
+    if (heap.rootCount == heap.rootCapacity)
+    {
+        heap.rootCapacity = heap.rootCapacity == 0 ? 16 : heap.rootCapacity * 2;
+        heap.roots = (void***) realloc(heap.roots, heap.rootCapacity * sizeof(void**));
+        if (heap.roots == nullptr)
+            abort();
+    }
+    heap.roots[heap.rootCount++] = root;
+}
+
+extern "C" void pxGcRemoveRoot(void **root)
+{
+    for (size_t i = heap.rootCount; i-- != 0;)
+    {
+        if (heap.roots[i] == root)
+        {
+            heap.roots[i] = heap.roots[--heap.rootCount];
+            return;
+        }
+    }
+}
+
+extern "C" void pxGcCollect(void)
+{
+    collect();
+}
+
+extern "C" void pxGcConfigure(PxGcConfig config)
+{
+    minimumHeapBytes.store(config.minimumHeapBytes, std::memory_order_relaxed);
+    growthFactor.store(config.growthFactor, std::memory_order_relaxed);
+}
+
+extern "C" PxGcStats pxGcStats(void)
+{
+    return heap.stats;
+}
@@ -0,0 +1,69 @@
+extern "C" {
+    #include "PxMap.h"
+}
+
+#include "PxRegion.h"
+
+namespace {
+
+    const size_t TABLE_ALIGNMENT = 16;
+
+    PxRegion *regionOf(const PxMap *map)
+    {
+        return map->region != nullptr ? map->region : px::defaultRegion();
+    }
+
+    // Copies the table of source, which has the same capacity as map
+    void copyTable(PxMap *map, const PxMap *source, size_t entrySize)
+    {
+        memcpy(map->control, source->control, (size_t) source->capacity);
+        memcpy(map->entries, source->entries, (size_t) source->capacity * entrySize);
+        map->length = source->length;
+        map->growthLeft = source->growthLeft;
+    }
+
+}
+
+extern "C" void pxMapAllocate(PxMap *map, intptr_t capacity, size_t entrySize)
+{
+    PxRegion *region = regionOf(map);
+    map->control = (int8_t*) pxRegionAllocate(region, (size_t) capacity, TABLE_ALIGNMENT);
+    map->entries = pxRegionAllocate(region, (size_t) capacity * entrySize, TABLE_ALIGNMENT);
+    memset(map->control, PX_MAP_EMPTY, (size_t) capacity);
+    map->capacity = capacity;
+    map->length = 0;
+    map->growthLeft = capacity - capacity / 8;
+}
+
+extern "C" intptr_t pxMapCapacityFor(intptr_t count)
+{
+    intptr_t capacity = PX_MAP_GROUP_SIZE;
+    while (capacity - capacity / 8 < count)
+        capacity *= 2;
+    return capacity;
+}
+
+extern "C" PxMap pxMapCopy(const PxMap *map, size_t entrySize)
+{
+    PxMap copy = pxMapCreate();
+    if (map->length != 0)
+    {
+        pxMapAllocate(&copy, map->capacity, entrySize);
+        copyTable(&copy, map, entrySize);
+    }
+    return copy;
+}
+
+extern "C" void pxMapAssign(PxMap *map, const PxMap *source, size_t entrySize)
+{
+    if (map == source)
+        return;
+    if (source->length == 0)
+    {
+        if (map->capacity != 0)
+            pxMapAllocate(map, map->capacity, entrySize);
+        return;
+    }
+    pxMapAllocate(map, source->capacity, entrySize);
+    copyTable(map, source, entrySize);
+}
@@ -0,0 +1,274 @@
+extern "C" {
+    #include "PxRuntime.h"
+}
+
+#include "PxRegion.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define PX_REGION_MMAP 1
+#endif
+
+namespace {
+
+    // One transparent huge page, so a chunk can be backed by a single one
+    const size_t CHUNK_SIZE = 2 * 1024 * 1024;
+    const size_t PAGE_SIZE = 4096;
+    const size_t MAX_CACHED_CHUNKS = 8;
+
+    struct Chunk
+    {
+        Chunk *next;
+        size_t size;
+    };
+
+    const size_t CHUNK_CAPACITY = CHUNK_SIZE - sizeof(Chunk);
+
+    std::atomic<bool> useHugePages{ false };
+
+    // Chunks released by this thread, reused before new ones are mapped
+    thread_local Chunk *cachedChunks;
+    thread_local size_t cachedCount;
+
+    int8_t *chunkData(Chunk *chunk)
+    {
+        return (int8_t*) (chunk + 1);
+    }
+
+    Chunk *mapChunk(size_t size)
+    {
+#if defined(PX_REGION_MMAP)
+        void *memory;
+        if (useHugePages.load(std::memory_order_relaxed) && size == CHUNK_SIZE)
+        {
+            // Map one chunk more than needed and trim it so the chunk starts on a huge page boundary
+            auto mapped = (int8_t*) mmap(nullptr, size + CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapped == (int8_t*) MAP_FAILED)
+                abort();
+            auto start = (int8_t*) (((uintptr_t) mapped + CHUNK_SIZE - 1) & ~(uintptr_t) (CHUNK_SIZE - 1));
+            if (start != mapped)
+                munmap(mapped, start - mapped);
+            munmap(start + size, mapped + CHUNK_SIZE - start);
+#if defined(MADV_HUGEPAGE)
+            madvise(start, size, MADV_HUGEPAGE);
+#endif
+            memory = start;
+        }
+        else
+        {
+            memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                abort();
+        }
+#else
+        void *memory = malloc(size);
+        if (memory == nullptr)
+            abort();
+#endif
+        auto chunk = (Chunk*) memory;
+        chunk->next = nullptr;
+        chunk->size = size;
+        return chunk;
+    }
+
+    void unmapChunk(Chunk *chunk)
+    {
+#if defined(PX_REGION_MMAP)
+        munmap(chunk, chunk->size);
+#else
+        free(chunk);
+#endif
+    }
+
+}
+
+struct _PxRegion
+{
+    int8_t *top;
+    int8_t *limit;
+    // Standard chunks, kept with their tail and count so releasing them is one splice
+    Chunk *chunks;
+    Chunk *lastChunk;
+    size_t chunkCount;
+    // Chunks made for allocations larger than a standard chunk, unmapped on release
+    Chunk *largeChunks;
+    // The region that was current before a scoped region was entered
+    PxRegion *outer;
+};
+
+namespace {
+
+    thread_local PxRegion threadRegion;
+    thread_local PxRegion *current;
+    // Scoped region structures kept for the next pxRegionEnter
+    thread_local PxRegion *freeScopes;
+
+    void clear(PxRegion *region)
+    {
+        region->top = nullptr;
+        region->limit = nullptr;
+        region->chunks = nullptr;
+        region->lastChunk = nullptr;
+        region->chunkCount = 0;
+        region->largeChunks = nullptr;
+        region->outer = nullptr;
+    }
+
+    void refill(PxRegion *region, size_t needed)
+    {
+        Chunk *chunk;
+        if (needed <= CHUNK_CAPACITY)
+        {
+            if (cachedChunks != nullptr)
+            {
+                chunk = cachedChunks;
+                cachedChunks = chunk->next;
+                --cachedCount;
+            }
+            else
+            {
+                chunk = mapChunk(CHUNK_SIZE);
+            }
+            chunk->next = region->chunks;
+            if (region->chunks == nullptr)
+                region->lastChunk = chunk;
+            region->chunks = chunk;
+            ++region->chunkCount;
+        }
+        else
+        {
+            // Twice the size, so a string or builder that keeps growing at the end of it can
+            // extend in place and is copied a logarithmic number of times
+            size_t size = (sizeof(Chunk) + needed * 2 + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+            chunk = mapChunk(size);
+            chunk->next = region->largeChunks;
+            region->largeChunks = chunk;
+        }
+        region->top = chunkData(chunk);
+        region->limit = (int8_t*) chunk + chunk->size;
+    }
+
+}
+
+bool px::regionExtend(PxRegion *region, const void *end, size_t extra)
+{
+    if (region->top != end || (size_t) (region->limit - region->top) < extra)
+        return false;
+    region->top += extra;
+    return true;
+}
+
+void px::regionShrink(PxRegion *region, const void *end, size_t size)
+{
+    if (region->top == end)
+        region->top -= size;
+}
+
+void px::regionReset(PxRegion *region)
+{
+    if (region->chunks != nullptr)
+    {
+        region->lastChunk->next = cachedChunks;
+        cachedChunks = region->chunks;
+        cachedCount += region->chunkCount;
+        while (cachedCount > MAX_CACHED_CHUNKS)
+        {
+            Chunk *chunk = cachedChunks;
+            cachedChunks = chunk->next;
+            --cachedCount;
+            unmapChunk(chunk);
+        }
+    }
+    while (region->largeChunks != nullptr)
+    {
+        Chunk *chunk = region->largeChunks;
+        region->largeChunks = chunk->next;
+        unmapChunk(chunk);
+    }
+    PxRegion *outer = region->outer;
+    clear(region);
+    region->outer = outer;
+}
+
+PxRegion *px::defaultRegion()
+{
+    return &threadRegion;
+}
+
+PxRegion *px::swapRegion(PxRegion *region)
+{
+    PxRegion *previous = current;
+    current = region;
+    return previous;
+}
+
+extern "C" PxRegion *pxRegionCreate(void)
+{
+    auto region = (PxRegion*) malloc(sizeof(PxRegion));
+    if (region == nullptr)
+        abort();
+    clear(region);
+    return region;
+}
+
+extern "C" void *pxRegionAllocate(PxRegion *region, size_t size, size_t alignment)
+{
+    auto start = (int8_t*) (((uintptr_t) region->top + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    if (region->top == nullptr || start > region->limit || (size_t) (region->limit - start) < size)
+    {
+        refill(region, size + alignment - 1);
+        start = (int8_t*) (((uintptr_t) region->top + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    }
+    region->top = start + size;
+    return start;
+}
+
+extern "C" void pxRegionRelease(PxRegion *region)
+{
+    px::regionReset(region);
+    free(region);
+}
+
+extern "C" void pxRegionEnter(void)
+{
+    PxRegion *region = freeScopes;
+    if (region != nullptr)
+        freeScopes = region->outer;
+    else
+        region = pxRegionCreate();
+    clear(region);
+    region->outer = current;
+    current = region;
+}
+
+extern "C" void pxRegionExit(void)
+{
+    PxRegion *region = current;
+    if (region == nullptr)
+        abort();
+    px::regionReset(region);
+    current = region->outer;
+    region->outer = freeScopes;
+    freeScopes = region;
+}
+
+extern "C" PxRegion *pxCurrentRegion(void)
+{
+    return current != nullptr ? current : &threadRegion;
+}
+
+extern "C" void *pxNew(size_t size)
+{
+    void *memory = pxRegionAllocate(pxCurrentRegion(), size, alignof(max_align_t));
+    memset(memory, 0, size);
+    return memory;
+}
+
+extern "C" void pxRegionUseHugePages(bool enable)
+{
+    useHugePages.store(enable, std::memory_order_relaxed);
+}
@@ -0,0 +1,29 @@
+#ifndef PX_PXREGION_H
+#define PX_PXREGION_H
+
+#include <stddef.h>
+
+typedef struct _PxRegion PxRegion;
+
+namespace px {
+
+    // Grows the allocation ending at end by extra bytes, when it is the last one made from region
+    // and its chunk has room
+    bool regionExtend(PxRegion *region, const void *end, size_t extra);
+
+    // Gives back the last size bytes of the allocation ending at end, when it is the last one made
+    // from region
+    void regionShrink(PxRegion *region, const void *end, size_t size);
+
+    // Frees everything allocated from region but keeps region itself usable
+    void regionReset(PxRegion *region);
+
+    PxRegion *defaultRegion();
+
+    // Makes region the calling thread's current region, nullptr for its default region, and returns
+    // the one that was current before
+    PxRegion *swapRegion(PxRegion *region);
+
+}
+
+#endif //PX_PXREGION_H
@@ -2,19 +2,197 @@ extern "C" {
     #include "PxRuntime.h"
 }
 
+#include "PxFormat.h"
+
 #include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace {
+
+    const size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+    const char DIGIT_PAIRS[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    // Each thread fills its own buffer, so output from one thread is never split inside a call
+    // and no lock is taken until the buffer is handed to stdio. The buffer is plain data so the
+    // runtime links into C programs without the C++ library; it is flushed through a thread-exit
+    // callback registered on first use, and through atexit for the thread that ends the program.
+    struct OutputBuffer
+    {
+        char data[OUTPUT_BUFFER_SIZE];
+        size_t used;
+        bool registered;
+    };
+
+    thread_local OutputBuffer output;
+
+    void flushBuffer(OutputBuffer *buffer)
+    {
+        if (buffer->used != 0)
+        {
+            fwrite(buffer->data, 1, buffer->used, stdout);
+            buffer->used = 0;
+        }
+        fflush(stdout);
+    }
+
+#if defined(_WIN32)
+    void WINAPI flushAtThreadExit(void *buffer)
+    {
+        if (buffer != nullptr)
+            flushBuffer((OutputBuffer*) buffer);
+    }
+
+    const DWORD threadExitKey = FlsAlloc(flushAtThreadExit);
+
+    void registerBuffer()
+    {
+        FlsSetValue(threadExitKey, &output);
+        output.registered = true;
+    }
+#else
+    void flushAtThreadExit(void *buffer)
+    {
+        flushBuffer((OutputBuffer*) buffer);
+    }
+
+    pthread_key_t createThreadExitKey()
+    {
+        pthread_key_t key;
+        pthread_key_create(&key, flushAtThreadExit);
+        return key;
+    }
+
+    const pthread_key_t threadExitKey = createThreadExitKey();
+
+    void registerBuffer()
+    {
+        pthread_setspecific(threadExitKey, &output);
+        output.registered = true;
+    }
+#endif
+
+    void flushAtExit()
+    {
+        flushBuffer(&output);
+    }
+
+    const int atExitRegistered = atexit(flushAtExit);
+
+    char *reserve(size_t size)
+    {
+        if (!output.registered)
+            registerBuffer();
+        if (output.used + size > OUTPUT_BUFFER_SIZE)
+            flushBuffer(&output);
+        return output.data + output.used;
+    }
+
+    void commit(size_t size)
+    {
+        output.used += size;
+    }
+
+    void writeBytes(const char *bytes, size_t size)
+    {
+        if (size > OUTPUT_BUFFER_SIZE / 2)
+        {
+            flushBuffer(&output);
+            fwrite(bytes, 1, size, stdout);
+            return;
+        }
+        memcpy(reserve(size), bytes, size);
+        commit(size);
+    }
+
+    void writeInteger(uint64_t magnitude, bool negative)
+    {
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *start = px::formatDigits(magnitude, end);
+        if (negative)
+            *--start = '-';
+        writeBytes(start, end - start);
+    }
+
+}
+
+char *px::formatDigits(uint64_t value, char *end)
+{
+    while (value >= 100)
+    {
+        const char *pair = DIGIT_PAIRS + (value % 100) * 2;
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (value >= 10)
+    {
+        const char *pair = DIGIT_PAIRS + value * 2;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    else
+    {
+        *--end = (char) ('0' + value);
+    }
+    return end;
+}
+
+void px::flushOutput()
+{
+    if (output.used != 0)
+        flushBuffer(&output);
+}
 
 extern "C" void printFloat(float f)
 {
-    printf("%f", f);
+    commit(pxFormatFloat32(f, reserve(PX_FLOAT_TEXT_SIZE)));
+}
+
+extern "C" void printFloat64(double d)
+{
+    commit(pxFormatFloat64(d, reserve(PX_FLOAT_TEXT_SIZE)));
+}
+
+extern "C" void printInt(int32_t i)
+{
+    printInt64(i);
+}
+
+extern "C" void printInt64(int64_t i)
+{
+    uint64_t magnitude = i < 0 ? 0 - (uint64_t) i : (uint64_t) i;
+    writeInteger(magnitude, i < 0);
 }
 
-extern "C" void printInt(int i)
+extern "C" void printUInt64(uint64_t i)
 {
-    printf("%d", i);
+    writeInteger(i, false);
 }
 
 extern "C" void printString(PxString str)
 {
-    printf("%s", str);
+    writeBytes((const char*) pxStringBytes(&str), (size_t) str.byteLength);
+}
+
+extern "C" void pxFlush(void)
+{
+    flushBuffer(&output);
 }
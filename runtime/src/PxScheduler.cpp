@@ -0,0 +1,663 @@
+extern "C" {
+    #include "PxRuntime.h"
+}
+
+#include "PxFormat.h"
+#include "PxRegion.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    const int64_t INITIAL_DEQUE_CAPACITY = 256;
+    const int32_t MAXIMUM_WORKERS = 256;
+    // Rounds of looking for work an idle thread makes before it goes to sleep
+    const int SPIN_ROUNDS = 64;
+    // Without a configured minimum, a loop is cut into chunks of at least 1/64 of each worker's share
+    const int64_t CHUNKS_PER_WORKER = 64;
+    const size_t CACHE_LINE = 64;
+
+    // The pool only uses the system's threads, locks and condition variables so the runtime still
+    // links into C programs without the C++ library
+#if defined(_WIN32)
+    struct Mutex
+    {
+        SRWLOCK lock = SRWLOCK_INIT;
+    };
+
+    struct Condition
+    {
+        CONDITION_VARIABLE variable = CONDITION_VARIABLE_INIT;
+    };
+
+    void acquire(Mutex &mutex)
+    {
+        AcquireSRWLockExclusive(&mutex.lock);
+    }
+
+    void release(Mutex &mutex)
+    {
+        ReleaseSRWLockExclusive(&mutex.lock);
+    }
+
+    void wait(Condition &condition, Mutex &mutex)
+    {
+        SleepConditionVariableSRW(&condition.variable, &mutex.lock, INFINITE, 0);
+    }
+
+    void wakeOne(Condition &condition)
+    {
+        WakeConditionVariable(&condition.variable);
+    }
+
+    void wakeAll(Condition &condition)
+    {
+        WakeAllConditionVariable(&condition.variable);
+    }
+
+    void pause()
+    {
+        SwitchToThread();
+    }
+
+    int32_t processorCount()
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (int32_t) info.dwNumberOfProcessors;
+    }
+#else
+    struct Mutex
+    {
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    };
+
+    struct Condition
+    {
+        pthread_cond_t variable = PTHREAD_COND_INITIALIZER;
+    };
+
+    void acquire(Mutex &mutex)
+    {
+        pthread_mutex_lock(&mutex.mutex);
+    }
+
+    void release(Mutex &mutex)
+    {
+        pthread_mutex_unlock(&mutex.mutex);
+    }
+
+    void wait(Condition &condition, Mutex &mutex)
+    {
+        pthread_cond_wait(&condition.variable, &mutex.mutex);
+    }
+
+    void wakeOne(Condition &condition)
+    {
+        pthread_cond_signal(&condition.variable);
+    }
+
+    void wakeAll(Condition &condition)
+    {
+        pthread_cond_broadcast(&condition.variable);
+    }
+
+    void pause()
+    {
+        sched_yield();
+    }
+
+    int32_t processorCount()
+    {
+        return (int32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+#endif
+
+    // run runs the task, and frees it for the ranges of a parallel for, while next links the tasks
+    // queued by threads outside the pool. Spawned tasks also use body and state.
+    typedef PxTask Task;
+
+    // The states of a spawned task: its awaiter only sleeps after marking it as waited for, so the
+    // thread that finishes it knows whether anyone needs waking
+    const int32_t TASK_PENDING = 0;
+    const int32_t TASK_DONE = 1;
+    const int32_t TASK_WAITED_FOR = 2;
+
+    struct TaskArray
+    {
+        int64_t capacity;
+        // The array this one replaced, kept since a thief may still be reading it
+        TaskArray *previous;
+        std::atomic<Task*> slots[1];
+    };
+
+    // A Chase-Lev deque, with the memory orders of Lê, Pop, Cohen and Zappa Nardelli's C11 version.
+    // Only the owner moves bottom; top only moves forward, through a compare and swap whenever the
+    // owner and a thief may want the same task.
+    struct Deque
+    {
+        alignas(CACHE_LINE) std::atomic<int64_t> top;
+        alignas(CACHE_LINE) std::atomic<int64_t> bottom;
+        std::atomic<TaskArray*> array;
+    };
+
+    struct alignas(CACHE_LINE) Worker
+    {
+        Deque deque;
+        uint64_t seed;
+    };
+
+    struct ParallelJob
+    {
+        PxRangeFunction body;
+        void *environment;
+        int64_t chunk;
+        // Iterations not yet run; whoever runs the last ones marks the job finished
+        std::atomic<int64_t> remaining;
+        std::atomic<bool> finished;
+    };
+
+    struct RangeTask
+    {
+        Task task;
+        ParallelJob *job;
+        int64_t start;
+        int64_t end;
+    };
+
+    std::atomic<int32_t> configuredWorkers{ 0 };
+    std::atomic<int64_t> minimumChunk{ 0 };
+
+    // workers and workerCount are set once, before started
+    std::atomic<bool> started{ false };
+    Mutex startLock;
+    Worker *workers;
+    int32_t workerCount;
+
+    thread_local Worker *currentWorker;
+
+    // Tasks queued by threads outside the pool
+    Mutex queueLock;
+    Task *queueHead;
+    Task *queueTail;
+    std::atomic<int64_t> queued{ 0 };
+
+    Mutex idleLock;
+    Condition idleCondition;
+    std::atomic<int32_t> sleeping{ 0 };
+
+    // Threads outside the pool sleep here until their loop finishes
+    Mutex completionLock;
+    Condition completionCondition;
+
+    std::atomic<int32_t> &taskState(Task *task)
+    {
+        static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "a task's state is used as an atomic");
+        return *reinterpret_cast<std::atomic<int32_t>*>(&task->state);
+    }
+
+    // Tasks taken while a thread waits for something else may come from a caller in another region
+    // block, so they always allocate in the running thread's default region, which outlives them
+    void runTask(Task *task)
+    {
+        PxRegion *outer = px::swapRegion(nullptr);
+        task->run(task);
+        px::swapRegion(outer);
+    }
+
+    TaskArray *newTaskArray(int64_t capacity)
+    {
+        auto array = (TaskArray*) malloc(sizeof(TaskArray) + (size_t) (capacity - 1) * sizeof(std::atomic<Task*>));
+        array->capacity = capacity;
+        array->previous = nullptr;
+        return array;
+    }
+
+    void pushTask(Deque &deque, Task *task)
+    {
+        int64_t bottom = deque.bottom.load(std::memory_order_relaxed);
+        int64_t top = deque.top.load(std::memory_order_acquire);
+        TaskArray *array = deque.array.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity - 1)
+        {
+            TaskArray *grown = newTaskArray(array->capacity * 2);
+            for (int64_t i = top; i < bottom; ++i)
+            {
+                Task *moved = array->slots[i & (array->capacity - 1)].load(std::memory_order_relaxed);
+                grown->slots[i & (grown->capacity - 1)].store(moved, std::memory_order_relaxed);
+            }
+            grown->previous = array;
+            deque.array.store(grown, std::memory_order_release);
+            array = grown;
+        }
+        array->slots[bottom & (array->capacity - 1)].store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    Task *takeTask(Deque &deque)
+    {
+        int64_t bottom = deque.bottom.load(std::memory_order_relaxed) - 1;
+        TaskArray *array = deque.array.load(std::memory_order_relaxed);
+        deque.bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = deque.top.load(std::memory_order_relaxed);
+        if (top > bottom)
+        {
+            deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Task *task = array->slots[bottom & (array->capacity - 1)].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // The last task, which a thief may be taking at the same time
+            if (!deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                task = nullptr;
+            deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    Task *stealTask(Deque &deque)
+    {
+        int64_t top = deque.top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = deque.bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return nullptr;
+        TaskArray *array = deque.array.load(std::memory_order_acquire);
+        Task *task = array->slots[top & (array->capacity - 1)].load(std::memory_order_relaxed);
+        if (!deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return task;
+    }
+
+    bool isEmpty(Deque &deque)
+    {
+        return deque.bottom.load(std::memory_order_relaxed) <= deque.top.load(std::memory_order_relaxed);
+    }
+
+    Task *popQueued()
+    {
+        acquire(queueLock);
+        Task *task = queueHead;
+        if (task != nullptr)
+        {
+            queueHead = task->next;
+            if (queueHead == nullptr)
+                queueTail = nullptr;
+            queued.fetch_sub(1, std::memory_order_relaxed);
+        }
+        release(queueLock);
+        return task;
+    }
+
+    uint64_t nextRandom(Worker *worker)
+    {
+        uint64_t x = worker->seed;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        worker->seed = x;
+        return x;
+    }
+
+    // Work for self, which is nullptr on threads outside the pool: its own newest task, then the
+    // shared queue, then the oldest task of another worker, starting from a random one
+    Task *findTask(Worker *self)
+    {
+        Task *task = nullptr;
+        if (self != nullptr && (task = takeTask(self->deque)) != nullptr)
+            return task;
+        if (queued.load(std::memory_order_relaxed) != 0 && (task = popQueued()) != nullptr)
+            return task;
+        if (self == nullptr)
+            return nullptr;
+        uint32_t first = (uint32_t) (nextRandom(self) % (uint64_t) workerCount);
+        for (int32_t i = 0; i < workerCount; ++i)
+        {
+            Worker *victim = &workers[(first + i) % workerCount];
+            if (victim != self && (task = stealTask(victim->deque)) != nullptr)
+                return task;
+        }
+        return nullptr;
+    }
+
+    bool hasQueuedWork()
+    {
+        if (queued.load(std::memory_order_relaxed) != 0)
+            return true;
+        for (int32_t i = 0; i < workerCount; ++i)
+        {
+            if (!isEmpty(workers[i].deque))
+                return true;
+        }
+        return false;
+    }
+
+    // A worker that is about to sleep counts itself in sleeping before looking for work a last
+    // time, and a thread that queues work looks at sleeping after queueing it, with a full fence
+    // on both sides, so at least one of them sees the other
+    void wakeWorker()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) == 0)
+            return;
+        acquire(idleLock);
+        wakeOne(idleCondition);
+        release(idleLock);
+    }
+
+    void submit(Task *task)
+    {
+        if (currentWorker != nullptr)
+        {
+            pushTask(currentWorker->deque, task);
+        }
+        else
+        {
+            task->next = nullptr;
+            acquire(queueLock);
+            if (queueTail != nullptr)
+                queueTail->next = task;
+            else
+                queueHead = task;
+            queueTail = task;
+            queued.fetch_add(1, std::memory_order_relaxed);
+            release(queueLock);
+        }
+        wakeWorker();
+    }
+
+#if defined(_WIN32)
+    DWORD WINAPI runWorker(void *argument)
+#else
+    void *runWorker(void *argument)
+#endif
+    {
+        auto self = (Worker*) argument;
+        currentWorker = self;
+        int rounds = 0;
+        for (;;)
+        {
+            Task *task = findTask(self);
+            if (task != nullptr)
+            {
+                runTask(task);
+                rounds = 0;
+                continue;
+            }
+            if (++rounds < SPIN_ROUNDS)
+            {
+                pause();
+                continue;
+            }
+            acquire(idleLock);
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!hasQueuedWork())
+                wait(idleCondition, idleLock);
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            release(idleLock);
+            rounds = 0;
+        }
+#if defined(_WIN32)
+        return 0;
+#else
+        return nullptr;
+#endif
+    }
+
+    int32_t poolSize()
+    {
+        int32_t count = configuredWorkers.load(std::memory_order_relaxed);
+        if (count <= 0)
+        {
+            const char *variable = getenv("PX_WORKERS");
+            count = variable != nullptr ? atoi(variable) : 0;
+        }
+        if (count <= 0)
+            count = processorCount();
+        if (count < 1)
+            return 1;
+        return count > MAXIMUM_WORKERS ? MAXIMUM_WORKERS : count;
+    }
+
+    void startPool()
+    {
+        acquire(startLock);
+        if (!started.load(std::memory_order_relaxed))
+        {
+            int32_t count = poolSize();
+            // Workers are never freed, so the block is simply aligned by hand
+            auto block = (uintptr_t) calloc(1, sizeof(Worker) * (size_t) count + CACHE_LINE);
+            auto pool = (Worker*) ((block + CACHE_LINE - 1) & ~(uintptr_t) (CACHE_LINE - 1));
+            for (int32_t i = 0; i < count; ++i)
+            {
+                pool[i].deque.array.store(newTaskArray(INITIAL_DEQUE_CAPACITY), std::memory_order_relaxed);
+                pool[i].seed = 0x9E3779B97F4A7C15ull * (uint64_t) (i + 1);
+            }
+            workers = pool;
+            workerCount = count;
+            started.store(true, std::memory_order_release);
+
+            for (int32_t i = 0; i < count; ++i)
+            {
+#if defined(_WIN32)
+                CloseHandle(CreateThread(nullptr, 0, runWorker, &pool[i], 0, nullptr));
+#else
+                pthread_t thread;
+                pthread_attr_t attributes;
+                pthread_attr_init(&attributes);
+                pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+                pthread_create(&thread, &attributes, runWorker, &pool[i]);
+                pthread_attr_destroy(&attributes);
+#endif
+            }
+        }
+        release(startLock);
+    }
+
+    void finish(ParallelJob *job)
+    {
+        // Setting finished is the last use of the job, which lives on the waiting thread's stack
+        acquire(completionLock);
+        job->finished.store(true, std::memory_order_release);
+        wakeAll(completionCondition);
+        release(completionLock);
+    }
+
+    void runRangeTask(Task *task);
+
+    Task *newRangeTask(ParallelJob *job, int64_t start, int64_t end)
+    {
+        auto range = (RangeTask*) malloc(sizeof(RangeTask));
+        range->task.run = runRangeTask;
+        range->job = job;
+        range->start = start;
+        range->end = end;
+        return &range->task;
+    }
+
+    // Lazy binary splitting: the upper half of the range is only offered to other workers when
+    // this worker's deque is empty, since an empty deque means thieves are short of work. Otherwise
+    // the range runs a chunk at a time, checking again after each one.
+    void runRange(ParallelJob *job, int64_t start, int64_t end)
+    {
+        Worker *self = currentWorker;
+        int64_t done = 0;
+        while (end - start > job->chunk)
+        {
+            if (isEmpty(self->deque))
+            {
+                int64_t middle = start + (end - start) / 2;
+                submit(newRangeTask(job, middle, end));
+                end = middle;
+            }
+            else
+            {
+                job->body(job->environment, start, start + job->chunk);
+                done += job->chunk;
+                start += job->chunk;
+            }
+        }
+        job->body(job->environment, start, end);
+        done += end - start;
+
+        // Output written by the loop must be out before the caller carries on
+        px::flushOutput();
+        if (job->remaining.fetch_sub(done, std::memory_order_acq_rel) == done)
+            finish(job);
+    }
+
+    void runRangeTask(Task *task)
+    {
+        auto range = (RangeTask*) task;
+        ParallelJob *job = range->job;
+        int64_t start = range->start, end = range->end;
+        free(range);
+        runRange(job, start, end);
+    }
+
+    // Workers run other tasks while they wait and only sleep once there is nothing left to take;
+    // other threads have nothing to run and sleep straight away
+    void waitFor(ParallelJob &job)
+    {
+        Worker *self = currentWorker;
+        int rounds = self != nullptr ? 0 : SPIN_ROUNDS;
+        while (!job.finished.load(std::memory_order_acquire))
+        {
+            Task *task = self != nullptr ? findTask(self) : nullptr;
+            if (task != nullptr)
+            {
+                runTask(task);
+                rounds = 0;
+                continue;
+            }
+            if (++rounds < SPIN_ROUNDS)
+            {
+                pause();
+                continue;
+            }
+            acquire(completionLock);
+            while (!job.finished.load(std::memory_order_relaxed))
+                wait(completionCondition, completionLock);
+            release(completionLock);
+        }
+    }
+
+    void runSpawnedTask(Task *task)
+    {
+        task->body(task);
+        px::flushOutput();
+        // The awaiter may free the task as soon as it is done, so only the globals are used after
+        if (taskState(task).exchange(TASK_DONE, std::memory_order_acq_rel) == TASK_WAITED_FOR)
+        {
+            acquire(completionLock);
+            wakeAll(completionCondition);
+            release(completionLock);
+        }
+    }
+
+    // Like waitFor, except that the task is marked as waited for, under the lock, before sleeping
+    void awaitTask(Task *task)
+    {
+        std::atomic<int32_t> &state = taskState(task);
+        Worker *self = currentWorker;
+        int rounds = self != nullptr ? 0 : SPIN_ROUNDS;
+        while (state.load(std::memory_order_acquire) != TASK_DONE)
+        {
+            Task *other = self != nullptr ? findTask(self) : nullptr;
+            if (other != nullptr)
+            {
+                runTask(other);
+                rounds = 0;
+                continue;
+            }
+            if (++rounds < SPIN_ROUNDS)
+            {
+                pause();
+                continue;
+            }
+            acquire(completionLock);
+            int32_t pending = TASK_PENDING;
+            state.compare_exchange_strong(pending, TASK_WAITED_FOR, std::memory_order_acq_rel, std::memory_order_acquire);
+            while (state.load(std::memory_order_acquire) != TASK_DONE)
+                wait(completionCondition, completionLock);
+            release(completionLock);
+        }
+    }
+
+}
+
+extern "C" void pxParallelFor(int64_t start, int64_t end, PxRangeFunction body, void *environment)
+{
+    if (end <= start)
+        return;
+    if (!started.load(std::memory_order_acquire))
+        startPool();
+
+    int64_t count = end - start;
+    int64_t chunk = minimumChunk.load(std::memory_order_relaxed);
+    if (chunk <= 0)
+    {
+        chunk = count / ((int64_t) workerCount * CHUNKS_PER_WORKER);
+        if (chunk < 1)
+            chunk = 1;
+    }
+    if (count <= chunk)
+    {
+        body(environment, start, end);
+        return;
+    }
+
+    ParallelJob job;
+    job.body = body;
+    job.environment = environment;
+    job.chunk = chunk;
+    job.remaining.store(count, std::memory_order_relaxed);
+    job.finished.store(false, std::memory_order_relaxed);
+    if (currentWorker != nullptr)
+        runRange(&job, start, end);
+    else
+        submit(newRangeTask(&job, start, end));
+    waitFor(job);
+}
+
+extern "C" void pxSpawn(PxTask *task, void (*body)(PxTask *task))
+{
+    if (!started.load(std::memory_order_acquire))
+        startPool();
+    task->run = runSpawnedTask;
+    task->body = body;
+    taskState(task).store(TASK_PENDING, std::memory_order_relaxed);
+    submit(task);
+}
+
+extern "C" void pxAwait(PxTask *task)
+{
+    awaitTask(task);
+}
+
+extern "C" void pxSchedulerConfigure(PxSchedulerConfig config)
+{
+    configuredWorkers.store(config.workers, std::memory_order_relaxed);
+    minimumChunk.store(config.minimumChunk, std::memory_order_relaxed);
+}
+
+extern "C" int32_t pxSchedulerWorkers(void)
+{
+    if (started.load(std::memory_order_acquire))
+        return workerCount;
+    return poolSize();
+}
@@ -0,0 +1,370 @@
+extern "C" {
+    #include "PxRuntime.h"
+}
+
+#include "PxFormat.h"
+#include "PxRegion.h"
+
+namespace {
+
+    const size_t MIN_BUILDER_CAPACITY = 64;
+
+    // String bytes are only ever written while they are the newest allocation of their region, so
+    // they need no alignment and may be read from any thread afterwards
+    int8_t *allocate(PxRegion *region, size_t size)
+    {
+        return (int8_t*) pxRegionAllocate(region, size, 1);
+    }
+
+    // Grows the most recent allocation in place when bytes ends it and its chunk has room
+    bool extend(PxRegion *region, const int8_t *bytes, size_t used, size_t extra)
+    {
+        return px::regionExtend(region, bytes + used, extra);
+    }
+
+    // Hands back the unused end of the most recent allocation
+    void shrink(PxRegion *region, const int8_t *bytes, size_t used, size_t keep)
+    {
+        px::regionShrink(region, bytes + used, used - keep);
+    }
+
+    inline bool isContinuation(int8_t byte)
+    {
+        return (byte & 0xC0) == 0x80;
+    }
+
+    intptr_t countCodePoints(const int8_t *bytes, intptr_t byteLength)
+    {
+        intptr_t continuations = 0;
+        for (intptr_t i = 0; i < byteLength; ++i)
+            continuations += isContinuation(bytes[i]);
+        return byteLength - continuations;
+    }
+
+    // The byte offset count code points after offset, which must stay within byteLength
+    intptr_t advance(const int8_t *bytes, intptr_t byteLength, intptr_t offset, intptr_t count)
+    {
+        while (count > 0)
+        {
+            ++offset;
+            while (offset < byteLength && isContinuation(bytes[offset]))
+                ++offset;
+            --count;
+        }
+        return offset;
+    }
+
+    PxString makeString(const int8_t *bytes, intptr_t length, intptr_t byteLength, bool copy)
+    {
+        PxString str;
+        str.length = length;
+        str.byteLength = byteLength;
+        if (byteLength <= PX_STRING_INLINE_CAPACITY)
+        {
+            memcpy(str.data.inlineBytes, bytes, byteLength);
+            memset(str.data.inlineBytes + byteLength, 0, sizeof(str.data.inlineBytes) - byteLength);
+        }
+        else if (copy)
+        {
+            int8_t *storage = allocate(pxCurrentRegion(), byteLength);
+            memcpy(storage, bytes, byteLength);
+            str.data.bytes = storage;
+        }
+        else
+        {
+            str.data.bytes = bytes;
+        }
+        return str;
+    }
+
+    inline uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+}
+
+extern "C" PxString pxStringFromBytes(const int8_t *bytes, intptr_t byteLength)
+{
+    return makeString(bytes, countCodePoints(bytes, byteLength), byteLength, true);
+}
+
+extern "C" PxString pxStringConcat(PxString left, PxString right)
+{
+    if (right.byteLength == 0)
+        return left;
+    if (left.byteLength == 0)
+        return right;
+
+    intptr_t byteLength = left.byteLength + right.byteLength;
+    const int8_t *rightBytes = pxStringBytes(&right);
+    PxString str;
+    str.length = left.length + right.length;
+    str.byteLength = byteLength;
+    if (byteLength <= PX_STRING_INLINE_CAPACITY)
+    {
+        memcpy(str.data.inlineBytes, left.data.inlineBytes, left.byteLength);
+        memcpy(str.data.inlineBytes + left.byteLength, rightBytes, right.byteLength);
+        memset(str.data.inlineBytes + byteLength, 0, sizeof(str.data.inlineBytes) - byteLength);
+        return str;
+    }
+
+    // Appending to the string created last reuses its bytes, so s = s + t in a loop is not quadratic
+    PxRegion *region = pxCurrentRegion();
+    if (left.byteLength > PX_STRING_INLINE_CAPACITY && extend(region, left.data.bytes, left.byteLength, right.byteLength))
+    {
+        memcpy((int8_t*) left.data.bytes + left.byteLength, rightBytes, right.byteLength);
+        str.data.bytes = left.data.bytes;
+        return str;
+    }
+
+    int8_t *storage = allocate(region, byteLength);
+    memcpy(storage, pxStringBytes(&left), left.byteLength);
+    memcpy(storage + left.byteLength, rightBytes, right.byteLength);
+    str.data.bytes = storage;
+    return str;
+}
+
+extern "C" bool pxStringEquals(PxString left, PxString right)
+{
+    if (left.byteLength != right.byteLength)
+        return false;
+    // Inline strings are zero padded, so comparing the whole array is a couple of word compares
+    if (left.byteLength <= PX_STRING_INLINE_CAPACITY)
+        return memcmp(left.data.inlineBytes, right.data.inlineBytes, sizeof(left.data.inlineBytes)) == 0;
+    return left.data.bytes == right.data.bytes || memcmp(left.data.bytes, right.data.bytes, left.byteLength) == 0;
+}
+
+extern "C" int32_t pxStringCompare(PxString left, PxString right)
+{
+    // UTF-8 byte order is code point order
+    intptr_t common = left.byteLength < right.byteLength ? left.byteLength : right.byteLength;
+    int result = memcmp(pxStringBytes(&left), pxStringBytes(&right), common);
+    if (result != 0)
+        return result < 0 ? -1 : 1;
+    return left.byteLength < right.byteLength ? -1 : left.byteLength > right.byteLength;
+}
+
+extern "C" int32_t pxStringCharAt(PxString str, intptr_t index)
+{
+    if (index < 0 || index >= str.length)
+        return -1;
+    const int8_t *bytes = pxStringBytes(&str);
+    intptr_t offset = str.length == str.byteLength ? index : advance(bytes, str.byteLength, 0, index);
+    const uint8_t *c = (const uint8_t*) bytes + offset;
+    if (c[0] < 0x80)
+        return c[0];
+    if (c[0] < 0xE0)
+        return ((c[0] & 0x1F) << 6) | (c[1] & 0x3F);
+    if (c[0] < 0xF0)
+        return ((c[0] & 0x0F) << 12) | ((c[1] & 0x3F) << 6) | (c[2] & 0x3F);
+    return ((c[0] & 0x07) << 18) | ((c[1] & 0x3F) << 12) | ((c[2] & 0x3F) << 6) | (c[3] & 0x3F);
+}
+
+extern "C" PxString pxStringSlice(PxString str, intptr_t start, intptr_t end)
+{
+    if (start < 0)
+        start = 0;
+    if (end > str.length)
+        end = str.length;
+    if (end < start)
+        end = start;
+    const int8_t *bytes = pxStringBytes(&str);
+    intptr_t startOffset = start, endOffset = end;
+    if (str.length != str.byteLength)
+    {
+        startOffset = advance(bytes, str.byteLength, 0, start);
+        endOffset = advance(bytes, str.byteLength, startOffset, end - start);
+    }
+    return makeString(bytes + startOffset, end - start, endOffset - startOffset, false);
+}
+
+extern "C" uint64_t pxStringHash(PxString str)
+{
+    const int8_t *bytes = pxStringBytes(&str);
+    intptr_t remaining = str.byteLength;
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ (uint64_t) remaining;
+    while (remaining >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        h = (h ^ mix(word)) * 0x100000001b3ull;
+        bytes += 8;
+        remaining -= 8;
+    }
+    if (remaining > 0)
+    {
+        uint64_t word = 0;
+        memcpy(&word, bytes, remaining);
+        h = (h ^ mix(word)) * 0x100000001b3ull;
+    }
+    return mix(h);
+}
+
+extern "C" void pxStringArenaReset(void)
+{
+    px::regionReset(px::defaultRegion());
+}
+
+namespace {
+
+    // Makes room for extra more bytes, doubling the capacity so appends stay amortized constant time
+    int8_t *ensure(PxStringBuilder *builder, size_t extra)
+    {
+        size_t used = (size_t) builder->byteLength;
+        size_t capacity = (size_t) builder->capacity;
+        if (capacity - used < extra)
+        {
+            size_t newCapacity = capacity * 2;
+            if (newCapacity < used + extra)
+                newCapacity = used + extra;
+            if (newCapacity < MIN_BUILDER_CAPACITY)
+                newCapacity = MIN_BUILDER_CAPACITY;
+            if (builder->bytes == nullptr || !extend(builder->region, builder->bytes, capacity, newCapacity - capacity))
+            {
+                int8_t *storage = allocate(builder->region, newCapacity);
+                if (used != 0)
+                    memcpy(storage, builder->bytes, used);
+                builder->bytes = storage;
+            }
+            builder->capacity = (intptr_t) newCapacity;
+        }
+        return builder->bytes + used;
+    }
+
+    void appendAscii(PxStringBuilder *builder, const char *text, size_t size)
+    {
+        memcpy(ensure(builder, size), text, size);
+        builder->length += size;
+        builder->byteLength += size;
+    }
+
+    void appendInteger(PxStringBuilder *builder, uint64_t magnitude, bool negative)
+    {
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *start = px::formatDigits(magnitude, end);
+        if (negative)
+            *--start = '-';
+        appendAscii(builder, start, end - start);
+    }
+
+}
+
+extern "C" PxStringBuilder *newStringBuilder(void)
+{
+    PxRegion *region = pxCurrentRegion();
+    auto builder = (PxStringBuilder*) pxRegionAllocate(region, sizeof(PxStringBuilder), alignof(PxStringBuilder));
+    builder->region = region;
+    builder->bytes = nullptr;
+    builder->length = 0;
+    builder->byteLength = 0;
+    builder->capacity = 0;
+    return builder;
+}
+
+extern "C" void reserveStringBuilder(PxStringBuilder *builder, int64_t bytes)
+{
+    if (bytes > 0)
+        ensure(builder, (size_t) bytes);
+}
+
+extern "C" void appendInt(PxStringBuilder *builder, int32_t i)
+{
+    appendInt64(builder, i);
+}
+
+extern "C" void appendInt64(PxStringBuilder *builder, int64_t i)
+{
+    uint64_t magnitude = i < 0 ? 0 - (uint64_t) i : (uint64_t) i;
+    appendInteger(builder, magnitude, i < 0);
+}
+
+extern "C" void appendUInt64(PxStringBuilder *builder, uint64_t i)
+{
+    appendInteger(builder, i, false);
+}
+
+extern "C" void appendFloat(PxStringBuilder *builder, float f)
+{
+    int32_t size = pxFormatFloat32(f, (char*) ensure(builder, PX_FLOAT_TEXT_SIZE));
+    builder->length += size;
+    builder->byteLength += size;
+}
+
+extern "C" void appendFloat64(PxStringBuilder *builder, double d)
+{
+    int32_t size = pxFormatFloat64(d, (char*) ensure(builder, PX_FLOAT_TEXT_SIZE));
+    builder->length += size;
+    builder->byteLength += size;
+}
+
+extern "C" void appendBool(PxStringBuilder *builder, bool b)
+{
+    if (b)
+        appendAscii(builder, "true", 4);
+    else
+        appendAscii(builder, "false", 5);
+}
+
+extern "C" void appendChar(PxStringBuilder *builder, int32_t c)
+{
+    uint8_t *out = (uint8_t*) ensure(builder, 4);
+    size_t size;
+    if (c < 0x80)
+    {
+        out[0] = (uint8_t) c;
+        size = 1;
+    }
+    else if (c < 0x800)
+    {
+        out[0] = (uint8_t) (0xC0 | (c >> 6));
+        out[1] = (uint8_t) (0x80 | (c & 0x3F));
+        size = 2;
+    }
+    else if (c < 0x10000)
+    {
+        out[0] = (uint8_t) (0xE0 | (c >> 12));
+        out[1] = (uint8_t) (0x80 | ((c >> 6) & 0x3F));
+        out[2] = (uint8_t) (0x80 | (c & 0x3F));
+        size = 3;
+    }
+    else
+    {
+        out[0] = (uint8_t) (0xF0 | (c >> 18));
+        out[1] = (uint8_t) (0x80 | ((c >> 12) & 0x3F));
+        out[2] = (uint8_t) (0x80 | ((c >> 6) & 0x3F));
+        out[3] = (uint8_t) (0x80 | (c & 0x3F));
+        size = 4;
+    }
+    builder->length += 1;
+    builder->byteLength += size;
+}
+
+extern "C" void appendString(PxStringBuilder *builder, PxString str)
+{
+    memcpy(ensure(builder, (size_t) str.byteLength), pxStringBytes(&str), (size_t) str.byteLength);
+    builder->length += str.length;
+    builder->byteLength += str.byteLength;
+}
+
+extern "C" PxString finishStringBuilder(PxStringBuilder *builder)
+{
+    // Short results are copied inline and long ones take the buffer; either way the unused
+    // capacity goes back to the region when nothing was allocated after it
+    if (builder->bytes == nullptr)
+        return makeString((const int8_t*) "", 0, 0, false);
+    PxString str = makeString(builder->bytes, builder->length, builder->byteLength, false);
+    size_t keep = str.byteLength <= PX_STRING_INLINE_CAPACITY ? 0 : (size_t) str.byteLength;
+    shrink(builder->region, builder->bytes, (size_t) builder->capacity, keep);
+    builder->bytes = nullptr;
+    builder->length = 0;
+    builder->byteLength = 0;
+    builder->capacity = 0;
+    return str;
+}
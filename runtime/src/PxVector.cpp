@@ -0,0 +1,102 @@
+extern "C" {
+    #include "PxRuntime.h"
+}
+
+#include "PxRegion.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+    const intptr_t MINIMUM_CAPACITY = 4;
+    const size_t ELEMENT_ALIGNMENT = 16;
+
+    std::atomic<double> growthFactor{ 2.0 };
+
+    PxRegion *regionOf(const PxVector *vector)
+    {
+        return vector->region != nullptr ? vector->region : px::defaultRegion();
+    }
+
+    void *allocate(PxRegion *region, intptr_t count, size_t elementSize)
+    {
+        return pxRegionAllocate(region, (size_t) count * elementSize, ELEMENT_ALIGNMENT);
+    }
+
+}
+
+extern "C" void pxVectorReserve(PxVector *vector, intptr_t count, size_t elementSize)
+{
+    intptr_t needed = vector->length + count;
+    if (needed <= vector->capacity)
+        return;
+    intptr_t grown = (intptr_t) ((double) vector->capacity * growthFactor.load(std::memory_order_relaxed));
+    intptr_t capacity = grown > needed ? grown : needed;
+    if (capacity < MINIMUM_CAPACITY)
+        capacity = MINIMUM_CAPACITY;
+
+    PxRegion *region = regionOf(vector);
+    auto end = (int8_t*) vector->data + (size_t) vector->capacity * elementSize;
+    if (vector->data == nullptr || !px::regionExtend(region, end, (size_t) (capacity - vector->capacity) * elementSize))
+    {
+        void *data = allocate(region, capacity, elementSize);
+        if (vector->length != 0)
+            memcpy(data, vector->data, (size_t) vector->length * elementSize);
+        vector->data = data;
+    }
+    vector->capacity = capacity;
+}
+
+extern "C" PxVector pxVectorFromElements(const void *elements, intptr_t count, size_t elementSize)
+{
+    PxVector vector = pxVectorCreate();
+    if (count != 0)
+    {
+        vector.data = allocate(pxCurrentRegion(), count, elementSize);
+        memcpy(vector.data, elements, (size_t) count * elementSize);
+        vector.length = count;
+        vector.capacity = count;
+    }
+    return vector;
+}
+
+extern "C" void pxVectorAssign(PxVector *vector, const void *elements, intptr_t count, size_t elementSize)
+{
+    // elements may be vector's own, so they are not copied until it has room
+    if (count > vector->capacity)
+    {
+        PxVector grown = { nullptr, 0, 0, vector->region };
+        pxVectorReserve(&grown, count, elementSize);
+        memcpy(grown.data, elements, (size_t) count * elementSize);
+        grown.length = count;
+        *vector = grown;
+        return;
+    }
+    if (count != 0)
+        memmove(vector->data, elements, (size_t) count * elementSize);
+    vector->length = count;
+}
+
+extern "C" void pxVectorAppend(PxVector *vector, const PxVector *other, size_t elementSize)
+{
+    intptr_t count = other->length;
+    if (count == 0)
+        return;
+    pxVectorReserve(vector, count, elementSize);
+    // Read after growing, since other may be vector itself
+    memcpy((int8_t*) vector->data + (size_t) vector->length * elementSize, other->data, (size_t) count * elementSize);
+    vector->length += count;
+}
+
+extern "C" void pxVectorSetGrowthFactor(double factor)
+{
+    growthFactor.store(factor < 1.1 ? 1.1 : factor, std::memory_order_relaxed);
+}
+
+extern "C" void pxVectorPopEmpty(void)
+{
+    fputs("pop from an empty array\n", stderr);
+    abort();
+}
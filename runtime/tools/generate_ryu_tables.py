@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Generates runtime/src/RyuTables.h, the powers of five used by the shortest float formatter.
+
+Each table entry holds the leading bits of 5^i (the SPLIT tables) or of 2^k / 5^i rounded up (the
+INV_SPLIT tables), as described in Ulf Adams, "Ryu: fast float-to-string conversion", PLDI 2018.
+"""
+
+import os
+
+DOUBLE_POW5_INV_BITCOUNT = 125
+DOUBLE_POW5_BITCOUNT = 125
+DOUBLE_POW5_INV_TABLE_SIZE = 342
+DOUBLE_POW5_TABLE_SIZE = 326
+
+FLOAT_POW5_INV_BITCOUNT = 59
+FLOAT_POW5_BITCOUNT = 61
+FLOAT_POW5_INV_TABLE_SIZE = 31
+FLOAT_POW5_TABLE_SIZE = 48
+
+
+def split(i, bits):
+    power = 5 ** i
+    shift = power.bit_length() - bits
+    return power >> shift if shift >= 0 else power << -shift
+
+
+def inverse_split(i, bits):
+    power = 5 ** i
+    return (1 << (power.bit_length() - 1 + bits)) // power + 1
+
+
+def double_table(name, values):
+    lines = ["static const uint64_t %s[%d][2] = {" % (name, len(values))]
+    for value in values:
+        lines.append("    { %du, %du }," % (value & (2 ** 64 - 1), value >> 64))
+    lines.append("};")
+    return lines
+
+
+def float_table(name, values):
+    lines = ["static const uint64_t %s[%d] = {" % (name, len(values))]
+    for value in values:
+        lines.append("    %du," % value)
+    lines.append("};")
+    return lines
+
+
+def main():
+    lines = [
+        "// Generated by runtime/tools/generate_ryu_tables.py, do not edit",
+        "",
+        "#ifndef PX_RYUTABLES_H",
+        "#define PX_RYUTABLES_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "#define DOUBLE_POW5_INV_BITCOUNT %d" % DOUBLE_POW5_INV_BITCOUNT,
+        "#define DOUBLE_POW5_BITCOUNT %d" % DOUBLE_POW5_BITCOUNT,
+        "#define FLOAT_POW5_INV_BITCOUNT %d" % FLOAT_POW5_INV_BITCOUNT,
+        "#define FLOAT_POW5_BITCOUNT %d" % FLOAT_POW5_BITCOUNT,
+        "",
+    ]
+    lines += double_table("DOUBLE_POW5_INV_SPLIT", [inverse_split(i, DOUBLE_POW5_INV_BITCOUNT) for i in range(DOUBLE_POW5_INV_TABLE_SIZE)])
+    lines.append("")
+    lines += double_table("DOUBLE_POW5_SPLIT", [split(i, DOUBLE_POW5_BITCOUNT) for i in range(DOUBLE_POW5_TABLE_SIZE)])
+    lines.append("")
+    lines += float_table("FLOAT_POW5_INV_SPLIT", [inverse_split(i, FLOAT_POW5_INV_BITCOUNT) for i in range(FLOAT_POW5_INV_TABLE_SIZE)])
+    lines.append("")
+    lines += float_table("FLOAT_POW5_SPLIT", [split(i, FLOAT_POW5_BITCOUNT) for i in range(FLOAT_POW5_TABLE_SIZE)])
+    lines += ["", "#endif", ""]
+
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "RyuTables.h")
+    with open(path, "w") as output:
+        output.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
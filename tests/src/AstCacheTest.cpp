@@ -0,0 +1,134 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "catch.hpp"
+#include <AstCache.h>
+#include <ContextAnalyzer.h>
+#include <Parser.h>
+#include <cg/CCompiler.h>
+
+static const char *SOURCE =
+    "module cached;\n"
+    "extern func puts(text: string) : void;\n"
+    "counter: int64 = 16_i64;\n"
+    "func sum(values: int32[4]) : int32 { total: int32 = 0; for i in 0..4 { total += values[i]; } return total; }\n"
+    "private func pick(x: int32) : float64 {\n"
+    "    switch (x) { case 1, 2: return 1.5; default: return -2.0 as float64; }\n"
+    "}\n"
+    "func main() : int32 {\n"
+    "    values: int32[4] = [1, 2, 3, 4]; name: string = \"px\"; letter: char = 'x'; done: bool = false;\n"
+    "    region { list: int32[] = [1]; push(list, 2); }\n"
+    "    i: int32 = 0; while (i < 3) { i += 1; if (i == 2) { continue; } else { break; } }\n"
+    "    do { i -= 1; } while (done == false && i > 0)\n"
+    "    values[1] = -i;\n"
+    "    return i > 0 ? sum(values) : sum(values) * 2;\n"
+    "}\n";
+
+// The C of a module, which shows whether two trees are the same
+static std::string generate(px::ast::Module &module)
+{
+    px::ScopeTree scopeTree;
+    px::ErrorLog errors;
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+    analyzer.analyze(module);
+    REQUIRE(errors.count() == 0);
+    px::CCompiler compiler{ &scopeTree };
+    return compiler.compileToString(module).toString();
+}
+
+TEST_CASE("AST cache round trip") {
+    px::Utf8String fileName{ "cached.px" };
+    px::Utf8String source{ SOURCE };
+    uint64_t hash = px::AstCache::hash(source);
+    px::ErrorLog errors;
+    px::Parser parser{ &errors };
+    auto parsed = parser.parse(fileName, source);
+    REQUIRE(px::AstCache::write("cached.px.pxast", hash, *parsed));
+
+    auto loaded = px::AstCache::read("cached.px.pxast", hash, fileName);
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded->moduleName == parsed->moduleName);
+    REQUIRE(loaded->statements.size() == parsed->statements.size());
+    REQUIRE(loaded->statements[3]->position == parsed->statements[3]->position);
+    REQUIRE(generate(*loaded) == generate(*parsed));
+
+    // Other source, or a damaged file, is not taken from the cache
+    REQUIRE(px::AstCache::read("cached.px.pxast", hash + 1, fileName) == nullptr);
+    {
+        std::fstream file{ "cached.px.pxast", std::ios::in | std::ios::out | std::ios::binary };
+        file.seekp(40);
+        file.write("\x7f\x7f\x7f\x7f", 4);
+    }
+    REQUIRE(px::AstCache::read("cached.px.pxast", hash, fileName) == nullptr);
+    REQUIRE(px::AstCache::read("missing.px.pxast", hash, fileName) == nullptr);
+}
+
+// Writes bytes as the cache of SOURCE and reads it back
+static std::unique_ptr<px::ast::Module> readCache(const std::string &bytes, uint64_t hash)
+{
+    {
+        std::ofstream file{ "cached.px.pxast", std::ios::binary | std::ios::trunc };
+        file.write(bytes.data(), bytes.size());
+    }
+    return px::AstCache::read("cached.px.pxast", hash, px::Utf8String{ "cached.px" });
+}
+
+TEST_CASE("AST cache damage is a miss") {
+    px::Utf8String source{ SOURCE };
+    uint64_t hash = px::AstCache::hash(source);
+    px::ErrorLog errors;
+    px::Parser parser{ &errors };
+    auto parsed = parser.parse(px::Utf8String{ "cached.px" }, source);
+    REQUIRE(px::AstCache::write("cached.px.pxast", hash, *parsed));
+    std::string bytes;
+    {
+        std::ifstream file{ "cached.px.pxast", std::ios::binary };
+        bytes.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+    }
+    REQUIRE(readCache(bytes, hash) != nullptr);
+
+    SECTION("string count larger than the file") {
+        std::string damaged = bytes;
+        std::memset(&damaged[16], 0xff, 4);
+        REQUIRE(readCache(damaged, hash) == nullptr);
+    }
+
+    SECTION("operators outside their enums") {
+        std::vector<uint32_t> words(bytes.size() / sizeof(uint32_t));
+        std::memcpy(words.data(), bytes.data(), words.size() * sizeof(uint32_t));
+        // A binary node is its type, its position, its operator and its token
+        size_t binary = 0;
+        for (size_t i = 6; i + 5 < words.size() && binary == 0; ++i)
+        {
+            if (words[i] == (uint32_t) px::ast::NodeType::EXP_BINARY_OP && words[i + 4] == (uint32_t) px::ast::BinaryOperator::LT
+                && words[i + 5] == (uint32_t) px::TokenType::OP_LESS)
+                binary = i;
+        }
+        REQUIRE(binary != 0);
+
+        for (size_t field = binary + 4; field <= binary + 5; ++field)
+        {
+            std::string damaged = bytes;
+            uint32_t value = 1000;
+            std::memcpy(&damaged[field * sizeof(uint32_t)], &value, sizeof(value));
+            REQUIRE(readCache(damaged, hash) == nullptr);
+        }
+    }
+
+    SECTION("damaged words") {
+        // Every 13th word, which lands on headers, nodes and strings alike
+        for (size_t offset = 0; offset + sizeof(uint32_t) <= bytes.size(); offset += 13 * sizeof(uint32_t))
+        {
+            std::string damaged = bytes;
+            std::memset(&damaged[offset], 0xff, sizeof(uint32_t));
+            readCache(damaged, hash);
+        }
+    }
+
+    SECTION("truncated file") {
+        // Cutting a word or more always cuts into the last string
+        for (size_t length = 0; length + sizeof(uint32_t) <= bytes.size(); length += 61)
+            REQUIRE(readCache(bytes.substr(0, length), hash) == nullptr);
+        REQUIRE(readCache(bytes.substr(0, bytes.size() - sizeof(uint32_t)), hash) == nullptr);
+    }
+}
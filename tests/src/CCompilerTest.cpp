@@ -0,0 +1,138 @@
+#include "catch.hpp"
+#include <CompilerContext.h>
+#include <opt/Inliner.h>
+
+// The C compiling source gives, which must have no errors
+static std::string compile(const char *source, bool inlining = true)
+{
+    px::CompilerContext context{ px::CompileOptions{ inlining, px::Inliner::DEFAULT_THRESHOLD } };
+    px::Utf8String output;
+    bool compiled = context.compileToC("generated.px", source, output);
+    REQUIRE(context.diagnostics().empty());
+    REQUIRE(compiled);
+    return output.toString();
+}
+
+// The C of the first function whose signature has text
+static std::string functionText(const std::string &c, const std::string &text)
+{
+    size_t start = c.find(text);
+    REQUIRE(start != std::string::npos);
+    return c.substr(start, c.find("\n}\n", start) - start);
+}
+
+TEST_CASE("CCompiler parenthesizes the operand of a unary operator") {
+    const char *source = "module generated;"
+                         "func neg(a: int32) : int32 { return -a; }"
+                         "func main() : int32 { y: int32 = 5; x: int32 = neg(-y); z: int32 = neg(-7); w: int32 = -(-y); return x + z + w; }";
+    for (bool inlining : { true, false })
+    {
+        auto c = compile(source, inlining);
+        REQUIRE(c.find("--") == std::string::npos);
+        REQUIRE(c.find("-(-y)") != std::string::npos);
+    }
+    REQUIRE(compile(source).find("-(-7)") != std::string::npos);
+}
+
+TEST_CASE("CCompiler lowers dense switches to C and sparse ones to a search") {
+    // Close values, and fewer than four however far apart, stay a C switch
+    auto dense = compile("module generated;"
+                         "func pick(x: int32) : int32 { switch (x) { case 1, 2: return 10; case 3: return 20; case 4: return 30; default: return 0; } }"
+                         "func few(x: int32) : int32 { switch (x) { case 0: return 1; case 1000000: return 2; default: return 0; } }");
+    REQUIRE(dense.find("switch (x)") != std::string::npos);
+    REQUIRE(dense.find("case 4:") != std::string::npos);
+    REQUIRE(dense.find("case 1000000:") != std::string::npos);
+    REQUIRE(dense.find("goto") == std::string::npos);
+
+    // Four or more values spread far apart are searched in halves, down to a few comparisons
+    auto sparse = compile("module generated;"
+                          "func pick(x: int64) : int32 {"
+                          "    switch (x) { case -9000000000: return 1; case -5: return 2; case 7, 100000: return 3; case 9000000000: return 4; default: return 0; }"
+                          "}");
+    REQUIRE(sparse.find("switch (") == std::string::npos);
+    REQUIRE(sparse.find("const int64_t _pxsw1 = x;") != std::string::npos);
+    REQUIRE(sparse.find("if (_pxsw1 < 7)") != std::string::npos);
+    REQUIRE(sparse.find("if (_pxsw1 == -9000000000) goto _pxsw1_case0;") != std::string::npos);
+    REQUIRE(sparse.find("if (_pxsw1 == -5) goto _pxsw1_case1;") != std::string::npos);
+    REQUIRE(sparse.find("if (_pxsw1 == 100000) goto _pxsw1_case2;") != std::string::npos);
+    REQUIRE(sparse.find("goto _pxsw1_default;") != std::string::npos);
+    REQUIRE(sparse.find("_pxsw1_case3:") != std::string::npos);
+}
+
+TEST_CASE("CCompiler emits the inferred function attributes") {
+    auto c = compile("module generated;"
+                     "extern func ext(x: int32) : int32;"
+                     "g: int32 = 0;"
+                     "func square(x: int32) : int32 { return x * x; }"
+                     "func readG() : int32 { return g; }"
+                     "func writeG(x: int32) : int32 { g = x; return x; }"
+                     "func callsExt(x: int32) : int32 { return ext(x); }"
+                     "func fact(n: int64) : int64 { return n < 2 ? 1 : n * fact(n - 1); }"
+                     "func spin() : void { while (true) { } }"
+                     "func sum(a: int32[4]) : int32 { t: int32 = 0; for i in 0..4 { t += a[i]; } return t; }"
+                     "private func copy(a: int32[4], b: int32[4]) : void { for i in 0..4 { a[i] = b[i]; } }"
+                     "private func copyAliased(a: int32[4], b: int32[4]) : void { for i in 0..4 { a[i] = b[i]; } }"
+                     "private func twice(x: int32) : int32 { return x * 2; }"
+                     "func main() : int32 { x: int32[4] = [1, 2, 3, 4]; y: int32[4]; copy(y, x); copyAliased(x, x); return twice(sum(x)); }", false);
+    REQUIRE(c.find("\nPX_CONST int32_t square(int32_t x)") != std::string::npos);
+    REQUIRE(c.find("\nPX_PURE int32_t readG()") != std::string::npos);
+    REQUIRE(c.find("\nint32_t writeG(int32_t x)") != std::string::npos);
+    REQUIRE(c.find("\nint32_t callsExt(int32_t x)") != std::string::npos);
+    REQUIRE(c.find("\nint64_t fact(int64_t n)") != std::string::npos);
+    REQUIRE(c.find("\nPX_NORETURN void spin()") != std::string::npos);
+    REQUIRE(c.find("\nPX_PURE int32_t sum(int32_t *PX_RESTRICT a)") != std::string::npos);
+    REQUIRE(c.find("\nstatic PX_ALWAYS_INLINE void copy(int32_t *PX_RESTRICT a, int32_t *PX_RESTRICT b)") != std::string::npos);
+    REQUIRE(c.find("\nstatic PX_ALWAYS_INLINE void copyAliased(int32_t *a, int32_t *b)") != std::string::npos);
+    REQUIRE(c.find("\nstatic PX_ALWAYS_INLINE PX_CONST int32_t twice(int32_t x)") != std::string::npos);
+}
+
+TEST_CASE("CCompiler marks loops whose iterations are independent") {
+    auto c = compile("module generated;"
+                     "func local() : int32 { a: int32[8]; b: int32[8]; for i in 0..8 { a[i] = b[i] + 1; } return a[0]; }"
+                     "func shift() : int32 { a: int32[8]; for i in 1..8 { a[i] = a[i - 1]; } return a[7]; }"
+                     "private func copy(a: int32[8], b: int32[8]) : void { for i in 0..8 { a[i] = b[i]; } }"
+                     "private func copyAliased(a: int32[8], b: int32[8]) : void { for i in 0..8 { a[i] = b[i]; } }"
+                     "func copyPublic(a: int32[8], b: int32[8]) : void { for i in 0..8 { a[i] = b[i]; } }"
+                     "func main() : int32 { x: int32[8]; y: int32[8]; copy(y, x); copyAliased(x, x); copyPublic(x, y); return local() + shift(); }", false);
+    // Arrays of its own, or parameters made restrict because every call passes distinct arrays
+    REQUIRE(functionText(c, "int32_t local()").find("PX_INDEPENDENT_LOOP") != std::string::npos);
+    REQUIRE(functionText(c, "void copy(").find("PX_INDEPENDENT_LOOP") != std::string::npos);
+    // An element written is read by the next iteration
+    REQUIRE(functionText(c, "int32_t shift()").find("PX_INDEPENDENT_LOOP") == std::string::npos);
+    // Parameters that may be the same array, passed that way or by callers out of sight
+    REQUIRE(functionText(c, "void copyAliased(").find("PX_INDEPENDENT_LOOP") == std::string::npos);
+    REQUIRE(functionText(c, "void copyPublic(").find("PX_INDEPENDENT_LOOP") == std::string::npos);
+}
+
+TEST_CASE("CCompiler pools string literals and constant arrays") {
+    auto c = compile("module generated;"
+                     "extern func printString(s: string) : void;"
+                     "func sum(values: int32[4]) : int32 { t: int32 = 0; for i in 0..4 { t += values[i]; } return t; }"
+                     "func main() : int32 {"
+                     "    x: int32 = 9;"
+                     "    table: int32[4] = [1, 2, 3, 4];"
+                     "    written: int32[4] = [1, 2, 3, 4];"
+                     "    written[0] = 5;"
+                     "    passed: int32[4] = [1, 2, 3, 4];"
+                     "    other: int32[4] = [5, 6, 7, 8];"
+                     "    other[1] = 0;"
+                     "    computed: int32[4] = [x, 2, 3, 4];"
+                     "    printString(\"hello\"); printString(\"hello\"); printString(\"bye\");"
+                     "    return table[x % 4] + written[0] + sum(passed) + other[0] + computed[0];"
+                     "}", false);
+    // Each distinct literal is one entry of the module's table
+    REQUIRE(c.find("static const PxString _pxStrings[2] = {") != std::string::npos);
+    REQUIRE(c.find("printString(_pxStrings[0]);\n    printString(_pxStrings[0]);\n    printString(_pxStrings[1]);") != std::string::npos);
+
+    // An array that is only read is static, one that is written or passed copies a shared constant
+    REQUIRE(c.find("static const int32_t table[4] = { 1, 2, 3, 4 };") != std::string::npos);
+    REQUIRE(c.find("static const int32_t _pxArray0[4] = { 1, 2, 3, 4 };") != std::string::npos);
+    REQUIRE(c.find("static const int32_t _pxArray1[4] = { 5, 6, 7, 8 };") != std::string::npos);
+    REQUIRE(c.find("_pxArray2") == std::string::npos);
+    REQUIRE(c.find("int32_t written[4];\n    memcpy(written, _pxArray0, sizeof(written));") != std::string::npos);
+    REQUIRE(c.find("int32_t passed[4];\n    memcpy(passed, _pxArray0, sizeof(passed));") != std::string::npos);
+    REQUIRE(c.find("static const int32_t written") == std::string::npos);
+    REQUIRE(c.find("static const int32_t passed") == std::string::npos);
+    // An initializer that is not constant is built where it is declared
+    REQUIRE(c.find("int32_t computed[4]={ x, 2, 3, 4 };") != std::string::npos);
+}
@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "catch.hpp"
+#include <CompileServer.h>
+
+static void writeFile(const char *fileName, const std::string &contents)
+{
+    std::ofstream out{ fileName, std::ios::trunc };
+    out << contents;
+}
+
+// Stands in for pxc: prints the file it was given, and fails for a file called fail
+static int32_t echoCompile(const std::vector<std::string> &arguments, px::CompileRecord &record)
+{
+    std::ifstream in{ arguments[0] };
+    std::stringstream contents;
+    contents << in.rdbuf();
+    record.inputs.push_back(arguments[0]);
+    if (arguments[0] == "fail")
+    {
+        std::fprintf(stderr, "failed\n");
+        return 3;
+    }
+    std::printf("%s", contents.str().c_str());
+    return 0;
+}
+
+TEST_CASE("Compile server reuses compiles of unchanged files") {
+    const char *socketPath = "pxc_test.sock";
+    px::CompileServer server{ socketPath, echoCompile };
+    REQUIRE(server.listen());
+    std::thread serving{ [&server]() { server.run(); } };
+
+    char *current = getcwd(nullptr, 0);
+    std::string directory = current;
+    std::free(current);
+    writeFile("served.txt", "first");
+    px::CompileReply reply;
+    REQUIRE(px::CompileServer::request(socketPath, directory, { "served.txt" }, reply));
+    REQUIRE(reply.exitCode == 0);
+    REQUIRE(reply.out == "first");
+
+    // The same file gives the same reply without compiling
+    reply = px::CompileReply{};
+    REQUIRE(px::CompileServer::request(socketPath, directory, { "served.txt" }, reply));
+    REQUIRE(reply.out == "first");
+
+    // A changed file is compiled again, even when its size and time do not tell
+    writeFile("served.txt", "other");
+    REQUIRE(px::CompileServer::request(socketPath, directory, { "served.txt" }, reply));
+    REQUIRE(reply.out == "other");
+
+    // Failed compiles are always run again
+    REQUIRE(px::CompileServer::request(socketPath, directory, { "fail" }, reply));
+    REQUIRE(reply.exitCode == 3);
+    REQUIRE(reply.err == "failed\n");
+    REQUIRE(px::CompileServer::request(socketPath, directory, { "fail" }, reply));
+
+    REQUIRE(px::CompileServer::stop(socketPath));
+    serving.join();
+    REQUIRE(server.compileCount() == 4);
+    REQUIRE(server.reuseCount() == 1);
+    REQUIRE(!px::CompileServer::request(socketPath, directory, { "served.txt" }, reply));
+    std::remove("served.txt");
+}
@@ -0,0 +1,138 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include "catch.hpp"
+#include <CompilerContext.h>
+#include <opt/Inliner.h>
+#include <vm/Interpreter.h>
+
+static const px::CompileOptions OPTIONS{ true, px::Inliner::DEFAULT_THRESHOLD };
+
+// The allocations made through new in the test program and not deleted yet
+static std::atomic<long> liveAllocations{ 0 };
+
+void *operator new(std::size_t size)
+{
+    void *memory = std::malloc(size != 0 ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc{};
+    ++liveAllocations;
+    return memory;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {
+        return operator new(size);
+    }
+    catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *memory) noexcept
+{
+    if (memory == nullptr)
+        return;
+    --liveAllocations;
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    operator delete(memory);
+}
+
+TEST_CASE("Compiler context compiles to C in memory") {
+    px::CompilerContext context{ OPTIONS };
+    std::remove("snippet.px.c");
+    px::Utf8String output;
+    REQUIRE(context.compileToC("snippet.px", "module snippet; func triple(x: int32) : int32 { return x * 3; }", output));
+    REQUIRE(context.diagnostics().empty());
+    REQUIRE(output.toString().find("triple") != std::string::npos);
+    REQUIRE(!std::ifstream{ "snippet.px.c" }.good());
+
+    // Each compile starts over, so the same function can be compiled again
+    for (int i = 0; i < 100; ++i)
+    {
+        std::string source = "module snippet; func triple(x: int32) : int32 { return x * " + std::to_string(i) + "; }";
+        REQUIRE(context.compileToC("snippet.px", px::Utf8String{ source }, output));
+    }
+    REQUIRE(output.toString().find("* 99") != std::string::npos);
+}
+
+TEST_CASE("Compiler context gives diagnostics") {
+    px::CompilerContext context{ OPTIONS };
+    px::Utf8String output;
+    REQUIRE(!context.compileToC("broken.px", "module broken; func f() : int32 { return missing; }", output));
+    REQUIRE(context.diagnostics().size() == 1);
+    REQUIRE(context.diagnostics()[0].position.fileName == px::Utf8String{ "broken.px" });
+
+    REQUIRE(!context.compileToC("broken.px", "module broken; func f( : int32 {", output));
+    REQUIRE(context.diagnostics().size() == 1);
+    REQUIRE(context.compileToC("fixed.px", "module fixed; func f() : int32 { return 1; }", output));
+    REQUIRE(context.diagnostics().empty());
+}
+
+TEST_CASE("Compiler context compiles to bytecode") {
+    px::CompilerContext context{ OPTIONS };
+    auto program = context.compileToBytecode("run.px", "module run; func twice(x: int32) : int32 { return x * 2; } "
+                                                       "func main() : int32 { return twice(21); }");
+    REQUIRE(program != nullptr);
+    px::Interpreter interpreter{ *program };
+    REQUIRE(interpreter.run() == 42);
+    REQUIRE(context.compileToBytecode("run.px", "module run; func main() : int32 { return missing; }") == nullptr);
+    REQUIRE(context.diagnostics().size() == 1);
+}
+
+TEST_CASE("Compiler context frees what each compile allocates") {
+    const char *source = "module leaks;"
+                         "func twice(x: int32) : int32;"
+                         "func sum(values: int64[], counts: map[string, int64], fixed: int32[4]) : int64 {"
+                         "    total: int64 = 0;"
+                         "    for i in 0..length(values) { total += values[i]; }"
+                         "    return total + length(counts) + fixed[0];"
+                         "}"
+                         "func main() : int32 {"
+                         "    values: int64[];"
+                         "    push(values, 1);"
+                         "    counts: map[string, int64];"
+                         "    counts[\"a\"] = 2;"
+                         "    fixed: int32[4] = [1, 2, 3, 4];"
+                         "    result: future[int64] = spawn sum(values, counts, fixed);"
+                         "    n: int64 = await result;"
+                         "    return twice(1);"
+                         "}"
+                         "func twice(x: int32) : int32 { return x * 2; }";
+    px::CompilerContext context{ OPTIONS };
+    px::Utf8String output;
+    // The first compiles fill what is only allocated once, such as ICU's tables
+    for (int i = 0; i < 2; ++i)
+        REQUIRE(context.compileToC("leaks.px", source, output));
+    long before = liveAllocations;
+    for (int i = 0; i < 20; ++i)
+        REQUIRE(context.compileToC("leaks.px", source, output));
+    REQUIRE(liveAllocations == before);
+}
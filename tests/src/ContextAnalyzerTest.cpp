@@ -0,0 +1,245 @@
+#include "catch.hpp"
+#include <CompilerContext.h>
+#include <ContextAnalyzer.h>
+#include <Parser.h>
+#include <opt/Inliner.h>
+
+static const px::CompileOptions OPTIONS{ false, px::Inliner::DEFAULT_THRESHOLD };
+
+// The messages of the errors compiling source gives
+static std::vector<std::string> analyze(const char *source)
+{
+    px::CompilerContext context{ OPTIONS };
+    px::Utf8String output;
+    context.compileToC("analyzed.px", source, output);
+    std::vector<std::string> messages;
+    for (auto &error : context.diagnostics())
+        messages.push_back(error.errorMsg.toString());
+    return messages;
+}
+
+TEST_CASE("ContextAnalyzer region values passed with outer containers") {
+    auto errors = analyze("module analyzed;"
+                          "func keep(a: string[], s: string) : void { push(a, s); }"
+                          "func count(a: string[], s: string) : int64 { return length(a); }"
+                          "func main() : int32 {"
+                          "    outer: string[];"
+                          "    region {"
+                          "        s: string = \"x\" + \"y\";"
+                          "        keep(outer, s);"
+                          "        n: int64 = count(outer, s);"
+                          "        inner: string[];"
+                          "        keep(inner, s);"
+                          "        keep(outer, \"literal\");"
+                          "    }"
+                          "    return 0;"
+                          "}");
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == "Function keep may store a value allocated in a region block in outer, which outlives it");
+}
+
+TEST_CASE("ContextAnalyzer region values passed to functions that write globals") {
+    auto errors = analyze("module analyzed;"
+                          "g: string = \"\";"
+                          "count: int64 = 0;"
+                          "func setg(s: string) : void { g = s; }"
+                          "func store(s: string) : void { setg(s); }"
+                          "func bump(s: string) : void { count += 1; }"
+                          "func show(s: string) : bool { return s == \"xy\"; }"
+                          "func main() : int32 {"
+                          "    region {"
+                          "        t: string = \"x\" + \"y\";"
+                          "        setg(t);"
+                          "        store(t);"
+                          "        same: bool = show(t);"
+                          "        setg(\"literal\");"
+                          "        bump(\"literal\");"
+                          "    }"
+                          "    return 0;"
+                          "}");
+    REQUIRE(errors.size() == 2);
+    REQUIRE(errors[0] == "Function setg writes global variables, so it may store a value allocated in a region block in one, which outlives it");
+    REQUIRE(errors[1] == "Function store writes global variables, so it may store a value allocated in a region block in one, which outlives it");
+}
+
+TEST_CASE("ContextAnalyzer parallel for reads of arrays its iterations write") {
+    auto errors = analyze("module analyzed;"
+                          "func first(a: int32[16]) : int32 { return a[0]; }"
+                          "func shift(a: int32[16], b: int32[16]) : void {"
+                          "    parallel for i in 0..15 {"
+                          "        a[i] = a[i + 1];"
+                          "        b[i] = first(b);"
+                          "    }"
+                          "}"
+                          "private func copy(a: int32[16], b: int32[16]) : void {"
+                          "    parallel for i in 0..15 {"
+                          "        a[i] = a[i] + b[i + 1] + first(b);"
+                          "    }"
+                          "}");
+    REQUIRE(errors.size() == 2);
+    REQUIRE(errors[0] == "Can not read a inside a parallel for except at index i, since its iterations write it");
+    REQUIRE(errors[1] == "Can not read b inside a parallel for except at index i, since its iterations write it");
+}
+
+TEST_CASE("ContextAnalyzer parallel for reads of arrays that may be the ones it writes") {
+    auto errors = analyze("module analyzed;"
+                          "g: int64[8];"
+                          "private func shift(a: int64[8], b: int64[8]) : void { parallel for i in 1..8 { a[i] = b[i - 1] + 1; } }"
+                          "private func distinct(a: int64[8], b: int64[8]) : void { parallel for i in 1..8 { a[i] = b[i - 1] + 1; } }"
+                          "private func fromGlobal(a: int64[8]) : void { parallel for i in 1..8 { a[i] = g[i - 1]; } }"
+                          "func open(a: int64[8], b: int64[8]) : void { parallel for i in 1..8 { a[i] = b[i - 1] + b[i]; } }"
+                          "func main() : int32 {"
+                          "    x: int64[8]; y: int64[8];"
+                          "    shift(x, x);"
+                          "    distinct(x, y);"
+                          "    fromGlobal(g);"
+                          "    return 0;"
+                          "}");
+    REQUIRE(errors.size() == 3);
+    REQUIRE(errors[0] == "Can not read b inside a parallel for except at index i, since its iterations write a, which may be the same array");
+    REQUIRE(errors[1] == "Can not read g inside a parallel for except at index i, since its iterations write a, which may be the same array");
+    REQUIRE(errors[2] == "Can not read b inside a parallel for except at index i, since its iterations write a, which may be the same array");
+}
+
+TEST_CASE("ContextAnalyzer parallel for writes to shared dynamic arrays") {
+    auto errors = analyze("module analyzed;"
+                          "func fill(v: int32[]) : void {"
+                          "    parallel for i in 0..length(v) {"
+                          "        v[i] = 1;"
+                          "        local: int64[];"
+                          "        push(local, i);"
+                          "        local[0] = 2;"
+                          "    }"
+                          "}");
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == "Can not write to the dynamic array v inside a parallel for, since its iterations share it");
+}
+
+TEST_CASE("ContextAnalyzer containers passed to pending tasks") {
+    auto errors = analyze("module analyzed;"
+                          "func fill(v: int64[], n: int64) : void { for i in 0..length(v) { v[i] = n; } }"
+                          "func total(v: int64[]) : int64 { t: int64 = 0; for i in 0..length(v) { t += v[i]; } return t; }"
+                          "func main() : int32 {"
+                          "    v: int64[];"
+                          "    push(v, 1);"
+                          "    {"
+                          "        f: future[void] = spawn fill(v, 2);"
+                          "        v[0] = 1;"
+                          "        x: int64 = v[0];"
+                          "        g: future[int64] = spawn total(v);"
+                          "        n: int64 = length(v);"
+                          "        await f;"
+                          "        y: int64 = v[0];"
+                          "    }"
+                          "    {"
+                          "        t: future[int64] = spawn total(v);"
+                          "        u: future[int64] = spawn total(v);"
+                          "        z: int64 = v[0];"
+                          "        fill(v, 3);"
+                          "    }"
+                          "    return 0;"
+                          "}");
+    REQUIRE(errors.size() == 3);
+    REQUIRE(errors[0] == "Can not change v while the task f that was passed it may still be running");
+    REQUIRE(errors[1] == "Can not read v while the task f, which may write it, may still be running");
+    REQUIRE(errors[2] == "Can not pass v to another task while the task f that was passed it may still be running, since one of them may write it");
+}
+
+TEST_CASE("ContextAnalyzer switch case values") {
+    auto errors = analyze("module analyzed;"
+                          "func pick(x: int8, u: uint8, c: char, f: float64, n: int32) : int32 {"
+                          "    switch (x) { case 1, 2: return 1; case 2: return 2; case 200: return 3; case -128, 127: return 4; case 'a': return 5; case n: return 6; default: return 0; }"
+                          "    switch (u) { case -1: return 7; case 255: return 8; }"
+                          "    switch (c) { case 'a': return 9; case 97: return 10; }"
+                          "    switch (f) { case 1: return 11; }"
+                          "    return 0;"
+                          "}");
+    REQUIRE(errors.size() == 7);
+    REQUIRE(errors[0] == "Duplicate case value 2");
+    REQUIRE(errors[1] == "Case value 200 is out of range for type 'int8'");
+    REQUIRE(errors[2] == "Case value of type 'char' does not match switch value of type 'int8'");
+    REQUIRE(errors[3] == "Case value must be an integer or char literal");
+    REQUIRE(errors[4] == "Case value -1 is out of range for type 'uint8'");
+    REQUIRE(errors[5] == "Case value of type 'int32' does not match switch value of type 'char'");
+    REQUIRE(errors[6] == "Switch value must be an integer or a char, not 'float64'");
+}
+
+// A module analyzed without errors, whose functions can be asked for the attributes inferred for them
+struct AnalyzedModule
+{
+    px::ScopeTree scopeTree;
+    px::ErrorLog errors;
+    std::unique_ptr<px::ast::Module> module;
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+
+    explicit AnalyzedModule(const char *source)
+    {
+        px::Parser parser{ &errors };
+        module = parser.parse(px::Utf8String{ "analyzed.px" }, px::Utf8String{ source });
+        analyzer.analyze(*module);
+        REQUIRE(errors.count() == 0);
+    }
+
+    bool has(const char *function, px::Function::Attributes attribute)
+    {
+        px::Function *found = analyzer.moduleScope()->symbols()->getFunction(px::Utf8String{ function });
+        REQUIRE(found != nullptr);
+        return found->hasAttribute(attribute);
+    }
+};
+
+// Functions with and without each inferred attribute
+static const char *ATTRIBUTES_SOURCE =
+    "module analyzed;"
+    "extern func ext(x: int32) : int32;"
+    "g: int32 = 0;"
+    "func square(x: int32) : int32 { return x * x; }"
+    "func cube(x: int32) : int32 { return square(x) * x; }"
+    "func readG() : int32 { return g; }"
+    "func sum(a: int32[4]) : int32 { t: int32 = 0; for i in 0..4 { t += a[i]; } return t; }"
+    "func writeG(x: int32) : int32 { g = x; return x; }"
+    "func viaWriter(x: int32) : int32 { return writeG(x) + 1; }"
+    "func callsExt(x: int32) : int32 { return ext(x); }"
+    "func fact(n: int64) : int64 { return n < 2 ? 1 : n * fact(n - 1); }"
+    "func spin() : void { while (true) { } }"
+    "func callsSpin() : void { spin(); }"
+    "func maybeSpin(b: bool) : void { if (b) { spin(); } }"
+    "private func copy(a: int32[4], b: int32[4]) : void { for i in 0..4 { a[i] = b[i]; } }"
+    "private func copyAliased(a: int32[4], b: int32[4]) : void { for i in 0..4 { a[i] = b[i]; } }"
+    "func copyPublic(a: int32[4], b: int32[4]) : void { for i in 0..4 { a[i] = b[i]; } }"
+    "private func twice(x: int32) : int32 { return x * 2; }"
+    "private func down(n: int32) : int32 { return n > 0 ? down(n - 1) : 0; }"
+    "func main() : int32 {"
+    "    x: int32[4] = [1, 2, 3, 4]; y: int32[4];"
+    "    copy(y, x); copyAliased(x, x); copyPublic(x, y);"
+    "    return twice(sum(x)) + down(3);"
+    "}";
+
+TEST_CASE("ContextAnalyzer infers function attributes") {
+    AnalyzedModule analyzed{ ATTRIBUTES_SOURCE };
+
+    // const reads nothing but its arguments, pure may read globals and arrays
+    REQUIRE(analyzed.has("square", px::Function::CONST));
+    REQUIRE(analyzed.has("cube", px::Function::CONST));
+    REQUIRE(analyzed.has("readG", px::Function::PURE));
+    REQUIRE(!analyzed.has("readG", px::Function::CONST));
+    REQUIRE(analyzed.has("sum", px::Function::PURE));
+    REQUIRE(!analyzed.has("sum", px::Function::CONST));
+    for (const char *impure : { "writeG", "viaWriter", "callsExt", "fact", "down" })
+        REQUIRE(!analyzed.has(impure, px::Function::PURE));
+
+    REQUIRE(analyzed.has("spin", px::Function::NO_RETURN));
+    REQUIRE(analyzed.has("callsSpin", px::Function::NO_RETURN));
+    REQUIRE(!analyzed.has("maybeSpin", px::Function::NO_RETURN));
+    REQUIRE(!analyzed.has("square", px::Function::NO_RETURN));
+
+    // Arrays are restrict when they are only read, or for a private function given distinct arrays
+    REQUIRE(analyzed.has("sum", px::Function::RESTRICT_ARRAYS));
+    REQUIRE(analyzed.has("copy", px::Function::RESTRICT_ARRAYS));
+    REQUIRE(!analyzed.has("copyAliased", px::Function::RESTRICT_ARRAYS));
+    REQUIRE(!analyzed.has("copyPublic", px::Function::RESTRICT_ARRAYS));
+
+    REQUIRE(analyzed.has("twice", px::Function::ALWAYS_INLINE));
+    REQUIRE(!analyzed.has("down", px::Function::ALWAYS_INLINE));
+    REQUIRE(!analyzed.has("square", px::Function::ALWAYS_INLINE));
+}
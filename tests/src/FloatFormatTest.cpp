@@ -0,0 +1,160 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+static std::string format32(float f)
+{
+    char text[PX_FLOAT_TEXT_SIZE];
+    int32_t length = pxFormatFloat32(f, text);
+    return std::string(text, length);
+}
+
+static std::string format64(double d)
+{
+    char text[PX_FLOAT_TEXT_SIZE];
+    int32_t length = pxFormatFloat64(d, text);
+    return std::string(text, length);
+}
+
+static float fromBits32(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static double fromBits64(uint64_t bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// The fewest significant digits %.*e needs to round trip, counted the same way as the formatter's output
+static size_t shortestDigits64(double d)
+{
+    char text[64];
+    for (int precision = 0; precision < 17; ++precision)
+    {
+        snprintf(text, sizeof(text), "%.*e", precision, d);
+        if (strtod(text, nullptr) == d)
+            return precision + 1;
+    }
+    return 17;
+}
+
+static size_t significantDigits(const std::string &text)
+{
+    size_t end = text.find('e');
+    std::string digits;
+    for (char c : text.substr(0, end))
+    {
+        if (c >= '0' && c <= '9')
+            digits += c;
+    }
+    size_t first = digits.find_first_not_of('0');
+    if (first == std::string::npos)
+        return 1;
+    size_t last = digits.find_last_not_of('0');
+    return last - first + 1;
+}
+
+TEST_CASE("Float format special values") {
+    REQUIRE(format32(0.0f) == "0.0");
+    REQUIRE(format32(-0.0f) == "-0.0");
+    REQUIRE(format32(std::numeric_limits<float>::infinity()) == "inf");
+    REQUIRE(format32(-std::numeric_limits<float>::infinity()) == "-inf");
+    REQUIRE(format32(std::numeric_limits<float>::quiet_NaN()) == "nan");
+    REQUIRE(format64(0.0) == "0.0");
+    REQUIRE(format64(-std::numeric_limits<double>::infinity()) == "-inf");
+    REQUIRE(format64(std::numeric_limits<double>::quiet_NaN()) == "nan");
+}
+
+TEST_CASE("Float format notation") {
+    REQUIRE(format32(1.0f) == "1.0");
+    REQUIRE(format32(3.5f) == "3.5");
+    REQUIRE(format32(-3.5f) == "-3.5");
+    REQUIRE(format32(0.1f) == "0.1");
+    REQUIRE(format32(100.0f) == "100.0");
+    REQUIRE(format32(16777216.0f) == "16777216.0");
+    REQUIRE(format32(1e30f) == "1e+30");
+    REQUIRE(format32(3.4028235e38f) == "3.4028235e+38");
+    REQUIRE(format32(1e-45f) == "1e-45");
+    REQUIRE(format32(0.000123f) == "0.000123");
+    REQUIRE(format64(0.1) == "0.1");
+    REQUIRE(format64(0.3) == "0.3");
+    REQUIRE(format64(0.1 + 0.2) == "0.30000000000000004");
+    REQUIRE(format64(123456789012345680.0) == "123456789012345680.0");
+    REQUIRE(format64(1e21) == "1e+21");
+    REQUIRE(format64(1e22) == "1e+22");
+    REQUIRE(format64(5e-324) == "5e-324");
+    REQUIRE(format64(1.7976931348623157e308) == "1.7976931348623157e+308");
+    REQUIRE(format64(2.2250738585072014e-308) == "2.2250738585072014e-308");
+    REQUIRE(format64(0.000001) == "0.000001");
+    REQUIRE(format64(0.0000001) == "1e-7");
+}
+
+TEST_CASE("Float format float64 round trip") {
+    std::mt19937_64 random{ 12345 };
+    for (int i = 0; i < 1000000; ++i)
+    {
+        double d = fromBits64(random());
+        if (std::isnan(d))
+            continue;
+        std::string text = format64(d);
+        REQUIRE(strtod(text.c_str(), nullptr) == d);
+        if (i % 16 == 0 && !std::isinf(d) && d != 0)
+            REQUIRE(significantDigits(text) == shortestDigits64(d));
+    }
+}
+
+TEST_CASE("Float format float32 round trip sample") {
+    for (uint64_t bits = 0; bits <= 0xFFFFFFFFu; bits += 4099)
+    {
+        float f = fromBits32((uint32_t) bits);
+        if (std::isnan(f))
+            continue;
+        std::string text = format32(f);
+        REQUIRE(strtof(text.c_str(), nullptr) == f);
+    }
+}
+
+// Every float32 bit pattern; takes minutes, run explicitly with: tests "[exhaustive]"
+TEST_CASE("Float format float32 round trip exhaustive", "[.][exhaustive]") {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint64_t> failures(threads, 0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t, threads, &failures] {
+            uint64_t begin = (0x100000000ull * t) / threads;
+            uint64_t end = (0x100000000ull * (t + 1)) / threads;
+            char text[PX_FLOAT_TEXT_SIZE + 1];
+            for (uint64_t bits = begin; bits < end; ++bits)
+            {
+                float f = fromBits32((uint32_t) bits);
+                if (std::isnan(f))
+                    continue;
+                text[pxFormatFloat32(f, text)] = '\0';
+                float parsed = strtof(text, nullptr);
+                if (memcmp(&parsed, &f, sizeof(f)) != 0)
+                    ++failures[t];
+            }
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    for (uint64_t failed : failures)
+        REQUIRE(failed == 0);
+}
@@ -0,0 +1,166 @@
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+struct Node
+{
+    Node *left;
+    Node *right;
+    int64_t value;
+};
+
+static const size_t NODE_POINTERS[] = { offsetof(Node, left), offsetof(Node, right) };
+static const PxGcType NODE_TYPE = { sizeof(Node), 2, NODE_POINTERS };
+
+static const PxGcType BYTES_TYPE = { 1, 0, nullptr };
+
+static const size_t SLOT_POINTERS[] = { 0 };
+static const PxGcType SLOT_TYPE = { sizeof(void*), 1, SLOT_POINTERS };
+
+static Node *newNode(int64_t value, Node *left, Node *right)
+{
+    auto node = (Node*) pxGcAllocate(&NODE_TYPE);
+    node->value = value;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+static Node *makeTree(int depth)
+{
+    if (depth == 0)
+        return newNode(1, nullptr, nullptr);
+    // The left subtree must be rooted while the right one is allocated
+    Node *left = makeTree(depth - 1);
+    void **roots[] = { (void**) &left };
+    PxGcFrame frame = { nullptr, 1, roots };
+    pxGcPushFrame(&frame);
+    Node *right = makeTree(depth - 1);
+    Node *node = newNode(1, left, right);
+    pxGcPopFrame(&frame);
+    return node;
+}
+
+static int64_t sumTree(const Node *node)
+{
+    return node == nullptr ? 0 : node->value + sumTree(node->left) + sumTree(node->right);
+}
+
+TEST_CASE("Gc keeps rooted objects and frees the rest") {
+    Node *list = nullptr;
+    void **roots[] = { (void**) &list };
+    PxGcFrame frame = { nullptr, 1, roots };
+    pxGcPushFrame(&frame);
+
+    for (int64_t i = 0; i < 1000; ++i)
+    {
+        list = newNode(i, nullptr, list);
+        newNode(-i, nullptr, nullptr);
+    }
+    auto zeroed = (Node*) pxGcAllocate(&NODE_TYPE);
+    REQUIRE(zeroed->left == nullptr);
+    REQUIRE(zeroed->value == 0);
+
+    PxGcStats before = pxGcStats();
+    pxGcCollect();
+    PxGcStats after = pxGcStats();
+    REQUIRE(after.collections == before.collections + 1);
+    REQUIRE(after.liveBytes == 1000 * sizeof(Node));
+
+    // Garbage is freed as its blocks are swept, which a full allocation round forces
+    for (int i = 0; i < 100000; ++i)
+        newNode(0, nullptr, nullptr);
+    REQUIRE(pxGcStats().bytesFreed >= before.bytesFreed + 1001 * sizeof(Node));
+
+    int64_t expected = 999;
+    for (Node *node = list; node != nullptr; node = node->right, --expected)
+        REQUIRE(node->value == expected);
+    REQUIRE(expected == -1);
+    pxGcPopFrame(&frame);
+}
+
+TEST_CASE("Gc traces through nested frames and arrays") {
+    Node *tree = makeTree(12);
+    void **slots = nullptr;
+    void **roots[] = { (void**) &tree, (void**) &slots };
+    PxGcFrame frame = { nullptr, 2, roots };
+    pxGcPushFrame(&frame);
+
+    slots = (void**) pxGcAllocateArray(&SLOT_TYPE, 100);
+    for (int i = 0; i < 100; ++i)
+        slots[i] = i % 2 == 0 ? newNode(i, nullptr, nullptr) : nullptr;
+    pxGcCollect();
+    REQUIRE(sumTree(tree) == (1 << 13) - 1);
+    REQUIRE(pxGcStats().liveBytes == ((1 << 13) - 1 + 50) * sizeof(Node) + 100 * sizeof(void*));
+    for (int i = 0; i < 100; i += 2)
+        REQUIRE(((Node*) slots[i])->value == i);
+    pxGcPopFrame(&frame);
+}
+
+TEST_CASE("Gc reuses swept slots") {
+    pxGcCollect();
+    std::vector<void*> first;
+    for (int i = 0; i < 100; ++i)
+        first.push_back(pxGcAllocate(&NODE_TYPE));
+    pxGcCollect();
+    size_t heapBytes = pxGcStats().heapBytes;
+    for (int round = 0; round < 100; ++round)
+    {
+        for (int i = 0; i < 1000; ++i)
+            pxGcAllocate(&NODE_TYPE);
+        pxGcCollect();
+    }
+    REQUIRE(pxGcStats().heapBytes == heapBytes);
+}
+
+TEST_CASE("Gc large objects") {
+    auto kept = (int8_t*) pxGcAllocateArray(&BYTES_TYPE, 100000);
+    pxGcAddRoot((void**) &kept);
+    kept[99999] = 7;
+    REQUIRE(kept[0] == 0);
+    size_t heapBytes = pxGcStats().heapBytes;
+    pxGcAllocateArray(&BYTES_TYPE, 1000000);
+    REQUIRE(pxGcStats().heapBytes > heapBytes + 1000000);
+    pxGcCollect();
+    REQUIRE(pxGcStats().heapBytes == heapBytes);
+    REQUIRE(kept[99999] == 7);
+
+    pxGcRemoveRoot((void**) &kept);
+    pxGcCollect();
+    REQUIRE(pxGcStats().heapBytes < heapBytes);
+}
+
+TEST_CASE("Gc collects as allocation passes the threshold") {
+    pxGcConfigure(PxGcConfig{ 1024 * 1024, 2.0 });
+    PxGcStats stats;
+    int64_t keptSum = 0;
+    std::thread worker([&stats, &keptSum] {
+        Node *kept = makeTree(10);
+        void **roots[] = { (void**) &kept };
+        PxGcFrame frame = { nullptr, 1, roots };
+        pxGcPushFrame(&frame);
+        for (int i = 0; i < 1000; ++i)
+            makeTree(10);
+        stats = pxGcStats();
+        keptSum = sumTree(kept);
+        pxGcPopFrame(&frame);
+    });
+    worker.join();
+    pxGcConfigure(PxGcConfig{ 4 * 1024 * 1024, 2.0 });
+
+    REQUIRE(stats.collections > 10);
+    REQUIRE(stats.heapBytes < 8 * 1024 * 1024);
+    REQUIRE(stats.bytesAllocated == 1001 * ((1 << 11) - 1) * sizeof(Node));
+    REQUIRE(keptSum == (1 << 11) - 1);
+
+    uint64_t pauses = 0;
+    for (uint64_t count : stats.pauseHistogram)
+        pauses += count;
+    REQUIRE(pauses == stats.collections);
+    REQUIRE(stats.maxPauseNanoseconds <= stats.totalPauseNanoseconds);
+}
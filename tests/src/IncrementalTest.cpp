@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "catch.hpp"
+#include <IncrementalCompiler.h>
+#include <opt/Inliner.h>
+
+static void writeModule(const char *fileName, const std::string &source)
+{
+    std::ofstream out{ fileName, std::ios::trunc };
+    out << source;
+}
+
+static std::string readOutput(const char *fileName)
+{
+    std::ifstream in{ std::string{ fileName } + ".c" };
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static const char *COUNTER = "counter: int32 = 0;\n";
+static const char *HELPERS =
+    "func scale(x: int32) : int32 { total: int32 = 0; for i in 0..x { total += 2; } return total; }\n"
+    "func greet() : void { printString(\"hello\"); }\n"
+    "func twice(x: int32) : int32 { return scale(x) + scale(x); }\n"
+    "func main() : int32 { greet(); return twice(3); }\n";
+
+TEST_CASE("Incremental compile reuses unchanged functions") {
+    const char *fileName = "incremental.px";
+    std::remove("incremental.px.pxinc");
+    writeModule(fileName, std::string{ "module incremental;\n" } + COUNTER + HELPERS);
+    px::IncrementalOptions options{ false, px::Inliner::DEFAULT_THRESHOLD };
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.functionCount() == 4);
+        REQUIRE(compiler.compiledCount() == 4);
+    }
+    std::string first = readOutput(fileName);
+    REQUIRE(first.find("\"hello\"") != std::string::npos);
+
+    // Nothing changed, so nothing is generated again and the C is the same
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.compiledCount() == 0);
+    }
+    REQUIRE(readOutput(fileName) == first);
+
+    // A new body that leaves scale's facts as they were only compiles scale
+    std::string edited = HELPERS;
+    edited.replace(edited.find("total += 2"), 10, "total += 3");
+    writeModule(fileName, std::string{ "module incremental;\n" } + COUNTER + edited);
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.compiledCount() == 1);
+        REQUIRE(compiler.roundCount() == 1);
+    }
+    std::string second = readOutput(fileName);
+    REQUIRE(second.find("total+=3") != std::string::npos);
+    REQUIRE(second.find("\"hello\"") != std::string::npos);
+
+    // Writing a global changes what twice and main may do, so they follow in another round
+    edited.replace(edited.find("total += 3;"), 11, "total += 3; counter += 1;");
+    writeModule(fileName, std::string{ "module incremental;\n" } + COUNTER + edited);
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.compiledCount() == 3);
+        REQUIRE(compiler.roundCount() == 2);
+    }
+
+    // A change outside the functions compiles everything again
+    writeModule(fileName, std::string{ "module incremental;\ncounter: int32 = 1;\n" } + edited);
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.compiledCount() == 4);
+    }
+
+    // Callers of a function that is gone are analyzed again to report it
+    std::string removed = edited.substr(edited.find("func greet"));
+    writeModule(fileName, std::string{ "module incremental;\ncounter: int32 = 1;\n" } + removed);
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(!compiler.compile(errors));
+        // One error for each of the two calls twice makes
+        REQUIRE(errors.count() == 2);
+    }
+}
+
+TEST_CASE("Incremental compile follows inlined callees") {
+    const char *fileName = "incremental_inline.px";
+    std::remove("incremental_inline.px.pxinc");
+    std::string source =
+        "module incremental_inline;\n"
+        "func square(x: int32) : int32 { return x * 2; }\n"
+        "func area(x: int32) : int32 { total: int32 = 0; for i in 0..x { total += square(i); } return total; }\n"
+        "func unrelated(x: int32) : int32 { total: int32 = 1; for i in 0..x { total += i; } return total; }\n"
+        "func main() : int32 { return area(3) + unrelated(2); }\n";
+    writeModule(fileName, source);
+    px::IncrementalOptions options{ true, px::Inliner::DEFAULT_THRESHOLD };
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.compiledCount() == 4);
+    }
+
+    // square is inlined into area, so area is generated again with the new body
+    source.replace(source.find("x * 2"), 5, "x * 3");
+    writeModule(fileName, source);
+    {
+        px::IncrementalCompiler compiler{ fileName, options };
+        px::ErrorLog errors;
+        REQUIRE(compiler.compile(errors));
+        REQUIRE(compiler.compiledCount() == 2);
+    }
+    std::string output = readOutput(fileName);
+    REQUIRE(output.find("* 3") != std::string::npos);
+    REQUIRE(output.find("* 2") == std::string::npos);
+}
@@ -0,0 +1,167 @@
+#include <sstream>
+#include "catch.hpp"
+#include <Parser.h>
+#include <opt/Inliner.h>
+
+static std::unique_ptr<px::ast::Module> parseModule(px::Parser &parser, const char *source)
+{
+    px::Utf8String name{"myModule.px"};
+    std::stringstream input{ std::string{ source } };
+    return parser.parse(name, input);
+}
+
+TEST_CASE("Inliner expression function") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; func twice(x: int32) : int32 { return x * 2; }"
+                                      "func main() : int32 { y: int32 = twice(4); return y; }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 1);
+    REQUIRE(inliner.decisions()[0].inlined);
+    REQUIRE(inliner.decisions()[0].callee == "twice");
+    REQUIRE(inliner.decisions()[0].caller == "main");
+
+    auto main = (px::ast::FunctionDefinition*) module->statements[1].get();
+    auto declaration = (px::ast::VariableDeclaration*) main->block->statements[0].get();
+    REQUIRE(declaration->initialValue->nodeType == px::ast::NodeType::EXP_CAST);
+    auto returned = (px::ast::CastExpression*) declaration->initialValue.get();
+    REQUIRE(returned->newTypeName == "int32");
+    REQUIRE(returned->expression->nodeType == px::ast::NodeType::EXP_BINARY_OP);
+}
+
+TEST_CASE("Inliner void function renames locals") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; extern func printInt(i: int64) : void;"
+                                      "func show(x: int64) : void { y: int64 = x + 1; printInt(y); }"
+                                      "func main() : int32 { y: int64 = 2; show(y); return 0; }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 1);
+    REQUIRE(inliner.decisions()[0].inlined);
+
+    auto main = (px::ast::FunctionDefinition*) module->statements[2].get();
+    REQUIRE(main->block->statements[1]->nodeType == px::ast::NodeType::STMT_BLOCK);
+    auto block = (px::ast::BlockStatement*) main->block->statements[1].get();
+    REQUIRE(block->statements.size() == 3);
+    auto parameter = (px::ast::VariableDeclaration*) block->statements[0].get();
+    REQUIRE(parameter->name == "_inl1_x");
+    auto argument = (px::ast::VariableExpression*) parameter->initialValue.get();
+    REQUIRE(argument->variable == "y");
+    auto local = (px::ast::VariableDeclaration*) block->statements[1].get();
+    REQUIRE(local->name == "_inl1_y");
+}
+
+TEST_CASE("Inliner skips recursive functions") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; func f(x: int32) : int32 { return x > 0 ? f(x - 1) : 0; }"
+                                      "func main() : int32 { return f(3); }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    for (auto &decision : inliner.decisions())
+    {
+        REQUIRE(!decision.inlined);
+        REQUIRE(decision.reason == "recursive");
+    }
+    REQUIRE(inliner.decisions().size() == 2);
+}
+
+TEST_CASE("Inliner respects threshold") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; func f(x: int32) : int32 { return x * x + x * 3 - 7; }"
+                                      "func main() : int32 { return f(3); }");
+    px::Inliner inliner{ 2 };
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 1);
+    REQUIRE(!inliner.decisions()[0].inlined);
+}
+
+TEST_CASE("Inliner keeps side effects of arguments") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; extern func next() : int32;"
+                                      "func square(x: int32) : int32 { return x * x; }"
+                                      "func main() : int32 { return square(next()); }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 1);
+    REQUIRE(!inliner.decisions()[0].inlined);
+}
+
+TEST_CASE("Inliner keeps side effects of arguments before the body's calls") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; extern func g() : int32; extern func h() : int32;"
+                                      "func f(a: int32) : int32 { return g() + a; }"
+                                      "func main() : int32 { return f(h()); }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 1);
+    REQUIRE(!inliner.decisions()[0].inlined);
+    REQUIRE(inliner.decisions()[0].reason == "argument for 'a' has side effects and the body's calls could run before it");
+}
+
+TEST_CASE("Inliner keeps side effects of arguments used conditionally") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; extern func h() : int32;"
+                                      "func k(a: int32, b: bool) : int32 { return b ? a : 0; }"
+                                      "func both(a: bool, b: bool) : bool { return b && a; }"
+                                      "func main() : int32 { x: int32 = k(h(), false); y: bool = both(h() > 0, false); return x; }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 2);
+    REQUIRE(!inliner.decisions()[0].inlined);
+    REQUIRE(inliner.decisions()[0].reason == "argument for 'a' has side effects and would only be evaluated conditionally");
+    REQUIRE(!inliner.decisions()[1].inlined);
+
+    // An argument without calls may still be substituted there
+    auto pure = parseModule(parser, "module myModule; func k(a: int32, b: bool) : int32 { return b ? a : 0; }"
+                                    "func main() : int32 { x: int32 = 3; return k(x + 1, false); }");
+    px::Inliner pureInliner;
+    pureInliner.run(*pure);
+    REQUIRE(pureInliner.decisions().size() == 1);
+    REQUIRE(pureInliner.decisions()[0].inlined);
+}
+
+TEST_CASE("Inliner skips callees whose globals the caller shadows") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; extern func printInt(i: int64) : void; g: int64 = 5;"
+                                      "func f() : int64 { return g; }"
+                                      "func show(x: int64) : void { y: int64 = x + g; printInt(y); }"
+                                      "func main() : int32 { g: int64 = 1; printInt(f()); show(g); return 0; }"
+                                      "func other() : int32 { printInt(f()); show(2); return 0; }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 4);
+    REQUIRE(!inliner.decisions()[0].inlined);
+    REQUIRE(inliner.decisions()[0].reason == "'g' would refer to the caller's own variable");
+    REQUIRE(!inliner.decisions()[1].inlined);
+    REQUIRE(inliner.decisions()[1].reason == "'g' would refer to the caller's own variable");
+    REQUIRE(inliner.decisions()[2].inlined);
+    REQUIRE(inliner.decisions()[3].inlined);
+}
+
+TEST_CASE("Inliner skips dynamic array parameters") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; func first(values: int64[]) : int64 { return values[0]; }"
+                                      "func main() : int32 { values: int64[]; push(values, 1); return first(values) as int32; }");
+    px::Inliner inliner;
+    inliner.run(*module);
+    REQUIRE(inliner.decisions().size() == 1);
+    REQUIRE(!inliner.decisions()[0].inlined);
+    REQUIRE(inliner.decisions()[0].reason == "dynamic array parameter 'values' is passed by pointer");
+}
+
+TEST_CASE("Inliner cost") {
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parseModule(parser, "module myModule; func f(x: int32) : int32 { return x + 1; }");
+    auto function = (px::ast::FunctionDefinition*) module->statements[0].get();
+    REQUIRE(px::Inliner::cost(*function->block) == 4);
+}
@@ -0,0 +1,101 @@
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxMap.h>
+}
+
+PX_MAP_DEFINE(Int64, int64_t, int64_t, pxHashInteger, PX_MAP_EQUALS)
+PX_MAP_DEFINE(String, PxString, int32_t, pxStringHash, pxStringEquals)
+
+static PxString makeString(const std::string &text)
+{
+    return pxStringFromBytes((const int8_t*) text.data(), (intptr_t) text.size());
+}
+
+TEST_CASE("Map insert and find") {
+    PxMap map = pxMapCreate();
+    REQUIRE(!pxMapContains_Int64(&map, 1));
+    REQUIRE(pxMapGet_Int64(&map, 1) == 0);
+    for (int64_t i = 0; i < 10000; ++i)
+        *pxMapSlot_Int64(&map, i * 7) = i;
+    REQUIRE(map.length == 10000);
+    REQUIRE(map.capacity == pxMapCapacityFor(10000));
+    for (int64_t i = 0; i < 10000; ++i)
+    {
+        REQUIRE(pxMapGet_Int64(&map, i * 7) == i);
+        REQUIRE(!pxMapContains_Int64(&map, i * 7 + 1));
+    }
+    *pxMapSlot_Int64(&map, 7) += 5;
+    REQUIRE(pxMapGet_Int64(&map, 7) == 6);
+    REQUIRE(map.length == 10000);
+}
+
+TEST_CASE("Map remove reuses slots") {
+    PxMap map = pxMapCreate();
+    std::unordered_map<int64_t, int64_t> expected;
+    uint64_t seed = 1;
+    for (int i = 0; i < 200000; ++i)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        int64_t key = (int64_t) (seed >> 52);
+        if (seed & 0x100)
+        {
+            REQUIRE(pxMapRemove_Int64(&map, key) == (expected.erase(key) == 1));
+        }
+        else
+        {
+            *pxMapSlot_Int64(&map, key) = i;
+            expected[key] = i;
+        }
+    }
+    REQUIRE(map.length == (intptr_t) expected.size());
+    // Keys are drawn from 4096 values, so churn alone must not grow the table
+    REQUIRE(map.capacity <= 8192);
+    for (auto &entry : expected)
+        REQUIRE(pxMapGet_Int64(&map, entry.first) == entry.second);
+}
+
+TEST_CASE("Map with string keys") {
+    PxMap map = pxMapCreate();
+    for (int i = 0; i < 1000; ++i)
+        *pxMapSlot_String(&map, makeString("key number " + std::to_string(i))) = i;
+    REQUIRE(pxMapGet_String(&map, makeString("key number 999")) == 999);
+    REQUIRE(pxMapContains_String(&map, makeString("key number 0")));
+    REQUIRE(!pxMapContains_String(&map, makeString("key number 1000")));
+    REQUIRE(pxMapRemove_String(&map, makeString("key number 5")));
+    REQUIRE(!pxMapRemove_String(&map, makeString("key number 5")));
+    REQUIRE(map.length == 999);
+
+    PxVector keys = pxMapKeys_String(&map);
+    REQUIRE(keys.length == 999);
+    int64_t total = 0;
+    for (intptr_t i = 0; i < keys.length; ++i)
+        total += pxMapGet_String(&map, ((PxString*) keys.data)[i]);
+    REQUIRE(total == 999 * 1000 / 2 - 5);
+}
+
+TEST_CASE("Map copy, assign and reserve") {
+    PxMap map = pxMapCreate();
+    pxMapReserve_Int64(&map, 1000);
+    intptr_t capacity = map.capacity;
+    REQUIRE(capacity == pxMapCapacityFor(1000));
+    for (int64_t i = 0; i < 1000; ++i)
+        *pxMapSlot_Int64(&map, i) = -i;
+    REQUIRE(map.capacity == capacity);
+
+    PxMap copy = pxMapCopy(&map, sizeof(PxMapEntry_Int64));
+    *pxMapSlot_Int64(&copy, 3) = 42;
+    REQUIRE(pxMapGet_Int64(&map, 3) == -3);
+    REQUIRE(pxMapGet_Int64(&copy, 3) == 42);
+    REQUIRE(pxMapGet_Int64(&copy, 999) == -999);
+
+    pxMapAssign(&map, &copy, sizeof(PxMapEntry_Int64));
+    REQUIRE(pxMapGet_Int64(&map, 3) == 42);
+    PxMap empty = pxMapCreate();
+    pxMapAssign(&map, &empty, sizeof(PxMapEntry_Int64));
+    REQUIRE(map.length == 0);
+    REQUIRE(!pxMapContains_Int64(&map, 3));
+}
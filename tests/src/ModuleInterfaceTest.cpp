@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "catch.hpp"
+#include <ContextAnalyzer.h>
+#include <ModuleInterface.h>
+#include <Parser.h>
+
+// Analyzes source in scopeTree, which must outlive the functions it gives
+static std::unique_ptr<px::ast::Module> analyzeModule(px::ScopeTree &scopeTree, px::ContextAnalyzer &analyzer, px::ErrorLog &errors,
+                                                      const px::Utf8String &fileName, const char *source)
+{
+    px::Parser parser(&errors);
+    std::stringstream input{ std::string{ source } };
+    auto module = parser.parse(fileName, input);
+    analyzer.analyze(*module);
+    return module;
+}
+
+TEST_CASE("Module interface round trip") {
+    px::ScopeTree scopeTree;
+    px::ErrorLog errors;
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+    px::Utf8String name{ "mathlib.px" };
+    analyzeModule(scopeTree, analyzer, errors, name,
+                  "module mathlib; func square(x: int32) : int32 { return x * x; }"
+                  "func sum(values: int32[4], more: int64[]) : int64 { return values[0] as int64 + length(more); }"
+                  "private func hidden() : int32 { return 1; }"
+                  "func main() : int32 { return 0; }");
+    REQUIRE(errors.count() == 0);
+
+    auto exports = px::ModuleInterface::exports(*analyzer.moduleScope()->symbols());
+    REQUIRE(exports.size() == 2);
+    REQUIRE(px::ModuleInterface::write("mathlib.pxi", "mathlib", exports));
+
+    auto interface = px::ModuleInterface::open("mathlib.pxi");
+    REQUIRE(interface != nullptr);
+    REQUIRE(interface->moduleName() == px::Utf8String{ "mathlib" });
+    REQUIRE(interface->functionCount() == 2);
+    px::InterfaceFunction function;
+    REQUIRE(interface->findFunction("square", function));
+    REQUIRE(function.returnTypeName == px::Utf8String{ "int32" });
+    REQUIRE(function.parameters.size() == 1);
+    REQUIRE((function.attributes & px::Function::CONST) != 0);
+    REQUIRE(interface->findFunction("sum", function));
+    REQUIRE(function.parameters.size() == 2);
+    REQUIRE(function.parameters[0].typeName == px::Utf8String{ "int32" });
+    REQUIRE(function.parameters[0].arraySize == 4);
+    REQUIRE(function.parameters[1].typeName == px::Utf8String{ "int64[]" });
+    REQUIRE(function.parameters[1].arraySize == 0);
+    REQUIRE(!interface->findFunction("hidden", function));
+    REQUIRE(!interface->findFunction("main", function));
+    REQUIRE(!interface->findFunction("cube", function));
+
+    // Anything else is turned away
+    {
+        std::ofstream out{ "broken.pxi", std::ios::binary };
+        out << "module broken;";
+    }
+    REQUIRE(px::ModuleInterface::open("broken.pxi") == nullptr);
+    REQUIRE(px::ModuleInterface::open("missing.pxi") == nullptr);
+    std::remove("broken.pxi");
+}
+
+TEST_CASE("Module imports") {
+    {
+        px::ScopeTree scopeTree;
+        px::ErrorLog errors;
+        px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+        px::Utf8String name{ "mathlib.px" };
+        analyzeModule(scopeTree, analyzer, errors, name, "module mathlib; func square(x: int32) : int32 { return x * x; }");
+        REQUIRE(px::ModuleInterface::write("mathlib.pxi", "mathlib", px::ModuleInterface::exports(*analyzer.moduleScope()->symbols())));
+    }
+
+    px::ScopeTree scopeTree;
+    px::ErrorLog errors;
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+    px::Utf8String name{ "app.px" };
+    auto module = analyzeModule(scopeTree, analyzer, errors, name,
+                                "module app; import mathlib; func main() : int32 { return square(3) + square(4); }");
+    REQUIRE(errors.count() == 0);
+    REQUIRE(module->imports.size() == 1);
+    REQUIRE(module->importedFunctions.size() == 1);
+    px::Function *square = module->importedFunctions[0];
+    REQUIRE(square->module == px::Utf8String{ "mathlib" });
+    REQUIRE(square->hasAttribute(px::Function::CONST));
+    // A const import leaves its caller const
+    REQUIRE(analyzer.moduleScope()->symbols()->getFunction("main")->hasAttribute(px::Function::CONST));
+
+    px::ScopeTree otherTree;
+    px::ErrorLog otherErrors;
+    px::ContextAnalyzer otherAnalyzer{ otherTree.current(), &otherErrors };
+    px::Utf8String otherName{ "other.px" };
+    analyzeModule(otherTree, otherAnalyzer, otherErrors, otherName, "module other; import nothere; func main() : int32 { return 0; }");
+    REQUIRE(otherErrors.count() == 1);
+    std::remove("mathlib.pxi");
+}
+
+TEST_CASE("Interface cache") {
+    px::ScopeTree scopeTree;
+    px::ErrorLog errors;
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+    px::Utf8String name{ "cached.px" };
+    analyzeModule(scopeTree, analyzer, errors, name, "module cached; func square(x: int32) : int32 { return x * x; }");
+    auto exports = px::ModuleInterface::exports(*analyzer.moduleScope()->symbols());
+    REQUIRE(px::ModuleInterface::write("cached.pxi", "cached", exports));
+
+    px::InterfaceCache cache;
+    auto first = cache.open("cached.pxi");
+    REQUIRE(first != nullptr);
+    REQUIRE(first->functionCount() == 1);
+
+    // Writing the file again does not change the interface already read
+    REQUIRE(px::ModuleInterface::write("cached.pxi", "cached", std::vector<px::Function*>{}));
+    REQUIRE(first->functionCount() == 1);
+    px::InterfaceFunction function;
+    REQUIRE(first->findFunction("square", function));
+    auto second = cache.open("cached.pxi");
+    REQUIRE(second != nullptr);
+    REQUIRE(second->functionCount() == 0);
+
+    std::remove("cached.pxi");
+    REQUIRE(cache.open("cached.pxi") == nullptr);
+}
@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+
+// What write puts on standard output, which is sent to a file while it runs. Nothing is flushed
+// for it at the end, so output still in a buffer is left out.
+static std::string captureOutput(const std::function<void()> &write)
+{
+    fflush(stdout);
+    FILE *file = tmpfile();
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(file), STDOUT_FILENO);
+    write();
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    std::string text;
+    char chunk[4096];
+    fseek(file, 0, SEEK_SET);
+    for (size_t read; (read = fread(chunk, 1, sizeof(chunk), file)) != 0;)
+        text.append(chunk, read);
+    fclose(file);
+    return text;
+}
+
+static PxString makeString(const std::string &text)
+{
+    return pxStringFromBytes((const int8_t*) text.data(), (intptr_t) text.size());
+}
+
+TEST_CASE("Output waits in the buffer until pxFlush") {
+    pxFlush();
+    std::string text = captureOutput([] {
+        printInt(1);
+        printString(makeString(" and "));
+        printInt64(-9000000000);
+        fflush(stdout);
+    });
+    REQUIRE(text.empty());
+    REQUIRE(captureOutput([] { pxFlush(); }) == "1 and -9000000000");
+}
+
+TEST_CASE("Output keeps its order with writes to stdout after pxFlush") {
+    std::string text = captureOutput([] {
+        printInt(1);
+        pxFlush();
+        fputs(" two ", stdout);
+        fflush(stdout);
+        printUInt64(3);
+        pxFlush();
+    });
+    REQUIRE(text == "1 two 3");
+}
+
+TEST_CASE("Large output is written past the buffer") {
+    std::string large(48 * 1024, 'x');
+    std::string text = captureOutput([&large] {
+        printInt(7);
+        printString(makeString(large));
+        fflush(stdout);
+    });
+    REQUIRE(text == "7" + large);
+}
+
+TEST_CASE("Output of a thread is flushed when it exits") {
+    std::string text = captureOutput([] {
+        std::thread writer{ [] { printInt(42); } };
+        writer.join();
+        fflush(stdout);
+    });
+    REQUIRE(text == "42");
+}
+
+TEST_CASE("Output is flushed when the program exits") {
+    std::string text = captureOutput([] {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0)
+        {
+            printString(makeString("before exit"));
+            exit(0);
+        }
+        int status;
+        waitpid(child, &status, 0);
+    });
+    REQUIRE(text == "before exit");
+}
+#endif
@@ -5,7 +5,7 @@
 
 TEST_CASE("Parser function declare") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"func blah() : int32;"};
+    px::Utf8String source{"module myModule; func blah() : int32;"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -20,7 +20,7 @@ TEST_CASE("Parser function declare") {
 
 TEST_CASE("Parser function declare extern") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"extern func blah() : int32;"};
+    px::Utf8String source{"module myModule; extern func blah() : int32;"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -35,7 +35,7 @@ TEST_CASE("Parser function declare extern") {
 
 TEST_CASE("Parser function definition empty") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"func blah() : void { }"};
+    px::Utf8String source{"module myModule; func blah() : void { }"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -47,9 +47,40 @@ TEST_CASE("Parser function definition empty") {
     REQUIRE(firstStatement->prototype->returnTypeName == "void");
 }
 
+TEST_CASE("Parser function visibility") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; private func a() : void { } protected func b() : void { } public func c() : void { } func d() : void { }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    REQUIRE(((px::ast::FunctionDefinition*) module->statements[0].get())->prototype->visibility == px::Visibility::PRIVATE);
+    REQUIRE(((px::ast::FunctionDefinition*) module->statements[1].get())->prototype->visibility == px::Visibility::PROTECTED);
+    REQUIRE(((px::ast::FunctionDefinition*) module->statements[2].get())->prototype->visibility == px::Visibility::PUBLIC);
+    REQUIRE(((px::ast::FunctionDefinition*) module->statements[3].get())->prototype->visibility == px::Visibility::PUBLIC);
+}
+
+TEST_CASE("Parser function array parameter") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; func sum(values: int64[8], count: int32) : int64;"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto firstStatement = (px::ast::FunctionDeclaration*) module->statements[0].get();
+    auto &parameters = firstStatement->prototype->parameters;
+    REQUIRE(parameters.size() == 2);
+    REQUIRE(parameters[0].typeName == "int64");
+    REQUIRE(parameters[0].arraySize != nullptr);
+    REQUIRE(*parameters[0].arraySize == 8);
+    REQUIRE(parameters[1].arraySize == nullptr);
+}
+
 TEST_CASE("Parser declare var") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"myVar: int64 = 10;"};
+    px::Utf8String source{"module myModule; myVar: int64 = 10;"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -64,7 +95,7 @@ TEST_CASE("Parser declare var") {
 
 TEST_CASE("Parser var assign") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"x = 127.5;"};
+    px::Utf8String source{"module myModule; x = 127.5;"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -78,7 +109,7 @@ TEST_CASE("Parser var assign") {
 
 TEST_CASE("Parser return void") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"return;"};
+    px::Utf8String source{"module myModule; return;"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -91,7 +122,7 @@ TEST_CASE("Parser return void") {
 
 TEST_CASE("Parser return") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"return \"Testing\";"};
+    px::Utf8String source{"module myModule; return \"Testing\";"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -104,7 +135,7 @@ TEST_CASE("Parser return") {
 }
 TEST_CASE("Parser block empty") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"{ }"};
+    px::Utf8String source{"module myModule; { }"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -117,7 +148,7 @@ TEST_CASE("Parser block empty") {
 
 TEST_CASE("Parser block") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{"{ x: char = 'A'; print(x); }"};
+    px::Utf8String source{"module myModule; { x: char = 'A'; print(x); }"};
     std::string sourceString = source.toString();
     std::stringstream input{sourceString};
     px::ErrorLog errors;
@@ -130,7 +161,7 @@ TEST_CASE("Parser block") {
 
 TEST_CASE("Parser if") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{" if (y > 0) { x: char = 'A'; print(x); }"};
+    px::Utf8String source{"module myModule;  if (y > 0) { x: char = 'A'; print(x); }"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -145,7 +176,7 @@ TEST_CASE("Parser if") {
 
 TEST_CASE("Parser if else") {
     px::Utf8String name{"myModule.px"};
-    px::Utf8String source{" if (y > 0) { x: char = 'A'; print(x); } else -x;"};
+    px::Utf8String source{"module myModule;  if (y > 0) { x: char = 'A'; print(x); } else -x;"};
     std::string sourceString = source.toString();
     std::stringstream input{ sourceString };
     px::ErrorLog errors;
@@ -157,3 +188,196 @@ TEST_CASE("Parser if else") {
     REQUIRE(firstStatement->trueStatement->nodeType == px::ast::NodeType::STMT_BLOCK);
     REQUIRE(firstStatement->elseStatement->nodeType == px::ast::NodeType::STMT_EXP);
 }
+
+TEST_CASE("Parser for") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; for i in 0..n { a[i] = 0; } for j: int64 in 10..20 x += j;"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto firstStatement = (px::ast::ForStatement*) module->statements[0].get();
+    REQUIRE(firstStatement->nodeType == px::ast::NodeType::STMT_FOR);
+    REQUIRE(firstStatement->variableName == "i");
+    REQUIRE(firstStatement->typeName.length() == 0);
+    REQUIRE(firstStatement->start->nodeType == px::ast::NodeType::LITERAL_INT);
+    REQUIRE(firstStatement->end->nodeType == px::ast::NodeType::EXP_VAR_LOAD);
+    REQUIRE(firstStatement->body->nodeType == px::ast::NodeType::STMT_BLOCK);
+    auto secondStatement = (px::ast::ForStatement*) module->statements[1].get();
+    REQUIRE(secondStatement->variableName == "j");
+    REQUIRE(secondStatement->typeName == "int64");
+    REQUIRE(secondStatement->body->nodeType == px::ast::NodeType::STMT_ASSIGN);
+}
+
+TEST_CASE("Parser region") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; region { s: string = a + b; printString(s); }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto firstStatement = (px::ast::RegionStatement*) module->statements[0].get();
+    REQUIRE(firstStatement->nodeType == px::ast::NodeType::STMT_REGION);
+    REQUIRE(firstStatement->body->statements.size() == 2);
+    REQUIRE(firstStatement->body->statements[0]->nodeType == px::ast::NodeType::DECLARE_VAR);
+}
+
+TEST_CASE("Parser parallel for") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; parallel for i in 0..n { a[i] = i; } for j in 0..n { }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto parallel = (px::ast::ForStatement*) module->statements[0].get();
+    REQUIRE(parallel->nodeType == px::ast::NodeType::STMT_FOR);
+    REQUIRE(parallel->parallel);
+    REQUIRE(parallel->variableName == "i");
+    auto sequential = (px::ast::ForStatement*) module->statements[1].get();
+    REQUIRE(!sequential->parallel);
+}
+
+TEST_CASE("Parser spawn and await") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; func f(n: int64) : int64 { left: future[int64] = spawn f(n - 1); return await left + 1; }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto function = (px::ast::FunctionDefinition*) module->statements[0].get();
+    auto declaration = (px::ast::VariableDeclaration*) function->block->statements[0].get();
+    REQUIRE(declaration->typeName == "future[int64]");
+    REQUIRE(declaration->initialValue->nodeType == px::ast::NodeType::EXP_SPAWN);
+    auto spawn = (px::ast::SpawnExpression*) declaration->initialValue.get();
+    REQUIRE(spawn->call->functionName == "f");
+    auto result = (px::ast::ReturnStatement*) function->block->statements[1].get();
+    auto sum = (px::ast::BinaryOpExpression*) result->returnValue.get();
+    REQUIRE(sum->nodeType == px::ast::NodeType::EXP_BINARY_OP);
+    REQUIRE(sum->left->nodeType == px::ast::NodeType::EXP_AWAIT);
+}
+
+TEST_CASE("Parser spawn needs a call") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; func f() : void { x: future[int64] = spawn 1; }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    REQUIRE_THROWS(parser.parse(name, input));
+}
+
+TEST_CASE("Parser dynamic array") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; func evens(values: int64[]) : int64[] { result: int64[]; return result; }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto function = (px::ast::FunctionDefinition*) module->statements[0].get();
+    REQUIRE(function->prototype->returnTypeName == "int64[]");
+    REQUIRE(function->prototype->parameters[0].typeName == "int64[]");
+    REQUIRE(function->prototype->parameters[0].arraySize == nullptr);
+    auto declaration = (px::ast::VariableDeclaration*) function->block->statements[0].get();
+    REQUIRE(declaration->typeName == "int64[]");
+    REQUIRE(declaration->arraySize == nullptr);
+}
+
+TEST_CASE("Parser map") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; func count(words: map[string, int64]) : map[char, int32] { counts[words[w]] += 1; }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto function = (px::ast::FunctionDefinition*) module->statements[0].get();
+    REQUIRE(function->prototype->parameters[0].typeName == "map[string, int64]");
+    REQUIRE(function->prototype->returnTypeName == "map[char, int32]");
+    REQUIRE(function->block->statements[0]->nodeType == px::ast::NodeType::STMT_ARRAY_INDEX_ASSIGN);
+}
+
+TEST_CASE("Parser switch") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; switch (x) { case 1, 2: y = 1; case 3: default: y = 2; break; }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    auto module = parser.parse(name, input);
+    auto firstStatement = (px::ast::SwitchStatement*) module->statements[0].get();
+    REQUIRE(firstStatement->nodeType == px::ast::NodeType::STMT_SWITCH);
+    REQUIRE(firstStatement->scrutinee->nodeType == px::ast::NodeType::EXP_VAR_LOAD);
+    REQUIRE(firstStatement->cases.size() == 2);
+    REQUIRE(firstStatement->cases[0].values.size() == 2);
+    REQUIRE(firstStatement->cases[0].body->statements.size() == 1);
+    REQUIRE(firstStatement->cases[1].values.size() == 1);
+    REQUIRE(firstStatement->cases[1].body->statements.empty());
+    REQUIRE(firstStatement->defaultBody != nullptr);
+    REQUIRE(firstStatement->defaultBody->statements.size() == 2);
+    REQUIRE(firstStatement->defaultBody->statements[1]->nodeType == px::ast::NodeType::STMT_BREAK);
+}
+
+TEST_CASE("Parser switch two defaults") {
+    px::Utf8String name{"myModule.px"};
+    px::Utf8String source{"module myModule; switch (x) { default: y = 1; default: y = 2; }"};
+    std::string sourceString = source.toString();
+    std::stringstream input{ sourceString };
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    REQUIRE_THROWS(parser.parse(name, input));
+}
+
+TEST_CASE("Parser pipelined") {
+    px::Utf8String name{"myModule.px"};
+    std::string text = "module myModule;\n";
+    for (int i = 0; i < 3000; ++i)
+        text += "func f" + std::to_string(i) + "(x: int32) : int32 { values: int32[]; push(values, x); values[values[0]] += x; y: int32 = x; y = y + 1; return y; }\n";
+    px::Utf8String source{ text };
+    px::ErrorLog errors;
+    px::Parser serial(&errors);
+    serial.pipelineFrom(SIZE_MAX);
+    REQUIRE(!serial.pipelines(source));
+    auto expected = serial.parse(name, source);
+    px::Parser pipelined(&errors);
+    pipelined.pipelineFrom(0);
+    REQUIRE(pipelined.pipelines(source));
+    auto module = pipelined.parse(name, source);
+    REQUIRE(module->statements.size() == expected->statements.size());
+    for (size_t i = 0; i < module->statements.size(); ++i) {
+        auto function = (px::ast::FunctionDefinition*) module->statements[i].get();
+        auto expectedFunction = (px::ast::FunctionDefinition*) expected->statements[i].get();
+        REQUIRE(function->position == expectedFunction->position);
+        REQUIRE(function->prototype->name == expectedFunction->prototype->name);
+        REQUIRE(function->block->statements.size() == 6);
+    }
+
+    // Skipping bodies goes back to the start of the ones it parses after all
+    px::Parser skipping(&errors);
+    skipping.pipelineFrom(0);
+    skipping.skipBodies([](const px::ast::FunctionPrototype &prototype, size_t start, size_t end) {
+        return prototype.name != "f1500";
+    });
+    auto skipped = skipping.parse(name, source);
+    REQUIRE(skipped->statements.size() == 3000);
+    REQUIRE(((px::ast::FunctionDefinition*) skipped->statements[1499].get())->block->statements.empty());
+    REQUIRE(((px::ast::FunctionDefinition*) skipped->statements[1500].get())->block->statements.size() == 6);
+}
+
+TEST_CASE("Parser pipelined error") {
+    px::Utf8String name{"myModule.px"};
+    std::string text = "module myModule;\n";
+    for (int i = 0; i < 3000; ++i)
+        text += "func f" + std::to_string(i) + "() : int32 { return 1; }\n";
+    text += "func broken() : int32 { return 1 }\n";
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    parser.pipelineFrom(0);
+    REQUIRE_THROWS_AS(parser.parse(name, px::Utf8String{ text }), px::Error);
+    REQUIRE(errors.all().size() == 1);
+    REQUIRE(errors.all()[0].position.line == 3002);
+}
@@ -0,0 +1,126 @@
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+TEST_CASE("Region allocations are aligned and distinct") {
+    PxRegion *region = pxRegionCreate();
+    auto a = (char*) pxRegionAllocate(region, 3, 1);
+    auto b = (char*) pxRegionAllocate(region, 8, 8);
+    auto c = (char*) pxRegionAllocate(region, 100, 64);
+    REQUIRE((uintptr_t) b % 8 == 0);
+    REQUIRE((uintptr_t) c % 64 == 0);
+    REQUIRE(b >= a + 3);
+    REQUIRE(c >= b + 8);
+    memset(a, 1, 3);
+    memset(b, 2, 8);
+    memset(c, 3, 100);
+    REQUIRE(a[2] == 1);
+    REQUIRE(b[7] == 2);
+    pxRegionRelease(region);
+}
+
+TEST_CASE("Region spans many chunks and large allocations") {
+    PxRegion *region = pxRegionCreate();
+    std::vector<int64_t*> blocks;
+    for (int i = 0; i < 100000; ++i)
+    {
+        auto block = (int64_t*) pxRegionAllocate(region, 64, 8);
+        block[0] = i;
+        block[7] = -i;
+        blocks.push_back(block);
+    }
+    auto large = (char*) pxRegionAllocate(region, 8 * 1024 * 1024, 16);
+    memset(large, 7, 8 * 1024 * 1024);
+    for (int i = 0; i < 100000; ++i)
+    {
+        REQUIRE(blocks[i][0] == i);
+        REQUIRE(blocks[i][7] == -i);
+    }
+    REQUIRE(large[8 * 1024 * 1024 - 1] == 7);
+    pxRegionRelease(region);
+}
+
+TEST_CASE("Region scopes nest") {
+    PxRegion *outer = pxCurrentRegion();
+    pxRegionEnter();
+    PxRegion *first = pxCurrentRegion();
+    REQUIRE(first != outer);
+    auto value = (int32_t*) pxNew(sizeof(int32_t) * 4);
+    REQUIRE(value[0] == 0);
+    REQUIRE(value[3] == 0);
+
+    pxRegionEnter();
+    REQUIRE(pxCurrentRegion() != first);
+    pxNew(1000);
+    pxRegionExit();
+
+    REQUIRE(pxCurrentRegion() == first);
+    pxRegionExit();
+    REQUIRE(pxCurrentRegion() == outer);
+}
+
+TEST_CASE("Region scopes hold strings") {
+    PxString outer = pxStringFromBytes((const int8_t*) "a string from the default region", 33);
+    pxRegionEnter();
+    PxString inner = pxStringConcat(outer, pxStringFromBytes((const int8_t*) ", extended", 10));
+    REQUIRE(inner.byteLength == 43);
+    REQUIRE(inner.data.bytes != outer.data.bytes);
+
+    PxStringBuilder *builder = newStringBuilder();
+    appendString(builder, inner);
+    PxString built = finishStringBuilder(builder);
+    REQUIRE(pxStringEquals(built, inner));
+    pxRegionExit();
+
+    REQUIRE(memcmp(pxStringBytes(&outer), "a string from the default region", 33) == 0);
+}
+
+TEST_CASE("Region builders grow in their own region") {
+    PxStringBuilder *builder = newStringBuilder();
+    pxRegionEnter();
+    for (int i = 0; i < 1000; ++i)
+        appendInt(builder, i);
+    pxRegionExit();
+    PxString result = finishStringBuilder(builder);
+    REQUIRE(result.byteLength == 2890);
+}
+
+TEST_CASE("Region huge pages") {
+    pxRegionUseHugePages(true);
+    PxRegion *region = pxRegionCreate();
+    auto bytes = (char*) pxRegionAllocate(region, 1024, 1);
+    memset(bytes, 1, 1024);
+    REQUIRE(bytes[1023] == 1);
+    pxRegionRelease(region);
+    pxRegionUseHugePages(false);
+}
+
+TEST_CASE("Region per thread") {
+    std::vector<std::thread> threads;
+    std::vector<int64_t> sums(4);
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([t, &sums] {
+            pxRegionEnter();
+            std::vector<int64_t*> values;
+            for (int i = 0; i < 10000; ++i)
+            {
+                auto value = (int64_t*) pxNew(sizeof(int64_t));
+                *value = i * (t + 1);
+                values.push_back(value);
+            }
+            for (int64_t *value : values)
+                sums[t] += *value;
+            pxRegionExit();
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    for (int t = 0; t < 4; ++t)
+        REQUIRE(sums[t] == (int64_t) 49995000 * (t + 1));
+}
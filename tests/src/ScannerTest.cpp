@@ -155,6 +155,13 @@ TEST_CASE("Scanner keyword abstract") {
     REQUIRE(token.type == px::TokenType::KW_ABSTRACT);
 }
 
+TEST_CASE("Scanner keyword await") {
+    px::Utf8String name{"myModule.px"};
+    px::Scanner scanner(name, "await");
+    auto token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::KW_AWAIT);
+}
+
 TEST_CASE("Scanner keyword break") {
     px::Utf8String name{"myModule.px"};
     px::Scanner scanner(name, "break");
@@ -260,6 +267,13 @@ TEST_CASE("Scanner keyword new") {
     REQUIRE(token.type == px::TokenType::KW_NEW);
 }
 
+TEST_CASE("Scanner keyword parallel") {
+    px::Utf8String name{"myModule.px"};
+    px::Scanner scanner(name, "parallel");
+    auto token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::KW_PARALLEL);
+}
+
 TEST_CASE("Scanner keyword private") {
     px::Utf8String name{"myModule.px"};
     px::Scanner scanner(name, "private");
@@ -288,6 +302,13 @@ TEST_CASE("Scanner keyword ref") {
     REQUIRE(token.type == px::TokenType::KW_REF);
 }
 
+TEST_CASE("Scanner keyword region") {
+    px::Utf8String name{"myModule.px"};
+    px::Scanner scanner(name, "region");
+    auto token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::KW_REGION);
+}
+
 TEST_CASE("Scanner keyword return") {
     px::Utf8String name{"myModule.px"};
     px::Scanner scanner(name, "return");
@@ -295,6 +316,13 @@ TEST_CASE("Scanner keyword return") {
     REQUIRE(token.type == px::TokenType::KW_RETURN);
 }
 
+TEST_CASE("Scanner keyword spawn") {
+    px::Utf8String name{"myModule.px"};
+    px::Scanner scanner(name, "spawn");
+    auto token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::KW_SPAWN);
+}
+
 TEST_CASE("Scanner keyword state") {
     px::Utf8String name{"myModule.px"};
     px::Scanner scanner(name, "state");
@@ -470,6 +498,20 @@ TEST_CASE("Scanner operator dot") {
     REQUIRE(token.type == px::TokenType::OP_DOT);
 }
 
+TEST_CASE("Scanner operator range") {
+    px::Utf8String name{"myModule.px"};
+    px::Scanner scanner(name, "0..n");
+    auto token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::INTEGER);
+    REQUIRE(token.str == "0");
+    scanner.accept();
+    token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::OP_RANGE);
+    scanner.accept();
+    token = scanner.nextToken();
+    REQUIRE(token.type == px::TokenType::IDENTIFIER);
+}
+
 TEST_CASE("Scanner operator end statement") {
     px::Utf8String name{"myModule.px"};
     px::Scanner scanner(name, ";");
@@ -636,3 +678,67 @@ TEST_CASE("Scanner subtract unicode") {
     auto token = scanner.nextToken();
     REQUIRE(token.type == px::TokenType::OP_SUB);
 }
+
+TEST_CASE("Scanner pipelined gives the tokens of a serial one") {
+    px::Utf8String name{"myModule.px"};
+    // Longer than the ring, so it wraps around, and with every kind of token
+    std::string text = "module big;\n";
+    for (int i = 0; i < 2000; ++i)
+        text += "func f" + std::to_string(i) + "(x: int64) : int64 { y: float64 = 1.5 * x; s: string = \"a\\tb\"; c: char = 'z'; return x << 0x1F + 16_i64 ≠ −3; }\n";
+    px::Utf8String source{ text };
+    px::Scanner serial(name, source);
+    px::Scanner pipelined(name, source, true);
+    size_t count = 0;
+    while (true) {
+        // Looks one token further ahead and goes back each time, as the parser does
+        px::Token expected = serial.nextToken();
+        px::Token token = pipelined.nextToken();
+        REQUIRE(token.type == expected.type);
+        REQUIRE(token.str == expected.str);
+        REQUIRE(token.suffixType == expected.suffixType);
+        REQUIRE(token.integerBase == expected.integerBase);
+        REQUIRE(token.position == expected.position);
+        REQUIRE(pipelined.nextToken().position == serial.nextToken().position);
+        serial.rewind();
+        pipelined.rewind();
+        REQUIRE(pipelined.position() == serial.position());
+        REQUIRE(pipelined.nextToken().type == serial.nextToken().type);
+        if (expected.type == px::TokenType::END_FILE)
+            break;
+        serial.accept();
+        pipelined.accept();
+        ++count;
+    }
+    REQUIRE(count > 80000);
+    // The end of the file stays where it is
+    REQUIRE(pipelined.nextToken().type == px::TokenType::END_FILE);
+}
+
+TEST_CASE("Scanner pipelined restore") {
+    px::Utf8String name{"myModule.px"};
+    std::string text;
+    for (int i = 0; i < 10000; ++i)
+        text += "a" + std::to_string(i) + " ";
+    px::Scanner scanner(name, text, true);
+    scanner.nextToken();
+    px::Scanner::State start = scanner.save();
+    for (int i = 0; i < 9000; ++i) {
+        scanner.accept();
+        scanner.nextToken();
+    }
+    REQUIRE(scanner.nextToken().str == "a9001");
+    scanner.restore(start);
+    scanner.rewind();
+    REQUIRE(scanner.nextToken().str == "a0");
+    REQUIRE(scanner.nextToken().str == "a1");
+}
+
+TEST_CASE("Scanner pipelined exception") {
+    px::Utf8String name{"myModule.px"};
+    px::Scanner scanner(name, "a b '\\uzzzz'", true);
+    REQUIRE(scanner.nextToken().str == "a");
+    scanner.accept();
+    REQUIRE(scanner.nextToken().str == "b");
+    scanner.accept();
+    REQUIRE_THROWS(scanner.nextToken());
+}
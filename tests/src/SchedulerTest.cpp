@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+static void countIterations(void *environment, int64_t start, int64_t end)
+{
+    auto counts = (std::atomic<int32_t>*) environment;
+    for (int64_t i = start; i < end; ++i)
+        counts[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST_CASE("Parallel for runs every iteration once") {
+    pxSchedulerConfigure(PxSchedulerConfig{ 4, 0 });
+    REQUIRE(pxSchedulerWorkers() == 4);
+
+    const int64_t count = 100000;
+    std::vector<std::atomic<int32_t>> counts(count);
+    pxParallelFor(0, count, countIterations, counts.data());
+    int64_t wrong = 0;
+    for (auto &c : counts)
+        wrong += c.load() != 1;
+    REQUIRE(wrong == 0);
+
+    // Ranges need not start at zero
+    pxParallelFor(count / 2, count, countIterations, counts.data());
+    REQUIRE(counts[count / 2 - 1].load() == 1);
+    REQUIRE(counts[count / 2].load() == 2);
+    REQUIRE(counts[count - 1].load() == 2);
+}
+
+struct Ranges
+{
+    std::mutex lock;
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+};
+
+static void recordRange(void *environment, int64_t start, int64_t end)
+{
+    auto ranges = (Ranges*) environment;
+    std::lock_guard<std::mutex> guard(ranges->lock);
+    ranges->ranges.emplace_back(start, end);
+}
+
+TEST_CASE("Parallel for chunks") {
+    Ranges empty;
+    pxParallelFor(5, 5, recordRange, &empty);
+    pxParallelFor(5, 2, recordRange, &empty);
+    REQUIRE(empty.ranges.empty());
+
+    // Ranges no longer than the minimum chunk are run by the caller in one call
+    pxSchedulerConfigure(PxSchedulerConfig{ 4, 1000 });
+    Ranges whole;
+    pxParallelFor(0, 1000, recordRange, &whole);
+    REQUIRE(whole.ranges.size() == 1);
+    REQUIRE(whole.ranges[0] == std::make_pair<int64_t, int64_t>(0, 1000));
+
+    // Longer ones are cut into consecutive pieces of at least the minimum
+    Ranges split;
+    pxParallelFor(0, 10000, recordRange, &split);
+    std::sort(split.ranges.begin(), split.ranges.end());
+    int64_t next = 0;
+    for (auto &range : split.ranges)
+    {
+        REQUIRE(range.first == next);
+        REQUIRE(range.second > range.first);
+        next = range.second;
+    }
+    REQUIRE(next == 10000);
+    pxSchedulerConfigure(PxSchedulerConfig{ 4, 0 });
+}
+
+struct Threads
+{
+    std::mutex lock;
+    std::set<std::thread::id> ids;
+};
+
+static void sleepAndRecordThread(void *environment, int64_t start, int64_t end)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * (end - start)));
+    auto threads = (Threads*) environment;
+    std::lock_guard<std::mutex> guard(threads->lock);
+    threads->ids.insert(std::this_thread::get_id());
+}
+
+TEST_CASE("Parallel for spreads slow iterations over workers") {
+    Threads threads;
+    pxParallelFor(0, 64, sleepAndRecordThread, &threads);
+    REQUIRE(threads.ids.size() > 1);
+    REQUIRE(threads.ids.count(std::this_thread::get_id()) == 0);
+}
+
+static void sumRow(void *environment, int64_t start, int64_t end)
+{
+    auto sums = (std::atomic<int64_t>*) environment;
+    for (int64_t i = start; i < end; ++i)
+        sums[i / 1000].fetch_add(i % 1000, std::memory_order_relaxed);
+}
+
+static void sumRows(void *environment, int64_t start, int64_t end)
+{
+    auto sums = (std::atomic<int64_t>*) environment;
+    // A loop started from a worker runs there and on whichever workers steal from it
+    for (int64_t row = start; row < end; ++row)
+        pxParallelFor(row * 1000, (row + 1) * 1000, sumRow, sums);
+}
+
+TEST_CASE("Parallel for nests") {
+    std::vector<std::atomic<int64_t>> sums(64);
+    pxParallelFor(0, 64, sumRows, sums.data());
+    int64_t wrong = 0;
+    for (auto &sum : sums)
+        wrong += sum.load() != 999 * 1000 / 2;
+    REQUIRE(wrong == 0);
+}
+
+struct FibTask
+{
+    PxTask task;
+    int64_t n;
+    int64_t result;
+};
+
+static void runFib(PxTask *task)
+{
+    auto fib = (FibTask*) task;
+    if (fib->n < 2)
+    {
+        fib->result = fib->n;
+        return;
+    }
+    // Awaiting from a worker runs other tasks, including the one awaited, until it is done
+    FibTask left{ {}, fib->n - 1, 0 };
+    pxSpawn(&left.task, runFib);
+    FibTask right{ {}, fib->n - 2, 0 };
+    runFib(&right.task);
+    pxAwait(&left.task);
+    fib->result = left.result + right.result;
+}
+
+TEST_CASE("Spawned tasks nest") {
+    FibTask fib{ {}, 20, 0 };
+    pxSpawn(&fib.task, runFib);
+    pxAwait(&fib.task);
+    REQUIRE(fib.result == 6765);
+
+    // Awaiting a task that has finished returns straight away
+    pxAwait(&fib.task);
+    REQUIRE(fib.result == 6765);
+}
+
+struct SlowTask
+{
+    PxTask task;
+    std::thread::id thread;
+};
+
+static void runSlow(PxTask *task)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ((SlowTask*) task)->thread = std::this_thread::get_id();
+}
+
+TEST_CASE("Spawned tasks run on workers") {
+    SlowTask slow{ {}, {} };
+    pxSpawn(&slow.task, runSlow);
+    // A thread outside the pool sleeps until the task is done instead of running it
+    pxAwait(&slow.task);
+    REQUIRE(slow.thread != std::thread::id{});
+    REQUIRE(slow.thread != std::this_thread::get_id());
+}
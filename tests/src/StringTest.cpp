@@ -0,0 +1,228 @@
+#include <cstring>
+#include <string>
+#include <thread>
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+static PxString make(const char *text)
+{
+    return pxStringFromBytes((const int8_t*) text, (intptr_t) strlen(text));
+}
+
+static std::string toStd(const PxString &str)
+{
+    return std::string((const char*) pxStringBytes(&str), (size_t) str.byteLength);
+}
+
+TEST_CASE("String small strings are inline") {
+    PxString empty = make("");
+    REQUIRE(empty.length == 0);
+    REQUIRE(pxStringBytes(&empty)[0] == 0);
+
+    PxString shortString = make("fifteen bytes!!");
+    REQUIRE(shortString.byteLength == PX_STRING_INLINE_CAPACITY);
+    REQUIRE(pxStringBytes(&shortString) == shortString.data.inlineBytes);
+    REQUIRE(shortString.data.inlineBytes[PX_STRING_INLINE_CAPACITY] == 0);
+
+    PxString longString = make("sixteen bytes!!!");
+    REQUIRE(longString.byteLength == PX_STRING_INLINE_CAPACITY + 1);
+    REQUIRE(pxStringBytes(&longString) == longString.data.bytes);
+    REQUIRE(toStd(longString) == "sixteen bytes!!!");
+}
+
+TEST_CASE("String length counts code points") {
+    PxString str = make(u8"héllo 世界 \U0001F600");
+    REQUIRE(str.length == 10);
+    REQUIRE(str.byteLength == 18);
+}
+
+TEST_CASE("String concat") {
+    REQUIRE(toStd(pxStringConcat(make("ab"), make("cd"))) == "abcd");
+    REQUIRE(toStd(pxStringConcat(make(""), make("cd"))) == "cd");
+    REQUIRE(toStd(pxStringConcat(make("ab"), make(""))) == "ab");
+
+    PxString crossing = pxStringConcat(make("0123456789"), make("abcdefghij"));
+    REQUIRE(crossing.length == 20);
+    REQUIRE(toStd(crossing) == "0123456789abcdefghij");
+
+    PxString mixed = pxStringConcat(make(u8"é"), make(u8"世"));
+    REQUIRE(mixed.length == 2);
+    REQUIRE(mixed.byteLength == 5);
+}
+
+TEST_CASE("String concat extends the last string in place") {
+    PxString first = make("a string longer than inline");
+    PxString grown = pxStringConcat(first, make(" and more"));
+    REQUIRE(grown.data.bytes == first.data.bytes);
+    REQUIRE(toStd(first) == "a string longer than inline");
+    REQUIRE(toStd(grown) == "a string longer than inline and more");
+
+    // first no longer ends the arena, so appending to it again must copy rather than overwrite grown
+    PxString other = pxStringConcat(first, make(" and less"));
+    REQUIRE(other.data.bytes != first.data.bytes);
+    REQUIRE(toStd(grown) == "a string longer than inline and more");
+    REQUIRE(toStd(other) == "a string longer than inline and less");
+
+    std::string expected;
+    PxString built = make("");
+    for (int i = 0; i < 10000; ++i)
+    {
+        built = pxStringConcat(built, make("xyz"));
+        expected += "xyz";
+    }
+    REQUIRE(toStd(built) == expected);
+    REQUIRE(built.length == 30000);
+}
+
+TEST_CASE("String equals") {
+    REQUIRE(pxStringEquals(make("abc"), make("abc")));
+    REQUIRE(!pxStringEquals(make("abc"), make("abd")));
+    REQUIRE(!pxStringEquals(make("abc"), make("abcd")));
+    REQUIRE(pxStringEquals(make(""), make("")));
+    REQUIRE(pxStringEquals(make("a long string to compare"), make("a long string to compare")));
+    REQUIRE(!pxStringEquals(make("a long string to compare"), make("a long string to comparE")));
+}
+
+TEST_CASE("String compare") {
+    REQUIRE(pxStringCompare(make("abc"), make("abc")) == 0);
+    REQUIRE(pxStringCompare(make("abc"), make("abd")) < 0);
+    REQUIRE(pxStringCompare(make("abd"), make("abc")) > 0);
+    REQUIRE(pxStringCompare(make("ab"), make("abc")) < 0);
+    REQUIRE(pxStringCompare(make("abc"), make("ab")) > 0);
+    REQUIRE(pxStringCompare(make(""), make("a")) < 0);
+    REQUIRE(pxStringCompare(make("z"), make(u8"é")) < 0);
+    REQUIRE(pxStringCompare(make(u8"￿"), make(u8"\U00010000")) < 0);
+}
+
+TEST_CASE("String charAt") {
+    PxString ascii = make("hello");
+    REQUIRE(pxStringCharAt(ascii, 0) == 'h');
+    REQUIRE(pxStringCharAt(ascii, 4) == 'o');
+    REQUIRE(pxStringCharAt(ascii, 5) == -1);
+    REQUIRE(pxStringCharAt(ascii, -1) == -1);
+
+    PxString utf8 = make(u8"aé世\U0001F600b");
+    REQUIRE(pxStringCharAt(utf8, 0) == 'a');
+    REQUIRE(pxStringCharAt(utf8, 1) == 0xe9);
+    REQUIRE(pxStringCharAt(utf8, 2) == 0x4e16);
+    REQUIRE(pxStringCharAt(utf8, 3) == 0x1F600);
+    REQUIRE(pxStringCharAt(utf8, 4) == 'b');
+}
+
+TEST_CASE("String slice") {
+    PxString str = make("the quick brown fox jumps");
+    PxString quick = pxStringSlice(str, 4, 9);
+    REQUIRE(toStd(quick) == "quick");
+    REQUIRE(quick.length == 5);
+
+    PxString tail = pxStringSlice(str, 4, 100);
+    REQUIRE(toStd(tail) == "quick brown fox jumps");
+    REQUIRE(tail.data.bytes == str.data.bytes + 4);
+
+    REQUIRE(toStd(pxStringSlice(str, -3, 3)) == "the");
+    REQUIRE(pxStringSlice(str, 10, 5).length == 0);
+
+    PxString utf8 = make(u8"aé世\U0001F600b");
+    PxString middle = pxStringSlice(utf8, 1, 4);
+    REQUIRE(middle.length == 3);
+    REQUIRE(toStd(middle) == u8"é世\U0001F600");
+    REQUIRE(toStd(pxStringSlice(utf8, 4, 5)) == "b");
+}
+
+TEST_CASE("String hash") {
+    REQUIRE(pxStringHash(make("abc")) == pxStringHash(make("abc")));
+    REQUIRE(pxStringHash(make("abc")) != pxStringHash(make("abd")));
+    REQUIRE(pxStringHash(make("")) != pxStringHash(make("a")));
+    PxString longString = make("a string longer than inline storage");
+    REQUIRE(pxStringHash(longString) == pxStringHash(pxStringSlice(pxStringConcat(make("x"), longString), 1, 100)));
+}
+
+TEST_CASE("String arena is per thread") {
+    PxString mainString = make("created by the main thread's arena");
+    std::string fromThread;
+    std::thread worker([&fromThread, mainString] {
+        PxString str = pxStringConcat(mainString, make(" plus a worker suffix"));
+        fromThread = toStd(str);
+        pxStringArenaReset();
+    });
+    worker.join();
+    REQUIRE(fromThread == "created by the main thread's arena plus a worker suffix");
+    REQUIRE(toStd(mainString) == "created by the main thread's arena");
+}
+
+static std::string finish(PxStringBuilder *builder)
+{
+    return toStd(finishStringBuilder(builder));
+}
+
+TEST_CASE("StringBuilder appends every builtin type") {
+    PxStringBuilder *builder = newStringBuilder();
+    appendInt(builder, -42);
+    appendChar(builder, ' ');
+    appendInt64(builder, INT64_MIN);
+    appendChar(builder, ' ');
+    appendUInt64(builder, UINT64_MAX);
+    appendChar(builder, ' ');
+    appendFloat(builder, 0.1f);
+    appendChar(builder, ' ');
+    appendFloat64(builder, 1e300);
+    appendChar(builder, ' ');
+    appendBool(builder, true);
+    appendBool(builder, false);
+    appendChar(builder, 0xe9);
+    appendChar(builder, 0x4e16);
+    appendChar(builder, 0x1F600);
+    appendString(builder, make(u8"€!"));
+    REQUIRE(builder->length == 71);
+    REQUIRE(finish(builder) == u8"-42 -9223372036854775808 18446744073709551615 0.1 1e+300 truefalseé世\U0001F600€!");
+}
+
+TEST_CASE("StringBuilder finish") {
+    PxStringBuilder *builder = newStringBuilder();
+    PxString empty = finishStringBuilder(builder);
+    REQUIRE(empty.length == 0);
+    REQUIRE(empty.byteLength == 0);
+
+    appendString(builder, make("short"));
+    PxString shortString = finishStringBuilder(builder);
+    REQUIRE(pxStringBytes(&shortString) == shortString.data.inlineBytes);
+    REQUIRE(toStd(shortString) == "short");
+    REQUIRE(builder->byteLength == 0);
+
+    // Long results take over the buffer rather than copying it
+    appendString(builder, make("a string longer than inline"));
+    const int8_t *buffer = builder->bytes;
+    PxString longString = finishStringBuilder(builder);
+    REQUIRE(longString.data.bytes == buffer);
+    REQUIRE(toStd(longString) == "a string longer than inline");
+
+    // The builder starts over, leaving the finished string untouched
+    appendString(builder, make("another string, also long"));
+    REQUIRE(finish(builder) == "another string, also long");
+    REQUIRE(toStd(longString) == "a string longer than inline");
+}
+
+TEST_CASE("StringBuilder grows geometrically") {
+    PxStringBuilder *builder = newStringBuilder();
+    reserveStringBuilder(builder, 1000);
+    REQUIRE(builder->capacity >= 1000);
+
+    std::string expected;
+    intptr_t growths = 0, capacity = builder->capacity;
+    for (int i = 0; i < 200000; ++i)
+    {
+        appendInt(builder, i);
+        expected += std::to_string(i);
+        if (builder->capacity != capacity)
+        {
+            REQUIRE(builder->capacity >= capacity * 2);
+            capacity = builder->capacity;
+            ++growths;
+        }
+    }
+    REQUIRE(growths < 20);
+    REQUIRE(finish(builder) == expected);
+}
@@ -85,3 +85,14 @@ TEST_CASE("SymbolTable get local variables") {
     REQUIRE(std::count(result.begin(), result.end(), myInt) == 1);
     REQUIRE(std::count(result.begin(), result.end(), myChar) == 1);
 }
+
+TEST_CASE("SymbolTable globals include the string builder") {
+    px::SymbolTable table;
+    table.addGlobals();
+
+    REQUIRE(table.getType("StringBuilder") == px::Type::STRING_BUILDER);
+    REQUIRE(px::Type::STRING_BUILDER->isStringBuilder());
+    REQUIRE(table.getFunction("newStringBuilder")->returnType == px::Type::STRING_BUILDER);
+    REQUIRE(table.getFunction("finishStringBuilder")->returnType == px::Type::STRING);
+    REQUIRE(table.getFunction("appendFloat64")->parameters[1]->type == px::Type::FLOAT64);
+}
@@ -164,6 +164,16 @@ TEST_CASE("Ut8fString greater than") {
     REQUIRE(text1 > text2);
 }
 
+TEST_CASE("Ut8fString starts and ends with") {
+    px::Utf8String text{ std::string{ u8"こんにちは世界" } };
+    REQUIRE(text.startsWith(std::string{ u8"こん" }));
+    REQUIRE(!text.startsWith(std::string{ u8"世界" }));
+    REQUIRE(text.endsWith(std::string{ u8"世界" }));
+    REQUIRE(!text.endsWith(std::string{ u8"こん" }));
+    REQUIRE(!px::Utf8String{ std::string{ "[]" } }.endsWith(std::string{ "int64[]" }));
+    REQUIRE(px::Utf8String{ std::string{ "int64[]" } }.endsWith(std::string{ "[]" }));
+}
+
 TEST_CASE("Ut8fString clear") { ;
     std::string input = u8"Falsches Üben von Xylophonmusik quält jeden größeren Zwerg";
     px::Utf8String text{ input };
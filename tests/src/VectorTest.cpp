@@ -0,0 +1,88 @@
+#include "catch.hpp"
+
+extern "C" {
+    #include <PxRuntime.h>
+}
+
+TEST_CASE("Vector push and pop") {
+    PxVector vector = pxVectorCreate();
+    REQUIRE(vector.length == 0);
+    for (int64_t i = 0; i < 1000; ++i)
+        *(int64_t*) pxVectorPush(&vector, sizeof(int64_t)) = i * 3;
+    REQUIRE(vector.length == 1000);
+    REQUIRE(vector.capacity >= 1000);
+    REQUIRE(((int64_t*) vector.data)[999] == 2997);
+    REQUIRE(((int64_t*) vector.data)[pxVectorPop(&vector)] == 2997);
+    REQUIRE(((int64_t*) vector.data)[pxVectorPop(&vector)] == 2994);
+    REQUIRE(vector.length == 998);
+}
+
+TEST_CASE("Vector reserve grows by the growth factor") {
+    PxVector vector = pxVectorCreate();
+    pxVectorReserve(&vector, 1, sizeof(int32_t));
+    REQUIRE(vector.capacity == 4);
+    for (int32_t i = 0; i < 5; ++i)
+        *(int32_t*) pxVectorPush(&vector, sizeof(int32_t)) = i;
+    REQUIRE(vector.capacity == 8);
+    pxVectorReserve(&vector, 100, sizeof(int32_t));
+    REQUIRE(vector.capacity == 105);
+    REQUIRE(((int32_t*) vector.data)[4] == 4);
+
+    pxVectorSetGrowthFactor(1.5);
+    PxVector other = pxVectorCreate();
+    pxVectorReserve(&other, 8, sizeof(int32_t));
+    other.length = 8;
+    pxVectorReserve(&other, 1, sizeof(int32_t));
+    REQUIRE(other.capacity == 12);
+    pxVectorSetGrowthFactor(0.5);
+    other.length = 12;
+    pxVectorReserve(&other, 1, sizeof(int32_t));
+    REQUIRE(other.capacity == 13);
+    pxVectorSetGrowthFactor(2.0);
+}
+
+TEST_CASE("Vector grows in place at the end of its region") {
+    pxRegionEnter();
+    PxVector vector = pxVectorCreate();
+    pxVectorReserve(&vector, 16, sizeof(int64_t));
+    void *data = vector.data;
+    vector.length = 16;
+    pxVectorReserve(&vector, 1, sizeof(int64_t));
+    REQUIRE(vector.data == data);
+    REQUIRE(vector.capacity == 32);
+
+    // Once something else is allocated after it, the buffer moves
+    pxNew(8);
+    vector.length = 32;
+    ((int64_t*) vector.data)[31] = 7;
+    pxVectorReserve(&vector, 1, sizeof(int64_t));
+    REQUIRE(vector.data != data);
+    REQUIRE(((int64_t*) vector.data)[31] == 7);
+    pxRegionExit();
+}
+
+TEST_CASE("Vector assign and append") {
+    const int32_t values[] = { 1, 2, 3, 4, 5, 6 };
+    PxVector vector = pxVectorFromElements(values, 3, sizeof(int32_t));
+    REQUIRE(vector.length == 3);
+    REQUIRE(vector.data != values);
+
+    pxVectorAssign(&vector, values + 1, 2, sizeof(int32_t));
+    REQUIRE(vector.length == 2);
+    REQUIRE(((int32_t*) vector.data)[0] == 2);
+    pxVectorAssign(&vector, values, 6, sizeof(int32_t));
+    REQUIRE(vector.length == 6);
+    REQUIRE(((int32_t*) vector.data)[5] == 6);
+
+    // Appending a vector to itself doubles it
+    pxVectorAppend(&vector, &vector, sizeof(int32_t));
+    REQUIRE(vector.length == 12);
+    REQUIRE(((int32_t*) vector.data)[6] == 1);
+    REQUIRE(((int32_t*) vector.data)[11] == 6);
+
+    PxVector empty = pxVectorCreate();
+    pxVectorAppend(&vector, &empty, sizeof(int32_t));
+    REQUIRE(vector.length == 12);
+    pxVectorAssign(&vector, nullptr, 0, sizeof(int32_t));
+    REQUIRE(vector.length == 0);
+}
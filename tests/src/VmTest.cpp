@@ -0,0 +1,165 @@
+#include <sstream>
+#include "catch.hpp"
+#include <ContextAnalyzer.h>
+#include <Parser.h>
+#include <vm/BytecodeCompiler.h>
+#include <vm/Interpreter.h>
+#include <vm/Repl.h>
+#include <vm/TieredCompiler.h>
+
+static std::unique_ptr<px::Program> compileModule(const char *source)
+{
+    px::ErrorLog errors;
+    px::Parser parser(&errors);
+    px::Utf8String name{"myModule.px"};
+    std::stringstream input{ std::string{ source } };
+    auto module = parser.parse(name, input);
+    px::ScopeTree scopeTree;
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+    analyzer.analyze(*module);
+    REQUIRE(errors.count() == 0);
+
+    px::BytecodeCompiler compiler{ &scopeTree, &errors };
+    auto program = compiler.compile(*module);
+    REQUIRE(errors.count() == 0);
+    return program;
+}
+
+// Compiles source to bytecode and runs it, giving what main returns
+static int32_t runModule(const char *source)
+{
+    auto program = compileModule(source);
+    px::Interpreter interpreter{ *program };
+    return interpreter.run();
+}
+
+static uint32_t functionNamed(const px::Program &program, const char *name)
+{
+    for (uint32_t i = 0; i < program.functions.size(); ++i)
+    {
+        if (program.functions[i].name == px::Utf8String{ name })
+            return i;
+    }
+    FAIL(name);
+    return 0;
+}
+
+TEST_CASE("VM calls and arithmetic") {
+    REQUIRE(runModule("module myModule; func fib(n: int32) : int32 { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+                      "func main() : int32 { return fib(20); }") == 6765);
+    // Narrow integers wrap around at their own width
+    REQUIRE(runModule("module myModule; func main() : int32 { x: int8 = 100_i8; x += 100_i8; y: uint8 = 250_u8; y += 10_u8; return x as int32 * 100 + y as int32; }") == -5600 + 4);
+    REQUIRE(runModule("module myModule; func main() : int32 { f: float64 = 7.5 / 2.5; g: float32 = 2.25_f32 * 4.0_f32; return f as int32 + g as int32; }") == 12);
+    // Negative literals keep values outside of int32, as they do in C
+    REQUIRE(runModule("module myModule; func main() : int32 { y: int64 = -3000000000; z: int64 = y / 1000000; return z as int32; }") == -3000);
+    REQUIRE(runModule("module myModule; func main() : int32 { y: int64 = -2147483649; z: int64 = y / 1000; return z as int32; }") == -2147483);
+    REQUIRE(runModule("module myModule; func main() : int32 { y: int64 = -9223372036854775807; z: int64 = y / 1000000000000; return z as int32; }") == -9223372);
+    REQUIRE(runModule("module myModule; func main() : int32 { y: uint8 = -1_u8; return y as int32; }") == 255);
+    REQUIRE(runModule("module myModule; total: int64 = 5; func add(x: int64) : void { total += x; }"
+                      "func main() : int32 { add(10); add(20); return total as int32; }") == 35);
+}
+
+TEST_CASE("VM control flow") {
+    REQUIRE(runModule("module myModule; func main() : int32 { sum: int32 = 0; for i in 0..10 { if (i == 7) { break; } if (i % 2 == 0) { continue; } sum += i; }"
+                      "j: int32 = 0; while (j < 5) { j += 2; } do { j -= 1; } while (j > 3) return sum * 10 + j; }") == 93);
+    REQUIRE(runModule("module myModule; func pick(x: int32) : int32 { switch (x) { case 1, 2: return 10; case 100000: return 20; case -5: return 30; default: return 40; } }"
+                      "func main() : int32 { return pick(1) + pick(2) + pick(100000) + pick(-5) + pick(3); }") == 110);
+    // A few cases spread far apart are searched rather than given a table that spans them
+    REQUIRE(runModule("module myModule; func pick(x: int32) : int32 { switch (x) { case 0: return 1; case 200000000: return 2; default: return 3; } }"
+                      "func main() : int32 { return pick(0) * 100 + pick(200000000) * 10 + pick(5); }") == 123);
+    REQUIRE(runModule("module myModule; func pick(x: int64) : int32 { switch (x) { case 1: return 1; case 9000000000: return 2; default: return 3; } }"
+                      "func main() : int32 { return pick(1) * 100 + pick(9000000000) * 10 + pick(2); }") == 123);
+    REQUIRE(runModule("module myModule; func main() : int32 { a: bool = true; b: bool = false; return (a && b == false ? 1 : 0) + (b || a ? 2 : 0); }") == 3);
+}
+
+TEST_CASE("VM strings and arrays") {
+    REQUIRE(runModule("module myModule; func main() : int32 { s: string = \"ab\"; s += \"cd\"; t: string = s + \" and a longer tail\";"
+                      "return (s == \"abcd\" ? 1 : 0) + (\"abc\" < s ? 2 : 0) + (t != s ? 4 : 0); }") == 7);
+    REQUIRE(runModule("module myModule; func sum(values: int32[4]) : int32 { total: int32 = 0; for i in 0..4 { total += values[i]; } return total; }"
+                      "func main() : int32 { values: int32[4] = [1, 2, 3, 4]; values[3] = 10; return sum(values); }") == 16);
+    REQUIRE(runModule("module myModule; func fill(values: int64[], count: int64) : void { for i in 0..count { push(values, i * i); } }"
+                      "func main() : int32 { values: int64[] = [5]; fill(values, 4); last: int64 = pop(values); total: int64 = length(values) * 100 + last + values[0]; return total as int32; }") == 414);
+}
+
+TEST_CASE("VM tiered compilation") {
+    const char *source = "module myModule; total: int64 = 0; func bump() : void { total += 1; }"
+                         "func fib(n: int32) : int32 { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+                         "func count() : int32 { bump(); return fib(15); }"
+                         "func main() : int32 { return fib(20) + count(); }";
+    auto program = compileModule(source);
+    px::Interpreter interpreter{ *program };
+    px::TieringOptions options{ 100, false, 0, false };
+    px::TieredCompiler tiers{ *program, interpreter, "myModule.px", source, options };
+    REQUIRE(tiers.uncompilable(functionNamed(*program, "fib")).length() == 0);
+    REQUIRE(tiers.uncompilable(functionNamed(*program, "bump")) == px::Utf8String{ "it uses module variables" });
+    REQUIRE(tiers.uncompilable(functionNamed(*program, "count")) == px::Utf8String{ "it calls bump, which can not be compiled" });
+
+    interpreter.setTiering(&tiers, options.threshold, options.timed);
+    REQUIRE(interpreter.run() == 6765 + 610);
+    tiers.finish();
+    auto events = tiers.events();
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].function == px::Utf8String{ "fib" });
+    // Whether or not a C compiler was found to compile fib, the program gives the same answer
+    REQUIRE(interpreter.run() == 6765 + 610);
+}
+
+TEST_CASE("VM REPL inputs") {
+    px::Repl repl;
+    auto value = [&repl](const char *input) {
+        px::ReplResult result = repl.evaluate(px::Utf8String{ input });
+        REQUIRE(result.ok);
+        REQUIRE(result.type != nullptr);
+        return result.value;
+    };
+    REQUIRE(repl.evaluate(px::Utf8String{ "func twice(x: int32) : int32 { return x * 2; }" }).ok);
+    REQUIRE(value("twice(21);").i == 42);
+    REQUIRE(repl.evaluate(px::Utf8String{ "total: int64 = 5; total += 10;" }).ok);
+    REQUIRE(value("total;").i == 15);
+    REQUIRE(value("total > 10 && twice(2) == 4;").i == 1);
+
+    // An input with errors leaves nothing behind, so it can be typed again
+    px::ReplResult failed = repl.evaluate(px::Utf8String{ "func next(x: int32) : int32 { return missing; }" });
+    REQUIRE(!failed.ok);
+    REQUIRE(repl.errors().count() == 1);
+    REQUIRE(repl.evaluate(px::Utf8String{ "func next(x: int32) : int32 { return twice(x) + 1; }" }).ok);
+    REQUIRE(value("next(total as int32);").i == 31);
+    REQUIRE(!repl.evaluate(px::Utf8String{ "func next(x: int32) : int32 { return x; }" }).ok);
+
+    // Statements give no value
+    px::ReplResult statement = repl.evaluate(px::Utf8String{ "total = 1;" });
+    REQUIRE(statement.ok);
+    REQUIRE(statement.type == nullptr);
+    REQUIRE(value("total;").i == 1);
+}
+
+TEST_CASE("VM REPL inputs over several lines") {
+    px::Repl repl;
+    std::istringstream input{
+        "total: int64 = 0\n"
+        "names: string = \"a;}\"\n"
+        "for i in 0..4 {\n"
+        "    total += i\n"
+        "    if (i == 2)\n"
+        "        total += 10\n"
+        "    else if (i == 3) { total += 100 }\n"
+        "    else\n"
+        "        { total += 1000 }\n"
+        "    for j in 0..i\n"
+        "        total += 1\n"
+        "}\n"
+        "func add(x: int64,\n"
+        "         y: int64) : int64 {\n"
+        "    return x + y\n"
+        "}\n"
+        "do {\n"
+        "    total = add(total,\n"
+        "                1)\n"
+        "} while (total % 5 != 0)\n"
+    };
+    repl.run(input, false);
+    px::ReplResult total = repl.evaluate(px::Utf8String{ "total;" });
+    REQUIRE(total.ok);
+    REQUIRE(total.value.i == 2125);
+    REQUIRE(repl.evaluate(px::Utf8String{ "names == \"a;}\";" }).value.i == 1);
+}
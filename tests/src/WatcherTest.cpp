@@ -0,0 +1,82 @@
+#include <fstream>
+#include <sstream>
+#include "catch.hpp"
+#include <ContextAnalyzer.h>
+#include <ModuleInterface.h>
+#include <Parser.h>
+#include <Watcher.h>
+
+#if defined(__linux__)
+#include <sys/stat.h>
+
+static void writeModule(const std::string &path, const std::string &source)
+{
+    std::ofstream out{ path, std::ios::trunc };
+    out << source;
+}
+
+// Analyzes the module and writes its interface next to it, as pxc does
+static bool compileModule(const std::string &path)
+{
+    px::Utf8String fileName{ path };
+    px::ScopeTree scopeTree;
+    px::ErrorLog errors;
+    px::InterfaceCache interfaces;
+    px::Parser parser{ &errors };
+    std::ifstream in{ path };
+    auto module = parser.parse(fileName, in);
+    px::ContextAnalyzer analyzer{ scopeTree.current(), &errors };
+    analyzer.useInterfaces(&interfaces);
+    analyzer.analyze(*module);
+    if (errors.count() > 0)
+        return false;
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    return px::ModuleInterface::write(directory + module->moduleName.toString() + ".pxi", module->moduleName,
+                                      px::ModuleInterface::exports(*analyzer.moduleScope()->symbols()));
+}
+
+TEST_CASE("Watcher compiles only the modules a change affects") {
+    const std::string directory = "watched";
+    mkdir(directory.c_str(), 0755);
+    const std::string lib = "module lib; func square(x: int32) : int32 { return x * x; }\n";
+    const std::string app = "module app; import lib; func main() : int32 { return square(3); }\n";
+    writeModule(directory + "/lib.px", lib);
+    writeModule(directory + "/app.px", app);
+
+    std::stringstream log;
+    std::vector<std::string> compiled;
+    px::Watcher watcher{ directory, 20, [&](const std::string &path) {
+        compiled.push_back(path);
+        return compileModule(path);
+    }, log };
+    REQUIRE(watcher.start());
+    REQUIRE(compiled == std::vector<std::string>{ "watched/lib.px", "watched/app.px" });
+
+    // A body that changed leaves lib's interface as it was, so app is not compiled again
+    writeModule(directory + "/app.px", "module app; import lib; func main() : int32 { return square(4); }\n");
+    REQUIRE(watcher.waitAndRebuild(2000) == std::vector<std::string>{ "app.px" });
+    writeModule(directory + "/lib.px", "module lib; func square(x: int32) : int32 { return x * x * 1; }\n");
+    REQUIRE(watcher.waitAndRebuild(2000) == std::vector<std::string>{ "lib.px" });
+
+    // A new function changes the interface, which app imports
+    writeModule(directory + "/lib.px", lib + "func cube(x: int32) : int32 { return x * x * x; }\n");
+    REQUIRE(watcher.waitAndRebuild(2000) == std::vector<std::string>{ "lib.px", "app.px" });
+
+    // Saving the same text compiles nothing
+    writeModule(directory + "/lib.px", lib + "func cube(x: int32) : int32 { return x * x * x; }\n");
+    REQUIRE(watcher.waitAndRebuild(2000).empty());
+    REQUIRE(log.str().find("Compiled lib.px, app.px in ") != std::string::npos);
+    REQUIRE(log.str().find("after the first change") != std::string::npos);
+
+    // A module that does not compile is reported as failed rather than compiled
+    log.str("");
+    writeModule(directory + "/app.px", "module app; import lib; func main() : int32 { return missing(3); }\n");
+    REQUIRE(watcher.waitAndRebuild(2000) == std::vector<std::string>{ "app.px" });
+    REQUIRE(log.str().find("app.px failed in ") == 0);
+    writeModule(directory + "/lib.px", lib);
+    writeModule(directory + "/app.px", app);
+    REQUIRE(watcher.waitAndRebuild(2000) == std::vector<std::string>{ "lib.px", "app.px" });
+    REQUIRE(log.str().find("Compiled lib.px, app.px in ") != std::string::npos);
+}
+
+#endif